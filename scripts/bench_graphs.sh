@@ -0,0 +1,60 @@
+#!/bin/bash
+# time the graph stages of crass on the test datasets
+#
+# usage: bench_graphs.sh [-r runs] [-c crass binary] [-t threads] [dataset ...]
+# with no datasets every file in test/ is used. crass logs how long
+# buildGraph, cleanGraph, buildSpacerGraph, cleanSpacerGraph and splitContigs took
+# summed over all the groups, and the wall time for assembling all the
+# groups. The best time of each over all the runs is reported
+
+RUNS=3
+CRASS=crass
+THREADS=1
+while getopts ":r:c:t:" opt; do
+    case $opt in
+        r)
+            RUNS=$OPTARG
+            ;;
+        c)
+            CRASS=$OPTARG
+            ;;
+        t)
+            THREADS=$OPTARG
+            ;;
+        \?)
+            echo "Invalid option: -$OPTARG" >&2
+            exit 1
+            ;;
+        :)
+            echo "Option -$OPTARG requires an argument." >&2
+            exit 1
+            ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+DATASETS="$@"
+if [ -z "$DATASETS" ]; then
+    DATASETS=$(ls $(dirname $0)/../test/*)
+fi
+
+WORK=$(mktemp -d)
+trap "rm -rf $WORK" EXIT
+
+printf "%-30s %16s %16s %16s %16s %16s %16s\n" dataset buildGraph cleanGraph buildSpacerGraph cleanSpacerGraph splitContigs assembly
+for f in $DATASETS; do
+    rm -f $WORK/times
+    for run in $(seq $RUNS); do
+        out=$WORK/run_$run
+        mkdir -p $out
+        $CRASS -o $out -l 1 -t $THREADS $f > /dev/null 2>&1
+        grep -h "Graph timing:" $out/*.log >> $WORK/times
+        rm -rf $out
+    done
+    printf "%-30s" $(basename $f)
+    for stage in buildGraph cleanGraph buildSpacerGraph cleanSpacerGraph splitContigs assembly; do
+        best=$(grep "Graph timing: $stage " $WORK/times | sed 's/.* \([0-9.e+-]*\)s$/\1/' | sort -g | head -1)
+        printf " %16s" ${best:-NA}
+    done
+    printf "\n"
+done
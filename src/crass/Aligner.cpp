@@ -31,44 +31,99 @@
  *                              A B
  *                               A
  */
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <pthread.h>
 #include "Exception.h"
 #include "Aligner.h"
 #include "LoggerSimp.h"
 #include "SeqUtils.h"
+#include "Pileup.h"
 
-const unsigned char Aligner::seq_nt4_table[256] = {
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4
-    };
-
-// will convert any char to an A if it is not C,G,T
-const char Aligner::CHAR_TO_INDEX[128] = {
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 4, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 4, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
-    };
+// one pool per thread, made the first time the thread asks for it
+static pthread_key_t pool_key;
+static pthread_once_t pool_key_once = PTHREAD_ONCE_INIT;
 
+static void deletePool(void * pool) {
+    delete static_cast<AlignerBufferPool *>(pool);
+}
+
+static void makePoolKey(void) {
+    pthread_key_create(&pool_key, deletePool);
+}
+
+AlignerBufferPool * AlignerBufferPool::threadPool(void) {
+    pthread_once(&pool_key_once, makePoolKey);
+    AlignerBufferPool * pool = static_cast<AlignerBufferPool *>(pthread_getspecific(pool_key));
+    if (pool == NULL) {
+        pool = new AlignerBufferPool;
+        pthread_setspecific(pool_key, pool);
+    }
+    return pool;
+}
+
+AlignerBufferPool::~AlignerBufferPool() {
+    std::vector<AlignerBuffers *>::iterator iter;
+    for (iter = ABP_free.begin(); iter != ABP_free.end(); ++iter) {
+        delete *iter;
+    }
+}
+
+AlignerBuffers * AlignerBufferPool::acquire(void) {
+    if (ABP_free.empty()) {
+        return new AlignerBuffers;
+    }
+    AlignerBuffers * buffers = ABP_free.back();
+    ABP_free.pop_back();
+    return buffers;
+}
+
+void AlignerBufferPool::release(AlignerBuffers * buffers) {
+    if (ABP_free.size() < CRASS_DEF_MAX_POOLED_ALIGNER_BUFFERS) {
+        ABP_free.push_back(buffers);
+    } else {
+        delete buffers;
+    }
+}
+
+bool AlignmentCache::find(StringToken master, StringToken slave, kswr_t& forward, kswr_t& reverse) {
+    ++AC_lookups;
+    CRASS_HASH_MAP<uint64_t, kswr_t>::iterator forward_iter = AC_alignments.find(key(master, slave, false));
+    if (forward_iter == AC_alignments.end()) {
+        return false;
+    }
+    CRASS_HASH_MAP<uint64_t, kswr_t>::iterator reverse_iter = AC_alignments.find(key(master, slave, true));
+    if (reverse_iter == AC_alignments.end()) {
+        return false;
+    }
+    forward = forward_iter->second;
+    reverse = reverse_iter->second;
+    ++AC_hits;
+    return true;
+}
+
+void AlignmentCache::add(StringToken master, StringToken slave, const kswr_t& forward, const kswr_t& reverse) {
+    AC_alignments[key(master, slave, false)] = forward;
+    AC_alignments[key(master, slave, true)] = reverse;
+}
+
+void AlignmentCache::addReversed(StringToken master, StringToken slave, StringToken reversedSlave) {
+    CRASS_HASH_MAP<uint64_t, kswr_t>::iterator forward_iter = AC_alignments.find(key(master, slave, false));
+    CRASS_HASH_MAP<uint64_t, kswr_t>::iterator reverse_iter = AC_alignments.find(key(master, slave, true));
+    if (forward_iter != AC_alignments.end() && reverse_iter != AC_alignments.end()) {
+        // copy them out first, the inserts can rehash
+        kswr_t forward = forward_iter->second;
+        kswr_t reverse = reverse_iter->second;
+        add(master, reversedSlave, reverse, forward);
+    }
+}
+
+void AlignmentCache::clear(void) {
+    AC_alignments.clear();
+    AC_lookups = AC_hits = 0;
+}
 
 void Aligner::setMasterDR(StringToken master) {
     AL_masterDRToken = master;
@@ -77,11 +132,11 @@ void Aligner::setMasterDR(StringToken master) {
         // could not be found, through exception
         logError("cannot find the token for DR string "<< master_string);
     }
-    AL_Offsets[AL_masterDRToken] = (int)(AL_length * CRASS_DEF_CONS_ARRAY_START);
+    // everything is placed relative to the start of the master until the
+    // arrays are sized in fillCoverageArray. The master sits well away from
+    // zero so no slave can end up on the -1 used for unaligned DRs
+    AL_Offsets[AL_masterDRToken] = AL_ORIGIN;
     prepareMasterForAlignment(master_string);
-    placeReadsInCoverageArray(AL_masterDRToken);
-    calculateDRZone();
-    
 }
 
 void Aligner::alignSlave(StringToken& slaveDRToken) {
@@ -92,7 +147,7 @@ void Aligner::alignSlave(StringToken& slaveDRToken) {
     logInfo("aligning slave" << slaveDR << " ("<<slaveDRToken<<")", 6)
 #endif
     AlignerFlag_t flags;
-    int offset = getOffsetAgainstMaster(slaveDR, flags);
+    int offset = getOffsetAgainstMaster(slaveDR, flags, slaveDRToken);
     
     if (flags[score_equal]) {
 #ifdef DEBUG
@@ -141,15 +196,29 @@ void Aligner::alignSlave(StringToken& slaveDRToken) {
         }
         // fix the places where the DR is stored
         
-        slaveDR = reverseComplement(slaveDR);
+        reverseComplementInPlace(slaveDR);
         StringToken st = mStringCheck->addString(slaveDR);
+        if (AL_cache != NULL) {
+            // the reversed DR is what the children of this group will see
+            AL_cache->addReversed(AL_masterDRToken, slaveDRToken, st);
+        }
         (*mReads)[st] = (*mReads)[slaveDRToken];
         (*mReads)[slaveDRToken] = NULL;
         slaveDRToken = st;
     }
     //std::cerr << AL_Offsets[AL_masterDRToken] +  offset <<std::endl;
     AL_Offsets[slaveDRToken] = AL_Offsets[AL_masterDRToken] + offset;
-    placeReadsInCoverageArray(slaveDRToken);
+}
+
+void Aligner::alignSlaves(DR_ClusterIterator begin, DR_ClusterIterator end) {
+    
+    while (begin != end) {
+        if (*begin != AL_masterDRToken) {
+            alignSlave(*begin);
+        }
+        ++begin;
+    }
+    fillCoverageArray();
 }
 
 void Aligner::generateConsensus() {
@@ -159,37 +228,15 @@ void Aligner::generateConsensus() {
     logInfo("DR zone: " << AL_ZoneStart << " -> " << AL_ZoneEnd, 1);
 #endif
 
-	// chars we luv!
-    char alphabet[4] = {'A', 'C', 'G', 'T'};
-
-	
-	// populate the conservation array
-    int num_GT_zero = 0;
-    for(int j = 0; j < AL_length; j++)
-	{
-		int max_count = 0;
-		float total_count = 0.0;
-		for(int i = 0; i < 4; i++)
-		{
-			
-			total_count += static_cast<float>(AL_coverage[coverageIndex(j,alphabet[i])]);
-			if(AL_coverage[coverageIndex(j,alphabet[i])] > max_count)
-			{
-				max_count = AL_coverage[coverageIndex(j,alphabet[i])];
-				AL_consensus[j] = alphabet[i];
-			}
-		}
-		// we need at least CRASS_DEF_MIN_READ_DEPTH reads to call a DR
-		if(total_count > CRASS_DEF_MIN_READ_DEPTH)
-		{
-			AL_conservation[j] = static_cast<float>(max_count)/total_count;
-			num_GT_zero++;
-		}
-		else
-		{
-			AL_conservation[j] = 0;
-		}
-	}
+	// populate the consensus and conservation arrays
+    // we need at least CRASS_DEF_MIN_READ_DEPTH reads to call a DR
+    std::vector<float>& conservation = AL_buffers->AB_conservation;
+    int num_GT_zero;
+    if (AL_wideCounts) {
+        num_GT_zero = pileupConsensus(&(AL_buffers->AB_coverage32[0]), AL_length, CRASS_DEF_MIN_READ_DEPTH, &(AL_buffers->AB_consensus[0]), &conservation[0]);
+    } else {
+        num_GT_zero = pileupConsensus(&(AL_buffers->AB_coverage16[0]), AL_length, CRASS_DEF_MIN_READ_DEPTH, &(AL_buffers->AB_consensus[0]), &conservation[0]);
+    }
     
     // trim these back a bit (if we trim too much we'll get it back right now anywho)
     // CTS: Not quite true, if it is low coverage then there will be no extension!
@@ -200,7 +247,7 @@ void Aligner::generateConsensus() {
         // first work from the left and trim back
 	    while(AL_ZoneStart > 0)
 	    {
-		    if(AL_conservation[AL_ZoneStart - 1] < CRASS_DEF_ZONE_EXT_CONS_CUT_OFF) 
+		    if(conservation[AL_ZoneStart - 1] < CRASS_DEF_ZONE_EXT_CONS_CUT_OFF) 
                 AL_ZoneStart++;
             else 
 			    break;
@@ -209,7 +256,7 @@ void Aligner::generateConsensus() {
 	    // next work from the right
 	    while(AL_ZoneEnd < AL_length - 1)
 	    {
-		    if(AL_conservation[AL_ZoneEnd + 1] < CRASS_DEF_ZONE_EXT_CONS_CUT_OFF)
+		    if(conservation[AL_ZoneEnd + 1] < CRASS_DEF_ZONE_EXT_CONS_CUT_OFF)
 			    AL_ZoneEnd--;
 		    else
 			    break;
@@ -218,7 +265,7 @@ void Aligner::generateConsensus() {
 	//same as the loops above but this time extend outward
 	while(AL_ZoneStart > 0)
 	{
-		if(AL_conservation[AL_ZoneStart - 1] >= CRASS_DEF_ZONE_EXT_CONS_CUT_OFF) 
+		if(conservation[AL_ZoneStart - 1] >= CRASS_DEF_ZONE_EXT_CONS_CUT_OFF) 
             AL_ZoneStart--;
         else 
 			break;    
@@ -227,7 +274,7 @@ void Aligner::generateConsensus() {
 	// next work to the right
 	while(AL_ZoneEnd < AL_length - 1)
 	{
-		if(AL_conservation[AL_ZoneEnd + 1] >= CRASS_DEF_ZONE_EXT_CONS_CUT_OFF)
+		if(conservation[AL_ZoneEnd + 1] >= CRASS_DEF_ZONE_EXT_CONS_CUT_OFF)
 			AL_ZoneEnd++;
 		else
 			break;
@@ -236,76 +283,160 @@ void Aligner::generateConsensus() {
 #ifdef DEBUG
     logInfo("DR zone (post fix): " << AL_ZoneStart << " -> " << AL_ZoneEnd, 1);
 #endif
+    
+    // checking the sample means going through every read again so only do it
+    // when someone is going to read about it
+    if (isSampled() && isLogging(4)) {
+        int different_bases;
+        float max_conservation_change;
+        compareWithFullConsensus(different_bases, max_conservation_change);
+        logInfo("Consensus made from " << AL_sampledReads << " of " << AL_totalReads << " reads: " << different_bases << " of " << (AL_ZoneEnd - AL_ZoneStart + 1) << " DR zone bases differ from the full consensus, largest conservation change " << max_conservation_change, 4);
+    }
 
 }
 
 void Aligner::prepareSequenceForAlignment(std::string& sequence, uint8_t *transformedSequence) {
 
     size_t seq_length = sequence.length();
-    size_t i;
-    for (i = 0; i < seq_length; ++i) 
-        transformedSequence[i] = seq_nt4_table[(int)sequence[i]];
+    nt4Encode(sequence, transformedSequence);
     
     // null terminate the sequences
     transformedSequence[seq_length] = '\0';
 
 }
 
-void Aligner::prepareSlaveForAlignment(std::string& slaveDR, 
-                                       uint8_t *slaveTransformedForward, 
-                                       uint8_t *slaveTransformedReverse) {
+void Aligner::prepareSlaveForAlignment(std::string& slaveDR) {
+    
+    size_t slave_dr_length = slaveDR.length();
+    // grow the scratch buffers if this is the longest slave seen so far
+    if (AL_slaveForward.size() < slave_dr_length + 1) {
+        AL_slaveForward.resize(slave_dr_length + 1);
+        AL_slaveReverse.resize(slave_dr_length + 1);
+        AL_slaveScratch.resize(slave_dr_length + 1);
+    }
+    prepareSequenceForAlignment(slaveDR, &AL_slaveForward[0]);
+    // the reverse is just the forward codes flipped, no need to go back to ASCII
+    memcpy(&AL_slaveReverse[0], &AL_slaveForward[0], slave_dr_length + 1);
+    nt4ReverseComplement(&AL_slaveReverse[0], slave_dr_length);
+}
+
+void Aligner::prepareMasterForAlignment(std::string& masterDR) {
+    freeMaster();
+    AL_masterDRLength = static_cast<int>(masterDR.length());
+    //AL_minAlignmentScore = static_cast<int>(AL_masterDRLength * 0.5);
+    AL_masterDR = new uint8_t[AL_masterDRLength+1];
+    prepareSequenceForAlignment(masterDR, AL_masterDR);
+    
+    // the master is the query for every slave so the profile only needs
+    // to be made once. Same size choice as ksw_align
+    AL_profileSize = (AL_xtra & KSW_XBYTE) ? 1 : 2;
+    AL_masterProfile = ksw_qinit(AL_profileSize, AL_masterDRLength, AL_masterDR, 5, AL_scoringMatrix);
+    
+    // room for the master with the start of an alignment turned around
+    if (AL_masterScratch.size() < static_cast<size_t>(AL_masterDRLength + 1)) {
+        AL_masterScratch.resize(AL_masterDRLength + 1);
+    }
+}
+
+void Aligner::freeMaster() {
+    if (AL_masterDR != NULL) {
+        delete [] AL_masterDR;
+        AL_masterDR = NULL;
+    }
+    // ksw_qinit uses malloc
+    if (AL_masterProfile != NULL) {
+        free(AL_masterProfile);
+        AL_masterProfile = NULL;
+    }
+}
+
+kswr_t Aligner::alignToMaster(const uint8_t * slave, int slaveLength) {
+    
+    kswr_t master_query;
+    if (AL_profileSize == 2) {
+        master_query = ksw_i16(AL_masterProfile, slaveLength, slave, AL_gapOpening, AL_gapExtension, AL_xtra);
+    } else {
+        master_query = ksw_u8(AL_masterProfile, slaveLength, slave, AL_gapOpening, AL_gapExtension, AL_xtra);
+    }
     
-    prepareSequenceForAlignment(slaveDR, slaveTransformedForward);
-    std::string revcomp_slave_dr = reverseComplement(slaveDR);
-    prepareSequenceForAlignment(revcomp_slave_dr, slaveTransformedReverse);
+    // the master was the query here, flip the coordinates around so that the
+    // master is the target and the slave the query like everywhere else.
+    // There is no query end for the second best hit so te2 stays where ksw
+    // put it, on the slave
+    kswr_t alignment;
+    alignment.score = master_query.score;
+    alignment.te = master_query.qe;
+    alignment.qe = master_query.te;
+    alignment.score2 = master_query.score2;
+    alignment.te2 = master_query.te2;
+    alignment.tb = alignment.qb = -1;
+    return alignment;
 }
 
-int Aligner::getOffsetAgainstMaster(std::string& slaveDR, AlignerFlag_t& flags) {
+void Aligner::findAlignmentStart(kswr_t& alignment, const uint8_t * slave) {
+    
+    if ((AL_xtra & KSW_XSTART) == 0 || alignment.qe < 0) {
+        return;
+    }
+    if ((AL_xtra & KSW_XSUBO) && alignment.score < (AL_xtra & 0xffff)) {
+        return;
+    }
+    
+    // the same start pass as ksw_align. The slave up to the end of the
+    // alignment, backwards, is the query and the master with everything up
+    // to the end of the alignment turned around is the target. It stops as
+    // soon as the best score turns up again. Only the winning orientation
+    // gets here so this is the one profile made per slave
+    int slave_prefix_length = alignment.qe + 1;
+    for (int i = 0; i < slave_prefix_length; ++i) {
+        AL_slaveScratch[i] = slave[alignment.qe - i];
+    }
+    for (int i = 0; i <= alignment.te; ++i) {
+        AL_masterScratch[i] = AL_masterDR[alignment.te - i];
+    }
+    memcpy(&AL_masterScratch[alignment.te + 1], AL_masterDR + alignment.te + 1, AL_masterDRLength - alignment.te - 1);
+    kswq_t * prefix_profile = ksw_qinit(AL_profileSize, slave_prefix_length, &AL_slaveScratch[0], 5, AL_scoringMatrix);
+    
+    kswr_t backwards;
+    if (AL_profileSize == 2) {
+        backwards = ksw_i16(prefix_profile, AL_masterDRLength, &AL_masterScratch[0], AL_gapOpening, AL_gapExtension, KSW_XSTOP | alignment.score);
+    } else {
+        backwards = ksw_u8(prefix_profile, AL_masterDRLength, &AL_masterScratch[0], AL_gapOpening, AL_gapExtension, KSW_XSTOP | alignment.score);
+    }
+    free(prefix_profile);
+    
+    if (alignment.score == backwards.score) {
+        alignment.tb = alignment.te - backwards.te;
+        alignment.qb = alignment.qe - backwards.qe;
+    }
+}
+
+int Aligner::getOffsetAgainstMaster(std::string& slaveDR, AlignerFlag_t& flags, StringToken slaveDRToken) {
 #ifdef DEBUG
     logInfo("getting offset of this slave against master DR", 6)
 #endif
     int slave_dr_length = static_cast<int>(slaveDR.length());
-    uint8_t* slave_dr_forward = new uint8_t[slave_dr_length+1];
-    uint8_t* slave_dr_reverse = new uint8_t[slave_dr_length+1];
-    
-    prepareSlaveForAlignment(slaveDR, slave_dr_forward, slave_dr_reverse);
-
-    // query profile 
-    kswq_t *slave_forward_query_profile = 0;
-    kswq_t *slave_reverse_query_profile = 0;
-    
-    
-    
-    // alignment of slave against master
-    kswr_t forward_return = ksw_align(slave_dr_length, 
-                                      slave_dr_forward, 
-                                      AL_masterDRLength, 
-                                      AL_masterDR, 
-                                      5, 
-                                      AL_scoringMatrix, 
-                                      AL_gapOpening, 
-                                      AL_gapExtension, 
-                                      AL_xtra, 
-                                      &slave_forward_query_profile);
-    
-    
-    kswr_t reverse_return = ksw_align(slave_dr_length, 
-                                      slave_dr_reverse, 
-                                      AL_masterDRLength, 
-                                      AL_masterDR, 
-                                      5, 
-                                      AL_scoringMatrix, 
-                                      AL_gapOpening, 
-                                      AL_gapExtension, 
-                                      AL_xtra, 
-                                      &slave_reverse_query_profile);
-    
-    
-    // free the query profile
-    free(slave_forward_query_profile); 
-    free(slave_reverse_query_profile);
-    delete [] slave_dr_reverse;
-    delete [] slave_dr_forward;
+    bool use_cache = (AL_cache != NULL && slaveDRToken != 0);
+    
+    // alignment of slave against master, unless an earlier Aligner has
+    // already done it. Cached alignments have the winner's start filled in
+    kswr_t forward_return, reverse_return;
+    if (! use_cache || ! AL_cache->find(AL_masterDRToken, slaveDRToken, forward_return, reverse_return)) {
+        prepareSlaveForAlignment(slaveDR);
+        forward_return = alignToMaster(&AL_slaveForward[0], slave_dr_length);
+        reverse_return = alignToMaster(&AL_slaveReverse[0], slave_dr_length);
+        
+        // only the winning orientation needs start positions
+        if(reverse_return.score > forward_return.score) {
+            findAlignmentStart(reverse_return, &AL_slaveReverse[0]);
+        } else if (forward_return.score > reverse_return.score) {
+            findAlignmentStart(forward_return, &AL_slaveForward[0]);
+        }
+        if (use_cache) {
+            AL_cache->add(AL_masterDRToken, slaveDRToken, forward_return, reverse_return);
+        }
+    }
+    
     // figure out which alignment was better
     if (reverse_return.score == forward_return.score) {
         flags[score_equal] = true;
@@ -318,6 +449,7 @@ int Aligner::getOffsetAgainstMaster(std::string& slaveDR, AlignerFlag_t& flags)
     } else {
         best_alignment_info = forward_return;
     }
+    
     int min_query_seq_coverage = static_cast<int>(slave_dr_length / 2);
 
     if(min_query_seq_coverage > best_alignment_info.score) {
@@ -332,7 +464,7 @@ int Aligner::getOffsetAgainstMaster(std::string& slaveDR, AlignerFlag_t& flags)
         logWarn("\tqe: "<< best_alignment_info.qe+1, 4);
         logWarn("\tscore: "<< best_alignment_info.score, 4);
         logWarn("\t2nd-score: "<< best_alignment_info.score2, 4);
-        logWarn("\t2nd-te: "<< best_alignment_info.te2, 4);
+        logWarn("\t2nd-te (slave): "<< best_alignment_info.te2, 4);
         logWarn("\toffset: "<<best_alignment_info.tb - best_alignment_info.qb,4);
         logWarn("******", 4);
         flags[failed] = true;
@@ -350,7 +482,7 @@ int Aligner::getOffsetAgainstMaster(std::string& slaveDR, AlignerFlag_t& flags)
         logWarn("\tqe: "<< best_alignment_info.qe+1, 4);
         logWarn("\tscore: "<< best_alignment_info.score, 4);
         logWarn("\t2nd-score: "<< best_alignment_info.score2, 4);
-        logWarn("\t2nd-te: "<< best_alignment_info.te2, 4);
+        logWarn("\t2nd-te (slave): "<< best_alignment_info.te2, 4);
         logWarn("\toffset: "<<best_alignment_info.tb - best_alignment_info.qb,4);
         logWarn("******", 4);
         flags[failed] = true;
@@ -361,17 +493,21 @@ int Aligner::getOffsetAgainstMaster(std::string& slaveDR, AlignerFlag_t& flags)
 
 }
 
-void Aligner::placeReadsInCoverageArray(StringToken& currentDrToken) {
+void Aligner::findPlacements(const ReadList& reads, 
+                             int drOffset, 
+                             int drLength, 
+                             std::vector<std::pair<ReadHolder *, int> >& placements, 
+                             int& lowest, 
+                             int& highest) {
 
-    ReadListIterator read_iter = mReads->at(currentDrToken)->begin();
-    int current_dr_length = static_cast<int>(mStringCheck->getString(currentDrToken).length());
+    ReadList::const_iterator read_iter = reads.begin();
     
-    while (read_iter != mReads->at(currentDrToken)->end()) 
+    while (read_iter != reads.end()) 
     {
         // don't care about partials
         int dr_start_index = 0;
         int dr_end_index = 1;
-        while(((*read_iter)->startStopsAt(dr_end_index) - (*read_iter)->startStopsAt(dr_start_index)) != (current_dr_length - 1))
+        while(((*read_iter)->startStopsAt(dr_end_index) - (*read_iter)->startStopsAt(dr_start_index)) != (drLength - 1))
         {
             dr_start_index += 2;
             dr_end_index += 2;
@@ -379,28 +515,14 @@ void Aligner::placeReadsInCoverageArray(StringToken& currentDrToken) {
         // go through every full length DR in the read and place in the array
         do
         {
-            if(((*read_iter)->startStopsAt(dr_end_index) - (*read_iter)->startStopsAt(dr_start_index)) == (current_dr_length - 1))
+            if(((*read_iter)->startStopsAt(dr_end_index) - (*read_iter)->startStopsAt(dr_start_index)) == (drLength - 1))
             {
                 // we need to find the first kmer which matches the mode.
-                int this_read_start_pos = AL_Offsets[currentDrToken] - (*read_iter)->startStopsAt(dr_start_index);
-                for(int i = 0; i < (int)(*read_iter)->getSeqLength(); i++)
-                {
-                    char current_nt = (*read_iter)->getSeqCharAt(i);
-                    int index_b = i+this_read_start_pos; 
-
-                    if((index_b) >= AL_length)
-                    {
-                        logError("***FATAL*** MEMORY CORRUPTION: The consensus/coverage arrays are too short");
-                    }
-                    if((index_b) < 0)
-                    {
-                        logError("***FATAL*** MEMORY CORRUPTION: index = "<< index_b<<" less than array begining");
-                    }
-                    if(coverageIndex(index_b,current_nt) >= (int)AL_coverage.size()) {
-                        logError("***FATAL*** MEMORY CORRUPTION: index = "<<coverageIndex(index_b,current_nt)<<"("<<CHAR_TO_INDEX[(int)current_nt]<<" : "<<AL_length<<" : "<<index_b<<") >= "<<AL_coverage.size());
-                    }
-                    AL_coverage[coverageIndex(index_b,current_nt)]++;
-                }
+                int this_read_start_pos = drOffset - (*read_iter)->startStopsAt(dr_start_index);
+                int this_read_end_pos = this_read_start_pos + (int)(*read_iter)->getSeqLength();
+                placements.push_back(std::pair<ReadHolder *, int>(*read_iter, this_read_start_pos));
+                if (this_read_start_pos < lowest) lowest = this_read_start_pos;
+                if (this_read_end_pos > highest) highest = this_read_end_pos;
             }
             // go onto the next DR
             dr_start_index += 2;
@@ -411,11 +533,179 @@ void Aligner::placeReadsInCoverageArray(StringToken& currentDrToken) {
                 break;
             }
             
-        } while(((*read_iter)->startStopsAt(dr_end_index) - (*read_iter)->startStopsAt(dr_start_index)) == (current_dr_length - 1));
+        } while(((*read_iter)->startStopsAt(dr_end_index) - (*read_iter)->startStopsAt(dr_start_index)) == (drLength - 1));
         read_iter++;
     }
 }
 
+uint32_t Aligner::nextRandom() {
+    // xorshift32, plenty for picking reads and the same on every platform
+    AL_sampleState ^= AL_sampleState << 13;
+    AL_sampleState ^= AL_sampleState >> 17;
+    AL_sampleState ^= AL_sampleState << 5;
+    return AL_sampleState;
+}
+
+void Aligner::sampleReads(const ReadList& reads, int sampleSize) {
+    
+    // algorithm R. The sample is put back into read order afterwards so that
+    // reads are encoded and added in the same order as without sampling
+    std::vector<size_t> chosen;
+    chosen.reserve(sampleSize);
+    for (size_t i = 0; i < reads.size(); ++i) {
+        if (chosen.size() < (size_t)sampleSize) {
+            chosen.push_back(i);
+        } else {
+            size_t j = nextRandom() % (i + 1);
+            if (j < (size_t)sampleSize) {
+                chosen[j] = i;
+            }
+        }
+    }
+    std::sort(chosen.begin(), chosen.end());
+    
+    AL_sample.clear();
+    std::vector<size_t>::iterator chosen_iter;
+    for (chosen_iter = chosen.begin(); chosen_iter != chosen.end(); ++chosen_iter) {
+        AL_sample.push_back(reads[*chosen_iter]);
+    }
+}
+
+template <typename Count_t>
+void Aligner::addPlacements(std::vector<Count_t>& coverage, int shift) {
+    
+    ReadHolder * encoded_read = NULL;
+    std::vector<std::pair<ReadHolder *, int> >::iterator place_iter;
+    for (place_iter = AL_placements.begin(); place_iter != AL_placements.end(); ++place_iter) {
+        ReadHolder * read = place_iter->first;
+        int seq_length = (int)read->getSeqLength();
+        if (seq_length == 0) {
+            continue;
+        }
+        // reads with more than one full length DR are placed once for each
+        // but only need encoding once
+        if (read != encoded_read) {
+            AL_readCodes.resize(seq_length);
+            nt4Encode(read->getSeq(), &AL_readCodes[0]);
+            encoded_read = read;
+        }
+        pileupAdd(&coverage[0], AL_length, place_iter->second + shift, &AL_readCodes[0], seq_length);
+    }
+}
+
+void Aligner::fillCoverageArray() {
+    
+    // count the reads first to see whether the group needs sampling
+    AL_totalReads = 0;
+    std::map<StringToken, int>::iterator offset_iter;
+    for (offset_iter = AL_Offsets.begin(); offset_iter != AL_Offsets.end(); ++offset_iter) {
+        if (offset_iter->second != -1) {
+            AL_totalReads += (int)mReads->at(offset_iter->first)->size();
+        }
+    }
+    bool sampling = (AL_maxReads > 0 && AL_totalReads > AL_maxReads);
+    AL_sampledReads = 0;
+    AL_sampleState = CRASS_DEF_READ_SAMPLING_SEED;
+    
+    // everything is relative to the master
+    int lowest = AL_ORIGIN;
+    int highest = AL_ORIGIN + AL_masterDRLength;
+    AL_placements.clear();
+    for (offset_iter = AL_Offsets.begin(); offset_iter != AL_Offsets.end(); ++offset_iter) {
+        if (offset_iter->second == -1) {
+            continue;
+        }
+        ReadList * reads = mReads->at(offset_iter->first);
+        int dr_length = static_cast<int>(mStringCheck->getString(offset_iter->first).length());
+        if (sampling) {
+            // every variant gets its share of the sample, and at least one
+            // read so that rare variants can still show up as collapsed
+            int sample_size = (int)(((double)AL_maxReads * reads->size()) / AL_totalReads);
+            if (sample_size < 1) sample_size = 1;
+            sampleReads(*reads, sample_size);
+            findPlacements(AL_sample, offset_iter->second, dr_length, AL_placements, lowest, highest);
+            AL_sampledReads += (int)AL_sample.size();
+        } else {
+            findPlacements(*reads, offset_iter->second, dr_length, AL_placements, lowest, highest);
+            AL_sampledReads += (int)reads->size();
+        }
+    }
+    AL_sample.clear();
+    
+    // leave a few empty columns either side so there is always something
+    // to print around the DR zone
+    int shift = CRASS_DEF_CONS_ARRAY_PADDING - lowest;
+    AL_length = highest - lowest + 2 * CRASS_DEF_CONS_ARRAY_PADDING;
+    AL_buffers->AB_consensus.assign(AL_length, 'N');
+    AL_buffers->AB_conservation.assign(AL_length, 0.0f);
+    
+    // no column can be deeper than the number of placed reads
+    AL_wideCounts = (AL_placements.size() > 0xffff);
+    if (AL_wideCounts) {
+        AL_buffers->AB_coverage32.assign(4 * AL_length, 0);
+        addPlacements(AL_buffers->AB_coverage32, shift);
+    } else {
+        AL_buffers->AB_coverage16.assign(4 * AL_length, 0);
+        addPlacements(AL_buffers->AB_coverage16, shift);
+    }
+    
+    for (offset_iter = AL_Offsets.begin(); offset_iter != AL_Offsets.end(); ++offset_iter) {
+        if (offset_iter->second != -1) {
+            offset_iter->second += shift;
+        }
+    }
+    calculateDRZone();
+}
+
+
+void Aligner::compareWithFullConsensus(int& differentBases, float& maxConservationChange) {
+    
+    differentBases = 0;
+    maxConservationChange = 0.0f;
+    int zone_length = AL_ZoneEnd - AL_ZoneStart + 1;
+    if (zone_length <= 0) {
+        return;
+    }
+    
+    // place every read again but only count the bases that land in the zone
+    std::vector<std::pair<ReadHolder *, int> > placements;
+    int lowest = AL_length, highest = 0;
+    std::map<StringToken, int>::iterator offset_iter;
+    for (offset_iter = AL_Offsets.begin(); offset_iter != AL_Offsets.end(); ++offset_iter) {
+        if (offset_iter->second != -1) {
+            int dr_length = static_cast<int>(mStringCheck->getString(offset_iter->first).length());
+            findPlacements(*(mReads->at(offset_iter->first)), offset_iter->second, dr_length, placements, lowest, highest);
+        }
+    }
+    
+    std::vector<uint32_t> counts(4 * zone_length, 0);
+    std::vector<unsigned char> codes;
+    std::vector<std::pair<ReadHolder *, int> >::iterator place_iter;
+    for (place_iter = placements.begin(); place_iter != placements.end(); ++place_iter) {
+        const std::string& seq = place_iter->first->getSeq();
+        int first = std::max(AL_ZoneStart, place_iter->second);
+        int last = std::min(AL_ZoneEnd, place_iter->second + (int)seq.length() - 1);
+        if (first > last) {
+            continue;
+        }
+        int overlap = last - first + 1;
+        codes.resize(overlap);
+        nt4Encode(seq.data() + (first - place_iter->second), overlap, &codes[0]);
+        pileupAdd(&counts[0], zone_length, first - AL_ZoneStart, &codes[0], overlap);
+    }
+    
+    std::vector<char> full_consensus(zone_length);
+    std::vector<float> full_conservation(zone_length);
+    pileupConsensus(&counts[0], zone_length, CRASS_DEF_MIN_READ_DEPTH, &full_consensus[0], &full_conservation[0]);
+    for (int i = 0; i < zone_length; ++i) {
+        if (full_consensus[i] != consensusAt(AL_ZoneStart + i)) {
+            differentBases++;
+        }
+        float change = full_conservation[i] - conservationAt(AL_ZoneStart + i);
+        if (change < 0) change = -change;
+        if (change > maxConservationChange) maxConservationChange = change;
+    }
+}
 
 void Aligner::extendSlaveDR(StringToken& token, size_t slaveDRLength, std::string &extendedSlaveDR){
  
@@ -481,10 +771,10 @@ void Aligner::calculateDRZone() {
 }
 
 void Aligner::print(std::ostream& out) {
-    std::vector<int>::iterator iter;
-    for (int j = 1; j <= 4;++j) {
+    char alphabet[4] = {'A', 'C', 'G', 'T'};
+    for (int j = 0; j < 4; ++j) {
         for (int i = 0; i < AL_length; ++i) {
-            out<<AL_coverage[i*j]<<",";
+            out<<coverageAt(i, alphabet[j])<<",";
         }
         out<<"$"<<std::endl;
     }
@@ -506,6 +796,6 @@ void Aligner::printAlignment(const kswr_t &alignment, const std::string& slave,
             "\nqe: "<< alignment.qe+1<<
             "\nscore: "<< alignment.score<<
             "\n2nd-score: "<< alignment.score2<<
-            "\n2nd-te: "<< alignment.te2<<
+            "\n2nd-te (slave): "<< alignment.te2<<
             "\noffset: "<<alignment.tb - alignment.qb <<std::endl;
 }
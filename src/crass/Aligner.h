@@ -43,12 +43,81 @@
 #include "StringCheck.h"
 #include "Types.h"
 #include "crassDefines.h"
+#include "NucleotideCodec.h"
 
 
-#define coverageIndex(i,c) (((CHAR_TO_INDEX[(int)c] - 1) * AL_length) + i)
+// where the master DR starts before the arrays are sized
+#define AL_ORIGIN (1 << 24)
+
+// anything that isn't C, G or T is counted as an A
+#define coverageIndex(i,c) (((nt4Code(c) & 3) * AL_length) + i)
 
 typedef std::bitset<3> AlignerFlag_t;
 
+// the arrays an Aligner fills in. They are borrowed from an AlignerBufferPool
+// so their memory gets reused from one group to the next
+struct AlignerBuffers {
+    std::vector<char> AB_consensus;
+    std::vector<float> AB_conservation;
+    std::vector<uint16_t> AB_coverage16;        // counts for groups with fewer than 65536 placed DRs
+    std::vector<uint32_t> AB_coverage32;        // and for the rest
+};
+
+// Each thread keeps the buffers of finished Aligners for the next one.
+// parseGroupedDRs recurses when it splits a group so several Aligners can be
+// alive on one thread, each gets its own buffers
+class AlignerBufferPool {
+public:
+    ~AlignerBufferPool();
+    
+    // the pool for the calling thread
+    static AlignerBufferPool * threadPool(void);
+    
+    AlignerBuffers * acquire(void);
+    void release(AlignerBuffers * buffers);
+    
+private:
+    std::vector<AlignerBuffers *> ABP_free;
+};
+
+// ksw results for slaves aligned against masters. parseGroupedDRs makes a
+// new Aligner every time it splits a group but the children mostly align the
+// same DRs against the same masters again, so WorkHorse keeps one of these
+// for the whole consensus phase. Only alignments of a DR's own sequence are
+// kept, extended slaves depend on the reads and are always realigned
+class AlignmentCache {
+public:
+    AlignmentCache(): AC_lookups(0), AC_hits(0) {}
+    
+    // both orientations of the slave against the master, false if they
+    // haven't been aligned yet
+    bool find(StringToken master, StringToken slave, kswr_t& forward, kswr_t& reverse);
+    
+    void add(StringToken master, StringToken slave, const kswr_t& forward, const kswr_t& reverse);
+    
+    // the slave has been reverse complemented into reversedSlave, which
+    // aligns the same way with the orientations swapped
+    void addReversed(StringToken master, StringToken slave, StringToken reversedSlave);
+    
+    inline size_t lookups(void){return AC_lookups;}
+    
+    inline size_t hits(void){return AC_hits;}
+    
+    inline size_t size(void){return AC_alignments.size();}
+    
+    void clear(void);
+    
+private:
+    // master in the top bits, then the slave, then the orientation in the bottom bit
+    inline uint64_t key(StringToken master, StringToken slave, bool reversed) {
+        return ((uint64_t)(uint32_t)master << 33) | ((uint64_t)(uint32_t)slave << 1) | (reversed ? 1 : 0);
+    }
+    
+    CRASS_HASH_MAP<uint64_t, kswr_t> AC_alignments;
+    size_t AC_lookups;
+    size_t AC_hits;
+};
+
 
 class Aligner 
 {
@@ -60,57 +129,26 @@ class Aligner
     };
     
     
-    static const unsigned char seq_nt4_table[256];/* = {
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4
-    };*/
-    
-    
-    // ASCII table that converts characters into the multiplier
-    // used for finding the correct index in the coverage array
-    static const char CHAR_TO_INDEX[128];/* = {
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 1, 0, 2, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 1, 0, 2, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
-    };*/
 public:
     //int gapo = 5, gape = 2, minsc = 0, xtra = KSW_XSTART;
-    Aligner(int length, ReadMap *wh_reads, StringCheck *wh_st, int gapo=5, int gape=2, int minsc=5, int xtra=KSW_XSTART): 
-        AL_length(length),
-        AL_consensus(length,'N'), 
-        AL_conservation(length, 0.0f), 
-        AL_coverage(length*4, 0),
+    // the coverage arrays are sized once all the slaves have been aligned,
+    // to however far the reads stretch either side of the master
+    Aligner(ReadMap *wh_reads, StringCheck *wh_st, int gapo=5, int gape=2, int minsc=5, int xtra=KSW_XSTART): 
+        AL_length(0),
+        AL_buffers(AlignerBufferPool::threadPool()->acquire()),
+        AL_wideCounts(false),
+        AL_maxReads(0),
+        AL_totalReads(0),
+        AL_sampledReads(0),
+        AL_sampleState(CRASS_DEF_READ_SAMPLING_SEED),
         AL_gapOpening(gapo), 
         AL_gapExtension(gape), 
         AL_minAlignmentScore(minsc), 
-        AL_xtra(xtra) {
+        AL_xtra(xtra),
+        AL_masterDR(NULL),
+        AL_masterProfile(NULL),
+        AL_profileSize(2),
+        AL_cache(NULL) {
         
             // assign workhorse variables
             mReads = wh_reads;
@@ -132,18 +170,40 @@ public:
     
     
     ~Aligner(){
-        if (AL_masterDR != NULL) {
-            delete [] AL_masterDR;
-            AL_masterDR = NULL;
-        } 
+        freeMaster();
+        AlignerBufferPool::threadPool()->release(AL_buffers);
     }
     
     inline StringToken getMasterDrToken(){return AL_masterDRToken;}
     
+    // look up and store slave alignments in this cache, which has to outlive
+    // the aligner. Call before alignSlaves
+    inline void setAlignmentCache(AlignmentCache * cache){AL_cache = cache;}
+    
     void setMasterDR(StringToken master);
     
     void alignSlave(StringToken& slaveDRToken);
+    
+    // align every DR in the range against the master, skipping the master itself,
+    // then place the reads of every aligned DR in the coverage array.
+    // Tokens of slaves that get reverse complemented are updated in place
+    void alignSlaves(DR_ClusterIterator begin, DR_ClusterIterator end);
 
+    // make the consensus from at most maxReads of the reads in the group,
+    // 0 (the default) uses all of them. The sample only affects the coverage
+    // arrays, the reads themselves are left alone. Call before alignSlaves
+    inline void setReadSampling(int maxReads){AL_maxReads = maxReads;}
+    
+    inline int totalReads(){return AL_totalReads;}
+    
+    inline int sampledReads(){return AL_sampledReads;}
+    
+    inline bool isSampled(){return AL_sampledReads < AL_totalReads;}
+    
+    // call the consensus over the DR zone again using every read and count
+    // the columns where the base differs from the sampled consensus
+    void compareWithFullConsensus(int& differentBases, float& maxConservationChange);
+    
     // add in all of the reads for this group to the coverage array
     void generateConsensus();
     
@@ -165,40 +225,77 @@ public:
     
     inline void setDRZoneEnd(int i){AL_ZoneEnd = i;}
     
-    inline int coverageAt(int i, char c){return AL_coverage.at(coverageIndex(i,c)); }
+    inline int coverageAt(int i, char c){
+        if (AL_wideCounts) {
+            return AL_buffers->AB_coverage32.at(coverageIndex(i,c));
+        }
+        return AL_buffers->AB_coverage16.at(coverageIndex(i,c));
+    }
+    
+    inline char consensusAt(int i){return AL_buffers->AB_consensus.at(i);}
     
-    inline char consensusAt(int i){return AL_consensus.at(i);}
+    inline float conservationAt(int i){return AL_buffers->AB_conservation.at(i);}
     
-    inline float conservationAt(int i){return AL_conservation.at(i);}
+    inline int depthAt(int i){return coverageAt(i,'A') + coverageAt(i,'C') + coverageAt(i,'G') + coverageAt(i,'T');}
     
-    inline int depthAt(int i){return AL_coverage[coverageIndex(i,'A')] + AL_coverage[coverageIndex(i,'C')] + AL_coverage[coverageIndex(i,'G')] + AL_coverage[coverageIndex(i,'T')];}
+    inline int length(){return AL_length;}
 
 private:
+    // the buffers belong to the pool, don't copy them
+    Aligner(const Aligner&);
+    Aligner& operator=(const Aligner&);
+    
     // private methods
     //
     
     // call ksw alignment to determine the offset for this slave against the master
+    // The alignments are cached against the slave's token unless it is 0
     int getOffsetAgainstMaster(std::string& slaveDR,
-                               AlignerFlag_t& flags);
+                               AlignerFlag_t& flags,
+                               StringToken slaveDRToken = 0);
 
     // transform any sequence into the right form for ksw
     void prepareSequenceForAlignment(std::string& sequence, uint8_t *transformedSequence);
 
     // transform a slave DR into the right form for ksw in both orientations
-    void prepareSlaveForAlignment(std::string& slaveDR,
-                                  uint8_t *slaveTransformedForward, 
-                                  uint8_t *slaveTransformedReverse);
-
-    // transform the master DR into the right form for ksw
-    inline void prepareMasterForAlignment(std::string& masterDR) {
-        AL_masterDRLength = masterDR.length();
-        //AL_minAlignmentScore = static_cast<int>(AL_masterDRLength * 0.5);
-        AL_masterDR = new uint8_t[AL_masterDRLength+1];
-        prepareSequenceForAlignment(masterDR, AL_masterDR);
-    };
+    // the results go into AL_slaveForward and AL_slaveReverse
+    void prepareSlaveForAlignment(std::string& slaveDR);
+
+    // transform the master DR into the right form for ksw and build the
+    // query profile that every slave is aligned against
+    void prepareMasterForAlignment(std::string& masterDR);
+    
+    void freeMaster();
+    
+    // score one orientation of a slave against the master profile.
+    // The result uses the master as the target and the slave as the query,
+    // apart from te2 which is on the slave
+    kswr_t alignToMaster(const uint8_t * slave, int slaveLength);
+    
+    // fill in tb and qb for an alignment from alignToMaster
+    void findAlignmentStart(kswr_t& alignment, const uint8_t * slave);
     
 
-    void placeReadsInCoverageArray(StringToken& currentDRToken);
+    // work out where every full length DR in the reads sits relative to the
+    // master, given where the DR they were found with sits
+    void findPlacements(const ReadList& reads, 
+                        int drOffset, 
+                        int drLength, 
+                        std::vector<std::pair<ReadHolder *, int> >& placements, 
+                        int& lowest, 
+                        int& highest);
+    
+    // reservoir sample sampleSize reads from the list into AL_sample
+    void sampleReads(const ReadList& reads, int sampleSize);
+    
+    // next number from the sampling generator
+    uint32_t nextRandom();
+    
+    // size the coverage arrays to the placements and fill them in
+    void fillCoverageArray();
+    
+    template <typename Count_t>
+    void addPlacements(std::vector<Count_t>& coverage, int shift);
     
     void extendSlaveDR(StringToken& slaveDRToken, size_t slaveDRLength, std::string& extendedSlaveDR);
 
@@ -211,9 +308,19 @@ private:
     int AL_length;
     
     // Vectors to hold the alignment data
-    std::vector<char> AL_consensus;
-    std::vector<float> AL_conservation;
-    std::vector<int> AL_coverage;
+    AlignerBuffers * AL_buffers;
+    bool AL_wideCounts;                         // true when the counts are in AB_coverage32
+    
+    // reads and where they start relative to the start of the master
+    std::vector<std::pair<ReadHolder *, int> > AL_placements;
+    std::vector<unsigned char> AL_readCodes;    // nt4 codes of the read being placed
+    
+    // read sampling
+    int AL_maxReads;                            // 0 when every read is used
+    int AL_totalReads;                          // reads in all of the aligned DRs
+    int AL_sampledReads;                        // of those, how many made it into the arrays
+    uint32_t AL_sampleState;                    // xorshift state, reset for every group
+    ReadList AL_sample;
     
     // Storage of all the offsets against the master
     std::map<StringToken, int> AL_Offsets;
@@ -229,6 +336,17 @@ private:
     uint8_t *AL_masterDR;
     int AL_masterDRLength;
     StringToken AL_masterDRToken;
+    kswq_t * AL_masterProfile;                  // ksw query profile of the master
+    int AL_profileSize;                         // 1 for the 8-bit kernel, 2 for the 16-bit one
+    
+    // scratch space reused for every slave
+    std::vector<uint8_t> AL_slaveForward;
+    std::vector<uint8_t> AL_slaveReverse;
+    std::vector<uint8_t> AL_slaveScratch;
+    std::vector<uint8_t> AL_masterScratch;
+    
+    // alignments from earlier Aligners, not owned
+    AlignmentCache * AL_cache;
     
     // "Glue" between WorkHorse
     ReadMap * mReads;
@@ -0,0 +1,254 @@
+/*
+ *  Checkpoint.cpp is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+// system includes
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// local includes
+#include "Checkpoint.h"
+#include "Exception.h"
+#include "config.h"
+
+CheckpointWriter::CheckpointWriter(const std::string& fileName, const char * kind, uint32_t version)
+{
+    CW_FileName = fileName;
+    CW_File = fopen(fileName.c_str(), "wb");
+    if(NULL == CW_File)
+    {
+        std::stringstream msg;
+        msg << "Cannot open the checkpoint file " << fileName << " for writing";
+        throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, msg);
+    }
+    char kind_name[CRASS_CHECKPOINT_KIND_LENGTH];
+    memset(kind_name, 0, CRASS_CHECKPOINT_KIND_LENGTH);
+    memcpy(kind_name, kind, std::min(strlen(kind), static_cast<size_t>(CRASS_CHECKPOINT_KIND_LENGTH)));
+    writeBytes(CRASS_CHECKPOINT_MAGIC, strlen(CRASS_CHECKPOINT_MAGIC));
+    writeBytes(kind_name, CRASS_CHECKPOINT_KIND_LENGTH);
+    writeUInt(CRASS_CHECKPOINT_ENDIAN);
+    writeUInt(version);
+}
+
+CheckpointWriter::~CheckpointWriter(void)
+{
+    if(NULL != CW_File)
+    {
+        fclose(CW_File);
+    }
+}
+
+void CheckpointWriter::writeInt(int32_t value)
+{
+    writeBytes(&value, sizeof(value));
+}
+
+void CheckpointWriter::writeUInt(uint32_t value)
+{
+    writeBytes(&value, sizeof(value));
+}
+
+void CheckpointWriter::writeSize(uint64_t value)
+{
+    writeBytes(&value, sizeof(value));
+}
+
+void CheckpointWriter::writeBool(bool value)
+{
+    char byte = value ? 1 : 0;
+    writeBytes(&byte, 1);
+}
+
+void CheckpointWriter::writeString(const std::string& value)
+{
+    writeUInt(static_cast<uint32_t>(value.length()));
+    writeBytes(value.data(), value.length());
+}
+
+void CheckpointWriter::close(void)
+{
+    if(NULL == CW_File)
+    {
+        return;
+    }
+    bool failed = (0 != ferror(CW_File));
+    failed = (0 != fclose(CW_File)) || failed;
+    CW_File = NULL;
+    if(failed)
+    {
+        std::stringstream msg;
+        msg << "Could not write all of the checkpoint file " << CW_FileName;
+        throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, msg);
+    }
+}
+
+void CheckpointWriter::writeBytes(const void * data, size_t length)
+{
+    // stdio buffers it, errors get picked up in close
+    if(length > 0)
+    {
+        fwrite(data, 1, length, CW_File);
+    }
+}
+
+CheckpointReader::CheckpointReader(const std::string& fileName, const char * kind, uint32_t version)
+{
+    CR_FileName = fileName;
+    CR_Data = NULL;
+    CR_Size = 0;
+    CR_Pos = 0;
+    int fd = open(fileName.c_str(), O_RDONLY);
+    struct stat file_status;
+    if(-1 == fd || -1 == fstat(fd, &file_status))
+    {
+        if(-1 != fd)
+        {
+            ::close(fd);
+        }
+        std::stringstream msg;
+        msg << "Cannot open the checkpoint file " << fileName;
+        throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, msg);
+    }
+    CR_Size = static_cast<size_t>(file_status.st_size);
+    if(CR_Size > 0)
+    {
+        void * data = mmap(NULL, CR_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(MAP_FAILED == data)
+        {
+            ::close(fd);
+            std::stringstream msg;
+            msg << "Cannot map the checkpoint file " << fileName;
+            throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, msg);
+        }
+        CR_Data = static_cast<const char *>(data);
+        // it gets read front to back just the once
+        madvise(data, CR_Size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+    
+    // every check reads on from where the last one stopped
+    size_t magic_length = strlen(CRASS_CHECKPOINT_MAGIC);
+    char kind_name[CRASS_CHECKPOINT_KIND_LENGTH];
+    memset(kind_name, 0, CRASS_CHECKPOINT_KIND_LENGTH);
+    memcpy(kind_name, kind, std::min(strlen(kind), static_cast<size_t>(CRASS_CHECKPOINT_KIND_LENGTH)));
+    std::stringstream msg;
+    if(CR_Size < magic_length + CRASS_CHECKPOINT_KIND_LENGTH + 2 * sizeof(uint32_t) ||
+       0 != memcmp(readBytes(magic_length), CRASS_CHECKPOINT_MAGIC, magic_length))
+    {
+        msg << fileName << " is not a " << PACKAGE_NAME << " checkpoint";
+    }
+    else if(0 != memcmp(readBytes(CRASS_CHECKPOINT_KIND_LENGTH), kind_name, CRASS_CHECKPOINT_KIND_LENGTH))
+    {
+        msg << fileName << " is not a " << kind << " checkpoint";
+    }
+    else if(CRASS_CHECKPOINT_ENDIAN != readUInt())
+    {
+        msg << fileName << " was written on a machine with a different byte order";
+    }
+    else
+    {
+        uint32_t file_version = readUInt();
+        if(file_version != version)
+        {
+            msg << fileName << " is version " << file_version << " of the " << kind << " checkpoint but this build reads version " << version;
+        }
+    }
+    if(!msg.str().empty())
+    {
+        // no destructor to unmap it when the constructor throws
+        if(NULL != CR_Data)
+        {
+            munmap(const_cast<char *>(CR_Data), CR_Size);
+            CR_Data = NULL;
+        }
+        throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, msg);
+    }
+}
+
+CheckpointReader::~CheckpointReader(void)
+{
+    if(NULL != CR_Data)
+    {
+        munmap(const_cast<char *>(CR_Data), CR_Size);
+    }
+}
+
+int32_t CheckpointReader::readInt(void)
+{
+    int32_t value;
+    memcpy(&value, readBytes(sizeof(value)), sizeof(value));
+    return value;
+}
+
+uint32_t CheckpointReader::readUInt(void)
+{
+    uint32_t value;
+    memcpy(&value, readBytes(sizeof(value)), sizeof(value));
+    return value;
+}
+
+uint64_t CheckpointReader::readSize(void)
+{
+    uint64_t value;
+    memcpy(&value, readBytes(sizeof(value)), sizeof(value));
+    return value;
+}
+
+bool CheckpointReader::readBool(void)
+{
+    return 0 != *readBytes(1);
+}
+
+std::string CheckpointReader::readString(void)
+{
+    uint32_t length = readUInt();
+    return std::string(readBytes(length), length);
+}
+
+const char * CheckpointReader::readBytes(size_t length)
+{
+    if(length > CR_Size - CR_Pos)
+    {
+        std::stringstream msg;
+        msg << "The checkpoint file " << CR_FileName << " is cut short";
+        throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, msg);
+    }
+    const char * bytes = CR_Data + CR_Pos;
+    CR_Pos += length;
+    return bytes;
+}
@@ -0,0 +1,102 @@
+/*
+ *  Checkpoint.h is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+#ifndef crass_Checkpoint_h
+#define crass_Checkpoint_h
+
+// system includes
+#include <string>
+#include <stdio.h>
+#include <stdint.h>
+
+// Checkpoint files start with a header saying what kind of checkpoint they
+// are and which version of it, then hold plain native endian numbers and
+// length prefixed strings in whatever order the writer put them. Nothing is
+// padded or aligned so the reader copies numbers out rather than casting
+#define CRASS_CHECKPOINT_MAGIC          "CRASSCKP"
+#define CRASS_CHECKPOINT_KIND_LENGTH    (8)                 // kind names are padded out to this with nulls
+#define CRASS_CHECKPOINT_ENDIAN         (0x01020304)        // comes out scrambled on a machine with the other byte order
+
+class CheckpointWriter {
+public:
+    CheckpointWriter(const std::string& fileName, const char * kind, uint32_t version);
+    ~CheckpointWriter(void);
+
+    void writeInt(int32_t value);
+    void writeUInt(uint32_t value);
+    void writeSize(uint64_t value);
+    void writeBool(bool value);
+    void writeString(const std::string& value);
+
+    // flush everything out, throws if any of it didn't make it
+    void close(void);
+
+private:
+    CheckpointWriter(const CheckpointWriter&);
+    CheckpointWriter& operator=(const CheckpointWriter&);
+
+    void writeBytes(const void * data, size_t length);
+
+    std::string CW_FileName;
+    FILE * CW_File;
+};
+
+// Maps a checkpoint into memory and reads it back in the order it was
+// written. A header that doesn't match or reading past the end throws
+class CheckpointReader {
+public:
+    CheckpointReader(const std::string& fileName, const char * kind, uint32_t version);
+    ~CheckpointReader(void);
+
+    int32_t readInt(void);
+    uint32_t readUInt(void);
+    uint64_t readSize(void);
+    bool readBool(void);
+    std::string readString(void);
+
+    inline bool atEnd(void) const { return CR_Pos == CR_Size; }
+
+private:
+    CheckpointReader(const CheckpointReader&);
+    CheckpointReader& operator=(const CheckpointReader&);
+
+    const char * readBytes(size_t length);
+
+    std::string CR_FileName;
+    const char * CR_Data;               // the whole file, mapped
+    size_t CR_Size;
+    size_t CR_Pos;                      // where the next read starts
+};
+
+#endif
@@ -36,6 +36,7 @@
 //
 // system includes
 #include <vector>
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <fstream>
@@ -60,14 +61,10 @@ bool CrisprNode::addEdge(CrisprNode * parterNode, EDGE_TYPE type)
     // Add a new edge return success if the partner has been added
     // 
     
-    // get the right edge list
-    edgeList * add_list = getEdges(type);
-    
-    // now see we haven't added it before
-    if(add_list->find(parterNode) == add_list->end())
+    // see we haven't added it before
+    if(NULL == findEdge(parterNode->getID(), type))
     {
         // new guy
-        (*add_list)[parterNode] = true;
         switch(type)
         {
             case CN_EDGE_FORWARD:
@@ -88,66 +85,107 @@ bool CrisprNode::addEdge(CrisprNode * parterNode, EDGE_TYPE type)
                                                 __PRETTY_FUNCTION__,
                                                 "Unknown edge type");
         }
+        insertEdge(parterNode->getID(), type, true);
         return true;
     }
     return false;
 }
 
-edgeList * CrisprNode::getEdges(EDGE_TYPE type)
+void CrisprNode::insertEdge(StringToken partner, EDGE_TYPE type, bool attachState)
 {
     //-----
-    // get edges of a particular type
+    // keep the edges in order of type and then neighbour's token so that
+    // they are walked in the same order whenever and wherever they were made
     //
-    switch(type)
+    crisprEdgeStruct new_edge;
+    new_edge.partner = partner;
+    new_edge.type = static_cast<unsigned char>(type);
+    new_edge.attached = attachState;
+    mEdges.push_back(new_edge);
+    mDiscountedCoverage = -1;
+    size_t i = mEdges.size() - 1;
+    while(i > 0 && (mEdges[i - 1].type > new_edge.type || (mEdges[i - 1].type == new_edge.type && mEdges[i - 1].partner > partner)))
     {
-        case CN_EDGE_FORWARD:
-            return &mForwardEdges;
-        case CN_EDGE_BACKWARD:
-            return &mBackwardEdges;
-        case CN_EDGE_JUMPING_F:
-            return &mJumpingForwardEdges;
-        case CN_EDGE_JUMPING_B:
-            return &mJumpingBackwardEdges;
-        default:
-            throw crispr::runtime_exception(__FILE__,
-                                            __LINE__,
-                                            __PRETTY_FUNCTION__,
-                                            "Unknown edge type");
+        mEdges[i] = mEdges[i - 1];
+        i--;
     }
+    mEdges[i] = new_edge;
 }
 
-void CrisprNode::calculateReadCoverage(edgeList * currentList, std::map<StringToken, int>& countingMap)
+edgeListIterator CrisprNode::findEdge(StringToken partner, EDGE_TYPE type)
 {
+    //-----
+    // there are only ever a few edges so just look at them all
+    //
     edgeListIterator eli;
-    for (eli = currentList->begin(); eli != currentList->end(); eli++)
+    for (eli = mEdges.begin(); eli != mEdges.end(); eli++)
+    {
+        if(eli->partner == partner && eli->type == type)
+        {
+            return eli;
+        }
+    }
+    return NULL;
+}
+
+StringToken CrisprNode::getFirstEdge(EDGE_TYPE type)
+{
+    //-----
+    // the first neighbour joined by an edge of this type, attached or not
+    //
+    edgeListIterator eli;
+    for (eli = mEdges.begin(); eli != mEdges.end(); eli++)
+    {
+        if(eli->type == type)
+        {
+            return eli->partner;
+        }
+    }
+    return 0;
+}
+
+void CrisprNode::calculateReadCoverage(EDGE_TYPE type, const ReadMembership& reads, const std::vector<StringToken>& ownReads, std::vector<int>& counts)
+{
+    //-----
+    // count how often each of our reads turns up on the neighbours joined
+    // by attached edges of this type. Both lists are sorted so they can be
+    // walked side by side
+    //
+    edgeListIterator eli;
+    for (eli = mEdges.begin(); eli != mEdges.end(); eli++)
     {
     	// check if he's attached
-    	if(! eli->second)
+    	if(eli->type != type || ! eli->attached)
     	{
             continue;
         }
 #ifdef DEBUG
-        logInfo("Edge: "<<(eli->first)->getID(), 10);
+        logInfo("Edge: "<<eli->partner, 10);
 #endif
-        // get the headers
-        std::vector<StringToken> * inner_headers = (eli->first)->getReadHeaders();
-        std::vector<StringToken>::iterator inner_rh_iter = inner_headers->begin();
-        std::vector<StringToken>::iterator inner_rh_last = inner_headers->end();
-        while(inner_rh_iter != inner_rh_last)
+        const StringToken * inner_iter = reads.begin(eli->partner);
+        const StringToken * inner_last = reads.end(eli->partner);
+        size_t own_index = 0;
+        while(inner_iter != inner_last && own_index < ownReads.size())
         {
-            if(countingMap.find(*inner_rh_iter) != countingMap.end()) {
-                countingMap[*inner_rh_iter]++;
-#ifdef DEBUG
-                logInfo("\t\tIncrementing: "<<*inner_rh_iter<<" : "<<countingMap[*inner_rh_iter], 10);
-#endif
+            if(*inner_iter < ownReads[own_index])
+            {
+                inner_iter++;
+            }
+            else if(ownReads[own_index] < *inner_iter)
+            {
+                own_index++;
+            }
+            else
+            {
+                counts[own_index]++;
+                inner_iter++;
             }
-            inner_rh_iter++;
         }
     }
 }
 
 
-int CrisprNode::getDiscountedCoverage(void)
+int CrisprNode::getDiscountedCoverage(const ReadMembership& reads)
 {
 	//-----
 	// Return a (possibly) lower version of the coverage
@@ -157,45 +195,43 @@ int CrisprNode::getDiscountedCoverage(void)
     // backward of the current node are shared
     // This prevents the coverage from being exadgerated 
     // if two different spacers share a kmer
-	std::map<StringToken, int> counting_map;
-	
-	// initialise the counting map to inlcude all the reads we care about
-	std::vector<StringToken>::iterator rh_iter = mReadHeaders.begin();
-	for (rh_iter = mReadHeaders.begin(); rh_iter != mReadHeaders.end(); ++rh_iter) {
-		counting_map[*rh_iter] = 0;
-#ifdef DEBUG
-        logInfo("Node :"<<mid<<" Header: "<<*rh_iter, 10);
-#endif
-	}
+    //
+    // It only changes when the edges do so it is kept until then
+    //
+    if(mDiscountedCoverage >= 0)
+    {
+        return mDiscountedCoverage;
+    }
+    
+	// each of our reads once, and how often the neighbours have it
+	std::vector<StringToken> own_reads(reads.begin(mid), reads.end(mid));
+    own_reads.erase(std::unique(own_reads.begin(), own_reads.end()), own_reads.end());
+    std::vector<int> counts(own_reads.size(), 0);
 #ifdef DEBUG
-    logInfo("Node: "<<mid<<" Headers size:"<<mReadHeaders.size(), 10);
-    logInfo("\tForward: "<<mForwardEdges.size(), 10);
-    logInfo("\tBackward: "<<mBackwardEdges.size(), 10);
-    logInfo("\tJForward: "<<mJumpingForwardEdges.size(), 10);
-    logInfo("\tJBackward: "<<mJumpingBackwardEdges.size(), 10);
+    logInfo("Node: "<<mid<<" Headers size:"<<own_reads.size(), 10);
+    logInfo("\tEdges: "<<mEdges.size(), 10);
 #endif
-	// now update the counting map with reads found on the innner connecting nodes -> perhaps one of these lists is empty?
+	// now count the reads found on the innner connecting nodes -> perhaps one of these lists is empty?
     if(mIsForward) {
         // first forward
-         calculateReadCoverage(&mForwardEdges, counting_map);
+         calculateReadCoverage(CN_EDGE_FORWARD, reads, own_reads, counts);
         // then backward
-         calculateReadCoverage(&mJumpingBackwardEdges, counting_map);	
+         calculateReadCoverage(CN_EDGE_JUMPING_B, reads, own_reads, counts);	
     } else {
         // first forward
-         calculateReadCoverage(&mJumpingForwardEdges, counting_map);
+         calculateReadCoverage(CN_EDGE_JUMPING_F, reads, own_reads, counts);
         // then backward
-         calculateReadCoverage(&mBackwardEdges, counting_map);	
+         calculateReadCoverage(CN_EDGE_BACKWARD, reads, own_reads, counts);	
     }    
     int ret_val = 0;
-    std::map<StringToken, int>::iterator cm_iter = counting_map.begin();
-    std::map<StringToken, int>::iterator cm_last = counting_map.end();
-    while(cm_iter != cm_last)
+    std::vector<int>::iterator count_iter;
+    for(count_iter = counts.begin(); count_iter != counts.end(); count_iter++)
     {
-    	if(cm_iter->second > 1)
+    	if(*count_iter > 1)
     		ret_val++;
-    	cm_iter++;
     }
     
+    mDiscountedCoverage = ret_val;
     return ret_val;
 }
 
@@ -203,39 +239,64 @@ int CrisprNode::getDiscountedCoverage(void)
 //
 // Node level functions
 //
-void CrisprNode::setEdgeAttachState(edgeList * currentList, bool attachState, EDGE_TYPE currentType)
+void CrisprNode::setEdgeAttachState(StringToken partner, bool attachState, EDGE_TYPE type)
+{
+    //-----
+    // set the state of the edge to the partner, adding it if it isn't here.
+    // The rank is left alone
+    //
+    edgeListIterator eli = findEdge(partner, type);
+    if(NULL != eli)
+    {
+        eli->attached = attachState;
+        mDiscountedCoverage = -1;
+    }
+    else
+    {
+        insertEdge(partner, type, attachState);
+    }
+}
+
+void CrisprNode::setEdgeAttachState(bool attachState, EDGE_TYPE currentType, const NodeList& nodes)
 {
     edgeListIterator eli;
-    for (eli = currentList->begin(); eli != currentList->end(); eli++) {
+    for (eli = mEdges.begin(); eli != mEdges.end(); eli++) {
 
         // go through each edge, check if it's not the right state
-        if((eli->second ^ attachState) && (eli->first)->isAttached())
+        if(eli->type != currentType || !(eli->attached ^ attachState))
+        {
+            continue;
+        }
+        CrisprNode * partner_node = nodeAt(nodes, eli->partner);
+        if(partner_node->isAttached())
         {
-            // this edge is not the right state and the corresponding node is actually attached
-            edgeList * other_eli = (eli->first)->getEdges(currentType);
-            (*other_eli)[this] = attachState;
-            eli->second = attachState;
-            (eli->first)->updateRank(attachState, currentType);
-            if((eli->first)->getTotalRank() == 0)
-            	(eli->first)->setAsDetached();
+            // this edge is not the right state and the corresponding node is actually attached.
+            // Only the partner's list can change here
+            partner_node->setEdgeAttachState(mid, attachState, currentType);
+            eli->attached = attachState;
+            mDiscountedCoverage = -1;
+            partner_node->updateRank(attachState, currentType);
+            if(partner_node->getTotalRank() == 0)
+            	partner_node->setAsDetached();
         }
     }
 }
 
-void CrisprNode::setAttach(bool attachState)
+void CrisprNode::setAttach(bool attachState, const NodeList& nodes)
 {
     //-----
     // detach or re-attach this node
     //
     
-    // find and attached nodes and set the edges to attachState
-    setEdgeAttachState(&mForwardEdges, attachState, CN_EDGE_FORWARD);
+    // find and attached nodes and set the edges to attachState,
+    // a type at a time
+    setEdgeAttachState(attachState, CN_EDGE_FORWARD, nodes);
 
-    setEdgeAttachState(&mBackwardEdges, attachState, CN_EDGE_BACKWARD);
+    setEdgeAttachState(attachState, CN_EDGE_BACKWARD, nodes);
 
-    setEdgeAttachState(&mJumpingForwardEdges, attachState, CN_EDGE_JUMPING_F);
+    setEdgeAttachState(attachState, CN_EDGE_JUMPING_F, nodes);
 
-    setEdgeAttachState(&mJumpingBackwardEdges, attachState, CN_EDGE_JUMPING_B);
+    setEdgeAttachState(attachState, CN_EDGE_JUMPING_B, nodes);
     
     // set our state
     mAttached =  attachState;       
@@ -297,7 +358,7 @@ void CrisprNode::updateRank(bool attachState, EDGE_TYPE type)
 //
 // File IO / printing
 //
-void CrisprNode::printEdgesForList(edgeList * currentList,
+void CrisprNode::printEdgesForList(EDGE_TYPE type,
                        std::ostream &dataOut,
                        StringCheck * ST,
                        std::string label, 
@@ -305,15 +366,15 @@ void CrisprNode::printEdgesForList(edgeList * currentList,
                        bool longDesc)
 {
     edgeListIterator eli; 
-    for (eli = currentList->begin(); eli != currentList->end(); eli++) {
+    for (eli = mEdges.begin(); eli != mEdges.end(); eli++) {
         // check if the edge is active
-        if((eli->second) || showDetached)
+        if(eli->type == type && ((eli->attached) || showDetached))
         {
         	std::stringstream ss;
         	if(longDesc)
-        		ss << (eli->first)->getID() << "_" << ST->getString((eli->first)->getID());
+        		ss << eli->partner << "_" << ST->getString(eli->partner);
         	else
-        		ss << (eli->first)->getID();
+        		ss << eli->partner;
             gvEdge(dataOut,label,ss.str());
         }
     }
@@ -333,36 +394,18 @@ void CrisprNode::printEdges(std::ostream &dataOut,
     //
         
     // now print the edges
-    printEdgesForList(&mForwardEdges, dataOut, ST, label, showDetached, longDesc);
-    printEdgesForList(&mJumpingForwardEdges, dataOut, ST, label, showDetached, longDesc);
+    printEdgesForList(CN_EDGE_FORWARD, dataOut, ST, label, showDetached, longDesc);
+    printEdgesForList(CN_EDGE_JUMPING_F, dataOut, ST, label, showDetached, longDesc);
     
     if(printBackEdges)
     {
-        printEdgesForList(&mBackwardEdges, dataOut, ST, label, showDetached, longDesc);
+        printEdgesForList(CN_EDGE_BACKWARD, dataOut, ST, label, showDetached, longDesc);
 
-        printEdgesForList(&mJumpingBackwardEdges, dataOut, ST, label, showDetached, longDesc);
+        printEdgesForList(CN_EDGE_JUMPING_B, dataOut, ST, label, showDetached, longDesc);
 
     }
 }
 
-std::vector<std::string> CrisprNode::getReadHeaders(StringCheck * ST)
-{
-	//-----
-	// Given a StringCheck return the read headers for this node
-	//
-	std::vector<std::string> ret_vector;
-	if(ST != NULL)
-	{
-		std::vector<StringToken>::iterator rh_iter = mReadHeaders.begin();
-		while(rh_iter != mReadHeaders.end())
-		{
-			ret_vector.push_back(ST->getString(*rh_iter));
-			rh_iter++;
-		}
-	}
-	return ret_vector;
-}
-
 std::string CrisprNode::sayEdgeTypeLikeAHuman(EDGE_TYPE type)
 {
     //-----
@@ -387,3 +430,60 @@ std::string CrisprNode::sayEdgeTypeLikeAHuman(EDGE_TYPE type)
 }
 
 
+
+void CrisprNode::writeCheckpoint(CheckpointWriter& out)
+{
+    //-----
+    // The discounted coverage is left out, it's worked out again when it's needed
+    //
+    out.writeInt(mid);
+    out.writeInt(mInnerRank_F);
+    out.writeInt(mInnerRank_B);
+    out.writeInt(mJumpingRank_F);
+    out.writeInt(mJumpingRank_B);
+    out.writeBool(mAttached);
+    out.writeInt(mCoverage);
+    out.writeBool(mIsForward);
+    out.writeUInt(static_cast<uint32_t>(mEdges.size()));
+    edgeListIterator eli;
+    for (eli = mEdges.begin(); eli != mEdges.end(); eli++)
+    {
+        out.writeInt(eli->partner);
+        out.writeUInt(eli->type);
+        out.writeBool(eli->attached);
+    }
+}
+
+void CrisprNode::readCheckpoint(CheckpointReader& in, const NodeList& nodes)
+{
+    //-----
+    // The edges were written in order so they go straight back in
+    //
+    mid = in.readInt();
+    mInnerRank_F = in.readInt();
+    mInnerRank_B = in.readInt();
+    mJumpingRank_F = in.readInt();
+    mJumpingRank_B = in.readInt();
+    mAttached = in.readBool();
+    mCoverage = in.readInt();
+    mIsForward = in.readBool();
+    mDiscountedCoverage = -1;
+    mEdges.clear();
+    uint32_t edge_count = in.readUInt();
+    mEdges.reserve(static_cast<int>(edge_count));
+    for (uint32_t i = 0; i < edge_count; i++)
+    {
+        StringToken partner = in.readInt();
+        if (NULL == nodeAt(nodes, partner))
+        {
+            std::stringstream ss;
+            ss << "Node " << mid << " has an edge to " << partner << " which isn't a node";
+            throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ss);
+        }
+        crisprEdgeStruct edge;
+        edge.partner = partner;
+        edge.type = static_cast<unsigned char>(in.readUInt());
+        edge.attached = in.readBool();
+        mEdges.push_back(edge);
+    }
+}
@@ -49,9 +49,23 @@
 #include "Rainbow.h"
 #include "libcrispr.h"
 #include "ReadHolder.h"
+#include "SmallVector.h"
+#include "ReadMembership.h"
+#include "Checkpoint.h"
 
 class CrisprNode;
 
+// nodes are looked up by their token, tokens which aren't nodes point at NULL
+typedef std::vector<CrisprNode *> NodeList;
+
+// the node for a token, NULL if the token isn't a node. The list only
+// reaches as far as the last node made so a header or spacer token, or
+// one handed out since, can be past the end of it
+inline CrisprNode * nodeAt(const NodeList& nodes, StringToken token)
+{
+    return (token > 0 && token < static_cast<StringToken>(nodes.size())) ? nodes[token] : NULL;
+}
+
 // Enum to let us know if the node is a "first" node in a spacer pair
 enum EDGE_TYPE {
     CN_EDGE_BACKWARD,
@@ -61,10 +75,19 @@ enum EDGE_TYPE {
     CN_EDGE_ERROR
 };
 
-// a list of edges ( we use a map to make lookups faster )
-// The bool teels us if the edge is active (ie, if the joining node is still attached / in use)
-typedef std::map<CrisprNode *, bool> edgeList;
-typedef std::map<CrisprNode *, bool>::iterator edgeListIterator;
+// an edge to a neighbouring node. The neighbour goes by its token, look
+// it up in the node list of the manager that made it
+typedef struct {
+    StringToken partner;                // the neighbour's token
+    unsigned char type;                 // the EDGE_TYPE of the edge
+    bool attached;                      // is the edge active (ie, is the joining node still attached / in use)
+} crisprEdgeStruct;
+
+// all the edges of a node, whatever their type, sorted by type and then
+// neighbour. Most nodes only have a couple so they live inside the node and
+// the list only goes to the heap for the busy ones
+typedef SmallVector<crisprEdgeStruct, CRASS_DEF_NODE_INLINE_EDGES> edgeList;
+typedef crisprEdgeStruct * edgeListIterator;
 
 class CrisprNode 
 {
@@ -80,6 +103,7 @@ class CrisprNode
             mJumpingRank_B = 0;
             mCoverage = 0;
             mIsForward = true;
+            mDiscountedCoverage = -1;
         }
 
         CrisprNode(StringToken id)
@@ -92,6 +116,7 @@ class CrisprNode
             mJumpingRank_B = 0;
             mCoverage = 1;
             mIsForward = true;
+            mDiscountedCoverage = -1;
         }
         
         //destructor
@@ -104,23 +129,22 @@ class CrisprNode
         inline bool isForward(void) { return mIsForward; }
         inline void setForward(bool forward) { mIsForward = forward; }
         inline int getCoverage() {return mCoverage;}
-        int getDiscountedCoverage(void);
-        inline void addReadHeader(StringToken readHeader) { mReadHeaders.push_back(readHeader); }
-        inline void addReadHolder(ReadHolder * RH) { mReadHolders.push_back(RH); }
-        inline std::vector<StringToken> * getReadHeaders(void) { return &mReadHeaders; }
-        inline ReadList * getReadHolders(void) { return &mReadHolders; }
+        int getDiscountedCoverage(const ReadMembership& reads);
+        inline void forgetDiscountedCoverage(void) { mDiscountedCoverage = -1; } // call when the reads change
         
         //
         // Edge level functions
         //
         bool addEdge(CrisprNode * parterNode, EDGE_TYPE type);          // return success if the partner has been added
-        edgeList * getEdges(EDGE_TYPE type);                            // get edges of a particular type
+        inline edgeList * getEdges(void) { return &mEdges; }            // get the edges of every type, check the type when walking them
+        StringToken getFirstEdge(EDGE_TYPE type);                       // the token of the first neighbour joined by an edge of this type, 0 if there isn't one
+        edgeListIterator findEdge(StringToken partner, EDGE_TYPE type); // NULL if there is no such edge
         
         //
         // Node level functions
         //
-        inline void detachNode(void) { setAttach(false); }              // detach this node
-        inline void reattachNode(void) { setAttach(true); }             // re-attach this node
+        inline void detachNode(const NodeList& nodes) { setAttach(false, nodes); }  // detach this node, nodes is where its neighbours are
+        inline void reattachNode(const NodeList& nodes) { setAttach(true, nodes); } // re-attach this node
         inline bool isAttached(void) { return mAttached; }            // der...
         void setAsDetached(void) { mAttached = false; }					// DO NOT CALL THIS OUTSIDE OF THE ATTACH FUNCTION!
         int getRank(EDGE_TYPE type);                                    // return the rank of the node
@@ -135,17 +159,21 @@ class CrisprNode
         //
 
         void printEdges(std::ostream &dataOut, StringCheck * ST, std::string label, bool showDetached, bool printBackEdges, bool longDesc);    
-        std::vector<std::string> getReadHeaders(StringCheck * ST);
         std::string sayEdgeTypeLikeAHuman(EDGE_TYPE type);
-    std::vector<StringToken>::iterator beginHeaders(void) {return mReadHeaders.begin();}
-    std::vector<StringToken>::iterator endHeaders(void) {return mReadHeaders.end();}
+        
+        // the node and its edges, the neighbours go by their tokens so every
+        // one of them has to be in nodes before reading the node back in
+        void writeCheckpoint(CheckpointWriter& out);
+        void readCheckpoint(CheckpointReader& in, const NodeList& nodes);
 
     private:
     
-        void setAttach(bool attachState);                               // set the attach state of the node
-        void setEdgeAttachState(edgeList * currentList, bool attachState, EDGE_TYPE currentType);
-        void calculateReadCoverage(edgeList * currentList, std::map<StringToken, int>& countingMap);
-    void printEdgesForList(edgeList * currentList,
+        void setAttach(bool attachState, const NodeList& nodes);        // set the attach state of the node
+        void insertEdge(StringToken partner, EDGE_TYPE type, bool attachState);
+        void setEdgeAttachState(bool attachState, EDGE_TYPE currentType, const NodeList& nodes);
+        void setEdgeAttachState(StringToken partner, bool attachState, EDGE_TYPE type);
+        void calculateReadCoverage(EDGE_TYPE type, const ReadMembership& reads, const std::vector<StringToken>& ownReads, std::vector<int>& counts);
+    void printEdgesForList(EDGE_TYPE type,
                            std::ostream &dataOut, 
                            StringCheck * ST,
                            std::string label, 
@@ -173,10 +201,9 @@ class CrisprNode
         //  NODE 6 |   X    |   X    |   X    |   X    |   B    |   X    |
         // ---------------------------------------------------------------
         //
-        edgeList mForwardEdges;
-        edgeList mBackwardEdges;
-        edgeList mJumpingForwardEdges;
-        edgeList mJumpingBackwardEdges;
+        // All four types are kept in the one list
+        //
+        edgeList mEdges;
 
         // We need multiple classes of RANK
         int mInnerRank_F;
@@ -190,12 +217,12 @@ class CrisprNode
         // how many times have we seen this guy?
         int mCoverage;
         
+        // the coverage from reads shared with the neighbours, -1 until it
+        // is worked out and again whenever an edge changes
+        int mDiscountedCoverage;
+        
         // is this a forward facing node?
         bool mIsForward;
-
-        // we need to know which reads produced these nodes
-        std::vector<StringToken> mReadHeaders;  // headers of all reads which contain these spacers
-        ReadList mReadHolders;					// waste of the last var,  shut up.
 };
 
 #endif //CrisprNode_h
@@ -64,7 +64,18 @@ LoggerSimp* LoggerSimp::Inst(void) {
     return mInstance;
 }
 
-LoggerSimp::LoggerSimp() {}
+LoggerSimp::LoggerSimp() 
+{
+    // nothing gets logged until init is called
+    mGlobalHandle = NULL;
+    mFileHandle = NULL;
+    mBuff = NULL;
+    mTmpFH = NULL;
+    mLogLevel = 0;
+    mStartTime = 0;
+    mFileOpen = false;
+    pthread_mutex_init(&mWriteLock, NULL);
+}
 
 LoggerSimp::~LoggerSimp(){
     if(mFileOpen)
@@ -81,6 +92,7 @@ LoggerSimp::~LoggerSimp(){
     {
         delete mInstance;
     }
+    pthread_mutex_destroy(&mWriteLock);
 }
 
 void LoggerSimp::init(std::string logFile, int logLevel)
@@ -195,15 +207,17 @@ std::string LoggerSimp::timeToString(bool elapsed)
     //-----
     // get the time in a pretty form. Also can get time elapsed
     //
-    struct tm * timeinfo;
+    struct tm timeinfo;
     char buffer [80];
     
-    time ( &mCurrentTime );
+    // several threads can log at once so don't keep the time in the object
+    time_t current_time;
+    time ( &current_time );
     
     if(elapsed)
     {
         std::string tmp = "";
-        int tot_secs = (int)(difftime(mCurrentTime, mStartTime));
+        int tot_secs = (int)(difftime(current_time, mStartTime));
         int tot_days = tot_secs / 86400;
         if(tot_days)
         {
@@ -227,8 +241,8 @@ std::string LoggerSimp::timeToString(bool elapsed)
     }
     else
     {
-        timeinfo = localtime ( &mCurrentTime );
-        strftime (buffer,80,"%d/%m/%Y_%I:%M",timeinfo);
+        localtime_r ( &current_time, &timeinfo );
+        strftime (buffer,80,"%d/%m/%Y_%I:%M",&timeinfo);
         std::string tmp(buffer);
         return tmp;
     }
@@ -260,6 +274,20 @@ void LoggerSimp::closeLogFile(void)
     }
 }
 
+void LoggerSimp::writeLine(const std::string& line)
+{
+    //-----
+    // the log macros build the whole line first and hand it in here so
+    // that lines from different threads don't get mixed up
+    //
+    pthread_mutex_lock(&mWriteLock);
+    if(mGlobalHandle != NULL)
+    {
+        (*mGlobalHandle) << line << std::endl;
+    }
+    pthread_mutex_unlock(&mWriteLock);
+}
+
 void LoggerSimp::clearLogFile(void)
 {
     //-----
@@ -45,6 +45,7 @@
 #define LoggerSimp_h
 
 #include <time.h>
+#include <pthread.h>
 #include <iostream>
 #include "crassDefines.h"
 #include <config.h>
@@ -84,6 +85,7 @@ public:
     void closeLogFile(void);                                        // close the log file down
     void openLogFile(void);                                         // open the log file
     void clearLogFile(void);                                        // clear the logFile at the start
+    void writeLine(const std::string& line);                        // write one whole line, safe to call from several threads
     
     std::iostream * mGlobalHandle;                                       // what we realy write to
     
@@ -101,8 +103,8 @@ private:
     std::string mLogFile;                                                // this is the file we'll be writing out to
     int mLogLevel;                                                  // which logging level are we at?
     time_t mStartTime;                                              // the time when the logger was created
-    time_t mCurrentTime;                                            // now, .. no ... NOW! NOW!
     bool mFileOpen;                                                 // is the log file open?
+    pthread_mutex_t mWriteLock;                                     // held while a line is written
 };
 
 static LoggerSimp* logger = LoggerSimp::Inst();                     // this makes the singleton available to all classes
@@ -116,34 +118,39 @@ static LoggerSimp* logger = LoggerSimp::Inst();                     // this make
 // for logging info
 #define logInfo(cOUTsTRING, ll) { \
 if(logger->getLogLevel() >= ll) { \
-(*(logger->mGlobalHandle)) << logger->timeToString(true) << "\tI   " << cOUTsTRING << std::endl; \
+std::stringstream lOGlINE; lOGlINE << logger->timeToString(true) << "\tI   " << cOUTsTRING; \
+logger->writeLine(lOGlINE.str()); \
 } \
 }
 
 // for dumping large amounts of info to the logfile after a msg
 #define logInfoNoPrefix(cOUTsTRING, ll) {                       \
     if(logger->getLogLevel() >= ll) {                           \
-        (*(logger->mGlobalHandle)) << cOUTsTRING <<std::endl;   \
+        std::stringstream lOGlINE; lOGlINE << cOUTsTRING;       \
+        logger->writeLine(lOGlINE.str());                       \
     }                                                           \
 }
 
 // for errors
 #define logError(cOUTsTRING) { \
 std::stringstream s; s<<cOUTsTRING;\
-(*(logger->mGlobalHandle)) << logger->timeToString(true) << "\tERR " << __FILE__ << " : " << __PRETTY_FUNCTION__ << " : " << __LINE__ << ": " <<  cOUTsTRING << std::endl; \
+std::stringstream lOGlINE; lOGlINE << logger->timeToString(true) << "\tERR " << __FILE__ << " : " << __PRETTY_FUNCTION__ << " : " << __LINE__ << ": " <<  cOUTsTRING; \
+logger->writeLine(lOGlINE.str()); \
 throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__,s.str().c_str());\
 }
 
 // for warnings
 #define logWarn(cOUTsTRING, ll) { \
 if(logger->getLogLevel() >= ll) { \
-(*(logger->mGlobalHandle)) << logger->timeToString(true) << "\tW   " << cOUTsTRING << std::endl; \
+std::stringstream lOGlINE; lOGlINE << logger->timeToString(true) << "\tW   " << cOUTsTRING; \
+logger->writeLine(lOGlINE.str()); \
 } \
 }
 
 // time stamp
 #define logTimeStamp() { \
-(*(logger->mGlobalHandle)) << "----------------------------------------------------------------------\n----------------------------------------------------------------------\n-- " << logger->timeToString(false) << "  --  " << PACKAGE_FULL_NAME<<" ("<<PACKAGE_NAME<<")" << " --  Version: " << PACKAGE_VERSION << " --\n----------------------------------------------------------------------\n----------------------------------------------------------------------\n" << std::endl; \
+std::stringstream lOGlINE; lOGlINE << "----------------------------------------------------------------------\n----------------------------------------------------------------------\n-- " << logger->timeToString(false) << "  --  " << PACKAGE_FULL_NAME<<" ("<<PACKAGE_NAME<<")" << " --  Version: " << PACKAGE_VERSION << " --\n----------------------------------------------------------------------\n----------------------------------------------------------------------\n"; \
+logger->writeLine(lOGlINE.str()); \
 }
 
 #ifdef SUPER_LOGGING
@@ -154,19 +161,22 @@ if(logger->getLogLevel() >= ll) { \
 // for logging info
 #define logInfo(cOUTsTRING, ll) { \
 if(logger->getLogLevel() >= ll) { \
-(*(logger->mGlobalHandle)) << logger->timeToString(true) << "\tI   " << __FILE__ << " : " << __PRETTY_FUNCTION__ << " : " << __LINE__ << ": " <<  cOUTsTRING << std::endl; \
+std::stringstream lOGlINE; lOGlINE << logger->timeToString(true) << "\tI   " << __FILE__ << " : " << __PRETTY_FUNCTION__ << " : " << __LINE__ << ": " <<  cOUTsTRING; \
+logger->writeLine(lOGlINE.str()); \
 } \
 }
 
 // for errors
 #define logError(cOUTsTRING) { \
-(*(logger->mGlobalHandle)) << logger->timeToString(true) << "\tERR " << __FILE__ << " : " << __PRETTY_FUNCTION__ << " : " << __LINE__ << ": " <<  cOUTsTRING << std::endl; \
+std::stringstream lOGlINE; lOGlINE << logger->timeToString(true) << "\tERR " << __FILE__ << " : " << __PRETTY_FUNCTION__ << " : " << __LINE__ << ": " <<  cOUTsTRING; \
+logger->writeLine(lOGlINE.str()); \
 }
 
 // for warnings
 #define logWarn(cOUTsTRING, ll) { \
 if(logger->getLogLevel() >= ll) { \
-(*(logger->mGlobalHandle)) << logger->timeToString(true) << "\tW   " << __FILE__ << " : " << __PRETTY_FUNCTION__ << " : " << __LINE__ << ": " <<  cOUTsTRING << std::endl; \
+std::stringstream lOGlINE; lOGlINE << logger->timeToString(true) << "\tW   " << __FILE__ << " : " << __PRETTY_FUNCTION__ << " : " << __LINE__ << ": " <<  cOUTsTRING; \
+logger->writeLine(lOGlINE.str()); \
 } \
 }
 
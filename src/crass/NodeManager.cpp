@@ -38,6 +38,8 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <set>
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <fstream>
@@ -61,14 +63,6 @@
 
 
 
-SpacerInstance * WalkingManager::shift(SpacerInstance * newNode)
-{
-    SpacerInstance * old_node = WM_WalkingElem.first;
-    WM_WalkingElem.first = WM_WalkingElem.second;
-    WM_WalkingElem.second = newNode;
-    return old_node;
-}
-
 NodeManager::NodeManager(std::string drSeq, const options * userOpts)
 {
     //-----
@@ -78,7 +72,23 @@ NodeManager::NodeManager(std::string drSeq, const options * userOpts)
     NM_Opts = userOpts;
     NM_StringCheck.setName("NM_" + drSeq);
     NM_NextContigID = 0;
-    
+    NM_AttachedSpacerCount = 0;
+    NM_OwnsReads = false;
+}
+
+CrisprNode * NodeManager::newNode(StringToken st)
+{
+    //-----
+    // make a node for a freshly added kmer token
+    //
+    if((StringToken)NM_Nodes.size() <= st)
+    {
+        // tokens are handed out one after the other so this doesn't grow often
+        NM_Nodes.resize(2 * st + 1, NULL);
+    }
+    CrisprNode * node = new (NM_NodeSlab.allocate()) CrisprNode(st);
+    NM_Nodes[st] = node;
+    return node;
 }
 
 NodeManager::~NodeManager(void)
@@ -87,33 +97,19 @@ NodeManager::~NodeManager(void)
     // destructor
     //
     
-    // clean up all the cripsr nodes
-    NodeListIterator node_iter = NM_Nodes.begin();
-    while(node_iter != NM_Nodes.end())
-    {
-        if(NULL != node_iter->second)
-        {
-            delete node_iter->second;
-            node_iter->second = NULL;
-        }
-        node_iter++;
-    }
-    NM_Nodes.clear();
+    // the slabs take care of the nodes and spacers
+    
+    // delete contigs;
+    clearContigs();
     
-    SpacerListIterator spacer_iter = NM_Spacers.begin();
-    while(spacer_iter != NM_Spacers.end())
+    if(NM_OwnsReads)
     {
-        if(NULL != spacer_iter->second)
+        ReadListIterator read_iter;
+        for(read_iter = NM_ReadList.begin(); read_iter != NM_ReadList.end(); read_iter++)
         {
-            delete spacer_iter->second;
-            spacer_iter->second = NULL;
+            delete *read_iter;
         }
-        spacer_iter++;
     }
-    NM_Spacers.clear();
-    
-    // delete contigs;
-    clearContigs();
 }
 
 bool NodeManager::addReadHolder(ReadHolder * RH)
@@ -133,6 +129,43 @@ bool NodeManager::addReadHolder(ReadHolder * RH)
     }
 }
 
+void NodeManager::indexReads(void)
+{
+    //-----
+    // Freeze the reads of each node into one table. The discounted
+    // coverages were worked out from the old one so they have to go
+    //
+    if(NM_ReadMembership.frozen())
+    {
+        return;
+    }
+    NM_ReadMembership.freeze();
+    for(size_t i = 0; i < NM_NodeSlab.size(); i++)
+    {
+        NM_NodeSlab[i].forgetDiscountedCoverage();
+    }
+}
+
+int NodeManager::mostSpacersFromRead(ReadHolder * RH)
+{
+    //-----
+    // Only addCrisprNodes makes spacers. splitReadHolder calls it for every
+    // gap between two repeats and, when the read starts with a repeat, for
+    // whatever comes after the first one, so a read with only the one
+    // repeat at the very front can still make a spacer
+    //
+    unsigned int num_repeats = RH->numRepeats();
+    if(num_repeats > 1)
+    {
+        return (int)RH->numSpacers();
+    }
+    if(1 == num_repeats && 0 == RH->startStopsAt(0))
+    {
+        return 1;
+    }
+    return 0;
+}
+
 //----
 // private function called from addReadHolder to split the read into spacers and pass it through to others
 //
@@ -165,13 +198,13 @@ bool NodeManager::splitReadHolder(ReadHolder * RH)
 			if (RH->startStopsAt(0) == 0) 
 			{
 				//MI std::cout << "both" << std::endl;
-				addCrisprNodes(&prev_node, working_str, header_st, RH);
+				addCrisprNodes(&prev_node, working_str, header_st);
 			} 
 			else 
 			{
 				//MI std::cout << "sec" << std::endl;
 				// we only want to add the second kmer, since it is anchored by the direct repeat
-				addSecondCrisprNode(&prev_node, working_str, header_st, RH);
+				addSecondCrisprNode(&prev_node, working_str, header_st);
 			}
 			
 			// get all the spacers in the middle
@@ -183,7 +216,7 @@ bool NodeManager::splitReadHolder(ReadHolder * RH)
 				while (RH->getNextSpacer(&working_str)) 
 				{		
 					//MI std::cout << "SP: " << working_str << std::endl;
-					addCrisprNodes(&prev_node, working_str, header_st, RH);
+					addCrisprNodes(&prev_node, working_str, header_st);
 				}
 			} 
 			else 
@@ -196,7 +229,7 @@ bool NodeManager::splitReadHolder(ReadHolder * RH)
 					//std::cout<<RH->getLastSpacerPos()<<" : "<<(int)RH->getStartStopListSize() - 1<<" : "<<working_str<<std::endl;
 					RH->getNextSpacer(&working_str);
 					//MI std::cout << "SP: " << working_str << std::endl;
-					addCrisprNodes(&prev_node, working_str, header_st, RH);
+					addCrisprNodes(&prev_node, working_str, header_st);
 				} 
 				
 				// get our last spacer
@@ -204,7 +237,7 @@ bool NodeManager::splitReadHolder(ReadHolder * RH)
 				{
 					//std::cout<<working_str<<std::endl;
 					//MI std::cout << "last SP: " << working_str << std::endl;
-					addFirstCrisprNode(&prev_node, working_str, header_st, RH);
+					addFirstCrisprNode(&prev_node, working_str, header_st);
 				} 
 			}
 		} catch (crispr::substring_exception& e) {
@@ -225,7 +258,7 @@ bool NodeManager::splitReadHolder(ReadHolder * RH)
 //----
 // Private function called from splitReadHolder to cut the kmers and make the nodes
 //
-void NodeManager::addCrisprNodes(CrisprNode ** prevNode, std::string& workingString, StringToken headerSt, ReadHolder * RH)
+void NodeManager::addCrisprNodes(CrisprNode ** prevNode, std::string& workingString, StringToken headerSt)
 {
     //-----
     // Given a spacer string, cut kmers from each end and make crispr nodes
@@ -244,15 +277,15 @@ void NodeManager::addCrisprNodes(CrisprNode ** prevNode, std::string& workingStr
     // check to see if these kmers are already stored
     StringToken st1 = NM_StringCheck.getToken(first_kmer);
     
-    // if they have been added previously then token != 0
-    if(0 == st1)
+    first_kmer_node = nodeAt(NM_Nodes, st1);
+    // if they have been added previously they have a node. The kmer
+    // can also be in already as a spacer, it still needs its own node
+    if(NULL == first_kmer_node)
     {
         // first time we've seen this guy. Make some new objects
-        st1 = NM_StringCheck.addString(first_kmer);
-        first_kmer_node = new CrisprNode(st1);
-        
-        // add them to the pile
-        NM_Nodes[st1] = first_kmer_node;
+        if(0 == st1)
+            st1 = NM_StringCheck.addString(first_kmer);
+        first_kmer_node = newNode(st1);
 #ifdef DEBUG
         logInfo("creating node "<<st1<<" with string: "<<first_kmer, 10);
 #endif
@@ -260,32 +293,30 @@ void NodeManager::addCrisprNodes(CrisprNode ** prevNode, std::string& workingStr
     else
     {
         // we already have a node for this guy
-        first_kmer_node = NM_Nodes[st1];
         first_kmer_node->incrementCount();
     }
     
     StringToken st2 = NM_StringCheck.getToken(second_kmer);
-    if(0 == st2)
+    second_kmer_node = nodeAt(NM_Nodes, st2);
+    // the kmer can also be in already as a spacer, it still needs its own node
+    if(NULL == second_kmer_node)
     {
-        st2 = NM_StringCheck.addString(second_kmer);
-        second_kmer_node = new CrisprNode(st2);
+        if(0 == st2)
+            st2 = NM_StringCheck.addString(second_kmer);
+        second_kmer_node = newNode(st2);
         second_kmer_node->setForward(false);
-        NM_Nodes[st2] = second_kmer_node;
 #ifdef DEBUG
         logInfo("creating node "<<st2<<" with string: "<<second_kmer, 10);
 #endif
     }
     else
     {
-        second_kmer_node = NM_Nodes[st2];
         second_kmer_node->incrementCount();
     }
 
     // add in the read headers for the two CrisprNodes
-    first_kmer_node->addReadHeader(headerSt);
-    second_kmer_node->addReadHeader(headerSt);
-    first_kmer_node->addReadHolder(RH);
-    second_kmer_node->addReadHolder(RH);
+    NM_ReadMembership.add(first_kmer_node->getID(), headerSt);
+    NM_ReadMembership.add(second_kmer_node->getID(), headerSt);
     
     // the first kmers pair is the previous node which lay before it therefore bool is true
     // make sure prevNode is not NULL
@@ -314,8 +345,9 @@ void NodeManager::addCrisprNodes(CrisprNode ** prevNode, std::string& workingStr
     
     // check to see if we already have it here
     this_sp_key = makeSpacerKey(st1, st2);
+    SpacerListIterator sp_iter = NM_Spacers.find(this_sp_key);
     
-    if(NM_Spacers.find(this_sp_key) == NM_Spacers.end())
+    if(sp_iter == NM_Spacers.end())
     {
         // new instance
         StringToken sp_str_token = NM_StringCheck.getToken(workingString);
@@ -323,7 +355,7 @@ void NodeManager::addCrisprNodes(CrisprNode ** prevNode, std::string& workingStr
     	{
             sp_str_token = NM_StringCheck.addString(workingString);
     	}
-        curr_spacer = new SpacerInstance(sp_str_token, first_kmer_node, second_kmer_node);
+        curr_spacer = new (NM_SpacerSlab.allocate()) SpacerInstance(sp_str_token, first_kmer_node, second_kmer_node);
         NM_Spacers[this_sp_key] = curr_spacer;
 #ifdef SEARCH_SINGLETON
         if (debug_iter != debugger->end()) {
@@ -341,13 +373,13 @@ void NodeManager::addCrisprNodes(CrisprNode ** prevNode, std::string& workingStr
     else
     {
         // increment the number of times we've seen this guy
-        (NM_Spacers[this_sp_key])->incrementCount();
+        (sp_iter->second)->incrementCount();
     }
     
     *prevNode = second_kmer_node;
 }
 
-void NodeManager::addSecondCrisprNode(CrisprNode ** prevNode, std::string& workingString, StringToken headerSt, ReadHolder * RH)
+void NodeManager::addSecondCrisprNode(CrisprNode ** prevNode, std::string& workingString, StringToken headerSt)
 {
     if ((int)workingString.length() < NM_Opts->cNodeKmerLength)
         return;
@@ -358,22 +390,21 @@ void NodeManager::addSecondCrisprNode(CrisprNode ** prevNode, std::string& worki
     // check to see if these kmers are already stored
     StringToken st2 = NM_StringCheck.getToken(second_kmer);
     
-    // if they have been added previously then token != 0
-    if(0 == st2)
+    second_kmer_node = nodeAt(NM_Nodes, st2);
+    // if they have been added previously they have a node. The kmer
+    // can also be in already as a spacer, it still needs its own node
+    if(NULL == second_kmer_node)
     {
         // first time we've seen this guy. Make some new objects
-        st2 = NM_StringCheck.addString(second_kmer);
-        second_kmer_node = new CrisprNode(st2);
+        if(0 == st2)
+            st2 = NM_StringCheck.addString(second_kmer);
+        second_kmer_node = newNode(st2);
         second_kmer_node->setForward(false);
-        
-        // add them to the pile
-        NM_Nodes[st2] = second_kmer_node;
     }
     else
     {
         // we already have a node for this guy
-        second_kmer_node = NM_Nodes[st2];
-        (NM_Nodes[st2])->incrementCount();
+        second_kmer_node->incrementCount();
     }
 #ifdef SEARCH_SINGLETON
     SearchCheckerList::iterator debug_iter = debugger->find(NM_StringCheck.getString(headerSt));
@@ -383,8 +414,7 @@ void NodeManager::addSecondCrisprNode(CrisprNode ** prevNode, std::string& worki
     }
 #endif
     // add in the read headers for the this CrisprNode
-    second_kmer_node->addReadHeader(headerSt);
-    second_kmer_node->addReadHolder(RH);
+    NM_ReadMembership.add(second_kmer_node->getID(), headerSt);
     
     // add this guy in as the previous node for the next iteration
     *prevNode = second_kmer_node;
@@ -392,7 +422,7 @@ void NodeManager::addSecondCrisprNode(CrisprNode ** prevNode, std::string& worki
     // there is no one yet to make an edge
 }
 
-void NodeManager::addFirstCrisprNode(CrisprNode ** prevNode, std::string& workingString, StringToken headerSt, ReadHolder * RH)
+void NodeManager::addFirstCrisprNode(CrisprNode ** prevNode, std::string& workingString, StringToken headerSt)
 {
     if ((int)workingString.length() < NM_Opts->cNodeKmerLength)
         return;
@@ -403,21 +433,20 @@ void NodeManager::addFirstCrisprNode(CrisprNode ** prevNode, std::string& workin
     // check to see if these kmers are already stored
     StringToken st1 = NM_StringCheck.getToken(first_kmer);
     
-    // if they have been added previously then token != 0
-    if(0 == st1)
+    first_kmer_node = nodeAt(NM_Nodes, st1);
+    // if they have been added previously they have a node. The kmer
+    // can also be in already as a spacer, it still needs its own node
+    if(NULL == first_kmer_node)
     {
         // first time we've seen this guy. Make some new objects
-        st1 = NM_StringCheck.addString(first_kmer);
-        first_kmer_node = new CrisprNode(st1);
-        
-        // add them to the pile
-        NM_Nodes[st1] = first_kmer_node;
+        if(0 == st1)
+            st1 = NM_StringCheck.addString(first_kmer);
+        first_kmer_node = newNode(st1);
     }
     else
     {
         // we already have a node for this guy
-        first_kmer_node = NM_Nodes[st1];
-        (NM_Nodes[st1])->incrementCount();
+        first_kmer_node->incrementCount();
     }
 #ifdef SEARCH_SINGLETON
     SearchCheckerList::iterator debug_iter = debugger->find(NM_StringCheck.getString(headerSt));
@@ -427,8 +456,7 @@ void NodeManager::addFirstCrisprNode(CrisprNode ** prevNode, std::string& workin
     }
 #endif
     // add in the read headers for the this CrisprNode
-    first_kmer_node->addReadHeader(headerSt);
-    first_kmer_node->addReadHolder(RH);
+    NM_ReadMembership.add(first_kmer_node->getID(), headerSt);
     
     // check to see if we already have it here
     if(NULL != *prevNode)
@@ -442,6 +470,106 @@ void NodeManager::addFirstCrisprNode(CrisprNode ** prevNode, std::string& workin
     }
 }
 
+// Snapshots
+
+void NodeManager::writeCheckpoint(CheckpointWriter& out)
+{
+    //-----
+    // The strings go in token order so that they get the same tokens when
+    // they're added back in. All the nodes are listed before any of them
+    // are written out so that the edges have somewhere to point to. The
+    // spacers go in the order they were made so that they go back into the
+    // hash in the same order and get walked in the same order
+    //
+    indexReads();
+    StringToken last_token = NM_StringCheck.mNextFreeToken;
+    out.writeInt(last_token);
+    for(StringToken token = 2; token <= last_token; token++)
+    {
+        out.writeString(NM_StringCheck.getString(token));
+    }
+    
+    out.writeSize(NM_ReadList.size());
+    ReadListIterator read_iter;
+    for(read_iter = NM_ReadList.begin(); read_iter != NM_ReadList.end(); read_iter++)
+    {
+        (*read_iter)->writeCheckpoint(out);
+    }
+    
+    out.writeSize(NM_NodeSlab.size());
+    for(size_t i = 0; i < NM_NodeSlab.size(); i++)
+    {
+        out.writeInt(NM_NodeSlab[i].getID());
+    }
+    for(size_t i = 0; i < NM_NodeSlab.size(); i++)
+    {
+        NM_NodeSlab[i].writeCheckpoint(out);
+    }
+    
+    out.writeSize(NM_SpacerSlab.size());
+    for(size_t i = 0; i < NM_SpacerSlab.size(); i++)
+    {
+        NM_SpacerSlab[i].writeCheckpoint(out);
+    }
+    
+    NM_ReadMembership.writeCheckpoint(out);
+}
+
+void NodeManager::readCheckpoint(CheckpointReader& in)
+{
+    if(0 != NM_NodeSlab.size() || !NM_ReadList.empty())
+    {
+        throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, "Snapshots can only be read into an empty NodeManager");
+    }
+    StringToken last_token = in.readInt();
+    for(StringToken token = 2; token <= last_token; token++)
+    {
+        if(NM_StringCheck.addString(in.readString()) != token)
+        {
+            std::stringstream ss;
+            ss << "String " << token << " came back with a different token, the snapshot has the same string twice";
+            throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ss);
+        }
+    }
+    
+    NM_OwnsReads = true;
+    uint64_t read_count = in.readSize();
+    NM_ReadList.reserve(read_count);
+    for(uint64_t i = 0; i < read_count; i++)
+    {
+        ReadHolder * read = new ReadHolder();
+        NM_ReadList.push_back(read);
+        read->readCheckpoint(in);
+    }
+    
+    uint64_t node_count = in.readSize();
+    for(uint64_t i = 0; i < node_count; i++)
+    {
+        StringToken token = in.readInt();
+        if(token < 2 || token > last_token || NULL != nodeAt(NM_Nodes, token))
+        {
+            std::stringstream ss;
+            ss << "Node " << token << " is not a string or turns up twice";
+            throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ss);
+        }
+        newNode(token);
+    }
+    for(size_t i = 0; i < NM_NodeSlab.size(); i++)
+    {
+        NM_NodeSlab[i].readCheckpoint(in, NM_Nodes);
+    }
+    
+    uint64_t spacer_count = in.readSize();
+    for(uint64_t i = 0; i < spacer_count; i++)
+    {
+        SpacerInstance * spacer = new (NM_SpacerSlab.allocate()) SpacerInstance();
+        spacer->readCheckpoint(in, NM_Nodes);
+        NM_Spacers[makeSpacerKey(spacer->getLeader()->getID(), spacer->getLast()->getID())] = spacer;
+    }
+    
+    NM_ReadMembership.readCheckpoint(in);
+}
+
 // Walking
 
 
@@ -453,17 +581,16 @@ void NodeManager::findCapNodes(NodeVector * capNodes)
     //
     capNodes->clear();
     
-    NodeListIterator all_node_iter = NM_Nodes.begin();
-    while (all_node_iter != NM_Nodes.end()) 
+    for(size_t i = 0; i < NM_NodeSlab.size(); i++)
     {
-        if((all_node_iter->second)->isAttached())
+        CrisprNode * node = &NM_NodeSlab[i];
+        if(node->isAttached())
         {
-            if ((all_node_iter->second)->getTotalRank() == 1) 
+            if (node->getTotalRank() == 1) 
             {
-                capNodes->push_back(all_node_iter->second);
+                capNodes->push_back(node);
             }
         }
-        all_node_iter++;
     }
 }
 
@@ -474,13 +601,12 @@ void NodeManager::findAllNodes(NodeVector * allNodes)
     //
     allNodes->clear();
     
-    NodeListIterator all_node_iter = NM_Nodes.begin();
-    while (all_node_iter != NM_Nodes.end()) 
+    for(size_t i = 0; i < NM_NodeSlab.size(); i++)
     {
-        if((all_node_iter->second)->isAttached())
+        CrisprNode * node = &NM_NodeSlab[i];
+        if(node->isAttached())
         {
-            allNodes->push_back(all_node_iter->second);
-            all_node_iter++;
+            allNodes->push_back(node);
         }
     }
 }
@@ -493,18 +619,17 @@ void NodeManager::findAllNodes(NodeVector * capNodes, NodeVector * otherNodes)
     capNodes->clear();
     otherNodes->clear();
     
-    NodeListIterator all_node_iter = NM_Nodes.begin();
-    while (all_node_iter != NM_Nodes.end()) 
+    for(size_t i = 0; i < NM_NodeSlab.size(); i++)
     {
-        if((all_node_iter->second)->isAttached())
+        CrisprNode * node = &NM_NodeSlab[i];
+        if(node->isAttached())
         {
-            int rank = (all_node_iter->second)->getTotalRank(); 
+            int rank = node->getTotalRank(); 
             if (rank == 1) 
-            { capNodes->push_back(all_node_iter->second); }
+            { capNodes->push_back(node); }
             else
-            { otherNodes->push_back(all_node_iter->second); }
+            { otherNodes->push_back(node); }
         }
-        all_node_iter++;
     }
 }
 
@@ -522,29 +647,29 @@ int NodeManager::findCapsAt(NodeVector * capNodes, bool searchForward, bool isIn
     if(queryNode->isAttached())
     {
         // first, find what type of edge we are searching for.
-        edgeListIterator el_iter;
-        edgeList * el;
+        EDGE_TYPE search_type;
         if(searchForward)
         {
             if(isInner)
-                el = queryNode->getEdges(CN_EDGE_FORWARD);
+                search_type = CN_EDGE_FORWARD;
             else
-                el = queryNode->getEdges(CN_EDGE_JUMPING_F);
+                search_type = CN_EDGE_JUMPING_F;
         }
         else
         {
             if(isInner)
-                el = queryNode->getEdges(CN_EDGE_BACKWARD);
+                search_type = CN_EDGE_BACKWARD;
             else
-                el = queryNode->getEdges(CN_EDGE_JUMPING_B);
+                search_type = CN_EDGE_JUMPING_B;
         }
-        el_iter = el->begin();
+        edgeList * el = queryNode->getEdges();
+        edgeListIterator el_iter = el->begin();
         while(el_iter != el->end())
         {
             // make sure we only look at attached edges
-            if(el_iter->second)
+            if(el_iter->type == search_type && el_iter->attached)
             {
-                CrisprNode * attached_node = el_iter->first;
+                CrisprNode * attached_node = nodeAt(NM_Nodes, el_iter->partner);
                 if(1 == attached_node->getTotalRank())
                 {
                     // this guy is a cap!
@@ -568,129 +693,17 @@ int NodeManager::findCapsAt(NodeVector * capNodes, bool searchForward, bool isIn
 }
 
 
-bool NodeManager::getSpacerEdgeFromCap(WalkingManager * walkElem, SpacerInstance * currentSpacer)
-{
-    if (currentSpacer->getSpacerRank() == 1) 
-    {
-        SpacerEdgeVector_Iterator iter = currentSpacer->begin();
-        
-        while (iter != currentSpacer->end()) 
-        {
-            if (((*iter)->edge)->isAttached()) 
-            {
-                if (0 == ((*iter)->edge)->getContigID()) 
-                {
-                    walkElem->setSecondNode((*iter)->edge);
-                    walkElem->setFirstNode(currentSpacer);
-                    walkElem->setWantedEdge((*iter)->d);
-                } 
-                else 
-                {
-                    currentSpacer->setContigID(((*iter)->edge)->getContigID());
-                    return false;
-                }
-            } 
-            else 
-            {
-                return false;
-            }
-            iter++;
-        }
-    }
-    else 
-    {
-        return false;
-    }
-    if (walkElem->first() == NULL || walkElem->second() == NULL) {
-        return false;
-    } else {
-        return true;
-    }
-}
-
-bool NodeManager::getSpacerEdgeFromCross(WalkingManager * walkElem, SpacerInstance * currentSpacer )
-{
-    // check that the edge is a path node
-    if (currentSpacer->getSpacerRank() == 2) 
-    {
-        SpacerEdgeVector_Iterator iter = currentSpacer->begin();
-        
-        while (iter != currentSpacer->end()) 
-        {
-            if (((*iter)->edge)->isAttached()) 
-            {
-                if (0 == ((*iter)->edge)->getContigID()) 
-                {
-                    walkElem->setSecondNode((*iter)->edge);
-                    walkElem->setFirstNode(currentSpacer);
-                    walkElem->setWantedEdge((*iter)->d);
-                    return true;
-                } 
-            } 
-            else 
-            {
-                return false;
-            }
-            iter++;
-        }
-    }
-    else 
-    {
-        return false;
-    }
-    if (walkElem->first() == NULL || walkElem->second() == NULL) {
-        return false;
-    } else {
-        return true;
-    }
-}
-
-bool NodeManager::stepThroughSpacerPath(WalkingManager * walkElem, SpacerInstance ** previousNode)
-{
-    switch ((walkElem->second())->getSpacerRank()) 
-    {
-        case 2:
-        {
-            // path node?
-            // check to see if the other edge is going in the same direction as wantedDirection
-            SpacerEdgeVector_Iterator iter = (walkElem->second())->begin();
-            while (iter != (walkElem->second())->end()) 
-            {
-                // make sure the edge is attached, in the right direction, not the incomming edge and not assigned to a contig already
-                if ((*iter)->edge->isAttached()  && 
-                    ((*iter)->d == walkElem->getEdgeType()) && 
-                    ((*iter)->edge->getID() != walkElem->first()->getID()) && 
-                    ((*iter)->edge->getContigID() == 0)) 
-                {
-                    *previousNode = walkElem->shift((*iter)->edge);
-                    return true;
-                } 
-                iter++;
-            }
-            break;
-        }
-        case 1:
-            //
-        default:
-        {
-            return false;
-            // cross node
-            break;
-        }
-    }
-    return false;
-}
-
-
 // Cleaning
 int NodeManager::cleanGraph(void)
 {
     //-----
     // Clean all the bits off the graph mofo!
     //
+    indexReads();
+
     // keep going while we're detaching stuff
     bool some_detached = true;
-    
+
     while(some_detached)
     {
         std::multimap<CrisprNode *, CrisprNode *> fork_choice_map;
@@ -709,35 +722,34 @@ int NodeManager::cleanGraph(void)
             if ((*nv_iter)->getInnerRank() == 0)
             {
                 // make sure that this guy is linked to a cross node
-                edgeList * el;
+                CrisprNode * other_node;
                 if(0 != (*nv_iter)->getRank(CN_EDGE_JUMPING_F))
-                    el = (*nv_iter)->getEdges(CN_EDGE_JUMPING_F);
+                    other_node = nodeAt(NM_Nodes, (*nv_iter)->getFirstEdge(CN_EDGE_JUMPING_F));
                 else
-                    el = (*nv_iter)->getEdges(CN_EDGE_JUMPING_B);
+                    other_node = nodeAt(NM_Nodes, (*nv_iter)->getFirstEdge(CN_EDGE_JUMPING_B));
                 
-                // there is only one guy in this list!
-                int other_rank = ((el->begin())->first)->getTotalRank();
+                // there is only one guy of this type!
+                int other_rank = other_node->getTotalRank();
                 if(other_rank != 2)
                     detach_list.push_back(*nv_iter);
             }
             else
             {
                 // make sure that this guy is linked to a cross node
-                edgeList * el;
+                CrisprNode * joining_node;
                 bool is_forward;
                 if(0 != (*nv_iter)->getRank(CN_EDGE_FORWARD))
                 {
-                    el = (*nv_iter)->getEdges(CN_EDGE_FORWARD);
+                    joining_node = nodeAt(NM_Nodes, (*nv_iter)->getFirstEdge(CN_EDGE_FORWARD));
                     is_forward = false;
                 }
                 else
                 {
-                    el = (*nv_iter)->getEdges(CN_EDGE_BACKWARD);
+                    joining_node = nodeAt(NM_Nodes, (*nv_iter)->getFirstEdge(CN_EDGE_BACKWARD));
                     is_forward = true;
                 }
                 
-                // there is only one guy in this list!
-                CrisprNode * joining_node = ((el->begin())->first); 
+                // there is only one guy of this type!
                 int other_rank = joining_node->getTotalRank();
                 if(other_rank != 2)
                 {
@@ -803,7 +815,7 @@ int NodeManager::cleanGraph(void)
         nv_iter = detach_list.begin();
         while(nv_iter != detach_list.end())
         {
-            (*nv_iter)->detachNode();
+            (*nv_iter)->detachNode(NM_Nodes);
             nv_iter++;
         }
     
@@ -824,7 +836,7 @@ int NodeManager::cleanGraph(void)
     #ifdef DEBUG
                         logInfo("node "<<(*nv_iter)->getID()<<" has only two edges of the same type -- cannot be linear -- detaching", 8);
     #endif
-                        (*nv_iter)->detachNode();
+                        (*nv_iter)->detachNode(NM_Nodes);
                         some_detached = true;
                     }
                     break;
@@ -865,49 +877,51 @@ bool NodeManager::clearBubbles(CrisprNode * rootNode, EDGE_TYPE currentEdgeType)
 	bool some_detached = false;
 	
     // get a list of edges
-    edgeList * curr_edges = rootNode->getEdges(currentEdgeType);
+    edgeList * curr_edges = rootNode->getEdges();
+    EDGE_TYPE opposite_edge_type = getOppositeEdgeType(currentEdgeType);
     
     // the key is the hashed values of both the root node and the edge
     // the value is the node id of the edge
-    std::map<int, int> bubble_map;
+    CRASS_HASH_MAP<uint64_t, StringToken> bubble_map;
     
-    // now go through each of the edges and make a hashed key for the edge 
-    edgeListIterator curr_edges_iter; //= curr_edges->begin();
-    for (curr_edges_iter = curr_edges->begin(); curr_edges_iter != curr_edges->end(); ++curr_edges_iter) {
+    // now go through each of the edges and make a hashed key for the edge.
+    // Detaching nodes can add edges to the lists so go by position
+    for (size_t i = 0; i < curr_edges->size(); ++i) {
         
-        if ( !(curr_edges_iter->first)->isAttached()) 
+        CrisprNode * curr_node = nodeAt(NM_Nodes, (*curr_edges)[i].partner);
+        if ((*curr_edges)[i].type != currentEdgeType || !curr_node->isAttached()) 
         {
             continue;
         }
         // we want to go through all the edges of the nodes above (2nd degree separation)
         // and since we used the forward edges to get here we now want the opposite (Jummping_F)
-        edgeList * edges_of_curr_edge = (curr_edges_iter->first)->getEdges(getOppositeEdgeType(currentEdgeType));
+        edgeList * edges_of_curr_edge = curr_node->getEdges();
         
-        edgeListIterator edges_of_curr_edge_iter; //= edges_of_curr_edge->begin();
-        for (edges_of_curr_edge_iter = edges_of_curr_edge->begin(); edges_of_curr_edge_iter != edges_of_curr_edge->end(); ++edges_of_curr_edge_iter) 
+        for (size_t j = 0; j < edges_of_curr_edge->size(); ++j) 
         {
             // make sue that this guy is attached
-            if (! (edges_of_curr_edge_iter->first)->isAttached()) 
+            CrisprNode * second_node = nodeAt(NM_Nodes, (*edges_of_curr_edge)[j].partner);
+            if ((*edges_of_curr_edge)[j].type != opposite_edge_type || ! second_node->isAttached()) 
             {
                 continue;
             }
             // so now we're at the second degree of separation for our edges
             // again make a key but check to see if the key exists in the hash
             
-            int new_key = makeKey(rootNode->getID(), (edges_of_curr_edge_iter->first)->getID());
+            uint64_t new_key = makeKey(rootNode->getID(), second_node->getID());
             if (bubble_map.find(new_key) == bubble_map.end()) 
             {
                 // first time we've seen him
-                bubble_map[new_key] = (curr_edges_iter->first)->getID();
+                bubble_map[new_key] = curr_node->getID();
             } 
             else 
             {
                 // aha! he is pointing back onto the same guy as someone else.  We have a bubble!
                 //get the CrisprNode of the first guy
                 
-                CrisprNode * first_node = NM_Nodes[bubble_map[new_key]];
+                CrisprNode * first_node = nodeAt(NM_Nodes, bubble_map[new_key]);
 #ifdef DEBUG
-                logInfo("Bubble found conecting "<<rootNode->getID()<<" : "<<first_node->getID()<<" : "<<(edges_of_curr_edge_iter->first)->getID()<< " : "<<(curr_edges_iter->first)->getID(), 8);
+                logInfo("Bubble found conecting "<<rootNode->getID()<<" : "<<first_node->getID()<<" : "<<second_node->getID()<< " : "<<curr_node->getID(), 8);
 #endif
                 //perform a coverage test on the nodes that end up here and kill the one with the least coverage
                 
@@ -917,33 +931,37 @@ bool NodeManager::clearBubbles(CrisprNode * rootNode, EDGE_TYPE currentEdgeType)
                 // NodeManager to calculate the average and stdev of the coverage and then remove a node only if
                 // it is below 1 stdev of the average, else it could be a biological thing that this bubble exists.
                 
-                if (first_node->getDiscountedCoverage() > (curr_edges_iter->first)->getDiscountedCoverage()) 
+                if (first_node->getDiscountedCoverage(NM_ReadMembership) > curr_node->getDiscountedCoverage(NM_ReadMembership)) 
                 {
 #ifdef DEBUG
-                    logInfo("Node "<<first_node->getID()<<" has higher discounted coverage ("<<first_node->getDiscountedCoverage()<<") than Node "<<(curr_edges_iter->first)->getID()<<" ("<<(curr_edges_iter->first)->getDiscountedCoverage()<<")", 8);
+                    logInfo("Node "<<first_node->getID()<<" has higher discounted coverage ("<<first_node->getDiscountedCoverage(NM_ReadMembership)<<") than Node "<<curr_node->getID()<<" ("<<curr_node->getDiscountedCoverage(NM_ReadMembership)<<")", 8);
 #endif
                     
                     // the first guy has greater coverage so detach our current node
-                    (curr_edges_iter->first)->detachNode();
+                    curr_node->detachNode(NM_Nodes);
                     some_detached = true;
 #ifdef DEBUG
-                    logInfo("Detaching "<<(curr_edges_iter->first)->getID()<<" as it has lower coverage", 8);
+                    logInfo("Detaching "<<curr_node->getID()<<" as it has lower coverage", 8);
 #endif
                 } 
                 else 
                 {
 #ifdef DEBUG
-                    logInfo("Node "<<first_node->getID()<<" has lower discounted coverage ("<<first_node->getDiscountedCoverage()<<") than Node "<<(curr_edges_iter->first)->getID()<<" ("<<(curr_edges_iter->first)->getDiscountedCoverage()<<")", 8);
+                    logInfo("Node "<<first_node->getID()<<" has lower discounted coverage ("<<first_node->getDiscountedCoverage(NM_ReadMembership)<<") than Node "<<curr_node->getID()<<" ("<<curr_node->getDiscountedCoverage(NM_ReadMembership)<<")", 8);
 #endif
-                    // the first guy was lower so kill him
-                    first_node->detachNode();
+                    // the first guy was lower so kill him. On a tie this is
+                    // also him, the branch node with the lower token
+                    first_node->detachNode(NM_Nodes);
                     some_detached = true;
 #ifdef DEBUG
                     logInfo("Detaching "<<first_node->getID()<<" as it has lower coverage", 8);
 #endif
                     // replace the existing key (to check for triple bubbles)
-                    bubble_map[new_key] = (curr_edges_iter->first)->getID();
+                    bubble_map[new_key] = curr_node->getID();
                 }
+                // detaching can slot new edges in ahead of us, find our place again
+                i = rootNode->findEdge(curr_node->getID(), currentEdgeType) - curr_edges->begin();
+                j = curr_node->findEdge(second_node->getID(), opposite_edge_type) - edges_of_curr_edge->begin();
             }
         }
     }
@@ -975,17 +993,17 @@ EDGE_TYPE NodeManager::getOppositeEdgeType(EDGE_TYPE currentEdgeType)
 int NodeManager::getSpacerCountAndStats(bool showDetached, bool excludeFlankers)
 {
     int number_of_spacers = 0;
-    SpacerListIterator sp_iter; NM_Spacers.begin();
-    for (sp_iter = NM_Spacers.begin(); sp_iter != NM_Spacers.end(); ++sp_iter) 
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    for(size_t i = 0; i < walk_order.size(); i++)
     {
-        SpacerInstance * current_spacer = sp_iter->second;
+        SpacerInstance * current_spacer = walk_order[i];
         if (showDetached || current_spacer->isAttached()) 
         {
             if (excludeFlankers & current_spacer->isFlanker()) {
                 continue;
             }
             // add in some stats for the spacers
-            std::string spacer = NM_StringCheck.getString((sp_iter->second)->getID());
+            std::string spacer = NM_StringCheck.getString(current_spacer->getID());
             NM_SpacerLenStat.add(spacer.length());
             number_of_spacers++;
         }
@@ -1024,14 +1042,13 @@ void NodeManager::findAllForwardAttachedNodes(NodeVector * nodes)
     //
     nodes->clear();
     
-    NodeListIterator all_node_iter = NM_Nodes.begin();
-    while (all_node_iter != NM_Nodes.end()) 
+    for(size_t i = 0; i < NM_NodeSlab.size(); i++)
     {
-        if((all_node_iter->second)->isAttached()&& (all_node_iter->second)->isForward())
+        CrisprNode * node = &NM_NodeSlab[i];
+        if(node->isAttached() && node->isForward())
         {
-            nodes->push_back(all_node_iter->second);
+            nodes->push_back(node);
         }
-        all_node_iter++;
     }
 }
 
@@ -1041,41 +1058,45 @@ int NodeManager::buildSpacerGraph(void)
     // For all forward nodes, count the number of ongoing spacers
     // make spacer edges if told to do so
     //
-    SpacerListIterator spacers_iter = NM_Spacers.begin();
-    while(spacers_iter != NM_Spacers.end()) 
+    NM_AttachedSpacerCount = 0;
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    for(size_t i = 0; i < walk_order.size(); i++)
     {
+        SpacerInstance * current_spacer = walk_order[i];
         // get the last node of this spacer
-        CrisprNode * rq_leader_node = (spacers_iter->second)->getLeader();
-        CrisprNode * rq_last_node = (spacers_iter->second)->getLast();
+        CrisprNode * rq_leader_node = current_spacer->getLeader();
+        CrisprNode * rq_last_node = current_spacer->getLast();
         
         if(rq_last_node->isAttached() && rq_leader_node->isAttached())
         {
             // mark this guy as attached
-            (spacers_iter->second)->setAttached(true);
+            current_spacer->setAttached(true);
+            NM_AttachedSpacerCount++;
             
 #ifdef DEBUG
-            SpacerInstance * debug_spacer = (spacers_iter->second);
+            SpacerInstance * debug_spacer = current_spacer;
             logInfo("Spacer "<<debug_spacer->getID()<<" composed of nodes "<<(debug_spacer->getLeader())->getID()<<" "<<(debug_spacer->getLast())->getID(), 8);
 #endif
             // now get all the jumping forward edges from this node
-            edgeList * qel = rq_last_node->getEdges(CN_EDGE_JUMPING_F);
+            edgeList * qel = rq_last_node->getEdges();
             edgeListIterator qel_iter = qel->begin();
             while(qel_iter != qel->end())
             {
-                if((qel_iter->first)->isAttached() && (qel_iter->first)->isForward())
+                CrisprNode * jumping_node = nodeAt(NM_Nodes, qel_iter->partner);
+                if(qel_iter->type == CN_EDGE_JUMPING_F && jumping_node->isAttached() && jumping_node->isForward())
                 {
                     // a forward attached node. Now check for inner edges.
-                    edgeList * el = (qel_iter->first)->getEdges(CN_EDGE_FORWARD);
+                    edgeList * el = jumping_node->getEdges();
                     edgeListIterator el_iter = el->begin();
                     while(el_iter != el->end())
                     {
-                        if((el_iter->first)->isAttached())
+                        if(el_iter->type == CN_EDGE_FORWARD && nodeAt(NM_Nodes, el_iter->partner)->isAttached())
                         {
                             // bingo!
-                            SpacerInstance * next_spacer = NM_Spacers[makeSpacerKey((el_iter->first)->getID(), (qel_iter->first)->getID())];
+                            SpacerInstance * next_spacer = NM_Spacers[makeSpacerKey(el_iter->partner, qel_iter->partner)];
                             
-                            if (next_spacer == spacers_iter->second) {
-                                //logError("Spacer "<<spacers_iter->second << " with id "<< (spacers_iter->second)->getID()<< " has an edge to itself... aborting edge "<<next_spacer <<" : "<< spacers_iter->second);
+                            if (next_spacer == current_spacer) {
+                                //logError("Spacer "<<current_spacer << " with id "<< current_spacer->getID()<< " has an edge to itself... aborting edge "<<next_spacer <<" : "<< current_spacer);
                             } 
                             else 
                             {
@@ -1084,11 +1105,11 @@ int NodeManager::buildSpacerGraph(void)
                                 spacerEdgeStruct * new_edge = new spacerEdgeStruct();
                                 new_edge->edge = next_spacer;
                                 new_edge->d = FORWARD;
-                                (spacers_iter->second)->addEdge(new_edge);
+                                current_spacer->addEdge(new_edge);
                                 
                                 // add the corresponding reverse edge to the current spacer
                                 spacerEdgeStruct * new_edge2 = new spacerEdgeStruct();
-                                new_edge2->edge = spacers_iter->second;
+                                new_edge2->edge = current_spacer;
                                 new_edge2->d = REVERSE;
                                 next_spacer->addEdge(new_edge2);
                             }
@@ -1102,45 +1123,43 @@ int NodeManager::buildSpacerGraph(void)
         }
         else
         {
-            (spacers_iter->second)->setAttached(false);    
+            current_spacer->setAttached(false);    
         }
-        spacers_iter++;
     }
     return 0;
 }
 
 void NodeManager::getAllSpacerCaps(SpacerInstanceVector * sv)
 {
-    SpacerListIterator sp_iter = NM_Spacers.begin();
-    while (sp_iter != NM_Spacers.end()) 
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    for(size_t i = 0; i < walk_order.size(); i++)
     {
-        if((sp_iter->second)->isAttached() )
+        SpacerInstance * current_spacer = walk_order[i];
+        if(current_spacer->isAttached() )
         {
-            if ((sp_iter->second)->getSpacerRank() == 1) 
+            if (current_spacer->getSpacerRank() == 1) 
             {
-                sv->push_back(sp_iter->second);
+                sv->push_back(current_spacer);
             }
         }
-        sp_iter++;
     }
 }
 
 
 void NodeManager::findSpacerForContig(SpacerInstanceVector * sv, int contigID)
 {
-    SpacerListIterator sp_iter = NM_Spacers.begin();
-    
     // first we build up the contents of the walking queue
-    while(sp_iter != NM_Spacers.end())
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    for(size_t i = 0; i < walk_order.size(); i++)
     {
-        if((sp_iter->second)->isAttached() )
+        SpacerInstance * current_spacer = walk_order[i];
+        if(current_spacer->isAttached() )
         {
-            if ((sp_iter->second)->getContigID() == contigID) 
+            if (current_spacer->getContigID() == contigID) 
             {
-                sv->push_back(sp_iter->second);
+                sv->push_back(current_spacer);
             }
         }
-        sp_iter++;
     }
 }
 
@@ -1151,6 +1170,7 @@ int NodeManager::cleanSpacerGraph(void)
     //
     int round  = 0;
     bool cleaned_some = true;
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
     while(cleaned_some)
     {
         round++;
@@ -1158,39 +1178,37 @@ int NodeManager::cleanSpacerGraph(void)
         cleaned_some = false;
         
         // remove fur
-        SpacerListIterator sp_iter = NM_Spacers.begin();
-        while(sp_iter != NM_Spacers.end())
+        for(size_t i = 0; i < walk_order.size(); i++)
         {
-            if((sp_iter->second)->isAttached())
+            SpacerInstance * current_spacer = walk_order[i];
+            if(current_spacer->isAttached())
             {
-                if(sp_iter->second->isFur())
+                if(current_spacer->isFur())
                 {
-                    //std::cout << "a: " << (sp_iter->second) <<" round: "<<round<< std::endl;
-                    //(sp_iter->second)->printContents();
-                    sp_iter->second->detachFromSpacerGraph();
+                    //std::cout << "a: " << current_spacer <<" round: "<<round<< std::endl;
+                    //current_spacer->printContents();
+                    current_spacer->detachFromSpacerGraph();
                     cleaned_some = true;
                 }
             }
-            sp_iter++;
         }
         
         // remove non-viable nodes
-        sp_iter = NM_Spacers.begin();
-        while(sp_iter != NM_Spacers.end())
+        for(size_t i = 0; i < walk_order.size(); i++)
         {
-            //std::cout<<"Testing Attached: "<<(*sp_iter->second).getID()<<std::endl;
-            if((sp_iter->second)->isAttached())
+            SpacerInstance * current_spacer = walk_order[i];
+            //std::cout<<"Testing Attached: "<<(*current_spacer).getID()<<std::endl;
+            if(current_spacer->isAttached())
             {
-                if(!sp_iter->second->isViable())
+                if(!current_spacer->isViable())
                 {
-                    //std::cout << "b: " << sp_iter->second <<" round: "<<round<< std::endl;
-                    //(sp_iter->second)->printContents();
+                    //std::cout << "b: " << current_spacer <<" round: "<<round<< std::endl;
+                    //current_spacer->printContents();
 
-                    sp_iter->second->detachFromSpacerGraph();
+                    current_spacer->detachFromSpacerGraph();
                     cleaned_some = true;
                 }
             }
-            sp_iter++;
         }
         
         // remove bubbles
@@ -1206,14 +1224,14 @@ void NodeManager::removeSpacerBubbles(void)
     //-----
     // remove bubbles from the spacer graph
     //
-    std::map<SpacerKey, SpacerInstance *> bubble_map;
+    CRASS_HASH_MAP<SpacerKey, SpacerInstance *> bubble_map;
     
     SpacerInstanceVector detach_list;
-    SpacerListIterator sp_iter;
     
-    for(sp_iter = NM_Spacers.begin(); sp_iter != NM_Spacers.end(); sp_iter++)
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    for(size_t i = 0; i < walk_order.size(); i++)
     {
-        SpacerInstance * current_spacer = (sp_iter->second);
+        SpacerInstance * current_spacer = walk_order[i];
         if( !current_spacer->isAttached())
         {
             continue;
@@ -1250,11 +1268,11 @@ void NodeManager::removeSpacerBubbles(void)
                 SpacerKey tmp_key = makeSpacerKey(curent_reverse_spacer->getID(), curent_forward_spacer->getID());
                 
                 // check if we've seen this key before
-                std::map<SpacerKey, SpacerInstance *>::iterator bm_iter = bubble_map.find(tmp_key);
+                CRASS_HASH_MAP<SpacerKey, SpacerInstance *>::iterator bm_iter = bubble_map.find(tmp_key);
                 if(bm_iter == bubble_map.end())
                 {
                     // first time
-                    bubble_map[tmp_key] = sp_iter->second;
+                    bubble_map[tmp_key] = current_spacer;
                 }
                 else
                 {
@@ -1265,18 +1283,18 @@ void NodeManager::removeSpacerBubbles(void)
                         }
                     }
                     
-                    std::cout<<"Coverage test: "<<bubble_map[tmp_key]->getID()<<" : "<<current_spacer->getID()<<std::endl;
+                    logInfo("Spacer bubble coverage test: "<<bubble_map[tmp_key]->getID()<<" : "<<current_spacer->getID(), 8);
                     // -- check the coverages!
                     if(bubble_map[tmp_key]->getCount() < current_spacer->getCount())
                     {
                         // stored guy has lower coverage!
                         detach_list.push_back(bubble_map[tmp_key]);
-                        bubble_map[tmp_key] = sp_iter->second;
+                        bubble_map[tmp_key] = current_spacer;
                     }
                     else if(current_spacer->getCount() < bubble_map[tmp_key]->getCount())
                     {
                         // new guy has lower coverage!
-                        detach_list.push_back(sp_iter->second);
+                        detach_list.push_back(current_spacer);
                     }
                     else
                     {
@@ -1285,12 +1303,12 @@ void NodeManager::removeSpacerBubbles(void)
                         {
                             // stored guy has lower coverage!
                             detach_list.push_back(bubble_map[tmp_key]);
-                            bubble_map[tmp_key] = sp_iter->second;
+                            bubble_map[tmp_key] = current_spacer;
                         }
                         else
                         {
                             // new guy has lower or equal coverage!
-                            detach_list.push_back(sp_iter->second);
+                            detach_list.push_back(current_spacer);
                         }
                     }
                 }
@@ -1308,138 +1326,310 @@ void NodeManager::removeSpacerBubbles(void)
     
 }
 
+namespace {
+    // the key spacers used to be stored under, two tokens packed into 32
+    // bits so it wraps once the tokens get big
+    inline unsigned int wrappedSpacerKey(SpacerInstance * spacer)
+    {
+        unsigned int back = static_cast<unsigned int>(spacer->getLeader()->getID());
+        unsigned int front = static_cast<unsigned int>(spacer->getLast()->getID());
+        if(front < back)
+        {
+            std::swap(back, front);
+        }
+        return back * 10000000u + front;
+    }
+    
+    bool walksBefore(SpacerInstance * first, SpacerInstance * second)
+    {
+        unsigned int first_key = wrappedSpacerKey(first);
+        unsigned int second_key = wrappedSpacerKey(second);
+        if(first_key != second_key)
+        {
+            return first_key < second_key;
+        }
+        // these used to collide and be counted as one spacer
+        return makeSpacerKey(first->getLeader()->getID(), first->getLast()->getID()) < makeSpacerKey(second->getLeader()->getID(), second->getLast()->getID());
+    }
+}
+
+const SpacerInstanceVector& NodeManager::spacerWalkOrder(void)
+{
+    //-----
+    // The spacers used to live in a map under their wrapped key and every
+    // walk went in the map's order. Which bubble loses and how contigs are
+    // joined and numbered depend on that order so the walks still take it.
+    // Spacers are only ever added so the order is brought up to date here
+    // whenever some have been made since the last time
+    //
+    if(NM_SpacerWalkOrder.size() != NM_SpacerSlab.size())
+    {
+        for(size_t i = NM_SpacerWalkOrder.size(); i < NM_SpacerSlab.size(); i++)
+        {
+            NM_SpacerWalkOrder.push_back(&NM_SpacerSlab[i]);
+        }
+        std::sort(NM_SpacerWalkOrder.begin(), NM_SpacerWalkOrder.end(), walksBefore);
+    }
+    return NM_SpacerWalkOrder;
+}
+
+void NodeManager::flattenSpacerGraph(SpacerGraphCSR& graph)
+{
+    //-----
+    // Lay the spacer graph out flat, every spacer is in there attached or
+    // not as the rank of a spacer counts all of its edges. Spacers are
+    // numbered by their place in the walk order. The edges only point at
+    // spacers so each spacer holds its number in its contig ID while
+    // they're turned into numbers
+    //
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    size_t spacer_count = walk_order.size();
+    graph.offsets.resize(spacer_count + 1);
+    graph.attached.resize(spacer_count);
+    graph.IDs.resize(spacer_count);
+    graph.contigs.resize(spacer_count);
+    int edge_count = 0;
+    for(size_t i = 0; i < spacer_count; i++)
+    {
+        SpacerInstance * SI = walk_order[i];
+        graph.offsets[i] = edge_count;
+        graph.attached[i] = SI->isAttached();
+        graph.IDs[i] = SI->getID();
+        graph.contigs[i] = SI->getContigID();
+        SI->setContigID(static_cast<int>(i));
+        edge_count += SI->getSpacerRank();
+    }
+    graph.offsets[spacer_count] = edge_count;
+    
+    graph.targets.resize(edge_count);
+    graph.directions.resize(edge_count);
+    int edge = 0;
+    for(size_t i = 0; i < spacer_count; i++)
+    {
+        SpacerEdgeVector_Iterator edge_iter;
+        for(edge_iter = walk_order[i]->begin(); edge_iter != walk_order[i]->end(); edge_iter++, edge++)
+        {
+            graph.targets[edge] = (*edge_iter)->edge->getContigID();
+            graph.directions[edge] = static_cast<char>((*edge_iter)->d);
+        }
+    }
+    for(size_t i = 0; i < spacer_count; i++)
+    {
+        walk_order[i]->setContigID(graph.contigs[i]);
+    }
+}
+
+namespace {
+    // where a contig walk has got to, second is the spacer it has just
+    // stepped onto and wanted the direction of the edges it follows
+    struct ContigWalk {
+        int first;
+        int second;
+        char wanted;
+    };
+
+    inline int spacerRank(const SpacerGraphCSR& graph, int spacer)
+    {
+        return graph.offsets[spacer + 1] - graph.offsets[spacer];
+    }
+
+    bool startWalkFromCap(SpacerGraphCSR& graph, ContigWalk& walk, int cap)
+    {
+        //-----
+        // a cap leading into something nobody has walked yet, a cap leading
+        // into a contig just joins it
+        //
+        int edge = graph.offsets[cap];
+        int next = graph.targets[edge];
+        if(!graph.attached[next])
+        {
+            return false;
+        }
+        if(0 != graph.contigs[next])
+        {
+            graph.contigs[cap] = graph.contigs[next];
+            return false;
+        }
+        walk.first = cap;
+        walk.second = next;
+        walk.wanted = graph.directions[edge];
+        return true;
+    }
+
+    bool startWalkFromPath(SpacerGraphCSR& graph, ContigWalk& walk, int path)
+    {
+        //-----
+        // a path spacer off a cross node, walked away from the first of its
+        // edges that's still free. With none free the walk picks up where
+        // the last one stopped, if there was one
+        //
+        if(2 != spacerRank(graph, path))
+        {
+            return false;
+        }
+        for(int edge = graph.offsets[path]; edge < graph.offsets[path + 1]; edge++)
+        {
+            int next = graph.targets[edge];
+            if(!graph.attached[next])
+            {
+                return false;
+            }
+            if(0 == graph.contigs[next])
+            {
+                walk.first = path;
+                walk.second = next;
+                walk.wanted = graph.directions[edge];
+                return true;
+            }
+        }
+        return (-1 != walk.first && -1 != walk.second);
+    }
+
+    bool stepAlongPath(SpacerGraphCSR& graph, ContigWalk& walk, int& previous)
+    {
+        //-----
+        // one step on along a run of path spacers, previous gets the spacer
+        // that was left behind
+        //
+        if(2 != spacerRank(graph, walk.second))
+        {
+            return false;
+        }
+        for(int edge = graph.offsets[walk.second]; edge < graph.offsets[walk.second + 1]; edge++)
+        {
+            int next = graph.targets[edge];
+            if(graph.attached[next] && 
+               graph.directions[edge] == walk.wanted && 
+               graph.IDs[next] != graph.IDs[walk.first] && 
+               0 == graph.contigs[next])
+            {
+                previous = walk.first;
+                walk.first = walk.second;
+                walk.second = next;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void walkPath(SpacerGraphCSR& graph, ContigWalk& walk, std::vector<int>& contigSpacers)
+    {
+        int previous = -1;
+        contigSpacers.clear();
+        while(stepAlongPath(graph, walk, previous))
+        {
+            contigSpacers.push_back(previous);
+        }
+    }
+
+    void labelContig(SpacerGraphCSR& graph, std::vector<int>& contigSpacers, int contigID)
+    {
+        std::vector<int>::iterator iter;
+        for(iter = contigSpacers.begin(); iter != contigSpacers.end(); iter++)
+        {
+            graph.contigs[*iter] = contigID;
+        }
+    }
+}
+
 int NodeManager::splitIntoContigs(void)
 {
     //-----
     // split the group into contigs 
     //
+    // First every cap is walked along its path up to a cross node or the
+    // other end, then every cross node gets a contig of its own and each
+    // path coming off it is walked, in the order the cross nodes turn up.
+    // Every spacer and edge is looked at a fixed number of times, the walk
+    // goes over a flat copy of the graph and the contig IDs are handed back
+    // to the spacers at the end
+    //
+    SpacerGraphCSR graph;
+    flattenSpacerGraph(graph);
+    int spacer_count = static_cast<int>(graph.attached.size());
     
+    std::vector<int> cross_nodes;
+    std::vector<int> contig_spacers;
+    ContigWalk walk = {-1, -1, FORWARD};
     
-    // get all of the cap nodes
-    SpacerInstanceVector start_walk_nodes;
-    getAllSpacerCaps(&start_walk_nodes);
-    
-    SpacerInstanceList cross_nodes;
-    
-    WalkingManager * walk_elem = new WalkingManager();
     // walk from the cap nodes to a cross node
-    SpacerInstanceVector_Iterator cap_node_iter = start_walk_nodes.begin();
-    while (cap_node_iter != start_walk_nodes.end())
+    for(int cap = 0; cap < spacer_count; cap++)
     {
-        SpacerInstanceVector current_contig_spacers;
+        if(!graph.attached[cap] || 1 != spacerRank(graph, cap))
+        {
+            continue;
+        }
         NM_NextContigID++;
-        if (getSpacerEdgeFromCap(walk_elem,*cap_node_iter))
+        if(startWalkFromCap(graph, walk, cap))
         {
-            SpacerInstance * previous_spacer = NULL;
-            
-            //current_contig_spacers.push_back(*cap_node_iter);
-            do { 
-                if (NULL != previous_spacer) 
-                {
-                    
-                    current_contig_spacers.push_back(previous_spacer);
-                } 
-            } while (stepThroughSpacerPath(walk_elem, &previous_spacer));
+            walkPath(graph, walk, contig_spacers);
             
             // if we get to this point then it means that we reached a cross node or the end of a path
-            // the first node in the walking elem would be in the current contig
-            
-            current_contig_spacers.push_back(walk_elem->first());
-            
-            if ((walk_elem->second())->getSpacerRank() == 1) 
+            // the first node in the walk would be in the current contig
+            contig_spacers.push_back(walk.first);
+            if(1 == spacerRank(graph, walk.second))
             {
                 // end of path
-                current_contig_spacers.push_back(walk_elem->second());
-            } 
-            else 
+                contig_spacers.push_back(walk.second);
+            }
+            else
             {
-                // push the cross node onto a list
-                cross_nodes.push_back(walk_elem->second());
+                cross_nodes.push_back(walk.second);
             }
             
             // assign the nodes the same contig id as the cap -- but not the cross node
-            setContigIDForSpacers(&current_contig_spacers);
-        } 
-        cap_node_iter++;
+            labelContig(graph, contig_spacers, NM_NextContigID);
+        }
     }
     NM_NextContigID++;
-    walkFromCross(&cross_nodes);
-
-    delete walk_elem;
     
-    logInfo("Made: " << NM_NextContigID << " spacer contig(s)", 1);
-    return 0;
-}
-
-bool NodeManager::walkFromCross(SpacerInstanceList * crossNodes)
-{
-    WalkingManager * walk_elem = new WalkingManager();
-    SpacerInstanceList_Iterator cross_node_iter = crossNodes->begin();
-    while (cross_node_iter != crossNodes->end()) 
-    {    
-        (*cross_node_iter)->setContigID(NM_NextContigID++);
-        // walk along those edges as long as possible making sure that the first edge is not a 
-        // cross node and that the nodes don't already have a contig id
-        SpacerEdgeVector_Iterator edge_iter = (*cross_node_iter)->begin();
-        while (edge_iter != (*cross_node_iter)->end()) 
-        {
-            // go through all the edges of the cross node that do not have a contig id
-            if (((*edge_iter)->edge->isAttached()) && (0 == (*edge_iter)->edge->getContigID())) 
+    // the cross nodes found along the way are added to the end and walked too
+    walk.first = -1;
+    walk.second = -1;
+    for(size_t i = 0; i < cross_nodes.size(); i++)
+    {
+        int cross = cross_nodes[i];
+        graph.contigs[cross] = NM_NextContigID++;
+        for(int edge = graph.offsets[cross]; edge < graph.offsets[cross + 1]; edge++)
+        {
+            // walk along the edges that don't have a contig yet for as long as possible
+            int next = graph.targets[edge];
+            if(!graph.attached[next] || 0 != graph.contigs[next])
+            {
+                continue;
+            }
+            if(startWalkFromPath(graph, walk, next))
             {
-                if( getSpacerEdgeFromCross(walk_elem, (*edge_iter)->edge))
+                walkPath(graph, walk, contig_spacers);
+                if(1 == spacerRank(graph, walk.second) && graph.attached[walk.second])
                 {
-
-                    SpacerInstanceVector current_contig_nodes;
-                    SpacerInstance * previous_node = NULL;
-                    // edge is a path node so walk
-                    do {
-                        if (NULL != previous_node) 
-                        {
-                            current_contig_nodes.push_back(previous_node);
-                        }
-                    } while (stepThroughSpacerPath(walk_elem, &previous_node));
-                    
-                    if ((walk_elem->second())->getSpacerRank() == 1 && (walk_elem->second())->isAttached()) 
-                    {
-                        // end of path
-                        current_contig_nodes.push_back(walk_elem->second());
-                    } 
-                    else if ((walk_elem->second())->getContigID() == 0 && (walk_elem->second())->isAttached())
-                    {
-                        // add the first node into the list of current contig
-                        current_contig_nodes.push_back(walk_elem->first());
-                        
-                        // push the cross node onto a vector
-                        crossNodes->push_back(walk_elem->second());
-                    }
-                    //current_contig_nodes.push_back(walk_elem->first());
-                    setContigIDForSpacers(&current_contig_nodes);
-                    NM_NextContigID++;
+                    // end of path
+                    contig_spacers.push_back(walk.second);
                 }
-                else 
-                {                    
-                    // means that the edge is a cross node so push it back on to the list
-                    crossNodes->push_back((*edge_iter)->edge);
+                else if(0 == graph.contigs[walk.second] && graph.attached[walk.second])
+                {
+                    contig_spacers.push_back(walk.first);
+                    cross_nodes.push_back(walk.second);
                 }
+                labelContig(graph, contig_spacers, NM_NextContigID);
+                NM_NextContigID++;
+            }
+            else
+            {
+                // the edge is a cross node itself
+                cross_nodes.push_back(next);
             }
-            ++edge_iter;
         }
-        cross_node_iter++;
     }
-    delete walk_elem;
-    return true;
     
-}
-
-
-void NodeManager::setContigIDForSpacers(SpacerInstanceVector * currentContigNodes)
-{
-    SpacerInstanceVector_Iterator iter = currentContigNodes->begin();
-    while (iter != currentContigNodes->end()) 
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    for(int i = 0; i < spacer_count; i++)
     {
-        (*iter)->setContigID(NM_NextContigID);
-        iter++;
+        walk_order[i]->setContigID(graph.contigs[i]);
     }
+    
+    logInfo("Made: " << NM_NextContigID << " spacer contig(s)", 1);
+    return 0;
 }
 
 // Printing / IO
@@ -1454,34 +1644,23 @@ void NodeManager::dumpReads(std::string readsFileName, bool showDetached)
     reads_file.open(readsFileName.c_str());
     if (reads_file.good()) 
     {
-        SpacerListIterator spacer_iter = NM_Spacers.begin();
-        while(spacer_iter != NM_Spacers.end())
+        // the same read makes plenty of nodes so only look each one up once
+        TokenBitmap read_tokens;
+        const SpacerInstanceVector& walk_order = spacerWalkOrder();
+        for(size_t i = 0; i < walk_order.size(); i++)
         {
-            SpacerInstance * SI = spacer_iter->second;
-            
-            // get the crisprnodes for these guys
-            CrisprNode * Cleader = SI->getLeader();
-            CrisprNode * Clast = SI->getLast();
-            
+            SpacerInstance * SI = walk_order[i];
             if(showDetached || ((SI->getLeader())->isAttached() && (SI->getLast())->isAttached()))
             {
-                std::vector<std::string> headers = Cleader->getReadHeaders(&NM_StringCheck);
-                std::vector<std::string>::iterator h_iter = headers.begin();
-                while(h_iter != headers.end())
-                {
-                    reads_set.insert(*h_iter);
-                    h_iter++;
-                }
-                
-                headers = Clast->getReadHeaders(&NM_StringCheck);
-                h_iter = headers.begin();
-                while(h_iter != headers.end())
-                {
-                    reads_set.insert(*h_iter);
-                    h_iter++;
-                }
+                getHeadersForSpacers(SI, read_tokens);
             }
-            spacer_iter++;
+        }
+        std::vector<StringToken> tokens;
+        read_tokens.getTokens(tokens);
+        std::vector<StringToken>::iterator token_iter;
+        for(token_iter = tokens.begin(); token_iter != tokens.end(); token_iter++)
+        {
+            reads_set.insert(NM_StringCheck.getString(*token_iter));
         }
         
         // now we can print all the reads to file
@@ -1501,255 +1680,285 @@ void NodeManager::dumpReads(std::string readsFileName, bool showDetached)
 
 
 // Spacer dictionaries
-void NodeManager::addSpacersToDOM(crispr::xml::writer * xmlDoc, 
-                                  xercesc::DOMElement * parentNode, 
+void NodeManager::getAllSources(TokenBitmap& allSources, bool showDetached)
+{
+    //-----
+    // The reads behind every spacer and flanker that makes it into the XML.
+    // The <sources> of a group come before its spacers so this has to be
+    // worked out before any of them are written
+    //
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    for(size_t i = 0; i < walk_order.size(); i++)
+    {
+        SpacerInstance * SI = walk_order[i];
+        if((showDetached || ((SI->getLeader())->isAttached() && (SI->getLast())->isAttached())) && !(SI->isFlanker()))
+        {
+            getHeadersForSpacers(SI, allSources);
+        }
+    }
+    SpacerInstanceVector_Iterator iter;
+    for (iter = NM_FlankerNodes.begin(); iter != NM_FlankerNodes.end(); iter++) {
+        SpacerInstance * SI = *iter;
+        if(showDetached || ((SI->getLeader())->isAttached() && (SI->getLast())->isAttached()))
+        {
+            getHeadersForSpacers(SI, allSources);
+        }
+    }
+}
+
+void NodeManager::addSpacersToXML(crispr::xml::streamer& xmlOut, 
                                   bool showDetached, 
-                                  std::set<StringToken>& allSources)
+                                  std::ostream * sourcesFile)
 {
-    SpacerListIterator spacer_iter = NM_Spacers.begin();
-    while(spacer_iter != NM_Spacers.end())
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    for(size_t i = 0; i < walk_order.size(); i++)
     {
-        SpacerInstance * SI = spacer_iter->second;
+        SpacerInstance * SI = walk_order[i];
         if((showDetached || ((SI->getLeader())->isAttached() && (SI->getLast())->isAttached())) && !(SI->isFlanker()))
         {
-            std::set<StringToken> nr_tokens;
+            TokenBitmap nr_tokens;
             getHeadersForSpacers(SI, nr_tokens);
             
             // generate the spacer tag
             std::string spacer = NM_StringCheck.getString(SI->getID());
             std::string spid = "SP" + to_string(SI->getID());
             std::string cov = to_string(SI->getCount());
-            xercesc::DOMElement * spacer_node = xmlDoc->addSpacer(spacer, spid, parentNode, cov);
-            appendSourcesForSpacer(spacer_node, 
-                                   nr_tokens, 
-                                   xmlDoc);
-            allSources.insert(nr_tokens.begin(), nr_tokens.end());
-
+            xmlOut.beginSpacer(spacer, spid, cov);
+            if(sourcesFile != NULL)
+            {
+                printSourceList(*sourcesFile, spid, nr_tokens);
+            }
+            else
+            {
+                appendSourcesForSpacer(xmlOut, nr_tokens);
+            }
+            xmlOut.endElement();
         }
-        spacer_iter++;
     }
 }
 
-void NodeManager::addFlankersToDOM(crispr::xml::writer * xmlDoc, 
-                                   xercesc::DOMElement * parentNode, 
+void NodeManager::addFlankersToXML(crispr::xml::streamer& xmlOut, 
                                    bool showDetached, 
-                                   std::set<StringToken>& allSources)
+                                   std::ostream * sourcesFile)
 {
     SpacerInstanceVector_Iterator iter;
     for (iter = NM_FlankerNodes.begin(); iter != NM_FlankerNodes.end(); iter++) {
         SpacerInstance * SI = *iter;
         if(showDetached || ((SI->getLeader())->isAttached() && (SI->getLast())->isAttached()))
         {
-            std::set<StringToken> nr_tokens;
+            TokenBitmap nr_tokens;
             getHeadersForSpacers(SI, nr_tokens);
             
             std::string spacer = NM_StringCheck.getString(SI->getID());
             std::string flid = "FL" + to_string(SI->getID());
-            xercesc::DOMElement * spacer_node = xmlDoc->addFlanker(spacer, flid, parentNode);
+            xmlOut.beginFlanker(spacer, flid);
             // add in all the source tags for this spacer
-            appendSourcesForSpacer(spacer_node, 
-                                   nr_tokens, 
-                                   xmlDoc);
-            allSources.insert(nr_tokens.begin(), nr_tokens.end());
-
+            if(sourcesFile != NULL)
+            {
+                printSourceList(*sourcesFile, flid, nr_tokens);
+            }
+            else
+            {
+                appendSourcesForSpacer(xmlOut, nr_tokens);
+            }
+            xmlOut.endElement();
         }
     }
 }
 
-void NodeManager::printAssemblyToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMElement * parentNode, bool showDetached)
+void NodeManager::printAssemblyToXML(crispr::xml::streamer& xmlOut, bool showDetached)
 {
+    //-----
+    // One <contig> for every contig ID handed out, with its spacers in
+    // walk order. The spacers are sorted into their contigs up front rather
+    // than going over all of them once per contig
+    //
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    std::vector<std::vector<size_t> > contig_members(NM_NextContigID + 1);
+    for(size_t i = 0; i < walk_order.size(); i++)
+    {
+        int contig_id = walk_order[i]->getContigID();
+        if (contig_id > 0 && contig_id <= NM_NextContigID) 
+        {
+            contig_members[contig_id].push_back(i);
+        }
+    }
     
-    int current_contig_num = 0;
-    while (current_contig_num < NM_NextContigID) 
+    for (int current_contig_num = 1; current_contig_num <= NM_NextContigID; current_contig_num++) 
     {
-        current_contig_num++;
         std::string cid = "C" + to_string(current_contig_num);
-        xercesc::DOMElement * contig_elem = xmlDoc->addContig(cid, parentNode);
+        xmlOut.beginContig(cid);
 
-        SpacerListIterator spacer_iter = NM_Spacers.begin();
-        while(spacer_iter != NM_Spacers.end())
+        std::vector<size_t>::iterator member_iter;
+        for (member_iter = contig_members[current_contig_num].begin(); member_iter != contig_members[current_contig_num].end(); member_iter++) 
         {
-            SpacerInstance * SI = spacer_iter->second;
-            if (SI->getContigID() == current_contig_num) 
+            SpacerInstance * SI = walk_order[*member_iter];
+            if( showDetached || SI->isAttached())
             {
-                if( showDetached || SI->isAttached())
+                std::string id = (SI->isFlanker()) ? "FL" + to_string(SI->getID()) : "SP" + to_string(SI->getID());
+                
+                // the links come out grouped by kind, backward spacers first,
+                // so they're sorted before any of them are written
+                std::vector<std::string> fspacers;
+                std::vector<std::string> bspacers;
+                std::vector<std::string> fflankers;
+                std::vector<std::string> bflankers;
+                SpacerEdgeVector_Iterator sp_iter = SI->begin();
+                while (sp_iter != SI->end()) 
                 {
-
-                    std::string spacer = NM_StringCheck.getString(SI->getID());
-                    std::string id = (SI->isFlanker()) ? "FL" + to_string(SI->getID()) : "SP" + to_string(SI->getID());
-                    
-                    xercesc::DOMElement * cspacer = xmlDoc->addSpacerToContig(id, contig_elem);
-
-                    bool ff = false;
-                    bool bf = false;
-                    bool fs = false;
-                    bool bs = false;
-                    
-                    xercesc::DOMElement * fspacers = NULL;
-                    xercesc::DOMElement * bspacers = NULL;
-                    xercesc::DOMElement * fflankers = NULL;
-                    xercesc::DOMElement * bflankers = NULL;
-                    SpacerEdgeVector_Iterator sp_iter = SI->begin();
-                    while (sp_iter != SI->end()) 
+                    if ((*sp_iter)->edge->isAttached()) 
                     {
-                        if ((*sp_iter)->edge->isAttached()) 
+                        std::string edge_id = (SI->isFlanker()) ? "FL" + to_string((*sp_iter)->edge->getID()) : "SP" + to_string((*sp_iter)->edge->getID());
+                        switch ((*sp_iter)->d) 
                         {
-
-                            std::string edge_id = (SI->isFlanker()) ? "FL" + to_string((*sp_iter)->edge->getID()) : "SP" + to_string((*sp_iter)->edge->getID());
-                            std::string drid = "DR1";
-                            std::string drconf = "0";
-                            std::string directjoin = "0";
-                            switch ((*sp_iter)->d) 
+                            case FORWARD:
                             {
-                                case FORWARD:
-                                {
-                                    if ((*sp_iter)->edge->isFlanker()) {
-                                        if (ff) 
-                                        {
-                                            // we've already created <fflankers>
-                                            // add spacer
-                                            xmlDoc->addFlanker("ff", edge_id, drconf, directjoin, fflankers);//("fs", edge_spid, drid, drconf, fspacers);
-                                        } 
-                                        else 
-                                        {
-                                            // create <fflankers>
-                                            fflankers = xmlDoc->createFlankers("fflankers");
-                                            xmlDoc->addFlanker("ff", edge_id, drconf, directjoin, fflankers);//("fs", edge_spid, drid, drconf, fspacers);
-                                            ff = true;
-                                        }
-                                    } else {
-                                        if (fs) 
-                                        {
-                                            // we've already created <fspacers>
-                                            // add spacer
-                                            xmlDoc->addSpacer("fs", edge_id, drid, drconf, fspacers);
-                                        } 
-                                        else 
-                                        {
-                                            // create <fspacers>
-                                            fspacers = xmlDoc->createSpacers("fspacers");
-                                            xmlDoc->addSpacer("fs", edge_id, drid, drconf, fspacers);
-                                            fs = true;
-                                        }
-                                    }
-
-                                    break;
-                                }
-                                case REVERSE:
-                                {
-                                    if ((*sp_iter)->edge->isFlanker()) {
-                                        if (bf) 
-                                        {
-                                            // we've already created <bflankers>
-                                            // add spacer
-                                            xmlDoc->addFlanker("bf", edge_id, drconf, directjoin, bflankers);//("bs", edge_id, drid, drconf, bspacers);
-                                        } 
-                                        else 
-                                        {
-                                            // create <bflankers>
-                                            bflankers = xmlDoc->createFlankers("bflankers");
-                                            xmlDoc->addFlanker("bf", edge_id, drconf, directjoin, bflankers);//("bs", edge_id, drid, drconf, bspacers);
-                                            bf = true;
-                                        }
-                                    } else {
-                                        if (bs) 
-                                        {
-                                            // we've already created <fspacers>
-                                            // add spacer
-                                            xmlDoc->addSpacer("bs", edge_id, drid, drconf, bspacers);
-                                        } 
-                                        else 
-                                        {
-                                            // create <bspacers>
-                                            bspacers = xmlDoc->createSpacers("bspacers");
-                                            xmlDoc->addSpacer("bs", edge_id, drid, drconf, bspacers);
-                                            bs = true;
-                                        }
-                                    }
-
-                                    break;
+                                if ((*sp_iter)->edge->isFlanker()) {
+                                    fflankers.push_back(edge_id);
+                                } else {
+                                    fspacers.push_back(edge_id);
                                 }
-                                default:
-                                {
-                                    break;
+                                break;
+                            }
+                            case REVERSE:
+                            {
+                                if ((*sp_iter)->edge->isFlanker()) {
+                                    bflankers.push_back(edge_id);
+                                } else {
+                                    bspacers.push_back(edge_id);
                                 }
+                                break;
+                            }
+                            default:
+                            {
+                                break;
                             }
                         }
-                        ++sp_iter;
-                    }
-                    if (bspacers != NULL) 
-                    {
-                        cspacer->appendChild(bspacers);
-
-                    }
-                    if (fspacers != NULL) 
-                    {
-                        cspacer->appendChild(fspacers);
-
-                    }
-                    if (bflankers != NULL) 
-                    {
-                        cspacer->appendChild(bflankers);
-                        
-                    }
-                    if (fflankers != NULL) 
-                    {
-                        cspacer->appendChild(fflankers);
-                        
                     }
+                    ++sp_iter;
                 }
+                
+                xmlOut.beginSpacerToContig(id);
+                printContigLinks(xmlOut, "bspacers", "bs", bspacers, false);
+                printContigLinks(xmlOut, "fspacers", "fs", fspacers, false);
+                printContigLinks(xmlOut, "bflankers", "bf", bflankers, true);
+                printContigLinks(xmlOut, "fflankers", "ff", fflankers, true);
+                xmlOut.endElement();
             }
-            spacer_iter++;
         }
+        xmlOut.endElement();
     }
+}
 
+void NodeManager::printContigLinks(crispr::xml::streamer& xmlOut, 
+                                   const char * listTag, 
+                                   const char * linkTag, 
+                                   std::vector<std::string>& ids, 
+                                   bool flankers)
+{
+    //-----
+    // One of the <bspacers>, <fspacers>, <bflankers> or <fflankers> lists
+    // of a <cspacer>, left out altogether when there's nothing in it
+    //
+    if (ids.empty()) 
+    {
+        return;
+    }
+    std::string drid = "DR1";
+    std::string drconf = "0";
+    std::string directjoin = "0";
+    xmlOut.beginElement(listTag);
+    std::vector<std::string>::iterator id_iter;
+    for (id_iter = ids.begin(); id_iter != ids.end(); id_iter++) 
+    {
+        if (flankers) 
+        {
+            xmlOut.addFlanker(linkTag, *id_iter, drconf, directjoin);
+        } 
+        else 
+        {
+            xmlOut.addSpacer(linkTag, *id_iter, drid, drconf);
+        }
+    }
+    xmlOut.endElement();
 }
 
-void NodeManager::getHeadersForSpacers(SpacerInstance * SI, std::set<StringToken>& nrTokens)
+void NodeManager::getHeadersForSpacers(SpacerInstance * SI, TokenBitmap& nrTokens)
 {
     // go through all the string tokens for both the leader and last nodes
     // for all the CrisprNodes in the Spacers
-    CrisprNode * first_node = SI->getLeader();
-    CrisprNode * second_node = SI->getLast();
-    std::vector<StringToken>::iterator header_iter;
-    for (header_iter = first_node->beginHeaders(); header_iter != first_node->endHeaders(); header_iter++) {
-        nrTokens.insert(*header_iter);
-    }
-    for (header_iter = second_node->beginHeaders(); header_iter != second_node->endHeaders(); header_iter++) {
-        nrTokens.insert(*header_iter);
-    }
+    indexReads();
+    StringToken first_node = (SI->getLeader())->getID();
+    StringToken second_node = (SI->getLast())->getID();
+    nrTokens.add(NM_ReadMembership.begin(first_node), NM_ReadMembership.end(first_node));
+    nrTokens.add(NM_ReadMembership.begin(second_node), NM_ReadMembership.end(second_node));
 }
 
-void NodeManager::appendSourcesForSpacer(xercesc::DOMElement * spacerNode, 
-                            std::set<StringToken>& nrTokens,
-                            crispr::xml::writer * xmlDoc)
+void NodeManager::appendSourcesForSpacer(crispr::xml::streamer& xmlOut, 
+                                         TokenBitmap& nrTokens)
 {
     // add in all the source tags for this spacer
-    std::set<StringToken>::iterator nr_iter;
-    for (nr_iter = nrTokens.begin(); nr_iter != nrTokens.end(); nr_iter++) {
-        std::string s = NM_StringCheck.getString(*nr_iter);
+    std::vector<StringToken> tokens;
+    nrTokens.getTokens(tokens);
+    std::vector<StringToken>::iterator nr_iter;
+    for (nr_iter = tokens.begin(); nr_iter != tokens.end(); nr_iter++) {
         std::string sid = "SO";
         sid += to_string(*nr_iter);
-        // add the source to both the current spacer
-        // and to the total sources list
-        //xmlDoc->addSource(s, sid, allSources);
-        xmlDoc->addSpacerSource(sid, spacerNode);
+        xmlOut.addSpacerSource(sid);
     }
 }
 
-void NodeManager::generateAllsourceTags(crispr::xml::writer * xmlDoc, 
-                           std::set<StringToken>& allSourcesForNM,
-                           xercesc::DOMElement * parentNode
-                           )
+void NodeManager::generateAllsourceTags(crispr::xml::streamer& xmlOut, 
+                                        TokenBitmap& allSourcesForNM,
+                                        std::ostream * sourcesFile
+                                        )
 {
-    // add in all the source tags for this spacer
-    std::set<StringToken>::iterator nr_iter;
-    for (nr_iter = allSourcesForNM.begin(); nr_iter != allSourcesForNM.end(); nr_iter++) {
+    // add in all the source tags for this group
+    std::vector<StringToken> tokens;
+    allSourcesForNM.getTokens(tokens);
+    std::vector<StringToken>::iterator nr_iter;
+    for (nr_iter = tokens.begin(); nr_iter != tokens.end(); nr_iter++) {
         std::string s = NM_StringCheck.getString(*nr_iter);
         std::string sid = "SO";
         sid += to_string(*nr_iter);
-        xmlDoc->addSource(s, sid, parentNode);
+        if(sourcesFile != NULL)
+        {
+            *sourcesFile<<sid<<"\t"<<s<<"\n";
+        }
+        else
+        {
+            xmlOut.addSource(s, sid);
+        }
+    }
+}
+
+void NodeManager::printSourceList(std::ostream& sourcesFile, std::string& id, TokenBitmap& nrTokens)
+{
+    //-----
+    // One line for a spacer in the sources file: its id and then the ids of
+    // its sources without the "SO", with runs of ids written as first-last
+    //
+    std::vector<StringToken> tokens;
+    nrTokens.getTokens(tokens);
+    sourcesFile<<id;
+    char sep = '\t';
+    size_t i = 0;
+    while(i < tokens.size())
+    {
+        size_t j = i;
+        while(j + 1 < tokens.size() && tokens[j + 1] == tokens[j] + 1)
+        {
+            j++;
+        }
+        sourcesFile<<sep<<tokens[i];
+        if(j > i)
+        {
+            sourcesFile<<"-"<<tokens[j];
+        }
+        sep = ',';
+        i = j + 1;
     }
+    sourcesFile<<"\n";
 }
 // Making purdy colours
 void NodeManager::setDebugColourLimits(void)
@@ -1759,10 +1968,9 @@ void NodeManager::setDebugColourLimits(void)
     //
     double max_coverage = 0;
     double min_coverage = 10000000;
-    NodeListIterator nl_iter = nodeBegin();
-    while (nl_iter != nodeEnd()) 
+    for(size_t i = 0; i < NM_NodeSlab.size(); i++)
     {
-        int coverage = (nl_iter->second)->getCoverage();
+        int coverage = NM_NodeSlab[i].getCoverage();
         if (coverage > max_coverage) 
         {
             max_coverage = coverage;
@@ -1771,7 +1979,6 @@ void NodeManager::setDebugColourLimits(void)
         {
             min_coverage = coverage;
         }
-        nl_iter++;
     }
     
     NM_DebugRainbow.setType(NM_Opts->graphColourType);
@@ -1794,10 +2001,11 @@ void NodeManager::setSpacerColourLimits(void)
     double max_coverage = 0;
     double min_coverage = 10000000;
     
-    SpacerListIterator sp_iter = NM_Spacers.begin();
-    while (sp_iter != NM_Spacers.end()) 
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    for(size_t i = 0; i < walk_order.size(); i++)
     {
-        int coverage = (sp_iter->second)->getCount();
+        SpacerInstance * current_spacer = walk_order[i];
+        int coverage = current_spacer->getCount();
         if (coverage > max_coverage) 
         {
             max_coverage = coverage;
@@ -1806,7 +2014,6 @@ void NodeManager::setSpacerColourLimits(void)
         {
             min_coverage = coverage;
         }
-        sp_iter++;
     }
     
     NM_SpacerRainbow.setType(NM_Opts->graphColourType);
@@ -1828,33 +2035,31 @@ void NodeManager::printDebugGraph(std::ostream &dataOut, std::string title, bool
     setDebugColourLimits();
     
     gvGraphHeader(dataOut, title);
-    NodeListIterator nl_iter = nodeBegin();
     // first loop to print out the nodes
-    while (nl_iter != nodeEnd()) 
+    for(size_t i = 0; i < NM_NodeSlab.size(); i++)
     {
+        CrisprNode * node = &NM_NodeSlab[i];
         // check whether we should print
-        if((nl_iter->second)->isAttached() | showDetached)
+        if(node->isAttached() | showDetached)
         {
-            printDebugNodeAttributes(dataOut, nl_iter->second ,NM_DebugRainbow.getColour((nl_iter->second)->getCoverage()), longDesc);
+            printDebugNodeAttributes(dataOut, node ,NM_DebugRainbow.getColour(node->getCoverage()), longDesc);
         }
-        nl_iter++;
     }
     
     // and go through again to print the edges
-    nl_iter = nodeBegin();
-    while (nl_iter != nodeEnd()) 
+    for(size_t i = 0; i < NM_NodeSlab.size(); i++)
     {
+        CrisprNode * node = &NM_NodeSlab[i];
         // check whether we should print
-        if((nl_iter->second)->isAttached() | showDetached)
+        if(node->isAttached() | showDetached)
         {
             std::stringstream ss;
             if(longDesc)
-                ss << (nl_iter->second)->getID() << "_" << NM_StringCheck.getString((nl_iter->second)->getID());
+                ss << node->getID() << "_" << NM_StringCheck.getString(node->getID());
             else
-                ss << (nl_iter->second)->getID();
-            (nl_iter->second)->printEdges(dataOut, &NM_StringCheck, ss.str(), showDetached, printBackEdges, longDesc);
+                ss << node->getID();
+            node->printEdges(dataOut, &NM_StringCheck, ss.str(), showDetached, printBackEdges, longDesc);
         }
-        nl_iter++;
     }
     gvGraphFooter(dataOut)
 }
@@ -1889,24 +2094,24 @@ bool NodeManager::printSpacerGraph(std::string& outFileName, std::string title,
     setSpacerColourLimits();
     gvGraphHeader(tmp_out, title);
     bool at_least_one_spacer=false;        
-    SpacerListIterator spi_iter = NM_Spacers.begin();
-    while (spi_iter != NM_Spacers.end()) 
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    for(size_t i = 0; i < walk_order.size(); i++)
     {
-        if ((spi_iter->second)->isAttached() && (showSingles || (0 != (spi_iter->second)->getSpacerRank()))) 
+        SpacerInstance * current_spacer = walk_order[i];
+        if (current_spacer->isAttached() && (showSingles || (0 != current_spacer->getSpacerRank()))) 
         {
             at_least_one_spacer = true;
             // print the graphviz nodes
-            std::string label = getSpacerGraphLabel(spi_iter->second, longDesc);
+            std::string label = getSpacerGraphLabel(current_spacer, longDesc);
             
             // print the node attribute
-            if ((spi_iter->second)->isFlanker()) {
-                gvFlanker(tmp_out, label, NM_SpacerRainbow.getColour((spi_iter->second)->getCount()));
+            if (current_spacer->isFlanker()) {
+                gvFlanker(tmp_out, label, NM_SpacerRainbow.getColour(current_spacer->getCount()));
             } else {
-                gvSpacer(tmp_out,label,NM_SpacerRainbow.getColour((spi_iter->second)->getCount()));
+                gvSpacer(tmp_out,label,NM_SpacerRainbow.getColour(current_spacer->getCount()));
                 
             }
         }
-        spi_iter++;
     }
     if (!at_least_one_spacer) 
     {
@@ -1918,17 +2123,18 @@ bool NodeManager::printSpacerGraph(std::string& outFileName, std::string title,
     if (data_out.good()) 
     {
         data_out<<tmp_out.str();
-        spi_iter = NM_Spacers.begin();
-        while (spi_iter != NM_Spacers.end()) 
+        const SpacerInstanceVector& walk_order = spacerWalkOrder();
+        for(size_t i = 0; i < walk_order.size(); i++)
         {
-            if ((spi_iter->second)->isAttached() && (showSingles || (0 != (spi_iter->second)->getSpacerRank()))) 
+            SpacerInstance * current_spacer = walk_order[i];
+            if (current_spacer->isAttached() && (showSingles || (0 != current_spacer->getSpacerRank()))) 
             {
                 // print the graphviz nodes
-                std::string label = getSpacerGraphLabel(spi_iter->second, longDesc);
+                std::string label = getSpacerGraphLabel(current_spacer, longDesc);
                 // print the node attribute
                 // now print the edges
-                SpacerEdgeVector_Iterator edge_iter = (spi_iter->second)->begin();
-                while (edge_iter != (spi_iter->second)->end()) 
+                SpacerEdgeVector_Iterator edge_iter = current_spacer->begin();
+                while (edge_iter != current_spacer->end()) 
                 {
                     if (((*edge_iter)->edge)->isAttached() && (*edge_iter)->d == FORWARD && (showSingles || (0 != ((*edge_iter)->edge)->getSpacerRank()))) 
                     {
@@ -1940,7 +2146,6 @@ bool NodeManager::printSpacerGraph(std::string& outFileName, std::string title,
                     edge_iter++;
                 }
             }   
-            spi_iter++;
         }        
         gvGraphFooter(data_out);
         data_out.close();
@@ -1983,23 +2188,20 @@ std::string NodeManager::getSpacerGraphLabel(SpacerInstance * spacer, bool longD
 
 void NodeManager::printAllSpacers(void)
 {
-    SpacerListIterator sp_iter = NM_Spacers.begin();
-    
     // first we build up the contents of the walking queue
-    while(sp_iter != NM_Spacers.end())
+    const SpacerInstanceVector& walk_order = spacerWalkOrder();
+    for(size_t i = 0; i < walk_order.size(); i++)
     {
-        (sp_iter->second)->printContents(); 
-        sp_iter++;
+        SpacerInstance * current_spacer = walk_order[i];
+        current_spacer->printContents(); 
     }
 }
 
-void NodeManager::printSpacerKey(std::ostream &dataOut, int numSteps, std::string groupNumber)
+void NodeManager::printSpacerKey(std::ostream &dataOut, int numSteps)
 {
     //-----
-    // Print a graphviz style graph of the DRs and spacers
+    // Print the colours of a graphviz style key to the spacer graph
     //
-    static int cluster_number = 0;
-    gvKeyGroupHeader(dataOut, cluster_number, groupNumber);
     double ul = NM_SpacerRainbow.getUpperLimit();
     double ll = NM_SpacerRainbow.getLowerLimit();
     double step_size = (ul - ll) / (numSteps - 1);
@@ -2011,8 +2213,6 @@ void NodeManager::printSpacerKey(std::ostream &dataOut, int numSteps, std::strin
         ss << this_step;
         gvKeyEntry(dataOut, ss.str(), NM_SpacerRainbow.getColour(this_step));
     }
-    gvKeyFooter(dataOut);
-    cluster_number++;
 }
 
 // Flankers
@@ -2036,11 +2236,10 @@ void NodeManager::generateFlankers(bool showDetached)
             // call a spacer a 'flanker' if it's length is more than 1 standard deviation from the mean length
             // and it is a cap node
             
-            SpacerListIterator spacer_iter = NM_Spacers.begin();
-            //spacer_iter = NM_Spacers.begin();
-            while(spacer_iter != NM_Spacers.end())
+            const SpacerInstanceVector& walk_order = spacerWalkOrder();
+            for(size_t i = 0; i < walk_order.size(); i++)
             {
-                SpacerInstance * SI = spacer_iter->second;
+                SpacerInstance * SI = walk_order[i];
                 
                 if(showDetached || ((SI->getLeader())->isAttached() && (SI->getLast())->isAttached()))
                 {
@@ -2052,7 +2251,6 @@ void NodeManager::generateFlankers(bool showDetached)
                     }
                     /* }*/
                 }
-                spacer_iter++;
             }
         }
         else 
@@ -55,22 +55,27 @@
 #include "SpacerInstance.h"
 #include "libcrispr.h"
 #include "StringCheck.h"
+#include "Types.h"
 #include "ReadHolder.h"
 #include "GraphDrawingDefines.h"
 #include "Rainbow.h"
-#include "writer.h"
+#include "streamer.h"
 #include "StatsManager.h"
+#include "Slab.h"
+#include "ReadMembership.h"
+#include "TokenBitmap.h"
+#include "Checkpoint.h"
 
 #ifdef SEARCH_SINGLETON
 #include "SearchChecker.h"
 #endif
 
 // typedefs
-typedef std::map<StringToken, CrisprNode *> NodeList;
-typedef std::map<StringToken, CrisprNode *>::iterator NodeListIterator;
+typedef Slab<CrisprNode> NodeSlab;
 
-typedef std::map<SpacerKey, SpacerInstance *> SpacerList;
-typedef std::map<SpacerKey, SpacerInstance *>::iterator SpacerListIterator;
+typedef CRASS_HASH_MAP<SpacerKey, SpacerInstance *> SpacerList;
+typedef CRASS_HASH_MAP<SpacerKey, SpacerInstance *>::iterator SpacerListIterator;
+typedef Slab<SpacerInstance> SpacerSlab;
 
 typedef std::vector<CrisprNode *> NodeVector;
 typedef std::vector<CrisprNode *>::iterator NodeVectorIterator;
@@ -84,39 +89,25 @@ typedef std::vector<SpacerKey>::iterator SpacerVectorIterator;
 typedef std::map<int, SpacerVector *>ContigList;
 typedef std::map<int, SpacerVector *>::iterator ContigListIterator;
 
-//macros
-#define makeKey(i,j) (i*100000)+j
+// key for an ordered pair of node tokens
+inline uint64_t makeKey(StringToken i, StringToken j)
+{
+    return (static_cast<uint64_t>(i) << 32) | static_cast<unsigned int>(j);
+}
 
-class WalkingManager {
-    SpacerInstancePair WM_WalkingElem;
-    SI_EdgeDirection WM_Wanted_Edge_Type;
-    
-	public:
-	
-		WalkingManager(SpacerInstance * firstNode, SpacerInstance * secondNode, SI_EdgeDirection incommingEdge)
-		{
-			WM_WalkingElem.first = firstNode;
-			WM_WalkingElem.second = secondNode;
-			WM_Wanted_Edge_Type = incommingEdge;
-		}
-		WalkingManager(void){}
-		~WalkingManager(void){}
-	
-	
-		SpacerInstance * getFirstNode(void) { return WM_WalkingElem.first; }
-		SpacerInstance * getSecondNode(void) { return WM_WalkingElem.second; }
-        SpacerInstance * first(void) { return WM_WalkingElem.first; }
-        SpacerInstance * second(void) { return WM_WalkingElem.second; }
-    
-		SpacerInstancePair getWalkingElem(void) { return WM_WalkingElem; }
-		SI_EdgeDirection getEdgeType(void) { return WM_Wanted_Edge_Type; }
-		void setFirstNode(SpacerInstance * fn) { WM_WalkingElem.first = fn; }
-		void setSecondNode(SpacerInstance * sn) { WM_WalkingElem.second = sn; }
-		void setWalkingElem(SpacerInstancePair np) { WM_WalkingElem = np; }
-		void setWantedEdge(SI_EdgeDirection e) { WM_Wanted_Edge_Type = e; }
-    
-    SpacerInstance * shift(SpacerInstance * newNode);
-};
+// The attached spacer graph laid out flat for walking contigs. Spacers are
+// numbered by their place in the walk order and the edges of spacer i are
+// [offsets[i], offsets[i + 1]) in targets and directions, in the same order
+// as in the spacer. Contig IDs are worked out in here and handed back to
+// the spacers once the walk is done
+typedef struct {
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<char> directions;
+    std::vector<char> attached;
+    std::vector<StringToken> IDs;
+    std::vector<int> contigs;
+} SpacerGraphCSR;
 
 class NodeManager {
     public:
@@ -125,13 +116,13 @@ class NodeManager {
         ~NodeManager(void);
 
 		bool addReadHolder(ReadHolder * RH);
+        static int mostSpacersFromRead(ReadHolder * RH);                        // the most spacers addReadHolder can make from this read
+        void indexReads(void);                                                  // freeze which reads made which nodes, call once the reads are in
 
-        NodeListIterator nodeBegin(void) { return NM_Nodes.begin(); } 
-        NodeListIterator nodeEnd(void) { return NM_Nodes.end(); }
-        
     // get / set
     
         inline StringCheck * getStringCheck(void) { return &NM_StringCheck; }
+        inline const NodeList& getNodes(void) { return NM_Nodes; }             // indexed by token, edges name their neighbours by token
 		void findCapNodes(NodeVector * capNodes);                               // go through all the node and get a list of pointers to the nodes that have only one edge
 		void findAllNodes(NodeVector * allNodes);
 		void findAllNodes(NodeVector * capNodes, NodeVector * otherNodes);
@@ -141,16 +132,20 @@ class NodeManager {
     EDGE_TYPE getOppositeEdgeType(EDGE_TYPE currentEdgeType);
         
     int getSpacerCountAndStats( bool showDetached=false, bool excludeFlankers=true);
+
+    // every spacer made so far whether it's attached or not
+    inline int getSpacerInstanceCount(void) { return static_cast<int>(NM_SpacerSlab.size()); }
+    
+    // the spacers marked as attached by buildSpacerGraph, nothing after it changes that
+    inline int getAttachedSpacerCount(void) { return NM_AttachedSpacerCount; }
         
     inline bool haveAnyFlankers(void){return (0 != NM_FlankerNodes.size());}
     
     inline void clearStats(void) {NM_SpacerLenStat.clear();}
 
     // Walking
-        bool getSpacerEdgeFromCap(WalkingManager * walkElem, SpacerInstance * nextSpacer);
-        bool getSpacerEdgeFromCross(WalkingManager * walkElem, SpacerInstance * nextSpacer);
-        bool stepThroughSpacerPath(WalkingManager * walkElem, SpacerInstance ** previousNode);
-        bool walkFromCross(SpacerInstanceList * crossNodes);
+        const SpacerInstanceVector& spacerWalkOrder(void);              // every spacer, in the order all the walks over them go
+        void flattenSpacerGraph(SpacerGraphCSR& graph);
 
     // Cleaning
         int cleanGraph(void);
@@ -165,7 +160,6 @@ class NodeManager {
 		void findAllForwardAttachedNodes(NodeVector * nodes);
 		int buildSpacerGraph(void);
         void clearContigs(void);
-        void contigiseForwardSpacers(std::queue<SpacerInstance *> * walkingQueue, SpacerInstance * SI);
         bool getForwardSpacer(SpacerInstance ** retSpacer, SpacerInstance * SI);
         bool getPrevSpacer(SpacerInstance ** retSpacer, SpacerInstance * SI);
 
@@ -198,11 +192,11 @@ class NodeManager {
         std::string getSpacerGraphLabel(SpacerInstance * spacer, 
                                         bool longDesc);
 
-    // make a key for the spacer graph 	
+    // make a key for the spacer graph, the caller wraps it in the group's
+    // header and footer so the groups can be numbered in the order they go out
 
         void printSpacerKey(std::ostream &dataOut, 
-                            int numSteps, 
-                            std::string groupNumber); 
+                            int numSteps); 
     
 
         void dumpReads(std::string readsFileName, 
@@ -215,37 +209,59 @@ class NodeManager {
                       bool showDetached
                       );
 	
-    void addSpacersToDOM(crispr::xml::writer * xmlDoc, 
-                         xercesc::DOMElement * parentNode, 
+    void getAllSources(TokenBitmap& allSources, 
+                       bool showDetached
+                       );
+    
+    void addSpacersToXML(crispr::xml::streamer& xmlOut, 
                          bool showDetached, 
-                         std::set<StringToken>&  allSourcesForNM
+                         std::ostream * sourcesFile = NULL
                          );
     
-    void addFlankersToDOM(crispr::xml::writer * xmlDoc, 
-                          xercesc::DOMElement * parentNode, 
+    void addFlankersToXML(crispr::xml::streamer& xmlOut, 
                           bool showDetached,
-                          std::set<StringToken>& allSourcesForNM
+                          std::ostream * sourcesFile = NULL
                           );
     
-    void printAssemblyToDOM(crispr::xml::writer * xmlDoc, 
-                            xercesc::DOMElement * parentNode, 
+    void printAssemblyToXML(crispr::xml::streamer& xmlOut, 
                             bool showDetached
                             );
     
+    void printContigLinks(crispr::xml::streamer& xmlOut, 
+                          const char * listTag, 
+                          const char * linkTag, 
+                          std::vector<std::string>& ids, 
+                          bool flankers
+                          );
+    
     void getHeadersForSpacers(SpacerInstance * SI, 
-                              std::set<StringToken>& nrTokens
+                              TokenBitmap& nrTokens
                               );
     
-    void appendSourcesForSpacer(xercesc::DOMElement * spacerNode, 
-                                std::set<StringToken>& nrTokens,
-                                crispr::xml::writer * xmlDoc
+    void appendSourcesForSpacer(crispr::xml::streamer& xmlOut, 
+                                TokenBitmap& nrTokens
                                 );
     
-    void generateAllsourceTags(crispr::xml::writer * xmlDoc, 
-                               std::set<StringToken>& allSourcesForNM,
-                               xercesc::DOMElement * parentNode
+    void generateAllsourceTags(crispr::xml::streamer& xmlOut, 
+                               TokenBitmap& allSourcesForNM,
+                               std::ostream * sourcesFile = NULL
                                );
 
+    void printSourceList(std::ostream& sourcesFile, 
+                         std::string& id, 
+                         TokenBitmap& nrTokens
+                         );
+
+    // Snapshots
+    // the whole graph as it is after building or cleaning, the spacer graph
+    // and anything after it can't be saved. Reading one back in needs an
+    // empty manager, which then owns the reads that came with it
+        void writeCheckpoint(CheckpointWriter& out);
+    
+        void readCheckpoint(CheckpointReader& in);
+    
+        inline size_t getReadCount(void) { return NM_ReadList.size(); }
+    
     // Spacer dictionaries
         void printAllSpacers(void);
     
@@ -263,26 +279,27 @@ class NodeManager {
 
 		void addCrisprNodes(CrisprNode ** prevNode, 
                             std::string& workingString, 
-                            StringToken headerSt,
-                            ReadHolder * RH);
+                            StringToken headerSt);
     
         void addSecondCrisprNode(CrisprNode ** prevNode, 
                                  std::string& workingString, 
-                                 StringToken headerSt,
-                                 ReadHolder * RH);
+                                 StringToken headerSt);
     
         void addFirstCrisprNode(CrisprNode ** prevNode, 
                                 std::string& workingString, 
-                                StringToken headerSt,
-                                ReadHolder * RH);
-    
-        void setContigIDForSpacers(SpacerInstanceVector * currentContigNodes);
+                                StringToken headerSt);
     
         void setUpperAndLowerCoverage(void);
+    
+        CrisprNode * newNode(StringToken st);
      
     // members
         std::string NM_DirectRepeatSequence;  				// the sequence of this managers direct repeat
-        NodeList NM_Nodes;                    				// list of CrisprNodes this manager manages
+        NodeSlab NM_NodeSlab;                 				// the CrisprNodes this manager manages, in token order
+        NodeList NM_Nodes;                    				// CrisprNodes indexed by their token
+        ReadMembership NM_ReadMembership;     				// the reads of each CrisprNode
+        SpacerSlab NM_SpacerSlab;             				// storage for the spacers, in the order they were made
+        SpacerInstanceVector NM_SpacerWalkOrder;            // the spacers sorted for walking, see spacerWalkOrder
         SpacerList NM_Spacers;                				// list of all the spacers
         ReadList NM_ReadList;                 				// list of readholders
         StringCheck NM_StringCheck;           				// string check object for unique strings 
@@ -290,9 +307,11 @@ class NodeManager {
         Rainbow NM_SpacerRainbow;      				        // the Rainbow class for making colours
         const options * NM_Opts;              				// pointer to the user options structure
         int NM_NextContigID;								// next free contig ID (doubles as a counter)
+        int NM_AttachedSpacerCount;                         // how many spacers buildSpacerGraph marked as attached
         ContigList NM_Contigs; 								// our contigs
         StatsManager<std::vector<size_t> > NM_SpacerLenStat;   // Keep a check on all of the spacer lengths for deciding whecher thay are a flanker or not
         SpacerInstanceVector NM_FlankerNodes;               // a list of spacers that are also flankers -- used only in the print functions
+        bool NM_OwnsReads;                                  // the reads came from a snapshot so they're ours to delete
 };
 
 
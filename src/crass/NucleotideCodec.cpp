@@ -0,0 +1,284 @@
+/*
+ *  NucleotideCodec.cpp is part of the CRisprASSembler project
+ *  
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved. 
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A       	
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "NucleotideCodec.h"
+
+const unsigned char NT4_TABLE[256] = {
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4
+};
+
+const char NT4_TO_CHAR[5] = {'A', 'C', 'G', 'T', 'N'};
+
+const char COMP_TABLE[256] = {
+    0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,  15,
+    16,  17,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,
+    32,  33,  34,  35,  36,  37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,
+    48,  49,  50,  51,  52,  53,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,
+    64, 'T', 'V', 'G', 'H', 'E', 'F', 'C', 'D', 'I', 'J', 'M', 'L', 'K', 'N', 'O',
+    'P', 'Q', 'Y', 'S', 'A', 'A', 'B', 'W', 'X', 'R', 'Z',  91,  92,  93,  94,  95,
+    64, 't', 'v', 'g', 'h', 'e', 'f', 'c', 'd', 'i', 'j', 'm', 'l', 'k', 'n', 'o',
+    'p', 'q', 'y', 's', 'a', 'a', 'b', 'w', 'x', 'r', 'z', 123, 124, 125, 126, 127,
+    (char)128, (char)129, (char)130, (char)131, (char)132, (char)133, (char)134, (char)135,
+    (char)136, (char)137, (char)138, (char)139, (char)140, (char)141, (char)142, (char)143,
+    (char)144, (char)145, (char)146, (char)147, (char)148, (char)149, (char)150, (char)151,
+    (char)152, (char)153, (char)154, (char)155, (char)156, (char)157, (char)158, (char)159,
+    (char)160, (char)161, (char)162, (char)163, (char)164, (char)165, (char)166, (char)167,
+    (char)168, (char)169, (char)170, (char)171, (char)172, (char)173, (char)174, (char)175,
+    (char)176, (char)177, (char)178, (char)179, (char)180, (char)181, (char)182, (char)183,
+    (char)184, (char)185, (char)186, (char)187, (char)188, (char)189, (char)190, (char)191,
+    (char)192, (char)193, (char)194, (char)195, (char)196, (char)197, (char)198, (char)199,
+    (char)200, (char)201, (char)202, (char)203, (char)204, (char)205, (char)206, (char)207,
+    (char)208, (char)209, (char)210, (char)211, (char)212, (char)213, (char)214, (char)215,
+    (char)216, (char)217, (char)218, (char)219, (char)220, (char)221, (char)222, (char)223,
+    (char)224, (char)225, (char)226, (char)227, (char)228, (char)229, (char)230, (char)231,
+    (char)232, (char)233, (char)234, (char)235, (char)236, (char)237, (char)238, (char)239,
+    (char)240, (char)241, (char)242, (char)243, (char)244, (char)245, (char)246, (char)247,
+    (char)248, (char)249, (char)250, (char)251, (char)252, (char)253, (char)254, (char)255
+};
+
+#ifdef __SSE2__
+//**************************************
+// 16 bytes at a time. Anything that isn't A,C,G,T in either case
+// drops back to the lookup tables for that block
+//**************************************
+
+static inline __m128i reverseBytes(__m128i x)
+{
+    x = _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 1, 2, 3));
+    x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+    x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+static inline __m128i complementBlock(__m128i x, bool& allACGT)
+{
+    //-----
+    // A <-> T is an xor with 0x15 and C <-> G is an xor with 0x04
+    // in both upper and lower case
+    //
+    __m128i upper = _mm_and_si128(x, _mm_set1_epi8((char)0xDF));
+    __m128i is_at = _mm_or_si128(_mm_cmpeq_epi8(upper, _mm_set1_epi8('A')), _mm_cmpeq_epi8(upper, _mm_set1_epi8('T')));
+    __m128i is_cg = _mm_or_si128(_mm_cmpeq_epi8(upper, _mm_set1_epi8('C')), _mm_cmpeq_epi8(upper, _mm_set1_epi8('G')));
+    allACGT = (0xFFFF == _mm_movemask_epi8(_mm_or_si128(is_at, is_cg)));
+    __m128i flip = _mm_or_si128(_mm_and_si128(is_at, _mm_set1_epi8(0x15)), _mm_and_si128(is_cg, _mm_set1_epi8(0x04)));
+    return _mm_xor_si128(x, flip);
+}
+#endif
+
+void nt4Encode(const char * seq, size_t len, unsigned char * codes)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    for(; i + 16 <= len; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(seq + i));
+        __m128i upper = _mm_and_si128(x, _mm_set1_epi8((char)0xDF));
+        __m128i is_a = _mm_cmpeq_epi8(upper, _mm_set1_epi8('A'));
+        __m128i is_c = _mm_cmpeq_epi8(upper, _mm_set1_epi8('C'));
+        __m128i is_g = _mm_cmpeq_epi8(upper, _mm_set1_epi8('G'));
+        __m128i is_t = _mm_cmpeq_epi8(upper, _mm_set1_epi8('T'));
+        __m128i known = _mm_or_si128(_mm_or_si128(is_a, is_c), _mm_or_si128(is_g, is_t));
+        __m128i res = _mm_andnot_si128(known, _mm_set1_epi8(4));
+        res = _mm_or_si128(res, _mm_and_si128(is_c, _mm_set1_epi8(1)));
+        res = _mm_or_si128(res, _mm_and_si128(is_g, _mm_set1_epi8(2)));
+        res = _mm_or_si128(res, _mm_and_si128(is_t, _mm_set1_epi8(3)));
+        _mm_storeu_si128((__m128i *)(codes + i), res);
+    }
+#endif
+    for(; i < len; i++)
+    {
+        codes[i] = nt4Code(seq[i]);
+    }
+}
+
+void nt4Decode(const unsigned char * codes, size_t len, char * seq)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    for(; i + 16 <= len; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(codes + i));
+        __m128i is_a = _mm_cmpeq_epi8(x, _mm_setzero_si128());
+        __m128i is_c = _mm_cmpeq_epi8(x, _mm_set1_epi8(1));
+        __m128i is_g = _mm_cmpeq_epi8(x, _mm_set1_epi8(2));
+        __m128i is_t = _mm_cmpeq_epi8(x, _mm_set1_epi8(3));
+        __m128i known = _mm_or_si128(_mm_or_si128(is_a, is_c), _mm_or_si128(is_g, is_t));
+        __m128i res = _mm_andnot_si128(known, _mm_set1_epi8('N'));
+        res = _mm_or_si128(res, _mm_and_si128(is_a, _mm_set1_epi8('A')));
+        res = _mm_or_si128(res, _mm_and_si128(is_c, _mm_set1_epi8('C')));
+        res = _mm_or_si128(res, _mm_and_si128(is_g, _mm_set1_epi8('G')));
+        res = _mm_or_si128(res, _mm_and_si128(is_t, _mm_set1_epi8('T')));
+        _mm_storeu_si128((__m128i *)(seq + i), res);
+    }
+#endif
+    for(; i < len; i++)
+    {
+        seq[i] = (codes[i] < 4) ? NT4_TO_CHAR[codes[i]] : 'N';
+    }
+}
+
+void nt4ReverseComplement(unsigned char * codes, size_t len)
+{
+    if(0 == len)
+        return;
+    size_t i = 0;
+    size_t j = len - 1;
+    while(i < j)
+    {
+        unsigned char a = codes[i];
+        unsigned char b = codes[j];
+        codes[i] = (b < 4) ? 3 - b : 4;
+        codes[j] = (a < 4) ? 3 - a : 4;
+        i++;
+        j--;
+    }
+    if(i == j)
+    {
+        codes[i] = (codes[i] < 4) ? 3 - codes[i] : 4;
+    }
+}
+
+void reverseComplementInPlace(char * seq, size_t len)
+{
+    //-----
+    // swap blocks from either end working towards the middle
+    //
+    size_t i = 0;
+#ifdef __SSE2__
+    for(; 2 * i + 32 <= len; i += 16)
+    {
+        char * front = seq + i;
+        char * back = seq + len - i - 16;
+        bool front_ok, back_ok;
+        __m128i f = complementBlock(_mm_loadu_si128((const __m128i *)front), front_ok);
+        __m128i b = complementBlock(_mm_loadu_si128((const __m128i *)back), back_ok);
+        if(front_ok && back_ok)
+        {
+            _mm_storeu_si128((__m128i *)front, reverseBytes(b));
+            _mm_storeu_si128((__m128i *)back, reverseBytes(f));
+        }
+        else
+        {
+            for(int k = 0; k < 16; k++)
+            {
+                char a = front[k];
+                front[k] = complementOf(back[15 - k]);
+                back[15 - k] = complementOf(a);
+            }
+        }
+    }
+#endif
+    if(i >= len)
+        return;
+    size_t j = len - 1 - i;
+    while(i < j)
+    {
+        char a = seq[i];
+        seq[i] = complementOf(seq[j]);
+        seq[j] = complementOf(a);
+        i++;
+        j--;
+    }
+    if(i == j)
+    {
+        seq[i] = complementOf(seq[i]);
+    }
+}
+
+void reverseComplementInto(const char * seq, size_t len, char * out)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    for(; i + 16 <= len; i += 16)
+    {
+        const char * src = seq + len - i - 16;
+        bool all_acgt;
+        __m128i c = complementBlock(_mm_loadu_si128((const __m128i *)src), all_acgt);
+        if(all_acgt)
+        {
+            _mm_storeu_si128((__m128i *)(out + i), reverseBytes(c));
+        }
+        else
+        {
+            for(int k = 0; k < 16; k++)
+            {
+                out[i + k] = complementOf(src[15 - k]);
+            }
+        }
+    }
+#endif
+    for(; i < len; i++)
+    {
+        out[i] = complementOf(seq[len - 1 - i]);
+    }
+}
+
+int canonicalCompare(const char * seq, size_t len)
+{
+    //-----
+    // walk in from both ends, the first position that differs decides it.
+    // Compare as unsigned chars to match std::string::compare
+    //
+    for(size_t i = 0; i < len; i++)
+    {
+        unsigned char forward = (unsigned char)seq[i];
+        unsigned char reverse = (unsigned char)complementOf(seq[len - 1 - i]);
+        if(forward != reverse)
+        {
+            return (forward < reverse) ? -1 : 1;
+        }
+    }
+    return 0;
+}
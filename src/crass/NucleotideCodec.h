@@ -0,0 +1,93 @@
+/*
+ *  NucleotideCodec.h is part of the CRisprASSembler project
+ *  
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved. 
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A       	
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+#ifndef crass_NucleotideCodec_h
+#define crass_NucleotideCodec_h
+
+#include <string>
+#include <cstddef>
+
+//**************************************
+// One place for all of the nucleotide lookup tables. The nt4 codes are the
+// ones used by ksw: A,C,G,T (either case) -> 0,1,2,3 and everything else -> 4
+//**************************************
+
+extern const unsigned char NT4_TABLE[256];      // ASCII -> nt4 code
+extern const char NT4_TO_CHAR[5];               // nt4 code -> upper case ASCII, 4 -> 'N'
+extern const char COMP_TABLE[256];              // ASCII -> complement, IUPAC aware and case preserving
+
+#define nt4Code(c) (NT4_TABLE[(unsigned char)(c)])
+#define complementOf(c) (COMP_TABLE[(unsigned char)(c)])
+
+//**************************************
+// encoding
+//**************************************
+
+// ASCII -> nt4 codes, codes must hold len bytes
+void nt4Encode(const char * seq, size_t len, unsigned char * codes);
+
+inline void nt4Encode(const std::string& seq, unsigned char * codes) { nt4Encode(seq.data(), seq.length(), codes); }
+
+// nt4 codes -> upper case ASCII, seq must hold len bytes
+void nt4Decode(const unsigned char * codes, size_t len, char * seq);
+
+// reverse complement a run of nt4 codes in place, 4 stays as 4
+void nt4ReverseComplement(unsigned char * codes, size_t len);
+
+//**************************************
+// reverse complement
+//**************************************
+
+// reverse complement seq without making a copy
+void reverseComplementInPlace(char * seq, size_t len);
+
+inline void reverseComplementInPlace(std::string& seq) { if(!seq.empty()) reverseComplementInPlace(&seq[0], seq.length()); }
+
+// write the reverse complement of seq into out, which must hold len bytes
+// and must not overlap seq
+void reverseComplementInto(const char * seq, size_t len, char * out);
+
+//**************************************
+// orientation
+//**************************************
+
+// compare a sequence with its own reverse complement without building it.
+// < 0 : the sequence is the lowest lexicographical form
+// > 0 : the reverse complement is
+//   0 : the sequence is its own reverse complement
+int canonicalCompare(const char * seq, size_t len);
+
+inline int canonicalCompare(const std::string& seq) { return canonicalCompare(seq.data(), seq.length()); }
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ *  Pileup.cpp is part of the CRisprASSembler project
+ *  
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved. 
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A       	
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+#include <cstring>
+#include "Pileup.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const char PILEUP_BASES[4] = {'A', 'C', 'G', 'T'};
+
+//**************************************
+// one column at a time, for whatever is left over after the vector loops
+//**************************************
+
+template <typename Count_t>
+static inline void addColumns(Count_t * counts, int stride, int start, const unsigned char * codes, int from, int len)
+{
+    for(int i = from; i < len; i++)
+    {
+        counts[(codes[i] & 3) * stride + start + i]++;
+    }
+}
+
+template <typename Count_t>
+static inline int callColumns(const Count_t * counts, int stride, int minDepth, char * consensus, float * conservation, int from)
+{
+    int num_deep = 0;
+    for(int j = from; j < stride; j++)
+    {
+        Count_t max_count = 0;
+        float total_count = 0.0;
+        consensus[j] = 'N';
+        for(int b = 0; b < 4; b++)
+        {
+            Count_t count = counts[b * stride + j];
+            total_count += static_cast<float>(count);
+            if(count > max_count)
+            {
+                max_count = count;
+                consensus[j] = PILEUP_BASES[b];
+            }
+        }
+        if(total_count > minDepth)
+        {
+            conservation[j] = static_cast<float>(max_count)/total_count;
+            num_deep++;
+        }
+        else
+        {
+            conservation[j] = 0;
+        }
+    }
+    return num_deep;
+}
+
+#ifdef __SSE2__
+//**************************************
+// 16 columns at a time. Each base gets a one-hot byte mask which is widened
+// and added straight onto the counts
+//**************************************
+
+static inline __m128i selectBits(__m128i mask, __m128i yes, __m128i no)
+{
+    return _mm_or_si128(_mm_and_si128(mask, yes), _mm_andnot_si128(mask, no));
+}
+
+static inline int countBits(int mask)
+{
+    int n = 0;
+    for(; mask; mask &= mask - 1) n++;
+    return n;
+}
+
+// conservation and the deep column count for four columns of 32 bit totals
+static inline int conservationBlock(__m128i max_count, __m128i total, int minDepth, float * conservation)
+{
+    __m128i deep = _mm_cmpgt_epi32(total, _mm_set1_epi32(minDepth));
+    // empty columns divide by zero but get masked away
+    __m128 share = _mm_div_ps(_mm_cvtepi32_ps(max_count), _mm_cvtepi32_ps(total));
+    _mm_storeu_ps(conservation, _mm_and_ps(share, _mm_castsi128_ps(deep)));
+    return countBits(_mm_movemask_ps(_mm_castsi128_ps(deep)));
+}
+#endif
+
+void pileupAdd(uint16_t * counts, int stride, int start, const unsigned char * codes, int len)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i three = _mm_set1_epi8(3);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 16 <= len; i += 16)
+    {
+        __m128i x = _mm_and_si128(_mm_loadu_si128((const __m128i *)(codes + i)), three);
+        for(int b = 0; b < 4; b++)
+        {
+            __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8((char)b)), one);
+            __m128i * dest = (__m128i *)(counts + b * stride + start + i);
+            _mm_storeu_si128(dest, _mm_add_epi16(_mm_loadu_si128(dest), _mm_unpacklo_epi8(hit, zero)));
+            _mm_storeu_si128(dest + 1, _mm_add_epi16(_mm_loadu_si128(dest + 1), _mm_unpackhi_epi8(hit, zero)));
+        }
+    }
+#endif
+    addColumns(counts, stride, start, codes, i, len);
+}
+
+void pileupAdd(uint32_t * counts, int stride, int start, const unsigned char * codes, int len)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i three = _mm_set1_epi8(3);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 16 <= len; i += 16)
+    {
+        __m128i x = _mm_and_si128(_mm_loadu_si128((const __m128i *)(codes + i)), three);
+        for(int b = 0; b < 4; b++)
+        {
+            __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8((char)b)), one);
+            __m128i halves[2] = {_mm_unpacklo_epi8(hit, zero), _mm_unpackhi_epi8(hit, zero)};
+            __m128i * dest = (__m128i *)(counts + b * stride + start + i);
+            for(int h = 0; h < 2; h++)
+            {
+                __m128i lo = _mm_unpacklo_epi16(halves[h], zero);
+                __m128i hi = _mm_unpackhi_epi16(halves[h], zero);
+                _mm_storeu_si128(dest + 2 * h, _mm_add_epi32(_mm_loadu_si128(dest + 2 * h), lo));
+                _mm_storeu_si128(dest + 2 * h + 1, _mm_add_epi32(_mm_loadu_si128(dest + 2 * h + 1), hi));
+            }
+        }
+    }
+#endif
+    addColumns(counts, stride, start, codes, i, len);
+}
+
+int pileupConsensus(const uint16_t * counts, int stride, int minDepth, char * consensus, float * conservation)
+{
+    int j = 0;
+    int num_deep = 0;
+#ifdef __SSE2__
+    // there is no unsigned 16 bit max in SSE2, flip the sign bit and use the signed one
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    const __m128i zero = _mm_setzero_si128();
+    for(; j + 8 <= stride; j += 8)
+    {
+        __m128i base_counts[4];
+        __m128i max_count = bias;           // zero once the bias comes off
+        for(int b = 0; b < 4; b++)
+        {
+            base_counts[b] = _mm_loadu_si128((const __m128i *)(counts + b * stride + j));
+            max_count = _mm_max_epi16(max_count, _mm_xor_si128(base_counts[b], bias));
+        }
+        max_count = _mm_xor_si128(max_count, bias);
+        
+        // the first base to reach the max wins, so go backwards
+        __m128i call = _mm_set1_epi16('N');
+        for(int b = 3; b >= 0; b--)
+        {
+            call = selectBits(_mm_cmpeq_epi16(base_counts[b], max_count), _mm_set1_epi16(PILEUP_BASES[b]), call);
+        }
+        call = selectBits(_mm_cmpeq_epi16(max_count, zero), _mm_set1_epi16('N'), call);
+        _mm_storel_epi64((__m128i *)(consensus + j), _mm_packus_epi16(call, zero));
+        
+        __m128i total_lo = zero;
+        __m128i total_hi = zero;
+        for(int b = 0; b < 4; b++)
+        {
+            total_lo = _mm_add_epi32(total_lo, _mm_unpacklo_epi16(base_counts[b], zero));
+            total_hi = _mm_add_epi32(total_hi, _mm_unpackhi_epi16(base_counts[b], zero));
+        }
+        num_deep += conservationBlock(_mm_unpacklo_epi16(max_count, zero), total_lo, minDepth, conservation + j);
+        num_deep += conservationBlock(_mm_unpackhi_epi16(max_count, zero), total_hi, minDepth, conservation + j + 4);
+    }
+#endif
+    return num_deep + callColumns(counts, stride, minDepth, consensus, conservation, j);
+}
+
+int pileupConsensus(const uint32_t * counts, int stride, int minDepth, char * consensus, float * conservation)
+{
+    int j = 0;
+    int num_deep = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for(; j + 4 <= stride; j += 4)
+    {
+        // counts never get near 2^31 so the signed compares are fine
+        __m128i base_counts[4];
+        __m128i max_count = zero;
+        __m128i total = zero;
+        for(int b = 0; b < 4; b++)
+        {
+            base_counts[b] = _mm_loadu_si128((const __m128i *)(counts + b * stride + j));
+            max_count = selectBits(_mm_cmpgt_epi32(base_counts[b], max_count), base_counts[b], max_count);
+            total = _mm_add_epi32(total, base_counts[b]);
+        }
+        
+        __m128i call = _mm_set1_epi32('N');
+        for(int b = 3; b >= 0; b--)
+        {
+            call = selectBits(_mm_cmpeq_epi32(base_counts[b], max_count), _mm_set1_epi32(PILEUP_BASES[b]), call);
+        }
+        call = selectBits(_mm_cmpeq_epi32(max_count, zero), _mm_set1_epi32('N'), call);
+        call = _mm_packus_epi16(_mm_packs_epi32(call, zero), zero);
+        int packed = _mm_cvtsi128_si32(call);
+        memcpy(consensus + j, &packed, 4);
+        
+        num_deep += conservationBlock(max_count, total, minDepth, conservation + j);
+    }
+#endif
+    return num_deep + callColumns(counts, stride, minDepth, consensus, conservation, j);
+}
@@ -0,0 +1,59 @@
+/*
+ *  Pileup.h is part of the CRisprASSembler project
+ *  
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved. 
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A       	
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+#ifndef crass_Pileup_h
+#define crass_Pileup_h
+
+#include <cstddef>
+#include <stdint.h>
+
+//**************************************
+// Per base read counts for the consensus arrays. The counts for A, C, G and
+// T are four separate runs of `stride` columns, A first. Reads come in as
+// nt4 codes (see NucleotideCodec.h); anything that isn't C, G or T counts
+// as an A, the same as coverageIndex in Aligner.h
+//**************************************
+
+// add one read, starting at column start
+void pileupAdd(uint16_t * counts, int stride, int start, const unsigned char * codes, int len);
+void pileupAdd(uint32_t * counts, int stride, int start, const unsigned char * codes, int len);
+
+// call the most common base in every column, the first of A,C,G,T on ties
+// and N when a column is empty. Conservation is the share of the most common
+// base, or 0 when the column is no deeper than minDepth.
+// Returns the number of columns deeper than minDepth
+int pileupConsensus(const uint16_t * counts, int stride, int minDepth, char * consensus, float * conservation);
+int pileupConsensus(const uint32_t * counts, int stride, int minDepth, char * consensus, float * conservation);
+
+#endif //crass_Pileup_h
@@ -43,6 +43,7 @@
 // local includes
 #include "ReadHolder.h"
 #include "SeqUtils.h"
+#include "NucleotideCodec.h"
 #include "SmithWaterman.h"
 #include "LoggerSimp.h"
 #include "Exception.h"
@@ -379,17 +380,11 @@ void ReadHolder::reverseStartStops(void)
     RH_StartStops.insert(RH_StartStops.begin(), tmp_ss.begin(), tmp_ss.end());
 }
 
-void ReadHolder::updateStartStops(const int frontOffset, std::string * DR, const options * opts)
+void ReadHolder::shiftStartStops(const int frontOffset, const int DR_length)
 {
     //-----
-    // Update the start and stops to capture the largest part
-    // of the DR
+    // Move the start and stops so they capture the TRUE DR
     //
-    // Take this opportunity to look for partials at either end of the read
-    //
-    
-    int DR_length = static_cast<int>(DR->length());
-    
     StartStopListIterator ss_iter = RH_StartStops.begin();
     while(ss_iter != RH_StartStops.end())
     {
@@ -432,81 +427,79 @@ void ReadHolder::updateStartStops(const int frontOffset, std::string * DR, const
         ss_iter++;
         
     }
+}
 
-    // now we check to see if we can find one more DRs on the front or back of this mofo
-    // front first
-    ss_iter = RH_StartStops.begin();
-    if((*ss_iter) > opts->lowSpacerSize)
+bool ReadHolder::frontPartialWindow(const options * opts, int& searchStart, int& searchLength)
+{
+    //-----
+    // A partial at the front has to leave room for a spacer before the first DR
+    //
+    if(RH_StartStops.front() > opts->lowSpacerSize)
     {
-        // we should look for a DR here
-        int part_s, part_e;
-        part_s = part_e = 0;
-
-		stringPair sp = smithWaterman(RH_Seq, *DR, &part_s, &part_e, 0, (static_cast<int>((*ss_iter)) - opts->lowSpacerSize), CRASS_DEF_PARTIAL_SIM_CUT_OFF);
-		if(0 != part_e)
-		{
-			if (part_e - part_s >= CRASS_DEF_MIN_PARTIAL_LENGTH) 
-			{
-				if(((DR->rfind(sp.second) + (sp.second).length()) == DR->length()) && (0 == part_s))
-				{
-					logInfo("adding direct repeat to start",10);
-					logInfo(sp.first << " : " << sp.second << " : " << part_s << " : " << part_e,10);
-					if(part_e < 0) { 
-						std::stringstream ss;
-						ss<<"Adding negative to SS list! " << part_e;
-						logError(ss.str());
-                        //throw crispr::exception(__FILE__,
-						//                        __LINE__,
-						//                        __PRETTY_FUNCTION__,
-						//                        (ss.str()).c_str());
-					}
-					if(part_e > (int)RH_Seq.length()) { 
-						std::stringstream ss;
-						ss <<"SS longer than read: " << part_e;
-						logError(ss.str());
-                        //throw crispr::exception(__FILE__,
-						//                        __LINE__,
-						//                        __PRETTY_FUNCTION__,
-						//                        (ss.str()).c_str());	
-					}
-					std::reverse(RH_StartStops.begin(), RH_StartStops.end());
-					RH_StartStops.push_back(part_e);
-					RH_StartStops.push_back(0);
-					std::reverse(RH_StartStops.begin(), RH_StartStops.end());
-				}
-			}
-		}
+        searchStart = 0;
+        searchLength = static_cast<int>(RH_StartStops.front()) - opts->lowSpacerSize;
+        return true;
     }
-    // then the back
+    return false;
+}
+
+bool ReadHolder::backPartialWindow(const options * opts, int& searchStart, int& searchLength)
+{
+    //-----
+    // and one at the back needs room for a spacer after the last DR
+    //
     unsigned int end_dist = static_cast<unsigned int>(RH_Seq.length()) - RH_StartStops.back();
     if(end_dist > (unsigned int)(opts->lowSpacerSize))
     {
-        // we should look for a DR here
-        int part_s, part_e;
-        part_s = part_e = 0;
+        searchStart = RH_StartStops.back() + opts->lowSpacerSize;
+        searchLength = end_dist - opts->lowSpacerSize;
+        return true;
+    }
+    return false;
+}
 
-		stringPair sp = smithWaterman(RH_Seq, 
-		                              *DR, 
-		                              &part_s, 
-		                              &part_e, 
-		                              (RH_StartStops.back() + opts->lowSpacerSize), 
-		                              (end_dist - opts->lowSpacerSize), 
-		                              CRASS_DEF_PARTIAL_SIM_CUT_OFF);
-		if(0 != part_e)
-		{
-			if (part_e - part_s >= CRASS_DEF_MIN_PARTIAL_LENGTH) 
-			{
-				if((((int)(RH_Seq.length()) - 1 ) == part_e) && (0 == DR->find(sp.second)))
-				{
-					logInfo("adding partial direct repeat to end",10);
-					logInfo(sp.first << " : " << sp.second << " : " << part_s << " : " << part_e,10);
-					logInfo((int)sp.first.length() - (int)sp.second.length(),10);
-					// in most cases the right index is returned however 
-					// if the length of the smith waterman alignment differ the index needs to be corrected 
-					startStopsAdd(part_s + abs((int)sp.first.length() - (int)sp.second.length()), part_e);
-				}
-			}
-		}
+void ReadHolder::addFrontPartial(const SW_Alignment& partial, const std::string& DR)
+{
+    int part_s = partial.targetStart;
+    int part_e = partial.targetEnd;
+    if (part_e - part_s >= CRASS_DEF_MIN_PARTIAL_LENGTH) 
+    {
+        logInfo("adding direct repeat to start",10);
+        logInfo(RH_Seq.substr(part_s, part_e - part_s + 1) << " : " << DR.substr(partial.queryStart) << " : " << part_s << " : " << part_e,10);
+        if(part_e < 0) { 
+            std::stringstream ss;
+            ss<<"Adding negative to SS list! " << part_e;
+            logError(ss.str());
+            //throw crispr::exception(__FILE__,
+            //                        __LINE__,
+            //                        __PRETTY_FUNCTION__,
+            //                        (ss.str()).c_str());
+        }
+        if(part_e > (int)RH_Seq.length()) { 
+            std::stringstream ss;
+            ss <<"SS longer than read: " << part_e;
+            logError(ss.str());
+            //throw crispr::exception(__FILE__,
+            //                        __LINE__,
+            //                        __PRETTY_FUNCTION__,
+            //                        (ss.str()).c_str());	
+        }
+        std::reverse(RH_StartStops.begin(), RH_StartStops.end());
+        RH_StartStops.push_back(part_e);
+        RH_StartStops.push_back(0);
+        std::reverse(RH_StartStops.begin(), RH_StartStops.end());
+    }
+}
+
+void ReadHolder::addBackPartial(const SW_Alignment& partial, const std::string& DR)
+{
+    int part_s = partial.targetStart;
+    int part_e = partial.targetEnd;
+    if (part_e - part_s >= CRASS_DEF_MIN_PARTIAL_LENGTH) 
+    {
+        logInfo("adding partial direct repeat to end",10);
+        logInfo(RH_Seq.substr(part_s) << " : " << DR.substr(0, partial.queryEnd + 1) << " : " << part_s << " : " << part_e,10);
+        startStopsAdd(part_s, part_e);
     }
 }
 
@@ -517,14 +510,12 @@ std::string ReadHolder::DRLowLexi(void)
     //
     
     std::string tmp_dr;
-    std::string rev_comp;
     
     int num_repeats = numRepeats();
     // make sure that tere is 4 elements in the array, if not you can only cut one
     if (num_repeats == 1)
     {
         tmp_dr = repeatStringAt(0);
-        rev_comp = reverseComplement(tmp_dr);
     }
     else if (2 == num_repeats)
     {
@@ -534,14 +525,12 @@ std::string ReadHolder::DRLowLexi(void)
         if (RH_StartStops.front() == 0)
         {
             tmp_dr = repeatStringAt(2);
-            rev_comp = reverseComplement(tmp_dr);
         }
         
         // take the first
         else if (RH_StartStops.back() == static_cast<unsigned int>(RH_Seq.length()))
         {
             tmp_dr = repeatStringAt(0);
-            rev_comp = reverseComplement(tmp_dr);
         }
         // if they both are then just take whichever is longer
         else
@@ -552,12 +541,10 @@ std::string ReadHolder::DRLowLexi(void)
             if (lenA > lenB)
             {
                 tmp_dr = repeatStringAt(0);
-                rev_comp = reverseComplement(tmp_dr);
             }
             else
             {
                 tmp_dr = repeatStringAt(2);
-                rev_comp = reverseComplement(tmp_dr);
             }
         }
     }
@@ -566,11 +553,11 @@ std::string ReadHolder::DRLowLexi(void)
     {
         // take the second
         tmp_dr = repeatStringAt(2);
-        rev_comp = reverseComplement(tmp_dr);
 
     }
     
-    if (tmp_dr < rev_comp)
+    // work out the orientation without building the reverse complement
+    if (canonicalCompare(tmp_dr) < 0)
     {
         // the direct repeat is in it lowest lexicographical form
         RH_WasLowLexi = true;
@@ -586,7 +573,8 @@ std::string ReadHolder::DRLowLexi(void)
 #ifdef DEBUG
         logInfo("DR not in low lexi"<<endl<<RH_Seq, 9);
 #endif
-        return rev_comp;
+        reverseComplementInPlace(tmp_dr);
+        return tmp_dr;
     }
 }
 
@@ -596,7 +584,7 @@ void ReadHolder::reverseComplementSeq(void)
     // Reverse complement the read and fix the start stops
     // 
 
-    RH_Seq = reverseComplement(RH_Seq);
+    reverseComplementInPlace(RH_Seq);
 	if(RH_Seq.empty()) {
 		throw crispr::runtime_exception(__FILE__,
 		                                __LINE__,
@@ -1273,3 +1261,49 @@ std::ostream& operator<< (std::ostream& s,  ReadHolder& c)
     return c.print(s);
     
 }
+
+void ReadHolder::writeCheckpoint(CheckpointWriter& out)
+{
+    //-----
+    // Everything about the read, readCheckpoint takes it back in the same order
+    //
+    out.writeString(RH_Rle);
+    out.writeString(RH_Header);
+    out.writeString(RH_Comment);
+    out.writeString(RH_Qual);
+    out.writeBool(RH_IsFasta);
+    out.writeString(RH_Seq);
+    out.writeBool(RH_WasLowLexi);
+    out.writeUInt(static_cast<uint32_t>(RH_StartStops.size()));
+    StartStopListIterator ss_iter;
+    for (ss_iter = RH_StartStops.begin(); ss_iter != RH_StartStops.end(); ss_iter++) 
+    {
+        out.writeUInt(*ss_iter);
+    }
+    out.writeBool(RH_isSqueezed);
+    out.writeInt(RH_LastDREnd);
+    out.writeInt(RH_NextSpacerStart);
+    out.writeInt(RH_RepeatLength);
+}
+
+void ReadHolder::readCheckpoint(CheckpointReader& in)
+{
+    RH_Rle = in.readString();
+    RH_Header = in.readString();
+    RH_Comment = in.readString();
+    RH_Qual = in.readString();
+    RH_IsFasta = in.readBool();
+    RH_Seq = in.readString();
+    RH_WasLowLexi = in.readBool();
+    uint32_t start_stops = in.readUInt();
+    RH_StartStops.clear();
+    RH_StartStops.reserve(start_stops);
+    for (uint32_t i = 0; i < start_stops; i++) 
+    {
+        RH_StartStops.push_back(in.readUInt());
+    }
+    RH_isSqueezed = in.readBool();
+    RH_LastDREnd = in.readInt();
+    RH_NextSpacerStart = in.readInt();
+    RH_RepeatLength = in.readInt();
+}
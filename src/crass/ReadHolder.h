@@ -46,6 +46,8 @@
 #include <map>
 // local includes
 #include "crassDefines.h"
+#include "SmithWaterman.h"
+#include "Checkpoint.h"
 
 // typedefs
 typedef std::vector<unsigned int> StartStopList;
@@ -65,6 +67,7 @@ class ReadHolder
             RH_LastDREnd = 0; 
             RH_NextSpacerStart = 0; 
             RH_isSqueezed = false;
+            RH_WasLowLexi = false;
             RH_IsFasta = true;
         }  
         
@@ -75,6 +78,7 @@ class ReadHolder
             RH_LastDREnd = 0; 
             RH_NextSpacerStart = 0; 
             RH_isSqueezed = false;
+            RH_WasLowLexi = false;
             RH_IsFasta = true;
 
         }
@@ -86,6 +90,7 @@ class ReadHolder
             RH_LastDREnd = 0; 
             RH_NextSpacerStart = 0; 
             RH_isSqueezed = false;
+            RH_WasLowLexi = false;
             RH_IsFasta = true;
 
         }
@@ -98,6 +103,7 @@ class ReadHolder
             RH_LastDREnd = 0; 
             RH_NextSpacerStart = 0; 
             RH_isSqueezed = false;
+            RH_WasLowLexi = false;
             RH_IsFasta = false;
         }
         
@@ -110,6 +116,7 @@ class ReadHolder
             RH_LastDREnd = 0; 
             RH_NextSpacerStart = 0; 
             RH_isSqueezed = false;
+            RH_WasLowLexi = false;
             RH_IsFasta = false;
 
         }
@@ -149,7 +156,7 @@ class ReadHolder
         {
             return this->RH_IsFasta;
         }
-        inline std::string getSeq(void)
+        inline const std::string& getSeq(void) const
         {
             return this->RH_Seq;
         }
@@ -344,8 +351,20 @@ class ReadHolder
 	
 		void reverseStartStops(void);           // fix start stops what got corrupted during revcomping
 	
-		// update the DR after finding the TRUE DR
-		void updateStartStops(const int frontOffset, std::string * DR, const options * opts);
+		// update the DR after finding the TRUE DR. This is done in pieces
+		// so that WorkHorse::findPartialRepeats can look for the partials
+		// of a whole group's reads together. First move the start stops
+		// onto the TRUE DR
+		void shiftStartStops(const int frontOffset, const int DRLength);
+		
+		// then see whether there is room for a partial DR at either end,
+		// false if there isn't
+		bool frontPartialWindow(const options * opts, int& searchStart, int& searchLength);
+		bool backPartialWindow(const options * opts, int& searchStart, int& searchLength);
+		
+		// and add any partials that were found in those windows
+		void addFrontPartial(const SW_Alignment& partial, const std::string& DR);
+		void addBackPartial(const SW_Alignment& partial, const std::string& DR);
 		
 		// the positions are the start positions of the direct repeats
 		// 
@@ -434,6 +453,13 @@ class ReadHolder
         void logContents(int logLevel);
     
         inline std::ostream& print(std::ostream& s);
+        
+        //----
+        // Checkpointing
+        //
+        void writeCheckpoint(CheckpointWriter& out);
+        
+        void readCheckpoint(CheckpointReader& in);
     
     private:
         // members
@@ -0,0 +1,139 @@
+/*
+ *  ReadMembership.cpp is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+
+
+// system includes
+#include <algorithm>
+
+// local includes
+#include "ReadMembership.h"
+
+void ReadMembership::freeze(void)
+{
+    //-----
+    // Counting sort the new pairs in with the old table, then sort the new
+    // reads of each node and merge them with the ones it already had
+    //
+    if(RM_Pending.empty())
+    {
+        return;
+    }
+    size_t old_nodes = RM_Offsets.empty() ? 0 : RM_Offsets.size() - 1;
+    size_t nodes = old_nodes;
+    std::vector<std::pair<StringToken, StringToken> >::iterator pending_iter;
+    for(pending_iter = RM_Pending.begin(); pending_iter != RM_Pending.end(); pending_iter++)
+    {
+        nodes = std::max(nodes, static_cast<size_t>(pending_iter->first) + 1);
+    }
+    
+    // how many each node had before and how many it has now
+    std::vector<size_t> offsets(nodes + 1, 0);
+    for(size_t i = 0; i < old_nodes; i++)
+    {
+        offsets[i + 1] = RM_Offsets[i + 1] - RM_Offsets[i];
+    }
+    for(pending_iter = RM_Pending.begin(); pending_iter != RM_Pending.end(); pending_iter++)
+    {
+        offsets[pending_iter->first + 1]++;
+    }
+    for(size_t i = 0; i < nodes; i++)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+    
+    // old reads go first in each run, then the new ones
+    std::vector<StringToken> reads(offsets[nodes]);
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < old_nodes; i++)
+    {
+        fill[i] = std::copy(RM_Reads.begin() + RM_Offsets[i], RM_Reads.begin() + RM_Offsets[i + 1], reads.begin() + fill[i]) - reads.begin();
+    }
+    std::vector<size_t> old_ends(fill);
+    for(pending_iter = RM_Pending.begin(); pending_iter != RM_Pending.end(); pending_iter++)
+    {
+        reads[fill[pending_iter->first]++] = pending_iter->second;
+    }
+    for(size_t i = 0; i < nodes; i++)
+    {
+        if(old_ends[i] == offsets[i + 1])
+        {
+            continue;
+        }
+        std::sort(reads.begin() + old_ends[i], reads.begin() + offsets[i + 1]);
+        std::inplace_merge(reads.begin() + offsets[i], reads.begin() + old_ends[i], reads.begin() + offsets[i + 1]);
+    }
+    
+    RM_Offsets.swap(offsets);
+    RM_Reads.swap(reads);
+    std::vector<std::pair<StringToken, StringToken> >().swap(RM_Pending);
+}
+
+void ReadMembership::clear(void)
+{
+    std::vector<size_t>().swap(RM_Offsets);
+    std::vector<StringToken>().swap(RM_Reads);
+    std::vector<std::pair<StringToken, StringToken> >().swap(RM_Pending);
+}
+
+void ReadMembership::writeCheckpoint(CheckpointWriter& out) const
+{
+    out.writeSize(RM_Offsets.size());
+    std::vector<size_t>::const_iterator offset_iter;
+    for(offset_iter = RM_Offsets.begin(); offset_iter != RM_Offsets.end(); offset_iter++)
+    {
+        out.writeSize(*offset_iter);
+    }
+    out.writeSize(RM_Reads.size());
+    std::vector<StringToken>::const_iterator read_iter;
+    for(read_iter = RM_Reads.begin(); read_iter != RM_Reads.end(); read_iter++)
+    {
+        out.writeInt(*read_iter);
+    }
+}
+
+void ReadMembership::readCheckpoint(CheckpointReader& in)
+{
+    clear();
+    RM_Offsets.resize(in.readSize());
+    for(size_t i = 0; i < RM_Offsets.size(); i++)
+    {
+        RM_Offsets[i] = in.readSize();
+    }
+    RM_Reads.resize(in.readSize());
+    for(size_t i = 0; i < RM_Reads.size(); i++)
+    {
+        RM_Reads[i] = in.readInt();
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ *  ReadMembership.h is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+
+
+#ifndef crass_ReadMembership_h
+#define crass_ReadMembership_h
+
+// system includes
+#include <vector>
+#include <utility>
+
+// local includes
+#include "StringCheck.h"
+#include "Checkpoint.h"
+
+// Which reads made which nodes. Pairs are added while the graph is built
+// and then frozen into one flat table, sorted by node and then read, so
+// the reads of a node are one sorted run. A read shows up once for every
+// time it made the node. Adding more after freezing is fine, they are
+// folded in by the next freeze
+class ReadMembership {
+public:
+    ReadMembership(void) {}
+
+    inline void add(StringToken node, StringToken read) {
+        RM_Pending.push_back(std::pair<StringToken, StringToken>(node, read));
+    }
+
+    // fold everything added since the last freeze into the table
+    void freeze(void);
+
+    inline bool frozen(void) const { return RM_Pending.empty(); }
+
+    // the reads of a node, only good until the next freeze
+    inline const StringToken * begin(StringToken node) const {
+        return (node + 1 < static_cast<StringToken>(RM_Offsets.size())) ? &(RM_Reads[0]) + RM_Offsets[node] : NULL;
+    }
+    inline const StringToken * end(StringToken node) const {
+        return (node + 1 < static_cast<StringToken>(RM_Offsets.size())) ? &(RM_Reads[0]) + RM_Offsets[node + 1] : NULL;
+    }
+    inline size_t size(StringToken node) const {
+        return (node + 1 < static_cast<StringToken>(RM_Offsets.size())) ? RM_Offsets[node + 1] - RM_Offsets[node] : 0;
+    }
+
+    void clear(void);
+
+    // the frozen table as it is, pairs that are still pending are not saved
+    void writeCheckpoint(CheckpointWriter& out) const;
+    void readCheckpoint(CheckpointReader& in);
+
+private:
+    std::vector<size_t> RM_Offsets;                                 // where each node's reads start, indexed by node token
+    std::vector<StringToken> RM_Reads;                              // the reads of every node, one sorted run per node
+    std::vector<std::pair<StringToken, StringToken> > RM_Pending;   // (node, read) added since the last freeze
+};
+
+#endif
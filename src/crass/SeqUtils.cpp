@@ -46,54 +46,24 @@
 #include <sys/stat.h>
 
 #include "SeqUtils.h"
+#include "NucleotideCodec.h"
 
 
-char comp_tab[] = {
-    0,   1,	2,	 3,	  4,   5,	6,	 7,	  8,   9,  10,	11,	 12,  13,  14,	15,
-    16,  17,  18,	19,	 20,  21,  22,	23,	 24,  25,  26,	27,	 28,  29,  30,	31,
-    32,  33,  34,	35,	 36,  37,  38,	39,	 40,  41,  42,	43,	 44,  45,  46,	47,
-    48,  49,  50,	51,	 52,  53,  54,	55,	 56,  57,  58,	59,	 60,  61,  62,	63,
-    64, 'T', 'V', 'G', 'H', 'E', 'F', 'C', 'D', 'I', 'J', 'M', 'L', 'K', 'N', 'O',
-	'P', 'Q', 'Y', 'S', 'A', 'A', 'B', 'W', 'X', 'R', 'Z',	91,	 92,  93,  94,	95,
-    64, 't', 'v', 'g', 'h', 'e', 'f', 'c', 'd', 'i', 'j', 'm', 'l', 'k', 'n', 'o',
-	'p', 'q', 'y', 's', 'a', 'a', 'b', 'w', 'x', 'r', 'z', 123, 124, 125, 126, 127
-};
-
 std::string reverseComplement(std::string str)
 {
-
-	int l = static_cast<int>(str.length());
-    char * revcomp_str = new char[l+1];
-    for (int i = 0; i <=l; i++) {
-		revcomp_str[i]='\0';
-    }
-    int i, c0, c1;
-    for (i = 0; i < l>>1; ++i) 
-    {
-        c0 = comp_tab[(int)str[i]];
-        c1 = comp_tab[(int)str[l - 1 - i]];
-        revcomp_str[i] = c1;
-        revcomp_str[l - 1 - i] = c0;
-    }
-    if (l&1) 
-    {
-        revcomp_str[l>>1] = comp_tab[(int)str[l>>1]];
-    }
-
-    std::string ret = revcomp_str;
-    delete [] revcomp_str;
-
-    return ret;
+    // str is already our own copy so flip it where it is
+    reverseComplementInPlace(str);
+    return str;
 }
 
 std::string laurenize (std::string seq1)
 {
-    std::string seq2 = reverseComplement(seq1);
-    if (seq1 < seq2)
+    if (canonicalCompare(seq1) < 0)
     {
         return seq1;
     }
-    return seq2;
+    reverseComplementInPlace(seq1);
+    return seq1;
 }
 
 
@@ -0,0 +1,98 @@
+/*
+ *  Slab.h is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+
+#ifndef crass_Slab_h
+#define crass_Slab_h
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Hands out room for objects in big blocks instead of one new at a time.
+// Objects never move once they have a slot, so pointers to them stay good
+// until the slab is cleared. Slots are numbered in the order they were
+// handed out which makes walking every object a plain loop. Use it like:
+//
+//     T * thing = new (slab.allocate()) T(...);
+//
+// and never delete what comes out, the slab destroys everything it holds
+// when it is cleared or goes away
+template <typename T, int BlockSize = 64>
+class Slab {
+public:
+    Slab(): SL_used(BlockSize) {}
+
+    ~Slab() {
+        clear();
+    }
+
+    // a slot for one more object, construct into it straight away
+    void * allocate(void) {
+        if (SL_used == BlockSize) {
+            SL_blocks.push_back(static_cast<T *>(::operator new(sizeof(T) * BlockSize)));
+            SL_used = 0;
+        }
+        return SL_blocks.back() + SL_used++;
+    }
+
+    inline size_t size(void) const {
+        return SL_blocks.empty() ? 0 : (SL_blocks.size() - 1) * BlockSize + SL_used;
+    }
+
+    inline T& operator[](size_t i) { return SL_blocks[i / BlockSize][i % BlockSize]; }
+    inline const T& operator[](size_t i) const { return SL_blocks[i / BlockSize][i % BlockSize]; }
+
+    void clear(void) {
+        size_t count = size();
+        for (size_t i = 0; i < count; ++i) {
+            (*this)[i].~T();
+        }
+        for (size_t i = 0; i < SL_blocks.size(); ++i) {
+            ::operator delete(SL_blocks[i]);
+        }
+        SL_blocks.clear();
+        SL_used = BlockSize;
+    }
+
+private:
+    // the objects are pointed at from all over, they can't be copied about
+    Slab(const Slab&);
+    Slab& operator=(const Slab&);
+
+    std::vector<T *> SL_blocks;
+    int SL_used;
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ *  SmallVector.h is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+#ifndef crass_SmallVector_h
+#define crass_SmallVector_h
+
+#include <cstddef>
+
+// A vector that keeps its first N elements inside itself and only goes to
+// the heap when it grows past them. Meant for lots of short lists of plain
+// structs, like the edges of graph nodes. Elements are copied with =, so
+// only use it for types where that is all there is to copying
+template <typename T, int N>
+class SmallVector {
+public:
+    typedef T * iterator;
+    typedef const T * const_iterator;
+
+    SmallVector(): SV_data(SV_inline), SV_size(0), SV_capacity(N) {}
+
+    SmallVector(const SmallVector& other): SV_data(SV_inline), SV_size(0), SV_capacity(N) {
+        *this = other;
+    }
+
+    ~SmallVector() {
+        if (SV_data != SV_inline) {
+            delete [] SV_data;
+        }
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            SV_size = 0;
+            reserve(other.SV_size);
+            for (int i = 0; i < other.SV_size; ++i) {
+                SV_data[i] = other.SV_data[i];
+            }
+            SV_size = other.SV_size;
+        }
+        return *this;
+    }
+
+    inline iterator begin(void) { return SV_data; }
+    inline iterator end(void) { return SV_data + SV_size; }
+    inline const_iterator begin(void) const { return SV_data; }
+    inline const_iterator end(void) const { return SV_data + SV_size; }
+
+    inline size_t size(void) const { return static_cast<size_t>(SV_size); }
+    inline bool empty(void) const { return SV_size == 0; }
+
+    // true once the elements have spilled out onto the heap
+    inline bool onHeap(void) const { return SV_data != SV_inline; }
+
+    inline T& operator[](size_t i) { return SV_data[i]; }
+    inline const T& operator[](size_t i) const { return SV_data[i]; }
+
+    inline void push_back(const T& value) {
+        if (SV_size == SV_capacity) {
+            // value could be one of ours, hang on to it before moving
+            T copy = value;
+            reserve(2 * SV_capacity);
+            SV_data[SV_size++] = copy;
+        } else {
+            SV_data[SV_size++] = value;
+        }
+    }
+
+    inline void clear(void) { SV_size = 0; }
+
+    void reserve(int capacity) {
+        if (capacity <= SV_capacity) {
+            return;
+        }
+        T * grown = new T[capacity];
+        for (int i = 0; i < SV_size; ++i) {
+            grown[i] = SV_data[i];
+        }
+        if (SV_data != SV_inline) {
+            delete [] SV_data;
+        }
+        SV_data = grown;
+        SV_capacity = capacity;
+    }
+
+private:
+    T SV_inline[N];
+    T * SV_data;
+    int SV_size;
+    int SV_capacity;
+};
+
+#endif
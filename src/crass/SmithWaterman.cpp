@@ -37,272 +37,447 @@
 // --------------------------------------------------------------------
 
 //////////////////////////////////////////////
-// Simple Ends-Free Smith-Waterman Algorithm
+// Local alignment of a DR against part of a read
 //
-// You will be prompted for input sequences
-// Penalties and match scores are hard-coded
-//
-// Program does not perform multiple tracebacks if 
-// it finds several alignments with the same score
-//
-// By Nikhil Gopal
-// Similar implementation here: https://wiki.uni-koeln.de/biologicalphysics/index.php/Implementation_of_the_Smith-Waterman_local_alignment_algorithm
+// See SmithWaterman.h
 //////////////////////////////////////////////
 
 // system includes
-#include <iostream>
-#include <fstream>
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <string>
-#include <cmath>
-#include <sys/time.h>
-#include <map>
-#include <exception>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 // local includes
 #include "SmithWaterman.h"
-#include "SeqUtils.h"
-#include "LoggerSimp.h"
-#include "PatternMatcher.h"
-#include "Exception.h"
-double findMax(double a, double b, double c, double d, int * index)
+#include "NucleotideCodec.h"
+
+SmithWaterman::SmithWaterman(const std::string& query) :
+    SW_Query(query),
+    SW_Profile(NULL),
+    SW_ReverseProfile(NULL)
 {
     //-----
-    // find the biggest out of these guys!
-    // if all are equal it will return a
+    // N only ever scores as a mismatch, even against another N
     //
-    if(b > a)
-    {
-        if(c > d)
-        {
-            if(c > b) 
-            { 
-                *index = 2; 
-                return c; 
-            }
-            else 
-            { 
-                *index = 1; 
-                return b; 
-            }
-        }
-        else
-        {
-            if(d > b)
-            { 
-                *index = 3; 
-                return d; 
-            }
-            else 
-            { *index = 1; 
-                return b; 
-            }
-        }
-    }
-    else
-    {
-        if(c > d)
-        {
-            if(c > a) 
-            { 
-                *index = 2; 
-                return c; 
-            }
-            else 
-            { 
-                *index = 0; 
-                return a; 
-            }
-        }
-        else
-        {
-            if(d > a) 
-            { 
-                *index = 3; 
-                return d; 
-            }
-            else 
-            { 
-                *index = 0; 
-                return a; 
-            }
+    int k = 0;
+    for (int i = 0; i < 5; ++i) {
+        for (int j = 0; j < 5; ++j) {
+            SW_ScoringMatrix[k++] = (i == j && i < 4) ? SW_MATCH : SW_MISMATCH;
         }
     }
 }
 
-stringPair smithWaterman(std::string& seqA, std::string& seqB )
+SmithWaterman::~SmithWaterman()
 {
-    //-----
-    // The SW you've grown to know and love
-    //
-    int waste1, waste2;
-
-    return smithWaterman(seqA, seqB, &waste1, &waste2, 0, (int)seqA.length(), 0);
+    // ksw_qinit uses malloc
+    free(SW_Profile);
+    free(SW_ReverseProfile);
 }
 
-stringPair smithWaterman(std::string& seqA, std::string& seqB, int * aStartAlign, int * aEndAlign, int aStartSearch, int aSearchLen)
+void SmithWaterman::makeProfiles(void)
 {
     //-----
-    // Same as below but ignore similarity
+    // Only align needs these, the anchored modes work straight off the query
     //
-    return smithWaterman(seqA, seqB, aStartAlign, aEndAlign, aStartSearch, aSearchLen, 0);
+    int query_length = static_cast<int>(SW_Query.length());
+    std::vector<uint8_t> codes(query_length);
+    nt4Encode(SW_Query, &codes[0]);
+    SW_Profile = ksw_qinit(2, query_length, &codes[0], 5, SW_ScoringMatrix);
+    
+    std::vector<uint8_t> backwards(codes.rbegin(), codes.rend());
+    SW_ReverseProfile = ksw_qinit(2, query_length, &backwards[0], 5, SW_ScoringMatrix);
 }
 
-stringPair smithWaterman(std::string& seqA, std::string& seqB, int * aStartAlign, int * aEndAlign, int aStartSearch, int aSearchLen, double similarity)
+bool SmithWaterman::align(const std::string& target, int searchStart, int searchLength, double similarity, SW_Alignment& alignment)
 {
     //-----
-    // Trickle-ier verison of the original version of the smith waterman algorithm I found in this file
-    // 
-    // This function is seqA centric, it will align ALL of seqB to the parts of seqA which lie INCLUSIVELY
-    // between aStartSearch and aEndSearch. It will return the UNIMPUTED alignment strings for A and B respectively
-    // in the stringPair variable AND it also stores the start and end indexes used to cut the seqA substring in the 
-    // two int references  aStartAlign, aEndAlign 
-    // 
-    // Hoi!
+    // The query is the profile and the read is the target so the
+    // read is only passed over twice, no matter how long the DR is
     //
-    // initialize some variables
-    int length_seq_B = (int)seqB.length();
+    if (SW_Query.empty() || searchStart < 0 || searchLength <= 0 || searchStart + searchLength > static_cast<int>(target.length())) {
+        return false;
+    }
+    if (SW_Profile == NULL) {
+        makeProfiles();
+    }
     
-    // initialize matrix
-    double ** matrix = new double*[aSearchLen+1];
-    int ** I_i = new int*[aSearchLen+1];
-    int ** I_j = new int*[aSearchLen+1];
+    if (static_cast<int>(SW_Target.size()) < searchLength) {
+        SW_Target.resize(searchLength);
+        SW_ReverseTarget.resize(searchLength);
+    }
+    nt4Encode(target.data() + searchStart, searchLength, &SW_Target[0]);
     
-    for(int i=0;i<=aSearchLen;i++)
-    {
-        double * tmp_mat = new double[length_seq_B+1];
-        int * tmp_i = new int[length_seq_B+1];
-        int * tmp_j = new int[length_seq_B+1];
-
-        matrix[i] = tmp_mat;
-        I_i[i] = tmp_i;
-        I_j[i] = tmp_j;
-        
-        for(int j=0;j<=length_seq_B;j++)
-        {
-            matrix[i][j]=0;
+    kswr_t forward = ksw_i16(SW_Profile, searchLength, &SW_Target[0], SW_GAP_OPEN, SW_GAP_EXTEND, 0);
+    if (forward.score <= 0 || forward.te < 0) {
+        return false;
+    }
+    
+    // run backwards from the end of the alignment, stopping as soon as
+    // the best score turns up again. Both sequences are cut at the end of
+    // the alignment so the start can't come from some other stretch that
+    // scores as well. Most of the time the alignment reaches the end of the
+    // DR and the whole DR backwards is already profiled
+    int query_length = static_cast<int>(SW_Query.length());
+    int prefix_length = forward.te + 1;
+    for (int i = 0; i < prefix_length; ++i) {
+        SW_ReverseTarget[i] = SW_Target[forward.te - i];
+    }
+    kswq_t * reverse_profile = SW_ReverseProfile;
+    if (forward.qe != query_length - 1) {
+        std::vector<uint8_t> backwards(forward.qe + 1);
+        for (int i = 0; i <= forward.qe; ++i) {
+            backwards[i] = NT4_TABLE[(unsigned char)SW_Query[forward.qe - i]];
         }
+        reverse_profile = ksw_qinit(2, forward.qe + 1, &backwards[0], 5, SW_ScoringMatrix);
+    }
+    kswr_t backward = ksw_i16(reverse_profile, prefix_length, &SW_ReverseTarget[0], SW_GAP_OPEN, SW_GAP_EXTEND, KSW_XSTOP | forward.score);
+    if (reverse_profile != SW_ReverseProfile) {
+        free(reverse_profile);
     }
+    if (backward.score != forward.score) {
+        return false;
+    }
+    
+    alignment.score = forward.score;
+    alignment.targetEnd = searchStart + forward.te;
+    alignment.targetStart = alignment.targetEnd - backward.te;
+    alignment.queryEnd = forward.qe;
+    alignment.queryStart = forward.qe - backward.qe;
+    
+    int target_length = alignment.targetEnd - alignment.targetStart + 1;
+    int distance = editDistance(target.data() + alignment.targetStart, 
+                                target_length, 
+                                SW_Query.data() + alignment.queryStart, 
+                                alignment.queryEnd - alignment.queryStart + 1);
+    alignment.edits = distance;
+    alignment.identity = 1.0f - (static_cast<float>(distance) / target_length);
     
-      
-    //start populating matrix
-    double matrix_max = -1;
-    int i_max = 0, j_max = 0;
-    for (int i=1;i<=aSearchLen;i++)
-    {
-        for(int j=1;j<=length_seq_B;j++)
-        {
-            int index = -1;
-            matrix[i][j] = findMax(   matrix[i-1][j-1] + SW_SIM_SCORE(seqA[i-1 + aStartSearch],seqB[j-1]), \
-                                      matrix[i-1][j] + SW_GAP, \
-                                      matrix[i][j-1] + SW_GAP, \
-                                      0, \
-                                      &index
-                                  );
+    return (0 == similarity || alignment.identity >= similarity);
+}
 
-            if(matrix[i][j] > matrix_max)
-            {
-                matrix_max = matrix[i][j];
-                i_max = i;
-                j_max = j;
+bool SmithWaterman::alignAnchored(const std::string& target, int searchStart, int searchLength, SW_Anchor anchor, double similarity, SW_Alignment& alignment)
+{
+    //-----
+    // An edit distance fill that starts at the anchored end of the window.
+    // The query can start anywhere for free but the alignment has to finish
+    // at the far end of the query. Reading both sequences backwards for the
+    // back turns it into the same problem as the front
+    //
+    int query_length = static_cast<int>(SW_Query.length());
+    if (query_length == 0 || similarity <= 0 || searchStart < 0 || searchLength <= 0 || searchStart + searchLength > static_cast<int>(target.length())) {
+        return false;
+    }
+    
+    int max_edits = maxAnchoredEdits(similarity);
+    int rows = std::min(searchLength, query_length + max_edits);
+    
+    const char * window;
+    const char * query;
+    int step;
+    if (anchor == SW_ANCHOR_FRONT) {
+        window = target.data() + searchStart;
+        query = SW_Query.data();
+        step = 1;
+    } else {
+        window = target.data() + searchStart + searchLength - 1;
+        query = SW_Query.data() + query_length - 1;
+        step = -1;
+    }
+    
+    // column 0 is for none of the query, column j + 1 for query base j.
+    // The starts are where in the query each alignment began
+    const int unreachable = 1 << 28;
+    int width = query_length + 1;
+    SW_AnchoredRows.resize(2 * width);
+    SW_AnchoredStarts.resize(2 * width);
+    int * previous = &SW_AnchoredRows[0];
+    int * current = previous + width;
+    int * previous_starts = &SW_AnchoredStarts[0];
+    int * current_starts = previous_starts + width;
+    for (int j = 0; j < width; ++j) {
+        previous[j] = 0;
+        previous_starts[j] = j;
+    }
+    
+    int best_row = -1;
+    int best_edits = 0;
+    int best_start = 0;
+    for (int i = 0; i < rows; ++i) {
+        // cells more than max_edits left of the diagonal need too many insertions
+        int band_start = std::max(0, i - max_edits);
+        current[0] = (band_start == 0) ? i + 1 : unreachable;
+        current_starts[0] = 0;
+        for (int j = 1; j <= band_start; ++j) {
+            current[j] = unreachable;
+        }
+        int row_minimum = current[0];
+        char base = window[i * step];
+        for (int j = band_start + 1; j < width; ++j) {
+            int edits = previous[j - 1] + ((base == query[(j - 1) * step]) ? 0 : 1);
+            int start = previous_starts[j - 1];
+            if (previous[j] + 1 < edits) {
+                edits = previous[j] + 1;
+                start = previous_starts[j];
             }
-            
-            switch(index)
-            {
-                case 0:
-                    I_i[i][j] = i-1;
-                    I_j[i][j] = j-1;
-                    break;
-                case 1:
-                    I_i[i][j] = i-1;
-                    I_j[i][j] = j;
-                    break;
-                case 2:
-                    I_i[i][j] = i;
-                    I_j[i][j] = j-1;
-                    break;
-                case 3:
-                    I_i[i][j] = i;
-                    I_j[i][j] = j;
-                    break;
-                default:
-                    throw crispr::exception( __FILE__, __LINE__, __PRETTY_FUNCTION__,"Index never set in findMax");
+            if (current[j - 1] + 1 < edits) {
+                edits = current[j - 1] + 1;
+                start = current_starts[j - 1];
+            }
+            current[j] = edits;
+            current_starts[j] = start;
+            if (edits < row_minimum) row_minimum = edits;
+        }
+        
+        // anything ending here has used all of the query
+        int length = i + 1;
+        int edits = current[width - 1];
+        if (1.0 - (static_cast<double>(edits) / length) >= similarity) {
+            // the fewest edits for the length, longer wins a tie
+            if (best_row == -1 || length - 2 * edits >= (best_row + 1) - 2 * best_edits) {
+                best_row = i;
+                best_edits = edits;
+                best_start = current_starts[width - 1];
             }
         }
+        
+        // a row never has fewer edits than the one before it
+        if (row_minimum > max_edits) {
+            break;
+        }
+        std::swap(previous, current);
+        std::swap(previous_starts, current_starts);
     }
     
-    int current_i = i_max;
-    int current_j = j_max;
-    int next_i = I_i[current_i][current_j];
-    int next_j = I_j[current_i][current_j];
-    
-    while((next_j!=0) && (next_i!=0) && ((current_i!=next_i) || (current_j!=next_j)))
-    {
-        current_i = next_i;
-        current_j = next_j;
-        next_i = I_i[current_i][current_j];
-        next_j = I_j[current_i][current_j];
+    if (best_row == -1) {
+        return false;
     }
     
-    // record the start and end of seqA
-    current_i--;
-    current_j--;
-    if(0 > current_j) { current_j = 0; } 
-    if(0 > current_i) { current_i = 0; } 
+    anchoredResult(searchStart, searchLength, anchor, best_row, best_edits, best_start, alignment);
+    return true;
+}
+
+int SmithWaterman::maxAnchoredEdits(double similarity)
+{
+    //-----
+    // which is also how much longer than the query the aligned
+    // part of the window can be
+    //
+    return static_cast<int>((1.0 - similarity) * SW_Query.length() / similarity);
+}
+
+void SmithWaterman::anchoredResult(int searchStart, int searchLength, SW_Anchor anchor, int bestRow, int edits, int start, SW_Alignment& alignment)
+{
+    int query_length = static_cast<int>(SW_Query.length());
+    int length = bestRow + 1;
+    alignment.score = 0;
+    alignment.edits = edits;
+    alignment.identity = 1.0f - (static_cast<float>(edits) / length);
+    if (anchor == SW_ANCHOR_FRONT) {
+        alignment.targetStart = searchStart;
+        alignment.targetEnd = searchStart + bestRow;
+        alignment.queryStart = start;
+        alignment.queryEnd = query_length - 1;
+    } else {
+        alignment.targetStart = searchStart + searchLength - length;
+        alignment.targetEnd = searchStart + searchLength - 1;
+        alignment.queryStart = 0;
+        alignment.queryEnd = query_length - 1 - start;
+    }
+}
+
+void SmithWaterman::alignAnchoredBatch(const std::vector<SW_Window>& windows, SW_Anchor anchor, double similarity, std::vector<SW_Alignment>& alignments, std::vector<bool>& found)
+{
+    size_t count = windows.size();
+    alignments.resize(count);
+    found.assign(count, false);
     
-    *aStartAlign = current_i+ aStartSearch;
-    *aEndAlign = (*aStartAlign) + i_max - current_i - 1;
+#ifdef __SSE2__
+    // the lanes are bytes, every edit distance has to stay below 255
+    int query_length = static_cast<int>(SW_Query.length());
+    if (query_length > 0 && similarity > 0 && 2 * query_length + maxAnchoredEdits(similarity) < 255) {
+        SW_Alignment lane_alignments[SW_BATCH_LANES];
+        bool lane_found[SW_BATCH_LANES];
+        for (size_t first = 0; first < count; first += SW_BATCH_LANES) {
+            int lanes = static_cast<int>(std::min(count - first, (size_t)SW_BATCH_LANES));
+            alignAnchoredLanes(&windows[first], lanes, anchor, similarity, lane_alignments, lane_found);
+            for (int lane = 0; lane < lanes; ++lane) {
+                found[first + lane] = lane_found[lane];
+                alignments[first + lane] = lane_alignments[lane];
+            }
+        }
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        found[i] = alignAnchored(*(windows[i].target), windows[i].searchStart, windows[i].searchLength, anchor, similarity, alignments[i]);
+    }
+}
+
+#ifdef __SSE2__
+void SmithWaterman::alignAnchoredLanes(const SW_Window * windows, int count, SW_Anchor anchor, double similarity, SW_Alignment * alignments, bool * found)
+{
+    //-----
+    // The same fill as alignAnchored, with one window in each byte of the
+    // vectors. Every lane is on the same row and column at once, so the query
+    // base is the same for all of them and only the window bases differ
+    //
+    int query_length = static_cast<int>(SW_Query.length());
+    int max_edits = maxAnchoredEdits(similarity);
+    int width = query_length + 1;
     
-    // we don't need these guys anymore
-    for(int i=0;i<=aSearchLen;i++)
-    {
-        delete [] matrix[i];
-        delete [] I_i[i];
-        delete [] I_j[i];
+    // lay the windows out a row at a time, walking away from the anchor.
+    // Lanes that are out of bases or out of use get 0xff, which never
+    // matches the query
+    int lane_rows[SW_BATCH_LANES];
+    bool lane_done[SW_BATCH_LANES];
+    int rows = 0;
+    for (int lane = 0; lane < SW_BATCH_LANES; ++lane) {
+        found[lane] = false;
+        lane_rows[lane] = 0;
+        lane_done[lane] = true;
+        if (lane >= count) continue;
+        const SW_Window& window = windows[lane];
+        if (window.searchStart < 0 || window.searchLength <= 0 || window.searchStart + window.searchLength > static_cast<int>(window.target->length())) {
+            continue;
+        }
+        lane_rows[lane] = std::min(window.searchLength, query_length + max_edits);
+        lane_done[lane] = false;
+        if (lane_rows[lane] > rows) rows = lane_rows[lane];
+    }
+    SW_LaneBases.assign(rows * SW_BATCH_LANES, 0xff);
+    for (int lane = 0; lane < count; ++lane) {
+        if (lane_done[lane]) continue;
+        const SW_Window& window = windows[lane];
+        const char * bases = window.target->data();
+        for (int i = 0; i < lane_rows[lane]; ++i) {
+            int position = (anchor == SW_ANCHOR_FRONT) ? window.searchStart + i : window.searchStart + window.searchLength - 1 - i;
+            SW_LaneBases[i * SW_BATCH_LANES + lane] = static_cast<uint8_t>(bases[position]);
+        }
     }
-    delete [] matrix;
-    delete [] I_i;
-    delete [] I_j;
     
-    // calculate similarity and return substrings is need be
-    std::string a_ret;
-    std::string b_ret;
-    try {
-        a_ret = seqA.substr(current_i+ aStartSearch, i_max - current_i + aStartSearch);
-    } catch (std::exception& e) {
-        throw (crispr::exception( __FILE__, __LINE__, __PRETTY_FUNCTION__, e.what()));
+    SW_LaneRows.resize(2 * width * SW_BATCH_LANES);
+    SW_LaneStarts.resize(2 * width * SW_BATCH_LANES);
+    uint8_t * previous = &SW_LaneRows[0];
+    uint8_t * current = previous + width * SW_BATCH_LANES;
+    uint8_t * previous_starts = &SW_LaneStarts[0];
+    uint8_t * current_starts = previous_starts + width * SW_BATCH_LANES;
+    for (int j = 0; j < width; ++j) {
+        _mm_storeu_si128((__m128i *)(previous + j * SW_BATCH_LANES), _mm_setzero_si128());
+        _mm_storeu_si128((__m128i *)(previous_starts + j * SW_BATCH_LANES), _mm_set1_epi8(static_cast<char>(j)));
     }
-    try {
-        b_ret = seqB.substr(current_j, j_max - current_j);
-    } catch (std::exception& e) {
-        throw (crispr::exception( __FILE__, __LINE__, __PRETTY_FUNCTION__, e.what()));
+    
+    const __m128i ones = _mm_set1_epi8(1);
+    const __m128i all_set = _mm_set1_epi8(-1);
+    const __m128i unreachable = _mm_set1_epi8(-1);
+    uint8_t last_column[SW_BATCH_LANES];
+    uint8_t last_starts[SW_BATCH_LANES];
+    uint8_t row_minimums[SW_BATCH_LANES];
+    int best_row[SW_BATCH_LANES];
+    int best_edits[SW_BATCH_LANES];
+    int best_start[SW_BATCH_LANES];
+    for (int lane = 0; lane < SW_BATCH_LANES; ++lane) {
+        best_row[lane] = -1;
+        best_edits[lane] = best_start[lane] = 0;
     }
-    if(0 != similarity)
-    {
+    
+    for (int i = 0; i < rows; ++i) {
+        int band_start = std::max(0, i - max_edits);
+        __m128i left = (band_start == 0) ? _mm_set1_epi8(static_cast<char>(i + 1)) : unreachable;
+        __m128i left_start = _mm_setzero_si128();
+        _mm_storeu_si128((__m128i *)current, left);
+        _mm_storeu_si128((__m128i *)current_starts, left_start);
+        for (int j = 1; j <= band_start; ++j) {
+            _mm_storeu_si128((__m128i *)(current + j * SW_BATCH_LANES), unreachable);
+        }
+        __m128i row_minimum = left;
+        __m128i base = _mm_loadu_si128((const __m128i *)&SW_LaneBases[i * SW_BATCH_LANES]);
+        const char * query = SW_Query.data();
+        for (int j = band_start + 1; j < width; ++j) {
+            char query_base = (anchor == SW_ANCHOR_FRONT) ? query[j - 1] : query[query_length - j];
+            __m128i mismatch = _mm_andnot_si128(_mm_cmpeq_epi8(base, _mm_set1_epi8(query_base)), ones);
+            __m128i edits = _mm_adds_epu8(_mm_loadu_si128((const __m128i *)(previous + (j - 1) * SW_BATCH_LANES)), mismatch);
+            __m128i start = _mm_loadu_si128((const __m128i *)(previous_starts + (j - 1) * SW_BATCH_LANES));
+            
+            // only take the other moves when they are strictly better, like alignAnchored
+            __m128i up = _mm_adds_epu8(_mm_loadu_si128((const __m128i *)(previous + j * SW_BATCH_LANES)), ones);
+            __m128i better = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_max_epu8(up, edits), up), all_set);
+            edits = _mm_min_epu8(edits, up);
+            start = _mm_or_si128(_mm_and_si128(better, _mm_loadu_si128((const __m128i *)(previous_starts + j * SW_BATCH_LANES))), _mm_andnot_si128(better, start));
+            
+            left = _mm_adds_epu8(left, ones);
+            better = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_max_epu8(left, edits), left), all_set);
+            edits = _mm_min_epu8(edits, left);
+            start = _mm_or_si128(_mm_and_si128(better, left_start), _mm_andnot_si128(better, start));
+            
+            _mm_storeu_si128((__m128i *)(current + j * SW_BATCH_LANES), edits);
+            _mm_storeu_si128((__m128i *)(current_starts + j * SW_BATCH_LANES), start);
+            row_minimum = _mm_min_epu8(row_minimum, edits);
+            left = edits;
+            left_start = start;
+        }
         
-        double similarity_ld = 1.0 - (PatternMatcher::levenstheinDistance(a_ret, b_ret) /(double)a_ret.length()); 
-        if(similarity_ld >= similarity)
-        {
-            return std::pair<std::string, std::string>(a_ret, b_ret); 
+        memcpy(last_column, current + (width - 1) * SW_BATCH_LANES, SW_BATCH_LANES);
+        memcpy(last_starts, current_starts + (width - 1) * SW_BATCH_LANES, SW_BATCH_LANES);
+        _mm_storeu_si128((__m128i *)row_minimums, row_minimum);
+        bool all_done = true;
+        for (int lane = 0; lane < count; ++lane) {
+            if (lane_done[lane]) continue;
+            int length = i + 1;
+            int edits = last_column[lane];
+            if (1.0 - (static_cast<double>(edits) / length) >= similarity) {
+                if (best_row[lane] == -1 || length - 2 * edits >= (best_row[lane] + 1) - 2 * best_edits[lane]) {
+                    best_row[lane] = i;
+                    best_edits[lane] = edits;
+                    best_start[lane] = last_starts[lane];
+                }
+            }
+            if (row_minimums[lane] > max_edits || length >= lane_rows[lane]) {
+                lane_done[lane] = true;
+            } else {
+                all_done = false;
+            }
         }
-        else
-        {
-            // no go joe
-            *aStartAlign = 0;
-            *aEndAlign = 0;
-            return std::pair<std::string, std::string>("","");
+        if (all_done) {
+            break;
         }
+        std::swap(previous, current);
+        std::swap(previous_starts, current_starts);
     }
-    else
-    {
-        // just return the substrings
-        return std::pair<std::string, std::string>(a_ret, b_ret);
+    
+    for (int lane = 0; lane < count; ++lane) {
+        if (best_row[lane] != -1) {
+            found[lane] = true;
+            anchoredResult(windows[lane].searchStart, windows[lane].searchLength, anchor, best_row[lane], best_edits[lane], best_start[lane], alignments[lane]);
+        }
     }
 }
+#endif
 
-
-
-
-
-
-
+int SmithWaterman::editDistance(const char * target, int targetLength, const char * query, int queryLength)
+{
+    //-----
+    // Levenshtein distance a row at a time
+    //
+    SW_EditRow.resize(queryLength + 1);
+    for (int j = 0; j <= queryLength; ++j) {
+        SW_EditRow[j] = j;
+    }
+    for (int i = 1; i <= targetLength; ++i) {
+        int diagonal = SW_EditRow[0];
+        SW_EditRow[0] = i;
+        for (int j = 1; j <= queryLength; ++j) {
+            int above = SW_EditRow[j];
+            int best = diagonal + ((target[i - 1] == query[j - 1]) ? 0 : 1);
+            if (above + 1 < best) best = above + 1;
+            if (SW_EditRow[j - 1] + 1 < best) best = SW_EditRow[j - 1] + 1;
+            SW_EditRow[j] = best;
+            diagonal = above;
+        }
+    }
+    return SW_EditRow[queryLength];
+}
@@ -37,16 +37,20 @@
 // --------------------------------------------------------------------
 
 //////////////////////////////////////////////
-// Simple Ends-Free Smith-Waterman Algorithm
+// Alignment of a DR against part of a read
 //
-// You will be prompted for input sequences
-// Penalties and match scores are hard-coded
+// crass uses this to find partial DRs hanging off the ends
+// of reads, see alignAnchored and alignAnchoredBatch. These
+// are banded edit distance fills anchored at one end of the
+// search window.
 //
-// Program does not perform multiple tracebacks if 
-// it finds several alignments with the same score
-//
-// By Nikhil Gopal
-// Similar implementation here: https://wiki.uni-koeln.de/biologicalphysics/index.php/Implementation_of_the_Smith-Waterman_local_alignment_algorithm
+// align is a plain local alignment on the striped ksw kernels,
+// only the scores are kept during the fill. The end comes from
+// a forward pass and the start from a second pass over the
+// sequences backwards, there is no traceback so no aligned
+// strings either, just coordinates and an identity for the
+// aligned stretch. Its query profiles are only made the first
+// time it is called
 //////////////////////////////////////////////
 
 
@@ -55,32 +59,119 @@
 
 // system includes
 #include <string>
-#include <map>
+#include <vector>
+#include <stdint.h>
 
-#define SW_MATCH                (1.2)
-#define SW_MISMATCH             (-1)
-#define SW_GAP                  (-1)
-#define SW_SIM_SCORE(_a, _b)    ((_a == _b) ? SW_MATCH : SW_MISMATCH )
+// local includes
+#include "ksw.h"
 
-typedef std::pair<std::string, std::string> stringPair;
+// the old double scores (1.2, -1, -1) times ten. ksw needs a gap open
+// above zero so a gap costs one more than it used to
+#define SW_MATCH                (12)
+#define SW_MISMATCH             (-10)
+#define SW_GAP_OPEN             (1)
+#define SW_GAP_EXTEND           (10)
 
-double findMax(double a, double b, double c, double d, int * index);
-//-----
-// The SW you've grown to know and love
-//
-stringPair smithWaterman(std::string& seqA, std::string& seqB);
-//-----
-// Same as below but ignore similarity
-//
-stringPair smithWaterman(std::string& seqA, std::string& seqB, int * aStartAlign, int * aEndAlign, int aStartSearch, int aEndSearch, double similarity);
+// which end of the search window an anchored alignment has to reach
+enum SW_Anchor {
+    SW_ANCHOR_FRONT,                // start of the window and the end of the query
+    SW_ANCHOR_BACK                  // end of the window and the start of the query
+};
 
-//-----
-// Trickle-ier verison of the original version of the smith waterman algorithm I found in this file
-// 
-// This function is seqA centric, it will align ALL of seqB to the parts of seqA which lie INCLUSIVELY
-// between aStartSearch and aEndSearch. It will return the UNIMPUTED alignment strings for A and B respectively
-// in the stringPair variable AND it also stores the start and end indexes used to cut the seqA substring in the 
-// two int references  aStartAlign, aEndAlign 
-stringPair smithWaterman(std::string& seqA, std::string& seqB, int * aStartAlign, int * aEndAlign, int aStartSearch, int aEndSearch);
+// how many windows alignAnchoredBatch runs side by side
+#define SW_BATCH_LANES          (16)
+
+// one of the windows for alignAnchoredBatch
+typedef struct {
+    const std::string * target;
+    int searchStart;
+    int searchLength;
+} SW_Window;
+
+// where the query landed, everything inclusive
+typedef struct {
+    int score;                      // ksw score, 0 for anchored alignments
+    int edits;                      // edit distance between the aligned parts
+    int targetStart;
+    int targetEnd;
+    int queryStart;
+    int queryEnd;
+    float identity;                 // 1 - (edit distance / length of the aligned target)
+} SW_Alignment;
+
+class SmithWaterman {
+public:
+    // one SmithWaterman can be used for every read in a group
+    SmithWaterman(const std::string& query);
+    ~SmithWaterman();
+    
+    inline const std::string& query(void) { return SW_Query; }
+    
+    //-----
+    // Align ALL of the query against the part of target that lies between
+    // searchStart and searchStart + searchLength. Coordinates are in the whole
+    // target. Returns false if nothing aligns or if the identity is below
+    // similarity, 0 skips the identity check
+    //
+    bool align(const std::string& target, int searchStart, int searchLength, double similarity, SW_Alignment& alignment);
+    
+    //-----
+    // Look for a partial query hanging off one end of the search window.
+    // SW_ANCHOR_FRONT aligns a prefix of the window to a suffix of the query,
+    // SW_ANCHOR_BACK a suffix of the window to a prefix of the query. Unaligned
+    // bases at the anchored end of the window count as edits. The aligned part
+    // of the window can only be a few bases longer than the query so only a
+    // band of the window is looked at, and the fill stops as soon as no
+    // alignment can reach similarity. When several lengths pass the one with
+    // the fewest edits for its length wins.
+    // similarity must be above 0
+    //
+    bool alignAnchored(const std::string& target, int searchStart, int searchLength, SW_Anchor anchor, double similarity, SW_Alignment& alignment);
+    
+    //-----
+    // alignAnchored for lots of windows with the same anchor. The windows
+    // are done SW_BATCH_LANES at a time, one per SIMD lane, all against the
+    // same query. found and alignments come back in the same order as windows
+    // and give exactly what alignAnchored would for each window
+    //
+    void alignAnchoredBatch(const std::vector<SW_Window>& windows, SW_Anchor anchor, double similarity, std::vector<SW_Alignment>& alignments, std::vector<bool>& found);
+    
+private:
+    // owns the profiles, don't copy
+    SmithWaterman(const SmithWaterman&);
+    SmithWaterman& operator=(const SmithWaterman&);
+    
+    // profile the query both ways round for align
+    void makeProfiles(void);
+    
+    // most edits a passing anchored alignment can have
+    int maxAnchoredEdits(double similarity);
+    
+    // fill in an anchored alignment from the best row of the fill
+    void anchoredResult(int searchStart, int searchLength, SW_Anchor anchor, int bestRow, int edits, int start, SW_Alignment& alignment);
+    
+#ifdef __SSE2__
+    // up to SW_BATCH_LANES windows in one pass
+    void alignAnchoredLanes(const SW_Window * windows, int count, SW_Anchor anchor, double similarity, SW_Alignment * alignments, bool * found);
+#endif
+    
+    // edit distance between the aligned parts of the target and the query
+    int editDistance(const char * target, int targetLength, const char * query, int queryLength);
+    
+    std::string SW_Query;
+    int8_t SW_ScoringMatrix[25];
+    kswq_t * SW_Profile;                // the query, NULL until align needs it
+    kswq_t * SW_ReverseProfile;         // and the query backwards, for the start
+    
+    // scratch space reused between alignments
+    std::vector<uint8_t> SW_Target;
+    std::vector<uint8_t> SW_ReverseTarget;
+    std::vector<int> SW_EditRow;
+    std::vector<int> SW_AnchoredRows;         // two rows of edit distances
+    std::vector<int> SW_AnchoredStarts;       // and where in the query each one started
+    std::vector<uint8_t> SW_LaneBases;        // batch windows, SW_BATCH_LANES bases per row
+    std::vector<uint8_t> SW_LaneRows;         // two rows of edit distances for every lane
+    std::vector<uint8_t> SW_LaneStarts;       // and the starts
+};
 
 #endif // __SMITH_WATERMAN_H
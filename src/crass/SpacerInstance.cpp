@@ -35,6 +35,7 @@
 // system includes
 #include <iostream>
 #include <string>
+#include <sstream>
 #include "Exception.h"
 
 // local includes
@@ -237,3 +238,42 @@ void SpacerInstance::printContents(void)
 
 
 
+
+void SpacerInstance::writeCheckpoint(CheckpointWriter& out)
+{
+    if (!SI_SpacerEdges.empty()) 
+    {
+        std::stringstream ss;
+        ss << "Spacer " << SI_SpacerSeqID << " already has spacer edges, they can't be checkpointed";
+        throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ss);
+    }
+    out.writeInt(SI_SpacerSeqID);
+    out.writeInt(SI_LeadingNode->getID());
+    out.writeInt(SI_LastNode->getID());
+    out.writeUInt(SI_InstanceCount);
+    out.writeBool(SI_Attached);
+    out.writeInt(SI_ContigID);
+    out.writeBool(SI_isFlanker);
+}
+
+void SpacerInstance::readCheckpoint(CheckpointReader& in, const std::vector<CrisprNode *>& nodes)
+{
+    SI_SpacerSeqID = in.readInt();
+    StringToken ends[2];
+    for (int i = 0; i < 2; i++) 
+    {
+        ends[i] = in.readInt();
+        if (NULL == nodeAt(nodes, ends[i])) 
+        {
+            std::stringstream ss;
+            ss << "Spacer " << SI_SpacerSeqID << " ends on " << ends[i] << " which isn't a node";
+            throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ss);
+        }
+    }
+    SI_LeadingNode = nodeAt(nodes, ends[0]);
+    SI_LastNode = nodeAt(nodes, ends[1]);
+    SI_InstanceCount = in.readUInt();
+    SI_Attached = in.readBool();
+    SI_ContigID = in.readInt();
+    SI_isFlanker = in.readBool();
+}
@@ -42,15 +42,17 @@
 // system includes
 #include <iostream>
 #include <list>
+#include <stdint.h>
 
 // local includes
 #include "crassDefines.h"
 #include "CrisprNode.h"
 #include "StringCheck.h"
+#include "Checkpoint.h"
 
 class SpacerInstance;
 // we hash together string tokens to make a unique key for each spacer
-typedef unsigned int SpacerKey;
+typedef uint64_t SpacerKey;
 
 enum SI_EdgeDirection {
     REVERSE = 0,
@@ -83,13 +85,14 @@ typedef std::vector<spacerEdgeStruct *>::iterator SpacerEdgeVector_Iterator;
 inline SpacerKey makeSpacerKey(StringToken backST, StringToken frontST)
 {
     //-----
-    // make a spacer key from two string tokens
+    // make a spacer key from two string tokens,
+    // the smaller token goes in the top half so the order doesn't matter
     //
 	if(backST < frontST)
 	{
-		return (backST * 10000000) + frontST;
+		return (static_cast<SpacerKey>(backST) << 32) | static_cast<unsigned int>(frontST);
 	}
-	return (frontST * 10000000) + backST;
+	return (static_cast<SpacerKey>(frontST) << 32) | static_cast<unsigned int>(backST);
 }
 
 class SpacerInstance {
@@ -164,6 +167,11 @@ public:
         //
         void printContents(void);
         
+        // only for spacers without spacer edges, ie from before the spacer
+        // graph is built. The nodes are looked up by their tokens
+        void writeCheckpoint(CheckpointWriter& out);
+        void readCheckpoint(CheckpointReader& in, const std::vector<CrisprNode *>& nodes);
+        
     private:
         StringToken SI_SpacerSeqID;               // the StringToken of this spacer
         CrisprNode * SI_LeadingNode;              // the first node of this spacer
@@ -37,21 +37,271 @@
 // system includes
 #include <iostream>
 #include <sstream>
+#include <cstring>
 
 // local includes
 #include "StringCheck.h"
 #include "Exception.h"
 
+void StringCheck::init(void)
+{
+    //-----
+    // set up the empty shards and token table. Nothing is allocated until
+    // the first string goes in, lots of groups only ever hold a handful
+    //
+    mNextFreeToken = 1;
+    for(int i = 0; i < SC_NUM_SHARDS; i++)
+    {
+        pthread_mutex_init(&(mShards[i].SS_Lock), NULL);
+        mShards[i].SS_Table = NULL;
+        mShards[i].SS_Used = 0;
+        mShards[i].SS_BlockPos = 0;
+        mShards[i].SS_BlockSize = 0;
+    }
+    for(int i = 0; i < SC_MAX_RECORD_BLOCKS; i++)
+    {
+        mRecordBlocks[i] = NULL;
+    }
+}
+
+StringCheck::~StringCheck(void)
+{
+    for(int i = 0; i < SC_NUM_SHARDS; i++)
+    {
+        pthread_mutex_destroy(&(mShards[i].SS_Lock));
+        std::vector<char *>::iterator block_iter;
+        for(block_iter = mShards[i].SS_Blocks.begin(); block_iter != mShards[i].SS_Blocks.end(); block_iter++)
+        {
+            delete [] *block_iter;
+        }
+        freeTable(mShards[i].SS_Table);
+        std::vector<StringTable *>::iterator table_iter;
+        for(table_iter = mShards[i].SS_OldTables.begin(); table_iter != mShards[i].SS_OldTables.end(); table_iter++)
+        {
+            freeTable(*table_iter);
+        }
+    }
+    for(int i = 0; i < SC_MAX_RECORD_BLOCKS; i++)
+    {
+        if(NULL != mRecordBlocks[i])
+        {
+            delete [] mRecordBlocks[i];
+        }
+    }
+}
+
+StringCheck::StringTable * StringCheck::makeTable(size_t size)
+{
+    StringTable * table = new StringTable;
+    table->ST_Size = size;
+    table->ST_Slots = new StringToken[size];
+    table->ST_Hashes = new unsigned int[size];
+    memset(table->ST_Slots, 0, size * sizeof(StringToken));
+    memset(table->ST_Hashes, 0, size * sizeof(unsigned int));
+    return table;
+}
+
+void StringCheck::freeTable(StringTable * table)
+{
+    if(NULL == table)
+        return;
+    delete [] table->ST_Slots;
+    delete [] table->ST_Hashes;
+    delete table;
+}
+
+unsigned int StringCheck::hashString(const char * str, size_t len)
+{
+    //-----
+    // 32 bit FNV-1a
+    //
+    unsigned int hash = 2166136261u;
+    for(size_t i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+StringCheck::StringRecord * StringCheck::recordAt(StringToken token)
+{
+    //-----
+    // Find the record for a token without taking any locks. Block b of the
+    // token table holds SC_RECORD_BASE_SIZE * 2^b records so the table never
+    // has to move once a record has been handed out
+    //
+    unsigned int scaled = ((unsigned int)token / SC_RECORD_BASE_SIZE) + 1;
+    int block = 31 - __builtin_clz(scaled);
+    StringRecord * records = __atomic_load_n(&(mRecordBlocks[block]), __ATOMIC_ACQUIRE);
+    if(NULL == records)
+        return NULL;
+    return records + ((unsigned int)token - SC_RECORD_BASE_SIZE * ((1u << block) - 1));
+}
+
+StringCheck::StringRecord * StringCheck::makeRecord(StringToken token)
+{
+    //-----
+    // Same as recordAt but make the block if it doesn't exist yet. Two threads
+    // may race to make the same block, the loser throws its copy away
+    //
+    unsigned int scaled = ((unsigned int)token / SC_RECORD_BASE_SIZE) + 1;
+    int block = 31 - __builtin_clz(scaled);
+    StringRecord * records = __atomic_load_n(&(mRecordBlocks[block]), __ATOMIC_ACQUIRE);
+    if(NULL == records)
+    {
+        size_t block_size = (size_t)SC_RECORD_BASE_SIZE << block;
+        StringRecord * new_records = new StringRecord[block_size];
+        memset(new_records, 0, block_size * sizeof(StringRecord));
+        if(__atomic_compare_exchange_n(&(mRecordBlocks[block]), &records, new_records, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            records = new_records;
+        }
+        else
+        {
+            // records now holds the winner's block
+            delete [] new_records;
+        }
+    }
+    return records + ((unsigned int)token - SC_RECORD_BASE_SIZE * ((1u << block) - 1));
+}
+
+const char * StringCheck::arenaStore(StringShard * shard, const std::string& str)
+{
+    //-----
+    // copy the string into the shard's arena. Caller holds the shard lock.
+    // Blocks start small and double up to SC_ARENA_BLOCK_SIZE so that a
+    // shard holding a few strings only costs a few hundred bytes
+    //
+    size_t len = str.length();
+    char * dest;
+    if(len > SC_ARENA_BLOCK_SIZE / 4)
+    {
+        // big strings get a block to themselves. Put it at the front so that
+        // the last block is still the one we are filling
+        dest = new char[len + 1];
+        shard->SS_Blocks.insert(shard->SS_Blocks.begin(), dest);
+    }
+    else
+    {
+        if(shard->SS_BlockPos + len + 1 > shard->SS_BlockSize)
+        {
+            size_t block_size = (0 == shard->SS_BlockSize) ? SC_ARENA_FIRST_BLOCK : shard->SS_BlockSize * 2;
+            while(block_size < len + 1)
+            {
+                block_size *= 2;
+            }
+            if(block_size > SC_ARENA_BLOCK_SIZE)
+            {
+                block_size = SC_ARENA_BLOCK_SIZE;
+            }
+            shard->SS_Blocks.push_back(new char[block_size]);
+            shard->SS_BlockSize = block_size;
+            shard->SS_BlockPos = 0;
+        }
+        dest = shard->SS_Blocks.back() + shard->SS_BlockPos;
+        shard->SS_BlockPos += len + 1;
+    }
+    memcpy(dest, str.data(), len);
+    dest[len] = '\0';
+    return dest;
+}
+
+size_t StringCheck::findSlot(StringTable * table, unsigned int hash, const char * str, size_t len, StringToken * token)
+{
+    //-----
+    // linear probe for the slot holding this string, or the empty slot
+    // where it should go. Safe without the shard lock: a slot's hash and
+    // record are written before its token is released into the table, and
+    // a table is never changed in place once a bigger one replaces it.
+    // The token we saw in the slot goes into token, readers must use that
+    // one because an empty slot can be filled with some other string as
+    // soon as we have looked at it
+    //
+    size_t mask = table->ST_Size - 1;
+    size_t slot = hash & mask;
+    while(0 != (*token = __atomic_load_n(&(table->ST_Slots[slot]), __ATOMIC_ACQUIRE)))
+    {
+        if(table->ST_Hashes[slot] == hash)
+        {
+            StringRecord * record = recordAt(*token);
+            if(record->SR_Len == len && 0 == memcmp(record->SR_Str, str, len))
+                return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void StringCheck::growShard(StringShard * shard)
+{
+    //-----
+    // double the size of the shard's table. Caller holds the shard lock.
+    // Readers may still be probing the old table so it is kept until we go
+    //
+    StringTable * old_table = shard->SS_Table;
+    size_t new_size = (NULL == old_table) ? SC_FIRST_TABLE_SIZE : old_table->ST_Size * 2;
+    StringTable * new_table = makeTable(new_size);
+    
+    if(NULL != old_table)
+    {
+        size_t mask = new_size - 1;
+        for(size_t i = 0; i < old_table->ST_Size; i++)
+        {
+            if(0 == old_table->ST_Slots[i])
+                continue;
+            size_t slot = old_table->ST_Hashes[i] & mask;
+            while(0 != new_table->ST_Slots[slot])
+            {
+                slot = (slot + 1) & mask;
+            }
+            new_table->ST_Slots[slot] = old_table->ST_Slots[i];
+            new_table->ST_Hashes[slot] = old_table->ST_Hashes[i];
+        }
+        shard->SS_OldTables.push_back(old_table);
+    }
+    __atomic_store_n(&(shard->SS_Table), new_table, __ATOMIC_RELEASE);
+}
 
 StringToken StringCheck::addString(std::string newStr)
 {
     //-----
     // add the string and retuen it's token
     //
-    mNextFreeToken++;
-    mT2S_map[mNextFreeToken] = newStr;
-    mS2T_map[newStr] = mNextFreeToken;
-    return mNextFreeToken;
+    // Every call makes a new token, just like before. If the string is
+    // already stored then the new token shares the old copy and the index
+    // is pointed at the newest token
+    //
+    StringToken token = __atomic_add_fetch(&mNextFreeToken, 1, __ATOMIC_RELAXED);
+    unsigned int hash = hashString(newStr.data(), newStr.length());
+    StringShard * shard = &(mShards[hash >> SC_SHARD_SHIFT]);
+    
+    pthread_mutex_lock(&(shard->SS_Lock));
+    if(NULL == shard->SS_Table || (shard->SS_Used + 1) * 2 > shard->SS_Table->ST_Size)
+    {
+        growShard(shard);
+    }
+    StringTable * table = shard->SS_Table;
+    StringToken old_token;
+    size_t slot = findSlot(table, hash, newStr.data(), newStr.length(), &old_token);
+    const char * stored;
+    if(0 != old_token)
+    {
+        stored = recordAt(old_token)->SR_Str;
+    }
+    else
+    {
+        stored = arenaStore(shard, newStr);
+        table->ST_Hashes[slot] = hash;
+        shard->SS_Used++;
+    }
+    StringRecord * record = makeRecord(token);
+    record->SR_Len = (unsigned int)newStr.length();
+    __atomic_store_n(&(record->SR_Str), stored, __ATOMIC_RELEASE);
+    __atomic_store_n(&(table->ST_Slots[slot]), token, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&(shard->SS_Lock));
+    
+    return token;
 }
 
 std::string StringCheck::getString(StringToken token)
@@ -59,23 +309,33 @@ std::string StringCheck::getString(StringToken token)
     //-----
     // return the string for a given token or spew
     //
-    if(mT2S_map.find(token) != mT2S_map.end()) {
-        return mT2S_map[token];
-    } else {
-        throw crispr::exception(__FILE__, 
-                                __LINE__, 
-                                __PRETTY_FUNCTION__,
-                                "Token not stored");
+    if(token > 1 && token <= __atomic_load_n(&mNextFreeToken, __ATOMIC_RELAXED)) {
+        StringRecord * record = recordAt(token);
+        if(NULL != record) {
+            const char * str = __atomic_load_n(&(record->SR_Str), __ATOMIC_ACQUIRE);
+            if(NULL != str) {
+                return std::string(str, record->SR_Len);
+            }
+        }
     }
-
+    throw crispr::exception(__FILE__, 
+                            __LINE__, 
+                            __PRETTY_FUNCTION__,
+                            "Token not stored");
 }
 
 StringToken StringCheck::getToken(const std::string& queryStr)
 {
     //-----
-    // return the token or 0
+    // return the token or 0. Never takes a lock, a string added by another
+    // thread while we look may or may not be seen
     //
-    if(mS2T_map.end() == mS2T_map.find(queryStr))
+    unsigned int hash = hashString(queryStr.data(), queryStr.length());
+    StringShard * shard = &(mShards[hash >> SC_SHARD_SHIFT]);
+    StringTable * table = __atomic_load_n(&(shard->SS_Table), __ATOMIC_ACQUIRE);
+    if(NULL == table)
         return 0;
-    return mS2T_map[queryStr];
+    StringToken token;
+    findSlot(table, hash, queryStr.data(), queryStr.length(), &token);
+    return token;
 }
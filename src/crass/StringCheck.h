@@ -7,7 +7,10 @@
 // Give this guy a string, get a token, give this guy a token, get a string
 // All token are unique, all strings aren't!
 // 
-// Basically a glorified map
+// Strings live once in a per-shard character arena. Tokens are dense
+// indices into a table of (pointer, length) records so turning a token
+// back into a string never takes a lock. The string -> token index is
+// split into lock-striped shards so several threads can add strings at once
 //
 // --------------------------------------------------------------------
 //  Copyright  2011 Michael Imelfort and Connor Skennerton
@@ -43,8 +46,17 @@
 
 // system includes
 #include <iostream>
-#include <map>
+#include <string>
+#include <vector>
+#include <pthread.h>
 
+#define SC_NUM_SHARDS           (32)                // number of lock stripes in the string -> token index
+#define SC_SHARD_SHIFT          (27)                // top 5 bits of the hash pick the shard
+#define SC_ARENA_FIRST_BLOCK    (256)               // chars in a shard's first arena block
+#define SC_ARENA_BLOCK_SIZE     (65536)             // arena blocks double in size up to this many chars
+#define SC_FIRST_TABLE_SIZE     (16)                // slots in a shard's first index table
+#define SC_RECORD_BASE_SIZE     (64)                // records in the first block of the token table
+#define SC_MAX_RECORD_BLOCKS    (32)                // each record block is twice the size of the last
 
 // typedefs
 typedef int StringToken;
@@ -52,22 +64,59 @@ typedef int StringToken;
 class StringCheck 
 {
     public:
-		StringCheck(std::string name) { mNextFreeToken = 1; mName = name;}  
-		StringCheck(void) { mNextFreeToken = 1; mName = "unset";}  
-        ~StringCheck(void) {}  
+		StringCheck(std::string name) { init(); mName = name;}  
+		StringCheck(void) { init(); mName = "unset";}  
+        ~StringCheck(void);  
         
         StringToken addString(std::string newStr);
-        std::string getString(StringToken token);
-        StringToken getToken(const std::string& queryStr);
+        std::string getString(StringToken token);                  // lock free
+        StringToken getToken(const std::string& queryStr);         // lock free, the newest token or 0
         
         inline void setName(std::string name) { mName = name; }
 
         // members
         StringToken mNextFreeToken;                            // der
-        std::map<StringToken, std::string> mT2S_map;           // token to string map
-        std::map<std::string, StringToken> mS2T_map;           // string to token map
         
         std::string mName;
+    
+    private:
+        typedef struct {
+            const char * SR_Str;                               // start of the string in an arena block
+            unsigned int SR_Len;                               // length of the string
+        } StringRecord;
+    
+        typedef struct {
+            size_t ST_Size;                                    // number of slots, a power of two
+            StringToken * ST_Slots;                            // open addressing table of tokens, 0 is empty
+            unsigned int * ST_Hashes;                          // full hash of the string in each slot
+        } StringTable;
+    
+        typedef struct {
+            pthread_mutex_t SS_Lock;                           // stripe lock, only held for inserts
+            StringTable * SS_Table;                            // current index table, published with a release store
+            std::vector<StringTable *> SS_OldTables;           // tables we grew out of, readers may still be in them
+            unsigned int SS_Used;                              // number of filled slots
+            std::vector<char *> SS_Blocks;                     // arena blocks owned by this shard
+            size_t SS_BlockPos;                                // first free char in the last block
+            size_t SS_BlockSize;                               // size of the last block
+        } StringShard;
+    
+        // no copying, the records point into our own arena
+        StringCheck(const StringCheck&);
+        StringCheck& operator=(const StringCheck&);
+    
+        void init(void);
+        static unsigned int hashString(const char * str, size_t len);
+        StringRecord * recordAt(StringToken token);
+        StringRecord * makeRecord(StringToken token);
+        const char * arenaStore(StringShard * shard, const std::string& str);
+        size_t findSlot(StringTable * table, unsigned int hash, const char * str, size_t len, StringToken * token);
+        void growShard(StringShard * shard);
+        static StringTable * makeTable(size_t size);
+        static void freeTable(StringTable * table);
+    
+        StringShard mShards[SC_NUM_SHARDS];
+        StringRecord * mRecordBlocks[SC_MAX_RECORD_BLOCKS];           // token table, published with a CAS
 };
 
 #endif //StringCheck_h
@@ -0,0 +1,263 @@
+/*
+ *  TokenBitmap.cpp is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+// system includes
+#include <algorithm>
+#include <iterator>
+
+// local includes
+#include "TokenBitmap.h"
+
+// a sorted list takes more room than a bitmap once it gets past this
+#define TB_DENSE_LIMIT  4096
+#define TB_CHUNK_WORDS  1024
+
+namespace {
+    struct ChunkKeyLess {
+        template <class C>
+        bool operator()(const C& chunk, unsigned int key) const { return chunk.key < key; }
+    };
+}
+
+void TokenBitmap::add(StringToken token)
+{
+    unsigned int value = static_cast<unsigned int>(token);
+    if(addToChunk(getChunk(value >> 16), static_cast<unsigned short>(value & 0xffff)))
+    {
+        TB_Size++;
+    }
+}
+
+void TokenBitmap::add(const StringToken * begin, const StringToken * end)
+{
+    for(; begin != end; begin++)
+    {
+        add(*begin);
+    }
+}
+
+bool TokenBitmap::contains(StringToken token) const
+{
+    unsigned int value = static_cast<unsigned int>(token);
+    const Chunk * chunk = findChunk(value >> 16);
+    if(chunk == NULL)
+    {
+        return false;
+    }
+    unsigned short low = static_cast<unsigned short>(value & 0xffff);
+    if(!chunk->bits.empty())
+    {
+        return (chunk->bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(chunk->values.begin(), chunk->values.end(), low);
+}
+
+TokenBitmap& TokenBitmap::operator|=(const TokenBitmap& other)
+{
+    //-----
+    // Union chunk by chunk. Two lists are merged, anything to do with a
+    // bitmap is done a word at a time
+    //
+    if(this == &other)
+    {
+        return *this;
+    }
+    std::vector<Chunk>::const_iterator other_iter;
+    for(other_iter = other.TB_Chunks.begin(); other_iter != other.TB_Chunks.end(); other_iter++)
+    {
+        Chunk& chunk = getChunk(other_iter->key);
+        TB_Size -= chunk.size;
+        if(chunk.bits.empty() && other_iter->bits.empty())
+        {
+            std::vector<unsigned short> merged;
+            merged.reserve(chunk.values.size() + other_iter->values.size());
+            std::set_union(chunk.values.begin(), chunk.values.end(),
+                           other_iter->values.begin(), other_iter->values.end(),
+                           std::back_inserter(merged));
+            chunk.values.swap(merged);
+            chunk.size = chunk.values.size();
+            if(chunk.size > TB_DENSE_LIMIT)
+            {
+                makeDense(chunk);
+            }
+        }
+        else
+        {
+            if(chunk.bits.empty())
+            {
+                makeDense(chunk);
+            }
+            if(other_iter->bits.empty())
+            {
+                std::vector<unsigned short>::const_iterator value_iter;
+                for(value_iter = other_iter->values.begin(); value_iter != other_iter->values.end(); value_iter++)
+                {
+                    chunk.bits[*value_iter >> 6] |= static_cast<uint64_t>(1) << (*value_iter & 63);
+                }
+            }
+            else
+            {
+                for(int i = 0; i < TB_CHUNK_WORDS; i++)
+                {
+                    chunk.bits[i] |= other_iter->bits[i];
+                }
+            }
+            chunk.size = 0;
+            for(int i = 0; i < TB_CHUNK_WORDS; i++)
+            {
+                for(uint64_t word = chunk.bits[i]; word != 0; word &= word - 1)
+                {
+                    chunk.size++;
+                }
+            }
+        }
+        TB_Size += chunk.size;
+    }
+    return *this;
+}
+
+void TokenBitmap::getTokens(std::vector<StringToken>& tokens) const
+{
+    tokens.reserve(tokens.size() + TB_Size);
+    std::vector<Chunk>::const_iterator chunk_iter;
+    for(chunk_iter = TB_Chunks.begin(); chunk_iter != TB_Chunks.end(); chunk_iter++)
+    {
+        unsigned int high = chunk_iter->key << 16;
+        if(chunk_iter->bits.empty())
+        {
+            std::vector<unsigned short>::const_iterator value_iter;
+            for(value_iter = chunk_iter->values.begin(); value_iter != chunk_iter->values.end(); value_iter++)
+            {
+                tokens.push_back(static_cast<StringToken>(high | *value_iter));
+            }
+            continue;
+        }
+        for(int i = 0; i < TB_CHUNK_WORDS; i++)
+        {
+            uint64_t word = chunk_iter->bits[i];
+            for(int bit = 0; word != 0; bit++, word >>= 1)
+            {
+                if(word & 1)
+                {
+                    tokens.push_back(static_cast<StringToken>(high | (i << 6) | bit));
+                }
+            }
+        }
+    }
+}
+
+void TokenBitmap::clear(void)
+{
+    std::vector<Chunk>().swap(TB_Chunks);
+    TB_Size = 0;
+}
+
+TokenBitmap::Chunk& TokenBitmap::getChunk(unsigned int key)
+{
+    // tokens mostly turn up in order so the new chunk usually goes last
+    if(TB_Chunks.empty() || TB_Chunks.back().key < key)
+    {
+        TB_Chunks.push_back(Chunk());
+        TB_Chunks.back().key = key;
+        TB_Chunks.back().size = 0;
+        return TB_Chunks.back();
+    }
+    std::vector<Chunk>::iterator chunk_iter = std::lower_bound(TB_Chunks.begin(), TB_Chunks.end(), key, ChunkKeyLess());
+    if(chunk_iter->key != key)
+    {
+        Chunk chunk;
+        chunk.key = key;
+        chunk.size = 0;
+        chunk_iter = TB_Chunks.insert(chunk_iter, chunk);
+    }
+    return *chunk_iter;
+}
+
+const TokenBitmap::Chunk * TokenBitmap::findChunk(unsigned int key) const
+{
+    std::vector<Chunk>::const_iterator chunk_iter = std::lower_bound(TB_Chunks.begin(), TB_Chunks.end(), key, ChunkKeyLess());
+    if(chunk_iter == TB_Chunks.end() || chunk_iter->key != key)
+    {
+        return NULL;
+    }
+    return &(*chunk_iter);
+}
+
+bool TokenBitmap::addToChunk(Chunk& chunk, unsigned short low)
+{
+    //-----
+    // Put the low bits into the chunk, true if they weren't already there
+    //
+    if(!chunk.bits.empty())
+    {
+        uint64_t mask = static_cast<uint64_t>(1) << (low & 63);
+        if(chunk.bits[low >> 6] & mask)
+        {
+            return false;
+        }
+        chunk.bits[low >> 6] |= mask;
+        chunk.size++;
+        return true;
+    }
+    if(chunk.values.empty() || chunk.values.back() < low)
+    {
+        chunk.values.push_back(low);
+    }
+    else
+    {
+        std::vector<unsigned short>::iterator value_iter = std::lower_bound(chunk.values.begin(), chunk.values.end(), low);
+        if(*value_iter == low)
+        {
+            return false;
+        }
+        chunk.values.insert(value_iter, low);
+    }
+    chunk.size++;
+    if(chunk.size > TB_DENSE_LIMIT)
+    {
+        makeDense(chunk);
+    }
+    return true;
+}
+
+void TokenBitmap::makeDense(Chunk& chunk)
+{
+    chunk.bits.assign(TB_CHUNK_WORDS, 0);
+    std::vector<unsigned short>::iterator value_iter;
+    for(value_iter = chunk.values.begin(); value_iter != chunk.values.end(); value_iter++)
+    {
+        chunk.bits[*value_iter >> 6] |= static_cast<uint64_t>(1) << (*value_iter & 63);
+    }
+    std::vector<unsigned short>().swap(chunk.values);
+}
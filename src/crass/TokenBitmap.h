@@ -0,0 +1,89 @@
+/*
+ *  TokenBitmap.h is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+#ifndef crass_TokenBitmap_h
+#define crass_TokenBitmap_h
+
+// system includes
+#include <vector>
+#include <stdint.h>
+
+// local includes
+#include "StringCheck.h"
+
+// A set of string tokens kept as a compressed bitmap. Tokens are split up
+// into chunks of 65536 by their high bits, a chunk holds its low bits as a
+// sorted list while it is sparse and as a plain bitmap once it fills up.
+// Reads make up only a few of the tokens in a manager so the lists are the
+// usual case, but unions and counts stay cheap either way
+class TokenBitmap {
+public:
+    TokenBitmap(void): TB_Size(0) {}
+
+    void add(StringToken token);
+
+    // add a whole run of tokens, they don't need to be sorted
+    void add(const StringToken * begin, const StringToken * end);
+
+    bool contains(StringToken token) const;
+
+    TokenBitmap& operator|=(const TokenBitmap& other);
+
+    // how many different tokens are in the set
+    inline size_t size(void) const { return TB_Size; }
+    inline bool empty(void) const { return TB_Size == 0; }
+
+    // every token in the set, smallest first
+    void getTokens(std::vector<StringToken>& tokens) const;
+
+    void clear(void);
+
+private:
+    struct Chunk {
+        unsigned int key;                       // the high bits of every token in the chunk
+        size_t size;                            // how many tokens are in the chunk
+        std::vector<unsigned short> values;     // sorted low bits while the chunk is sparse
+        std::vector<uint64_t> bits;             // the low bits as a bitmap once it is dense
+    };
+
+    Chunk& getChunk(unsigned int key);
+    const Chunk * findChunk(unsigned int key) const;
+    static bool addToChunk(Chunk& chunk, unsigned short low);
+    static void makeDense(Chunk& chunk);
+
+    std::vector<Chunk> TB_Chunks;               // sorted by key
+    size_t TB_Size;
+};
+
+#endif
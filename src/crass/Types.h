@@ -37,6 +37,13 @@
 #include <map>
 #include <vector>
 #include <string>
+#if __cplusplus >= 201103L
+#include <unordered_map>
+#define CRASS_HASH_MAP std::unordered_map
+#else
+#include <tr1/unordered_map>
+#define CRASS_HASH_MAP std::tr1::unordered_map
+#endif
 #include "ReadHolder.h"
 #include "StringCheck.h"
 
@@ -66,6 +73,9 @@ typedef std::map<int, DR_Cluster *> DR_Cluster_Map;
 
 typedef std::map<int, std::map<std::string, int> * > GroupKmerMap;
 
+typedef CRASS_HASH_MAP<std::string, int> TrueDR_Index;
+typedef CRASS_HASH_MAP<std::string, int>::iterator TrueDR_IndexIterator;
+
 typedef std::vector<std::string> Vecstr;
 
 #endif
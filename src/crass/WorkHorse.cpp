@@ -48,6 +48,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <ctime>
+#include <sys/time.h>
 #include "StlExt.h"
 #include "Exception.h"
 
@@ -63,6 +64,15 @@
 #include "StringCheck.h"
 #include "config.h"
 #include "ksw.h"
+#include "Checkpoint.h"
+
+// wall clock seconds, for timing the graph stages
+static double graphTimer(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec + now.tv_usec / 1e6;
+}
 
 bool sortLengthDecending( const std::string& a, const std::string& b)
 {
@@ -183,21 +193,52 @@ int WorkHorse::doWork(Vecstr seqFiles)
     // wrapper for the various processes needed to assemble crisprs
     //
     
-
+    // the checkpoint and the cluster index both carry this so a later run
+    // can tell they go together
+    mRunID = mTimeStamp + "." + to_string(getpid());
     
-	logInfo("Parsing reads in " << (seqFiles.size()) << " files", 1);
-	if(parseSeqFiles(seqFiles))
-	{
-		logError("FATAL ERROR: parseSeqFiles failed");
-        return 2;
-	}
+    if(mOpts->fromGraphSnapshots)
+    {
+        // the groups come ready made, there's no searching to do
+        logInfo("Loading " << (seqFiles.size()) << " graph snapshots", 1);
+        if(loadGraphSnapshots(seqFiles))
+        {
+            logError("FATAL ERROR: loadGraphSnapshots failed");
+            return 2;
+        }
+    }
+    else
+    {
+        logInfo("Parsing reads in " << (seqFiles.size()) << " files", 1);
+        if(parseSeqFiles(seqFiles))
+        {
+            logError("FATAL ERROR: parseSeqFiles failed");
+            return 2;
+        }
+    }
 
-    // build the spacer end graph
-    if(buildGraph())
+    // build, clean and split the graphs of every group, each one is
+    // printed as soon as it's done
+    if(openOutput())
+    {
+        logError("FATAL ERROR: openOutput failed");
+        return 3;
+    }
+    if(assembleGroups())
     {
-        logError("FATAL ERROR: buildGraph failed");
+        logError("FATAL ERROR: assembleGroups failed");
         return 3;
     }
+    
+    if(!mOpts->fromGraphSnapshots && !mOpts->graphSnapshots.empty() && !mOpts->checkpointFile.empty())
+    {
+        try {
+            writeClusterIndex();
+        } catch (crispr::exception& e) {
+            std::cerr<<e.what()<<std::endl;
+            return 3;
+        }
+    }
 #ifdef SEARCH_SINGLETON
     std::ofstream debug_out;
     std::stringstream debug_out_file_name;
@@ -230,61 +271,6 @@ int WorkHorse::doWork(Vecstr seqFiles)
     }
 #endif
 	
-#if DEBUG
-	if (!mOpts->noDebugGraph) // this option will only exist if DEBUG is set anyway
-    {
-        // print debug graphs
-        if(renderDebugGraphs())
-        {
-            logError("FATAL ERROR: renderDebugGraphs failed");
-            return 4;
-        }
-    }
-
-#endif
-	
-	// clean each spacer end graph
-	if(cleanGraph())
-	{
-        logError("FATAL ERROR: cleanGraph failed");
-        return 5;
-	}
-    
-	// make spacer graphs
-	if(makeSpacerGraphs())
-	{
-        logError("FATAL ERROR: makeSpacerGraphs failed");
-        return 50;
-	}
-	
-	// clean spacer graphs
-	if(cleanSpacerGraphs())
-	{
-        logError("FATAL ERROR: cleanSpacerGraphs failed");
-        return 51;
-	}
-	
-	// make contigs
-	if(splitIntoContigs())
-	{
-        logError("FATAL ERROR: splitIntoContigs failed");
-        return 6;
-	}
-    // call flanking regions
-    if (generateFlankers()) {
-        logError("FATAL ERROR: generateFlankers failed");
-        return 70;
-    }
-    
-    //remove NodeManagers with low numbers of spacers
-    // and where the standard deviation of the spacer length 
-    // is too high
-    if (removeLowConfidenceNodeManagers())
-    {
-        logError("FATAL ERROR: removeLowSpacerNodeManagers failed");
-        return 7;
-    }
-	
     // print the reads to a file if requested
 //	if(dumpReads(false))
 //	{
@@ -292,18 +278,6 @@ int WorkHorse::doWork(Vecstr seqFiles)
 //        return 9;
 //	}
 	
-#if DEBUG
-	if (!mOpts->noDebugGraph) 
-    {
-        // print clean graphs
-        if(renderDebugGraphs("Clean_"))
-        {
-            logError("FATAL ERROR: renderDebugGraphs failed");
-            return 10;
-        }
-    }
-
-#endif
     
 	// print spacer graphs
 //	if(renderSpacerGraphs())
@@ -312,7 +286,11 @@ int WorkHorse::doWork(Vecstr seqFiles)
 //        return 11;
 //	}
 	
-	outputResults();
+	if(closeOutput())
+	{
+        logError("FATAL ERROR: closeOutput failed");
+        return 4;
+	}
 	
     logInfo("all done!", 1);
 	return 0;
@@ -323,6 +301,10 @@ int WorkHorse::parseSeqFiles(Vecstr seqFiles)
 	//-----
 	// Load data from files and search for DRs
 	//
+	// When resuming, everything an earlier run found is loaded from its
+	// checkpoint and only the files given this time are searched, on top
+	// of what was already there
+	//
     Vecstr::iterator seq_iter = seqFiles.begin();
     
     // direct repeat sequence and unique ID
@@ -330,7 +312,32 @@ int WorkHorse::parseSeqFiles(Vecstr seqFiles)
     
     // the sequence of whole spacers and their unique ID
     lookupTable reads_found;
-
+    
+    GroupKmerMap group_kmer_counts_map;
+    int next_free_GID = 1;
+    
+    if (!mOpts->resumeFrom.empty()) 
+    {
+        try {
+            std::string resumed_run_ID;
+            readSearchCheckpoint(mOpts->resumeFrom, reads_found, resumed_run_ID);
+            readClusterIndex(resumed_run_ID);
+        } catch (crispr::exception& e) {
+            std::cerr<<e.what()<<std::endl;
+            return 1;
+        }
+        std::cout<<"["<<PACKAGE_NAME<<"_patternFinder]: "<<"Loaded "<<numOfReads()<<" reads"<<std::endl;
+    } 
+    
+    // a DR that was only seen in singletons before gets clustered like
+    // any other once the search turns it up
+    std::map<StringToken, size_t> singleton_reads;
+    std::set<StringToken>::iterator singleton_iter;
+    for (singleton_iter = mSingletonDRs.begin(); singleton_iter != mSingletonDRs.end(); singleton_iter++) 
+    {
+        singleton_reads[*singleton_iter] = mReads[*singleton_iter]->size();
+    }
+    
     time_t start_time;
     time(&start_time);
     while(seq_iter != seqFiles.end())
@@ -364,13 +371,28 @@ int WorkHorse::parseSeqFiles(Vecstr seqFiles)
     }
     // add in a new line so the looger won't overlap itself
     std::cout<<std::endl;
+    
+    std::map<StringToken, size_t>::iterator sr_iter;
+    for (sr_iter = singleton_reads.begin(); sr_iter != singleton_reads.end(); sr_iter++) 
+    {
+        if (mReads[sr_iter->first]->size() != sr_iter->second) 
+        {
+            mSingletonDRs.erase(sr_iter->first);
+        }
+    }
 
-    GroupKmerMap group_kmer_counts_map;
-    int next_free_GID = 1;
-    Vecstr * non_redundant_set = createNonRedundantSet(group_kmer_counts_map, next_free_GID);
+    Vecstr * non_redundant_set = createNonRedundantSet(group_kmer_counts_map, next_free_GID, mSingletonDRs);
     logInfo("Number of reads found so far: "<<this->numOfReads(), 2);
 
-    if (non_redundant_set->size() > 0) 
+    // any DRs that aren't in here by the end only turned up while recruiting singletons
+    std::vector<StringToken> searched_DRs;
+    ReadMapIterator read_map_iter;
+    for (read_map_iter = mReads.begin(); read_map_iter != mReads.end(); read_map_iter++) 
+    {
+        searched_DRs.push_back(read_map_iter->first);
+    }
+    
+    if (non_redundant_set->size() > 0 && !seqFiles.empty()) 
     {
         std::cout<<"["<<PACKAGE_NAME<<"_clusterCore]: " << non_redundant_set->size() << " non-redundant patterns."<<std::endl;
         seq_iter = seqFiles.begin();
@@ -391,12 +413,32 @@ int WorkHorse::parseSeqFiles(Vecstr seqFiles)
             }
             seq_iter++;
         }
+        // add in a new line so the ouptut won't overlap itself
+        std::cout<<std::endl;
     }
-    // add in a new line so the ouptut won't overlap itself
-    std::cout<<std::endl;
     delete non_redundant_set;
+    
+    // they're left out of the clustering in any later run too
+    for (read_map_iter = mReads.begin(); read_map_iter != mReads.end(); read_map_iter++) 
+    {
+        if (!std::binary_search(searched_DRs.begin(), searched_DRs.end(), read_map_iter->first)) 
+        {
+            mSingletonDRs.insert(read_map_iter->first);
+        }
+    }
+    
     std::cout<<"["<<PACKAGE_NAME<<"_patternFinder]: "<<"Found "<<numOfReads()<<" reads"<<std::endl;
     logInfo("Searching complete. " << mReads.size()<<" direct repeat variants have been found", 1);
+    
+    if (!mOpts->checkpointFile.empty()) 
+    {
+        try {
+            writeSearchCheckpoint(mOpts->checkpointFile, reads_found);
+        } catch (crispr::exception& e) {
+            std::cerr<<e.what()<<std::endl;
+            return 1;
+        }
+    }
     logInfo("Number of reads found so far: "<<this->numOfReads(), 2);
 
     try {
@@ -413,202 +455,1113 @@ int WorkHorse::parseSeqFiles(Vecstr seqFiles)
     return 0;
 }
 
-void WorkHorse::combineGroupsWithIdenticalDRs()
+void WorkHorse::writeSearchCheckpoint(std::string fileName, lookupTable& readsFound)
 {
-    //----
-    // After parseGroupedDRs there will be occasions where the final true DR
-    // is identical between different groups. Here we explicently check for
-    // this and combine the groups as necessary
-    std::map<std::string, int> truedr_to_group;
-
-    std::map<int, std::string>::iterator iter = mTrueDRs.begin();
-    while(iter != mTrueDRs.end())
+    //-----
+    // Save the reads, the strings and what else the search leaves behind so
+    // that the clustering and everything after it can be rerun, or more
+    // files searched, without going through the sequence files again. The
+    // strings go in token order so that adding them back in gives them the
+    // same tokens
+    //
+    logInfo("Writing search checkpoint to " << fileName, 1);
+    CheckpointWriter out(fileName, CRASS_DEF_SEARCH_CHECKPOINT_KIND, CRASS_DEF_SEARCH_CHECKPOINT_VERSION);
+    out.writeString(mRunID);
+    
+    // the options that changed what the search found
+    out.writeUInt(mOpts->lowDRsize);
+    out.writeUInt(mOpts->highDRsize);
+    out.writeUInt(mOpts->lowSpacerSize);
+    out.writeUInt(mOpts->highSpacerSize);
+    out.writeUInt(mOpts->searchWindowLength);
+    out.writeUInt(mOpts->minNumRepeats);
+    
+    out.writeInt(mMaxReadLength);
+    
+    StringToken last_token = mStringCheck.mNextFreeToken;
+    out.writeInt(last_token);
+    for (StringToken token = 2; token <= last_token; token++) 
     {
-        std::map<std::string, int>::iterator prev_iter = truedr_to_group.find(iter->second);
-        if(prev_iter != truedr_to_group.end())
-        {
-            // this true DR has already been identified
-            logInfo("Combining groups "<<iter->first<<" ("<<iter->second<<") and "<<prev_iter->second << " ("<<prev_iter->first<<") as they are identical",4);
-            // combine the DR2GID_map
-            DR_ClusterIterator drc_iter;
-            for(drc_iter = mDR2GIDMap[iter->first]->begin(); drc_iter != mDR2GIDMap[iter->first]->end(); ++drc_iter)
-            {
-                logInfo(*drc_iter, 1);
-                mDR2GIDMap[prev_iter->second]->push_back(*drc_iter);
-            }
-            
-            // delete the references to this group in DR2GID_map
-            delete mDR2GIDMap[iter->first];
-            mDR2GIDMap.erase(iter->first);
-            // remove the reference in the true DRs
-            mTrueDRs.erase(iter++);
-        }
-        else
+        out.writeString(mStringCheck.getString(token));
+    }
+    
+    out.writeSize(mSingletonDRs.size());
+    std::set<StringToken>::iterator singleton_iter;
+    for (singleton_iter = mSingletonDRs.begin(); singleton_iter != mSingletonDRs.end(); singleton_iter++) 
+    {
+        out.writeInt(*singleton_iter);
+    }
+    
+    out.writeSize(readsFound.size());
+    lookupTable::iterator found_iter;
+    for (found_iter = readsFound.begin(); found_iter != readsFound.end(); found_iter++) 
+    {
+        out.writeString(found_iter->first);
+        out.writeBool(found_iter->second);
+    }
+    
+    out.writeSize(mReads.size());
+    ReadMapIterator read_map_iter;
+    for (read_map_iter = mReads.begin(); read_map_iter != mReads.end(); read_map_iter++) 
+    {
+        out.writeInt(read_map_iter->first);
+        out.writeSize(read_map_iter->second->size());
+        ReadListIterator read_iter;
+        for (read_iter = read_map_iter->second->begin(); read_iter != read_map_iter->second->end(); read_iter++) 
         {
-            truedr_to_group[iter->second] = iter->first;
-            ++iter;
+            (*read_iter)->writeCheckpoint(out);
         }
     }
+    out.close();
 }
 
-int WorkHorse::buildGraph(void)
+void WorkHorse::readSearchCheckpoint(std::string fileName, lookupTable& readsFound, std::string& runID)
 {
-	//-----
-	// Load the spacers into a graph
-	//
-    // go through the DR2GID_map and make all reads in each group into nodes
+    logInfo("Loading search checkpoint from " << fileName, 1);
+    CheckpointReader in(fileName, CRASS_DEF_SEARCH_CHECKPOINT_KIND, CRASS_DEF_SEARCH_CHECKPOINT_VERSION);
+    runID = in.readString();
     
-    DR_Cluster_MapIterator drg_iter = mDR2GIDMap.begin();
-    //std::cout<<'['<<PACKAGE_NAME<<"_graphBuilder]: "<<mTrueDRs.size()<<" putative CRISPRs found!"<<std::endl;
-    //MI std::cout<<'['<<PACKAGE_NAME<<"_graphBuilder]: "<<std::flush;
-    while(drg_iter != mDR2GIDMap.end())
+    unsigned int search_options[6];
+    for (int i = 0; i < 6; i++) 
     {
-        if(NULL != drg_iter->second)
-        {            
-#ifdef DEBUG
-            logInfo("Creating NodeManager "<<drg_iter->first, 6);
-#endif
-            //MI std::cout<<'['<<drg_iter->first<<','<<mTrueDRs[drg_iter->first]<<std::flush;
-            mDRs[mTrueDRs[drg_iter->first]] = new NodeManager(mTrueDRs[drg_iter->first], mOpts);
-            //MI std::cout<<'.'<<std::flush;
-            DR_ClusterIterator drc_iter = (drg_iter->second)->begin();
-            while(drc_iter != (drg_iter->second)->end())
-            {
-                // go through each read
-            	//MI std::cout<<'|'<<std::flush;
-                ReadListIterator read_iter = mReads[*drc_iter]->begin();
-                while (read_iter != mReads[*drc_iter]->end()) 
-                {
-                    if(*read_iter == NULL) {
-                        logError("Read is set to null");
-                    }
-                    //MI std::cout<<'.'<<std::flush;
-#ifdef SEARCH_SINGLETON
-                    SearchCheckerList::iterator debug_iter = debugger->find((*read_iter)->getHeader());
-                    if (debug_iter != debugger->end()) {
-                        //found one of our interesting reads
-                        // add in the true DR
-                        debug_iter->second.truedr(mTrueDRs[drg_iter->first]);
-                        debug_iter->second.gid(drg_iter->first);
-                    }
-#endif
-                    mDRs[mTrueDRs[drg_iter->first]]->addReadHolder(*read_iter);
-                    read_iter++;
-                }
-                drc_iter++;
-            }
-            //MI std::cout<<"],"<<std::flush;
+        search_options[i] = in.readUInt();
+    }
+    if (search_options[0] != mOpts->lowDRsize || 
+        search_options[1] != mOpts->highDRsize || 
+        search_options[2] != mOpts->lowSpacerSize || 
+        search_options[3] != mOpts->highSpacerSize || 
+        search_options[4] != mOpts->searchWindowLength || 
+        search_options[5] != mOpts->minNumRepeats) 
+    {
+        // the reads it found would not be the reads these options find
+        std::stringstream ss;
+        ss<<"The search in "<<fileName<<" was run with different DR, spacer, window or repeat options ("
+          <<search_options[0]<<"-"<<search_options[1]<<", "
+          <<search_options[2]<<"-"<<search_options[3]<<", "
+          <<search_options[4]<<", "<<search_options[5]<<"), resume with those or search the reads again";
+        throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ss);
+    }
+    
+    mMaxReadLength = in.readInt();
+    
+    StringToken last_token = in.readInt();
+    for (StringToken token = 2; token <= last_token; token++) 
+    {
+        mStringCheck.addString(in.readString());
+    }
+    
+    uint64_t singleton_count = in.readSize();
+    for (uint64_t i = 0; i < singleton_count; i++) 
+    {
+        mSingletonDRs.insert(in.readInt());
+    }
+    
+    uint64_t found_count = in.readSize();
+    for (uint64_t i = 0; i < found_count; i++) 
+    {
+        std::string header = in.readString();
+        readsFound[header] = in.readBool();
+    }
+    
+    uint64_t dr_count = in.readSize();
+    for (uint64_t i = 0; i < dr_count; i++) 
+    {
+        StringToken dr_token = in.readInt();
+        uint64_t read_count = in.readSize();
+        ReadList * reads = new ReadList();
+        mReads[dr_token] = reads;
+        reads->reserve(read_count);
+        for (uint64_t j = 0; j < read_count; j++) 
+        {
+            ReadHolder * read = new ReadHolder();
+            reads->push_back(read);
+            read->readCheckpoint(in);
         }
-        drg_iter++;
     }
-    //MI std::cout<<std::endl;
+    if (!in.atEnd()) 
+    {
+        throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ("There is more in the checkpoint file " + fileName + " than there should be").c_str());
+    }
+}
+
+int WorkHorse::writeGraphSnapshot(int GID, NodeManager * manager, int nextStage)
+{
+    //-----
+    // Save the group's graph so that it can be loaded back in with
+    // --fromGraphSnapshots and picked up again from nextStage. Each group
+    // gets its own file so they can be rerun separately
+    //
+    if(mOpts->graphSnapshots.empty())
+    {
+        return 0;
+    }
+    std::string file_name = mOpts->graphSnapshots + "Group_" + to_string(GID) + "_" + mTrueDRs.find(GID)->second + ((nextStage == WH_CLEAN_GRAPH) ? ".built" : ".cleaned") + CRASS_DEF_GRAPH_SNAPSHOT_EXT;
+    logInfo("Writing graph snapshot for group " << GID << " to " << file_name, 3);
+    try {
+        CheckpointWriter out(file_name, CRASS_DEF_GRAPH_SNAPSHOT_KIND, CRASS_DEF_GRAPH_SNAPSHOT_VERSION);
+        out.writeInt(GID);
+        out.writeInt(nextStage);
+        out.writeString(mTrueDRs.find(GID)->second);
+        manager->writeCheckpoint(out);
+        out.close();
+        mSnapshotFiles.find(GID)->second = file_name;
+    } catch (crispr::exception& e) {
+        std::cerr<<e.what()<<std::endl;
+        return 1;
+    }
     return 0;
 }
 
-int WorkHorse::cleanGraph(void)
+int WorkHorse::loadGraphSnapshots(Vecstr snapshotFiles)
 {
-	//-----
-	// Wrapper for graph cleaning
-	//
-	logInfo("Cleaning graphs", 1);
-	DR_Cluster_MapIterator drg_iter = mDR2GIDMap.begin();
-	while(drg_iter != mDR2GIDMap.end())
-	{
-		if(NULL != drg_iter->second)
-		{            
-#ifdef DEBUG
-            if (NULL == mDRs[mTrueDRs[drg_iter->first]])
+    //-----
+    // Make a group for each snapshot with the manager already filled in.
+    // The groups have no DRs of their own, everything they need came with
+    // the snapshot
+    //
+    Vecstr::iterator file_iter;
+    for(file_iter = snapshotFiles.begin(); file_iter != snapshotFiles.end(); file_iter++)
+    {
+        NodeManager * manager = NULL;
+        try {
+            CheckpointReader in(*file_iter, CRASS_DEF_GRAPH_SNAPSHOT_KIND, CRASS_DEF_GRAPH_SNAPSHOT_VERSION);
+            int GID = in.readInt();
+            int next_stage = in.readInt();
+            std::string true_dr = in.readString();
+            if(next_stage != WH_CLEAN_GRAPH && next_stage != WH_BUILD_SPACER_GRAPH)
             {
-                logWarn("Before Clean Graph: NodeManager "<<drg_iter->first<<" is NULL",6);
+                throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ("The snapshot " + *file_iter + " doesn't start at a stage that can be picked up").c_str());
             }
-            else
+            if(mTrueDRs.find(GID) != mTrueDRs.end() || mDRs.find(true_dr) != mDRs.end())
             {
-#endif
-                if((mDRs[mTrueDRs[drg_iter->first]])->cleanGraph())
-                {
-                    return 1;
-                }
-#ifdef DEBUG
+                logWarn("Skipping "<<*file_iter<<" as group "<<GID<<" or its direct repeat has already been loaded", 1);
+                continue;
             }
-            if (NULL == mDRs[mTrueDRs[drg_iter->first]])
+            manager = new NodeManager(true_dr, mOpts);
+            manager->readCheckpoint(in);
+            if(!in.atEnd())
             {
-                logWarn("After Clean Graph: NodeManager "<<drg_iter->first<<" is NULL",6);
+                throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ("There is more in the snapshot " + *file_iter + " than there should be").c_str());
             }
-#endif
-		}
-		drg_iter++;
-	}
-	return 0;
+            logInfo("Loaded group "<<GID<<" with "<<manager->getReadCount()<<" reads from "<<*file_iter, 1);
+            mTrueDRs[GID] = true_dr;
+            mDR2GIDMap[GID] = new DR_Cluster();
+            mGroupMap[GID] = true;
+            mDRs[true_dr] = manager;
+            mFirstStages[GID] = next_stage;
+        } catch (crispr::exception& e) {
+            delete manager;
+            std::cerr<<e.what()<<std::endl;
+            return 1;
+        }
+    }
+    return 0;
 }
 
-int WorkHorse::removeLowConfidenceNodeManagers(void)
+void WorkHorse::indexTrueDR(int GID)
 {
-    logInfo("Removing CRISPRs with low numbers of spacers", 1);
-	int counter = 0;
-    DR_Cluster_MapIterator drg_iter = mDR2GIDMap.begin();
-	while(drg_iter != mDR2GIDMap.end())
-	{
-		if(NULL != drg_iter->second)
-		{            
-            if (NULL != mDRs[mTrueDRs[drg_iter->first]])
-            {
-                NodeManager * current_manager = mDRs[mTrueDRs[drg_iter->first]];
-                if( current_manager->getSpacerCountAndStats(false) < mOpts->covCutoff) 
-                {
-                    logInfo("Deleting NodeManager "<<drg_iter->first<<" as it contained less than "<<mOpts->covCutoff<<" attached spacers",5);
-                    delete mDRs[mTrueDRs[drg_iter->first]];
-                     mDRs[mTrueDRs[drg_iter->first]] = NULL;
-                } else if (current_manager->stdevSpacerLength() > CRASS_DEF_STDEV_SPACER_LENGTH) {
-                    logInfo("Deleting NodeManager "<<drg_iter->first<<" as the stdev ("<<current_manager->stdevSpacerLength()<<") of the spacer lengths was greater than "<<CRASS_DEF_STDEV_SPACER_LENGTH, 4);
-                    delete mDRs[mTrueDRs[drg_iter->first]];
-                     mDRs[mTrueDRs[drg_iter->first]] = NULL;
-                }
-                counter++;
-            }
-		}
-		drg_iter++;
-	}
-    //std::cout<<'['<<PACKAGE_NAME<<"_graphBuilder]: "<<counter<<" putative CRISPRs have passed all checks"<<std::endl;
-	return 0;
+    //----
+    // Called as soon as a group's true DR is finalised. Keep track of which
+    // group owns each true DR so that identical groups can be found without
+    // rescanning mTrueDRs. The group with the lowest GID always owns the DR
+    std::pair<TrueDR_IndexIterator, bool> ins = mTrueDRIndex.insert(std::make_pair(mTrueDRs[GID], GID));
+    if(! ins.second)
+    {
+        if(GID < ins.first->second)
+        {
+            mIdenticalDRGroups.push_back(ins.first->second);
+            ins.first->second = GID;
+        }
+        else
+        {
+            mIdenticalDRGroups.push_back(GID);
+        }
+    }
 }
 
-//**************************************
-// Functions used to cluster DRs into groups and identify the "true" DR
-//**************************************
-int WorkHorse::findConsensusDRs(GroupKmerMap& groupKmerCountsMap, int& nextFreeGID)
+void WorkHorse::combineGroupsWithIdenticalDRs()
 {
-    //-----
-    // Cluster potential DRs and work out their true sequences
-    // make the node managers while we're at it!
-    //
-
-    logInfo("Reducing list of potential DRs (2): Cluster refinement and true DR finding", 1);
-    
-    // go through all the counts for each group
-    GroupKmerMap::iterator group_count_iter; 
-    for(group_count_iter =  groupKmerCountsMap.begin(); 
-        group_count_iter != groupKmerCountsMap.end(); 
-        group_count_iter++)
+    //----
+    // After parseGroupedDRs there will be occasions where the final true DR
+    // is identical between different groups. indexTrueDR has recorded these
+    // as they came up, so here we combine them all in one go. Merged groups are
+    // never parsed again so doing this once at the end is the same as doing it
+    // after every group
+    std::sort(mIdenticalDRGroups.begin(), mIdenticalDRGroups.end());
+    std::vector<int>::iterator iter;
+    for(iter = mIdenticalDRGroups.begin(); iter != mIdenticalDRGroups.end(); ++iter)
     {
-        if(NULL == mDR2GIDMap[group_count_iter->first])
+        std::map<int, std::string>::iterator tdr_iter = mTrueDRs.find(*iter);
+        if(tdr_iter == mTrueDRs.end())
         {
             continue;
         }
-#ifdef DEBUG
-        logInfo(__FILE__ <<":"<<__LINE__<<" checking for null "<< mDR2GIDMap[group_count_iter->first], 6)
-#endif
-        parseGroupedDRs(group_count_iter->first, &nextFreeGID);
-        combineGroupsWithIdenticalDRs();
-        // delete the kmer count lists cause we're finsihed with them now
-        if(NULL != group_count_iter->second)
+        int owner_GID = mTrueDRIndex[tdr_iter->second];
+        
+        // this true DR has already been identified
+        logInfo("Combining groups "<<*iter<<" ("<<tdr_iter->second<<") and "<<owner_GID << " ("<<tdr_iter->second<<") as they are identical",4);
+        // combine the DR2GID_map
+        DR_ClusterIterator drc_iter;
+        for(drc_iter = mDR2GIDMap[*iter]->begin(); drc_iter != mDR2GIDMap[*iter]->end(); ++drc_iter)
+        {
+            logInfo(*drc_iter, 1);
+            mDR2GIDMap[owner_GID]->push_back(*drc_iter);
+        }
+        
+        // delete the references to this group in DR2GID_map
+        delete mDR2GIDMap[*iter];
+        mDR2GIDMap.erase(*iter);
+        // remove the reference in the true DRs
+        mTrueDRs.erase(tdr_iter);
+    }
+    mIdenticalDRGroups.clear();
+}
+
+GroupOutputQueue::GroupOutputQueue(WorkHorse * workHorse, size_t groups):
+    GOQ_WorkHorse(workHorse),
+    GOQ_Outputs(groups),
+    GOQ_Finished(groups, false),
+    GOQ_Next(0),
+    GOQ_Appending(false)
+{
+    pthread_mutex_init(&GOQ_Lock, NULL);
+}
+
+GroupOutputQueue::~GroupOutputQueue(void)
+{
+    pthread_mutex_destroy(&GOQ_Lock);
+}
+
+void GroupOutputQueue::finished(size_t index, GroupOutput * output)
+{
+    pthread_mutex_lock(&GOQ_Lock);
+    if (NULL != output) {
+        std::swap(GOQ_Outputs[index], *output);
+    }
+    GOQ_Finished[index] = true;
+    if (GOQ_Appending) {
+        // whoever is appending picks it up when they get to it
+        pthread_mutex_unlock(&GOQ_Lock);
+        return;
+    }
+    GOQ_Appending = true;
+    while (GOQ_Next < GOQ_Outputs.size() && GOQ_Finished[GOQ_Next]) {
+        size_t next = GOQ_Next++;
+        pthread_mutex_unlock(&GOQ_Lock);
+        GOQ_WorkHorse->appendGroup(GOQ_Outputs[next]);
+        GOQ_Outputs[next] = GroupOutput();
+        pthread_mutex_lock(&GOQ_Lock);
+    }
+    GOQ_Appending = false;
+    pthread_mutex_unlock(&GOQ_Lock);
+}
+
+GroupAssemblyTask::GroupAssemblyTask(WorkHorse * workHorse, int GID, DR_Cluster * group, NodeManager ** manager, int firstStage, size_t reads, GroupOutputQueue * output, size_t outputIndex):
+    PoolTask(reads),
+    GAT_WorkHorse(workHorse),
+    GAT_GID(GID),
+    GAT_Group(group),
+    GAT_Manager(manager),
+    GAT_FirstStage(firstStage),
+    GAT_PrunedBefore(WH_GRAPH_STAGES),
+    GAT_WriteFailed(false),
+    GAT_Output(output),
+    GAT_OutputIndex(outputIndex)
+{
+    for (int i = 0; i < WH_GRAPH_STAGES; i++) {
+        GAT_StageTimes[i] = 0;
+    }
+}
+
+int GroupAssemblyTask::run(void)
+{
+    int failed = 1;
+    GroupOutput output = GroupOutput();
+    try {
+        failed = GAT_WorkHorse->assembleGroup(GAT_GID, GAT_Group, GAT_Manager, GAT_FirstStage, GAT_StageTimes, &GAT_PrunedBefore);
+        if (0 == failed) {
+            GAT_WriteFailed = (0 != GAT_WorkHorse->writeGroup(GAT_GID, GAT_Manager, output));
+        }
+    } catch (...) {
+        // the groups after this one still have to go out
+        GAT_Output->finished(GAT_OutputIndex, NULL);
+        throw;
+    }
+    GAT_Output->finished(GAT_OutputIndex, (0 == failed && !GAT_WriteFailed) ? &output : NULL);
+    return failed;
+}
+
+int WorkHorse::assembleGroups(void)
+{
+	//-----
+	// Make the graphs for every group, clean them, make spacer graphs and
+	// contigs and throw away the groups that don't look real. Groups share
+	// nothing so each one goes through the whole lot as a single task on
+	// the pool, biggest groups first so that a huge group isn't left
+	// running on its own at the end. Each group's own files are written
+	// and its node manager freed as soon as it is done, what it adds to the
+	// files openOutput opened goes out in GID order once every group
+	// before it is done too
+	//
+    double start = graphTimer();
+    std::vector<PoolTask *> tasks;
+    std::vector<GroupAssemblyTask *> group_tasks;
+    size_t groups = 0;
+    DR_Cluster_MapIterator drg_iter;
+    for(drg_iter = mDR2GIDMap.begin(); drg_iter != mDR2GIDMap.end(); drg_iter++)
+    {
+        if(NULL != drg_iter->second)
+        {
+            groups++;
+        }
+    }
+    GroupOutputQueue output(this, groups);
+    for(drg_iter = mDR2GIDMap.begin(); drg_iter != mDR2GIDMap.end(); drg_iter++)
+    {
+        if(NULL != drg_iter->second)
+        {
+            GroupAssemblyTask * task = newGroupTask(drg_iter->first, drg_iter->second, &output, group_tasks.size());
+            tasks.push_back(task);
+            group_tasks.push_back(task);
+        }
+    }
+    
+    int threads = mOpts->numThreads;
+#ifdef SEARCH_SINGLETON
+    // the search checker isn't safe to share
+    threads = 1;
+#endif
+    logInfo("Assembling "<<tasks.size()<<" groups using "<<threads<<" threads", 1);
+    WorkStealingPool pool(threads);
+    int failed = pool.runAll(tasks);
+    
+    // how long each stage took, and how many reads went through it and
+    // how many were pruned before it for guessing at the time saved
+    double stage_times[WH_GRAPH_STAGES] = {0, 0, 0, 0, 0};
+    size_t stage_reads[WH_GRAPH_STAGES] = {0, 0, 0, 0, 0};
+    size_t pruned_reads[WH_GRAPH_STAGES] = {0, 0, 0, 0, 0};
+    int pruned_groups[WH_GRAPH_STAGES + 1] = {0, 0, 0, 0, 0, 0};
+    int write_failed = 0;
+    for(size_t i = 0; i < group_tasks.size(); i++)
+    {
+        int pruned_before = group_tasks[i]->prunedBefore();
+        pruned_groups[pruned_before]++;
+        write_failed += (group_tasks[i]->writeFailed()) ? 1 : 0;
+        for(int stage = 0; stage < WH_GRAPH_STAGES; stage++)
+        {
+            stage_times[stage] += group_tasks[i]->stageTime(stage);
+            if(stage < pruned_before)
+            {
+                stage_reads[stage] += group_tasks[i]->cost();
+            }
+            else
+            {
+                pruned_reads[stage] += group_tasks[i]->cost();
+            }
+        }
+        delete group_tasks[i];
+    }
+    // summed over all the groups, so with more than one thread these add up to more than the wall time
+    const char * stage_names[WH_GRAPH_STAGES] = {"buildGraph", "cleanGraph", "buildSpacerGraph", "cleanSpacerGraph", "splitContigs"};
+    for(int stage = 0; stage < WH_GRAPH_STAGES; stage++)
+    {
+        logInfo("Graph timing: " << stage_names[stage] << " " << stage_times[stage] << "s", 1);
+    }
+    logInfo("Graph timing: assembly " << (graphTimer() - start) << "s", 1);
+    
+    // the pruned groups never ran the stage so go by the time per read of the groups that did
+    logInfo("Pruned "<<pruned_groups[WH_BUILD_GRAPH]<<" groups before buildGraph, "<<pruned_groups[WH_CLEAN_GRAPH]<<" before cleanGraph and "<<pruned_groups[WH_CLEAN_SPACER_GRAPH]<<" before cleanSpacerGraph", 1);
+    for(int stage = 0; stage < WH_GRAPH_STAGES; stage++)
+    {
+        if(pruned_reads[stage] > 0 && stage_reads[stage] > 0)
+        {
+            logInfo("Pruning saved about " << (stage_times[stage] * pruned_reads[stage] / stage_reads[stage]) << "s of " << stage_names[stage], 1);
+        }
+    }
+    
+    if(write_failed)
+    {
+        logError(write_failed<<" groups could not be written out");
+        return 1;
+    }
+    if(failed)
+    {
+        logWarn(failed<<" groups could not be assembled", 1);
+        return 1;
+    }
+    return 0;
+}
+
+GroupAssemblyTask * WorkHorse::newGroupTask(int GID, DR_Cluster * group, GroupOutputQueue * output, size_t outputIndex)
+{
+    // make every entry now so the threads never change the shape of mDRs
+    NodeManager ** manager = &(mDRs[mTrueDRs[GID]]);
+    int first_stage = WH_BUILD_GRAPH;
+    size_t cost = 0;
+    mSnapshotFiles.insert(std::make_pair(GID, std::string()));
+    mMostSpacers.insert(std::make_pair(GID, -1));
+    std::map<int, int>::iterator stage_iter = mFirstStages.find(GID);
+    if(stage_iter != mFirstStages.end())
+    {
+        // loaded from a snapshot, its reads are in the manager
+        first_stage = stage_iter->second;
+        cost = (NULL == *manager) ? 0 : (*manager)->getReadCount();
+    }
+    else
+    {
+        cost = numberOfReadsInGroup(group);
+    }
+    return new GroupAssemblyTask(this, GID, group, manager, first_stage, cost, output, outputIndex);
+}
+
+int WorkHorse::assembleGroup(int GID, DR_Cluster * group, NodeManager ** manager, int firstStage, double * stageTimes, int * prunedBefore)
+{
+	//-----
+	// Everything from loading a group's reads into a graph through to
+	// deciding whether to keep it. Only touches this group's reads and
+	// manager so it can run alongside other groups.
+	//
+	// A group is kept if it ends up with at least covCutoff attached
+	// spacers. Along the way there are cheap counts that can only be
+	// more than that final number, once one of those falls below the
+	// cutoff the group is dropped without going through the rest.
+	// prunedBefore gets the first stage that was skipped
+	//
+	// Groups loaded from a snapshot already have their manager and start
+	// at firstStage instead of building the graph
+	//
+    *prunedBefore = WH_GRAPH_STAGES;
+    NodeManager * current_manager = *manager;
+    if(firstStage > WH_BUILD_GRAPH && NULL == current_manager)
+    {
+        // copied through from a run that dropped it before building its graph
+        *prunedBefore = WH_BUILD_GRAPH;
+        return 0;
+    }
+    if(firstStage <= WH_BUILD_GRAPH)
+    {
+#ifndef SEARCH_SINGLETON
+        // a group whose reads can't make enough spacers will never pass
+        // the coverage cutoff. The search checker wants to see every read
+        // go into a graph so it doesn't prune
+        int most_spacers = mostSpacersInGroup(group);
+        mMostSpacers.find(GID)->second = most_spacers;
+        if(most_spacers < mOpts->covCutoff) 
+        {
+            logInfo("Deleting group "<<GID<<" before building its graph as its reads only have "<<most_spacers<<" spacers",5);
+            *manager = NULL;
+            *prunedBefore = WH_BUILD_GRAPH;
+            return 0;
+        }
+#endif
+#ifdef DEBUG
+        logInfo("Creating NodeManager "<<GID, 6);
+#endif
+        double stage_start = graphTimer();
+        current_manager = new NodeManager(mTrueDRs.find(GID)->second, mOpts);
+        *manager = current_manager;
+        DR_ClusterIterator drc_iter = group->begin();
+        while(drc_iter != group->end())
+        {
+            // go through each read
+            ReadList * reads = mReads.find(*drc_iter)->second;
+            ReadListIterator read_iter = reads->begin();
+            while (read_iter != reads->end()) 
+            {
+                if(*read_iter == NULL) {
+                    logError("Read is set to null");
+                }
+#ifdef SEARCH_SINGLETON
+                SearchCheckerList::iterator debug_iter = debugger->find((*read_iter)->getHeader());
+                if (debug_iter != debugger->end()) {
+                    //found one of our interesting reads
+                    // add in the true DR
+                    debug_iter->second.truedr(mTrueDRs.find(GID)->second);
+                    debug_iter->second.gid(GID);
+                }
+#endif
+                current_manager->addReadHolder(*read_iter);
+                read_iter++;
+            }
+            drc_iter++;
+        }
+        current_manager->indexReads();
+        stageTimes[WH_BUILD_GRAPH] = graphTimer() - stage_start;
+        
+        if(writeGraphSnapshot(GID, current_manager, WH_CLEAN_GRAPH))
+        {
+            return 1;
+        }
+        
+#if DEBUG
+        if (!mOpts->noDebugGraph) // this option will only exist if DEBUG is set anyway
+        {
+            // print debug graphs
+            if(renderDebugGraph(GID, current_manager, "Group_"))
+            {
+                return 1;
+            }
+        }
+#endif
+    }
+    
+    // cleaning only ever detaches nodes, it never makes new spacers
+    if(current_manager->getSpacerInstanceCount() < mOpts->covCutoff) 
+    {
+        logInfo("Deleting NodeManager "<<GID<<" before cleaning as it only made "<<current_manager->getSpacerInstanceCount()<<" spacers",5);
+        delete current_manager;
+        *manager = NULL;
+        *prunedBefore = WH_CLEAN_GRAPH;
+        return 0;
+    }
+    
+    if(firstStage <= WH_CLEAN_GRAPH)
+    {
+        // clean the spacer end graph
+        double stage_start = graphTimer();
+        logInfo("Cleaning graph for group: " << GID, 1);
+        if(current_manager->cleanGraph())
+        {
+            return 1;
+        }
+        stageTimes[WH_CLEAN_GRAPH] = graphTimer() - stage_start;
+        
+        if(writeGraphSnapshot(GID, current_manager, WH_BUILD_SPACER_GRAPH))
+        {
+            return 1;
+        }
+    }
+    
+    // make the spacer graph
+    double stage_start = graphTimer();
+    logInfo("Making spacer graph for group: " << GID, 1);
+    if(current_manager->buildSpacerGraph())
+    {
+        return 1;
+    }
+    stageTimes[WH_BUILD_SPACER_GRAPH] = graphTimer() - stage_start;
+    
+    // which spacers are attached is settled now, calling flankers can
+    // only take more away
+    if(current_manager->getAttachedSpacerCount() < mOpts->covCutoff) 
+    {
+        logInfo("Deleting NodeManager "<<GID<<" as it contained less than "<<mOpts->covCutoff<<" attached spacers",5);
+        delete current_manager;
+        *manager = NULL;
+        *prunedBefore = WH_CLEAN_SPACER_GRAPH;
+        return 0;
+    }
+    
+    // clean the spacer graph
+    stage_start = graphTimer();
+    logInfo("Cleaning spacer graph for group: " << GID, 1);
+    if(current_manager->cleanSpacerGraph())
+    {
+        return 1;
+    }
+    stageTimes[WH_CLEAN_SPACER_GRAPH] = graphTimer() - stage_start;
+    
+    // make contigs
+    stage_start = graphTimer();
+    logInfo("Making spacer contigs for group: " << GID, 1);
+    if(current_manager->splitIntoContigs())
+    {
+        return 1;
+    }
+    
+    // call flanking regions
+    logInfo("Assigning flankers for group: " << GID, 3);
+    current_manager->generateFlankers();
+    stageTimes[WH_SPLIT_CONTIGS] = graphTimer() - stage_start;
+    
+    // remove groups with low numbers of spacers and where the
+    // standard deviation of the spacer length is too high. This is what
+    // removeLowConfidenceNodeManagers did for all the groups once they
+    // were all assembled, the checks above only drop groups it would drop
+    if(current_manager->getSpacerCountAndStats(false) < mOpts->covCutoff)
+    {
+        logInfo("Deleting NodeManager "<<GID<<" as it contained less than "<<mOpts->covCutoff<<" attached spacers",5);
+        delete current_manager;
+        *manager = NULL;
+        return 0;
+    } 
+    else if (current_manager->stdevSpacerLength() > CRASS_DEF_STDEV_SPACER_LENGTH) 
+    {
+        logInfo("Deleting NodeManager "<<GID<<" as the stdev ("<<current_manager->stdevSpacerLength()<<") of the spacer lengths was greater than "<<CRASS_DEF_STDEV_SPACER_LENGTH, 4);
+        delete current_manager;
+        *manager = NULL;
+        return 0;
+    }
+    
+#if DEBUG
+	if (!mOpts->noDebugGraph) 
+    {
+        // print clean graphs
+        if(renderDebugGraph(GID, current_manager, "Clean_"))
+        {
+            return 1;
+        }
+    }
+#endif
+    return 0;
+}
+
+//**************************************
+// Functions used to cluster DRs into groups and identify the "true" DR
+//**************************************
+int WorkHorse::findConsensusDRs(GroupKmerMap& groupKmerCountsMap, int& nextFreeGID)
+{
+    //-----
+    // Cluster potential DRs and work out their true sequences
+    // make the node managers while we're at it!
+    //
+    // A cluster with exactly the same reads as one the resumed run already
+    // worked through is copied through from its graph snapshots instead. Its
+    // GIDs are kept free as it goes so every other group gets the same GID
+    // it would have had anyway
+    //
+
+    logInfo("Reducing list of potential DRs (2): Cluster refinement and true DR finding", 1);
+    
+    std::vector<int> copy_GIDs;
+    std::map<int, int> first_new_GIDs;
+    std::map<int, ClusterMembers> copy_members;
+    std::map<std::string, int> copy_DR_counts;
+    
+    // go through all the counts for each group
+    GroupKmerMap::iterator group_count_iter; 
+    for(group_count_iter =  groupKmerCountsMap.begin(); 
+        group_count_iter != groupKmerCountsMap.end(); 
+        group_count_iter++)
+    {
+        if(NULL == mDR2GIDMap[group_count_iter->first])
+        {
+            continue;
+        }
+#ifdef DEBUG
+        logInfo(__FILE__ <<":"<<__LINE__<<" checking for null "<< mDR2GIDMap[group_count_iter->first], 6)
+#endif
+        int GID = group_count_iter->first;
+        ClusterMembers members;
+        clusterMembers(GID, members);
+        int first_new_GID = nextFreeGID;
+        ClusterIndex::iterator prior_iter = mPriorClusters.find(members);
+        if(prior_iter != mPriorClusters.end() && canCopyCluster(prior_iter->second))
+        {
+            // hold on to its GIDs, it's copied once every cluster has its true DRs
+            nextFreeGID += prior_iter->second.gidsUsed;
+            copy_GIDs.push_back(GID);
+            first_new_GIDs[GID] = first_new_GID;
+            copy_members[GID] = members;
+            Vecstr::iterator dr_iter;
+            for(dr_iter = prior_iter->second.trueDRs.begin(); dr_iter != prior_iter->second.trueDRs.end(); dr_iter++)
+            {
+                copy_DR_counts[*dr_iter]++;
+            }
+        }
+        else
+        {
+            parseGroupedDRs(GID, &nextFreeGID);
+            recordClusterOutcome(GID, members, first_new_GID, nextFreeGID);
+        }
+        // delete the kmer count lists cause we're finsihed with them now
+        if(NULL != group_count_iter->second)
+        {
+            delete group_count_iter->second;
+            group_count_iter->second = NULL;
+        }
+    }
+    
+    // copying a group that would be merged with another would lose the
+    // other group's reads, so those clusters go through consensus again
+    std::vector<int> copies;
+    std::vector<int>::iterator copy_iter;
+    for(copy_iter = copy_GIDs.begin(); copy_iter != copy_GIDs.end(); copy_iter++)
+    {
+        ClusterOutcome& outcome = mPriorClusters[copy_members[*copy_iter]];
+        bool collides = false;
+        Vecstr::iterator dr_iter;
+        for(dr_iter = outcome.trueDRs.begin(); dr_iter != outcome.trueDRs.end(); dr_iter++)
+        {
+            if(copy_DR_counts[*dr_iter] > 1 || mTrueDRIndex.find(*dr_iter) != mTrueDRIndex.end())
+            {
+                collides = true;
+            }
+        }
+        if(collides)
+        {
+            rerunCluster(*copy_iter, first_new_GIDs[*copy_iter], copy_members[*copy_iter], outcome);
+        }
+        else
+        {
+            copies.push_back(*copy_iter);
+        }
+    }
+    int copied = 0;
+    for(copy_iter = copies.begin(); copy_iter != copies.end(); copy_iter++)
+    {
+        ClusterOutcome& outcome = mPriorClusters[copy_members[*copy_iter]];
+        if(copyClusterThrough(*copy_iter, first_new_GIDs[*copy_iter], copy_members[*copy_iter], outcome))
+        {
+            copied++;
+        }
+        else
+        {
+            rerunCluster(*copy_iter, first_new_GIDs[*copy_iter], copy_members[*copy_iter], outcome);
+        }
+    }
+    if(!mPriorClusters.empty())
+    {
+        logInfo("Copied "<<copied<<" unchanged clusters through from the resumed run, "<<(copy_GIDs.size() - copied)<<" had to be redone", 1);
+    }
+    
+    // how much of the realigning after splits was saved
+    if (mAlignmentCache.lookups() > 0) {
+        logInfo("Slave alignments reused: " << mAlignmentCache.hits() << " of " << mAlignmentCache.lookups() 
+                << " (" << (100.0 * mAlignmentCache.hits() / mAlignmentCache.lookups()) << "%), " 
+                << mAlignmentCache.size() << " alignments cached", 1);
+    }
+    mAlignmentCache.clear();
+    
+    // a cluster whose groups get merged with another's depends on more than its own reads
+    std::set<std::string> merged_DRs;
+    std::vector<int>::iterator identical_iter;
+    for(identical_iter = mIdenticalDRGroups.begin(); identical_iter != mIdenticalDRGroups.end(); identical_iter++)
+    {
+        merged_DRs.insert(mTrueDRs[*identical_iter]);
+    }
+    std::map<int, ClusterRecord>::iterator cluster_iter = mClusters.begin();
+    while(cluster_iter != mClusters.end())
+    {
+        Vecstr& true_DRs = cluster_iter->second.outcome.trueDRs;
+        bool merged = false;
+        for(Vecstr::iterator dr_iter = true_DRs.begin(); dr_iter != true_DRs.end(); dr_iter++)
+        {
+            if(merged_DRs.find(*dr_iter) != merged_DRs.end())
+            {
+                merged = true;
+            }
+        }
+        if(merged)
+        {
+            mClusters.erase(cluster_iter++);
+        }
+        else
+        {
+            cluster_iter++;
+        }
+    }
+    
+    // merge any groups that ended up with the same true DR
+    combineGroupsWithIdenticalDRs();
+    
+    return 0;
+}
+
+void WorkHorse::clusterMembers(int GID, ClusterMembers& members)
+{
+    //-----
+    // The DRs of a cluster before consensus and how many reads each has
+    //
+    DR_ClusterIterator drc_iter;
+    for(drc_iter = mDR2GIDMap[GID]->begin(); drc_iter != mDR2GIDMap[GID]->end(); drc_iter++)
+    {
+        members.push_back(std::make_pair(*drc_iter, mReads[*drc_iter]->size()));
+    }
+    std::sort(members.begin(), members.end());
+}
+
+void WorkHorse::recordClusterOutcome(int GID, ClusterMembers& members, int firstNewGID, int nextFreeGID)
+{
+    //-----
+    // Keep track of the groups consensus made from a cluster. The snapshots
+    // are filled in once the groups have been assembled
+    //
+    ClusterRecord record;
+    record.members = members;
+    record.firstNewGID = firstNewGID;
+    record.outcome.gidsUsed = nextFreeGID - firstNewGID;
+    for(int group = GID; group < nextFreeGID; group = (group == GID) ? firstNewGID : group + 1)
+    {
+        DR_Cluster_MapIterator drg_iter = mDR2GIDMap.find(group);
+        if(drg_iter == mDR2GIDMap.end() || NULL == drg_iter->second)
+        {
+            continue;
+        }
+        std::map<int, std::string>::iterator tdr_iter = mTrueDRs.find(group);
+        if(tdr_iter == mTrueDRs.end())
+        {
+            // not something that can be copied
+            return;
+        }
+        record.outcome.groups.push_back((group == GID) ? -1 : group - firstNewGID);
+        record.outcome.trueDRs.push_back(tdr_iter->second);
+    }
+    mClusters[GID] = record;
+}
+
+bool WorkHorse::canCopyCluster(ClusterOutcome& outcome)
+{
+    //-----
+    // Every group needs a snapshot unless it was never going to get a graph
+    //
+    for(size_t i = 0; i < outcome.groups.size(); i++)
+    {
+        if(outcome.snapshots[i].empty() && outcome.mostSpacers[i] >= mOpts->covCutoff)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void WorkHorse::rerunCluster(int GID, int firstNewGID, ClusterMembers& members, ClusterOutcome& outcome)
+{
+    //-----
+    // Consensus for a cluster whose GIDs were held for copying it. The same
+    // reads with the same options, which readClusterIndex made sure of,
+    // split into the same number of groups again
+    //
+    int next_free_GID = firstNewGID;
+    parseGroupedDRs(GID, &next_free_GID);
+    if(next_free_GID - firstNewGID > outcome.gidsUsed)
+    {
+        std::stringstream ss;
+        ss << "Group "<<GID<<" split into more groups than the run it was resumed from made of it";
+        throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ss);
+    }
+    recordClusterOutcome(GID, members, firstNewGID, firstNewGID + outcome.gidsUsed);
+}
+
+bool WorkHorse::copyClusterThrough(int GID, int firstNewGID, ClusterMembers& members, ClusterOutcome& outcome)
+{
+    //-----
+    // Make the cluster's groups as the resumed run left them, straight
+    // from their graph snapshots. Nothing changes unless all of them load
+    //
+    std::vector<NodeManager *> managers(outcome.groups.size(), static_cast<NodeManager *>(NULL));
+    std::vector<int> first_stages(outcome.groups.size(), WH_CLEAN_GRAPH);
+    for(size_t i = 0; i < outcome.groups.size(); i++)
+    {
+        if(outcome.snapshots[i].empty())
+        {
+            continue;
+        }
+        try {
+            CheckpointReader in(outcome.snapshots[i], CRASS_DEF_GRAPH_SNAPSHOT_KIND, CRASS_DEF_GRAPH_SNAPSHOT_VERSION);
+            in.readInt();
+            first_stages[i] = in.readInt();
+            std::string true_dr = in.readString();
+            if(true_dr != outcome.trueDRs[i] || (first_stages[i] != WH_CLEAN_GRAPH && first_stages[i] != WH_BUILD_SPACER_GRAPH))
+            {
+                throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ("The snapshot " + outcome.snapshots[i] + " isn't the one the cluster index expects").c_str());
+            }
+            managers[i] = new NodeManager(true_dr, mOpts);
+            managers[i]->readCheckpoint(in);
+            if(!in.atEnd())
+            {
+                throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ("There is more in the snapshot " + outcome.snapshots[i] + " than there should be").c_str());
+            }
+        } catch (crispr::exception& e) {
+            logWarn("Could not copy group "<<GID<<" through: "<<e.what(), 1);
+            for(size_t j = 0; j <= i; j++)
+            {
+                delete managers[j];
+            }
+            return false;
+        }
+    }
+    
+    // the GIDs splitting used are taken even when nothing is left in them
+    for(int group = firstNewGID; group < firstNewGID + outcome.gidsUsed; group++)
+    {
+        mDR2GIDMap[group];
+    }
+    bool keep_own = false;
+    for(size_t i = 0; i < outcome.groups.size(); i++)
+    {
+        int group = (-1 == outcome.groups[i]) ? GID : firstNewGID + outcome.groups[i];
+        if(group == GID)
+        {
+            keep_own = true;
+        }
+        else
+        {
+            mDR2GIDMap[group] = new DR_Cluster();
+        }
+        mTrueDRs[group] = outcome.trueDRs[i];
+        indexTrueDR(group);
+        mDRs[outcome.trueDRs[i]] = managers[i];
+        mFirstStages[group] = first_stages[i];
+        mSnapshotFiles[group] = outcome.snapshots[i];
+        mMostSpacers[group] = outcome.mostSpacers[i];
+        logInfo("Copied group "<<group<<" ("<<outcome.trueDRs[i]<<") through from "<<(outcome.snapshots[i].empty() ? "before its graph was built" : outcome.snapshots[i]), 2);
+    }
+    if(!keep_own)
+    {
+        cleanGroup(GID);
+    }
+    
+    ClusterRecord record;
+    record.members = members;
+    record.firstNewGID = firstNewGID;
+    record.outcome = outcome;
+    mClusters[GID] = record;
+    return true;
+}
+
+void WorkHorse::readClusterIndex(std::string runID)
+{
+    //-----
+    // Pick up what the resumed run made of its clusters, from the graph
+    // snapshot directory. It's only any use if that run also wrote the
+    // checkpoint being resumed from
+    //
+    if(mOpts->graphSnapshots.empty())
+    {
+        return;
+    }
+    std::string file_name = mOpts->graphSnapshots + CRASS_DEF_CLUSTER_INDEX_FILE;
+    if(access(file_name.c_str(), F_OK))
+    {
+        logInfo("No cluster index in "<<mOpts->graphSnapshots<<", every cluster will be worked through", 1);
+        return;
+    }
+    try {
+        CheckpointReader in(file_name, CRASS_DEF_CLUSTER_INDEX_KIND, CRASS_DEF_CLUSTER_INDEX_VERSION);
+        std::string index_run_ID = in.readString();
+        if(index_run_ID != runID)
+        {
+            logWarn("The cluster index "<<file_name<<" is from a different run to the checkpoint, not using it", 1);
+            return;
+        }
+        
+        // the same reads only split and clean up the same way with the same options
+        int kmer_length = in.readInt();
+        int cov_cutoff = in.readInt();
+        unsigned int cluster_options[4];
+        for(int i = 0; i < 4; i++)
+        {
+            cluster_options[i] = in.readUInt();
+        }
+        if(kmer_length != mOpts->cNodeKmerLength || 
+           cov_cutoff != mOpts->covCutoff || 
+           cluster_options[0] != mOpts->lowDRsize || 
+           cluster_options[1] != mOpts->highDRsize || 
+           cluster_options[2] != mOpts->lowSpacerSize || 
+           cluster_options[3] != mOpts->highSpacerSize)
+        {
+            logWarn("The cluster index "<<file_name<<" was made with different kmer, coverage, DR or spacer options, not using it", 1);
+            return;
+        }
+        
+        uint64_t cluster_count = in.readSize();
+        for(uint64_t i = 0; i < cluster_count; i++)
+        {
+            ClusterMembers members;
+            uint64_t member_count = in.readSize();
+            for(uint64_t j = 0; j < member_count; j++)
+            {
+                StringToken token = in.readInt();
+                members.push_back(std::make_pair(token, static_cast<size_t>(in.readSize())));
+            }
+            ClusterOutcome& outcome = mPriorClusters[members];
+            outcome.gidsUsed = in.readInt();
+            uint64_t group_count = in.readSize();
+            for(uint64_t j = 0; j < group_count; j++)
+            {
+                outcome.groups.push_back(in.readInt());
+                outcome.trueDRs.push_back(in.readString());
+                outcome.snapshots.push_back(in.readString());
+                outcome.mostSpacers.push_back(in.readInt());
+            }
+        }
+        if(!in.atEnd())
+        {
+            throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, ("There is more in the cluster index " + file_name + " than there should be").c_str());
+        }
+    } catch (crispr::exception& e) {
+        // it only saves work, so every cluster gets worked through instead
+        logWarn("Could not read the cluster index "<<file_name<<", not using it: "<<e.what(), 1);
+        mPriorClusters.clear();
+        return;
+    }
+    logInfo("Loaded "<<mPriorClusters.size()<<" clusters from "<<file_name, 1);
+}
+
+void WorkHorse::writeClusterIndex(void)
+{
+    //-----
+    // Save what consensus and the graphs made of each cluster next to the
+    // snapshots, so a run resuming from this one's checkpoint can copy the
+    // clusters new reads don't touch. Clusters with a group that has
+    // neither a snapshot nor a spacer count are left out
+    //
+    std::string file_name = mOpts->graphSnapshots + CRASS_DEF_CLUSTER_INDEX_FILE;
+    logInfo("Writing cluster index to " << file_name, 1);
+    std::vector<ClusterRecord *> records;
+    std::map<int, ClusterRecord>::iterator cluster_iter;
+    for(cluster_iter = mClusters.begin(); cluster_iter != mClusters.end(); cluster_iter++)
+    {
+        ClusterRecord& record = cluster_iter->second;
+        record.outcome.snapshots.clear();
+        record.outcome.mostSpacers.clear();
+        bool complete = true;
+        for(size_t i = 0; i < record.outcome.groups.size(); i++)
+        {
+            int group = (-1 == record.outcome.groups[i]) ? cluster_iter->first : record.firstNewGID + record.outcome.groups[i];
+            std::map<int, std::string>::iterator snapshot_iter = mSnapshotFiles.find(group);
+            std::map<int, int>::iterator spacers_iter = mMostSpacers.find(group);
+            if(snapshot_iter == mSnapshotFiles.end() || spacers_iter == mMostSpacers.end() || (snapshot_iter->second.empty() && -1 == spacers_iter->second))
+            {
+                complete = false;
+                break;
+            }
+            record.outcome.snapshots.push_back(snapshot_iter->second);
+            record.outcome.mostSpacers.push_back(spacers_iter->second);
+        }
+        if(complete)
+        {
+            records.push_back(&record);
+        }
+    }
+    
+    CheckpointWriter out(file_name, CRASS_DEF_CLUSTER_INDEX_KIND, CRASS_DEF_CLUSTER_INDEX_VERSION);
+    out.writeString(mRunID);
+    
+    // the options that changed what consensus and the graphs made of the clusters
+    out.writeInt(mOpts->cNodeKmerLength);
+    out.writeInt(mOpts->covCutoff);
+    out.writeUInt(mOpts->lowDRsize);
+    out.writeUInt(mOpts->highDRsize);
+    out.writeUInt(mOpts->lowSpacerSize);
+    out.writeUInt(mOpts->highSpacerSize);
+    
+    out.writeSize(records.size());
+    std::vector<ClusterRecord *>::iterator record_iter;
+    for(record_iter = records.begin(); record_iter != records.end(); record_iter++)
+    {
+        ClusterMembers& members = (*record_iter)->members;
+        out.writeSize(members.size());
+        for(size_t i = 0; i < members.size(); i++)
         {
-            delete group_count_iter->second;
-            group_count_iter->second = NULL;
+            out.writeInt(members[i].first);
+            out.writeSize(members[i].second);
+        }
+        ClusterOutcome& outcome = (*record_iter)->outcome;
+        out.writeInt(outcome.gidsUsed);
+        out.writeSize(outcome.groups.size());
+        for(size_t i = 0; i < outcome.groups.size(); i++)
+        {
+            out.writeInt(outcome.groups[i]);
+            out.writeString(outcome.trueDRs[i]);
+            out.writeString(outcome.snapshots[i]);
+            out.writeInt(outcome.mostSpacers[i]);
         }
     }
-    
-    return 0;
+    out.close();
 }
+
 void WorkHorse::removeRedundantRepeats(Vecstr& repeatVector)
 {
     // given a vector of repeat sequences, will order the vector based on repeat
@@ -645,7 +1598,7 @@ void WorkHorse::removeRedundantRepeats(Vecstr& repeatVector)
 }
 
 
-Vecstr * WorkHorse::createNonRedundantSet(GroupKmerMap& groupKmerCountsMap, int& nextFreeGID)
+Vecstr * WorkHorse::createNonRedundantSet(GroupKmerMap& groupKmerCountsMap, int& nextFreeGID, const std::set<StringToken>& skipDRs)
 {
     // cluster the direct repeats then remove the redundant ones
     // creates a vector in dynamic memory, so don't forget to delete 
@@ -660,7 +1613,11 @@ Vecstr * WorkHorse::createNonRedundantSet(GroupKmerMap& groupKmerCountsMap, int&
     ReadMapIterator read_map_iter = mReads.begin();
     while (read_map_iter != mReads.end()) 
     {
-        clusterDRReads(read_map_iter->first, &nextFreeGID, &k2GID_map, &groupKmerCountsMap);
+        // DRs that only singletons have turned up for
+        if (skipDRs.find(read_map_iter->first) == skipDRs.end()) 
+        {
+            clusterDRReads(read_map_iter->first, &nextFreeGID, &k2GID_map, &groupKmerCountsMap);
+        }
         ++read_map_iter;
     }
     std::cout<<'['<<PACKAGE_NAME<<"_clusterCore]: "<<mReads.size()<<" variants mapped to "<<mDR2GIDMap.size()<<" clusters"<<std::endl;
@@ -761,18 +1718,11 @@ bool WorkHorse::populateCoverageArray(int GID, Aligner& drAligner)
     //++++++++++++++++++++++++++++++++++++++++++++++++
     // now go thru all the other DRs in this group and add them into
     // the consensus array
-    DR_ClusterIterator dr_iter;// = (mDR2GIDMap[GID])->begin();
-    for (dr_iter = (mDR2GIDMap[GID])->begin(); dr_iter != (mDR2GIDMap[GID])->end(); dr_iter++) 
-    {
-        // we've already done the master DR
-        if(drAligner.getMasterDrToken() == *dr_iter)
-        {
-            continue;
-        }
-        drAligner.alignSlave(*dr_iter);
-    }
+    // the master DR has already been placed and is skipped by the aligner
+    drAligner.alignSlaves((mDR2GIDMap[GID])->begin(), (mDR2GIDMap[GID])->end());
+
     // kill the unfounded ones
-    dr_iter = (mDR2GIDMap[GID])->begin();
+    DR_ClusterIterator dr_iter = (mDR2GIDMap[GID])->begin();
     while (dr_iter != (mDR2GIDMap[GID])->end()) 
     {
     	if(drAligner.offsetFind(*dr_iter) != drAligner.offsetEnd())
@@ -1163,8 +2113,12 @@ bool WorkHorse::parseGroupedDRs(int GID, int * nextFreeGID)
     
     // now we have the n most abundant kmers and one DR which contains them all
     // time to rock and rrrroll!
-    Aligner dr_aligner((CRASS_DEF_CONS_ARRAY_RL_MULTIPLIER*mMaxReadLength), &mReads, &mStringCheck);
+    Aligner dr_aligner(&mReads, &mStringCheck);
+    dr_aligner.setAlignmentCache(&mAlignmentCache);
     dr_aligner.setMasterDR(master_DR_token);
+    // big groups don't need every read to call the DR, graph building
+    // still gets all of them
+    dr_aligner.setReadSampling(CRASS_DEF_MAX_READS_FOR_DECISION);
 
     //++++++++++++++++++++++++++++++++++++++++++++++++
     // Set up the master DR's array and insert this guy into the main array
@@ -1306,7 +2260,11 @@ bool WorkHorse::parseGroupedDRs(int GID, int * nextFreeGID)
         logInfo("Found DR: " << laurenized_true_dr, 2);
         
         mTrueDRs[GID] = laurenized_true_dr;
+        indexTrueDR(GID);
         logInfo("group: "<< GID<< " associated:" << &mDR2GIDMap[GID], 5);
+        // every read gets checked for partials against the same DR
+        SmithWaterman partial_aligner(true_DR);
+        std::vector<ReadHolder *> group_reads;
         DR_ClusterIterator drc_iter = (mDR2GIDMap[GID])->begin();
         while(drc_iter != (mDR2GIDMap[GID])->end())
         {
@@ -1344,7 +2302,7 @@ bool WorkHorse::parseGroupedDRs(int GID, int * nextFreeGID)
                         //}
                         try {
                         //    std::cerr << "Alignment offset: "<< dr_aligner.offset(*drc_iter)<< " DR Zone Start: " <<dr_aligner.getDRZoneStart()<<std::endl;
-						    (*read_iter)->updateStartStops((dr_aligner.offset(*drc_iter) - dr_aligner.getDRZoneStart()), &true_DR, mOpts);
+						    (*read_iter)->shiftStartStops((dr_aligner.offset(*drc_iter) - dr_aligner.getDRZoneStart()), static_cast<int>(true_DR.length()));
                         } catch (crispr::exception &e) {
                             std::cerr <<dr_aligner.offset(*drc_iter) << " : "<<  dr_aligner.getDRZoneStart()<<std::endl;
                             logInfo("Dumping read set of group:", 1);
@@ -1355,29 +2313,99 @@ bool WorkHorse::parseGroupedDRs(int GID, int * nextFreeGID)
                             }
                             throw e;
                         }
-						// reverse complement sequence if the true DR is not in its laurenized form
-						if (rev_comp) 
-						{
-							try {
-								(*read_iter)->reverseComplementSeq();
-							} catch (crispr::exception& e) {
-								std::cerr<<e.what()<<std::endl;
-								throw crispr::exception(__FILE__,
-								                        __LINE__,
-								                        __PRETTY_FUNCTION__,
-								                        "Failed to reverse complement sequence");
-							}
-						}
+                        group_reads.push_back(*read_iter);
 						read_iter++;
 					}
 				}
         	}
             drc_iter++;
         }
+        
+        // look for partial DRs on the ends of all the reads at once
+        findPartialRepeats(group_reads, partial_aligner);
+        
+        // reverse complement sequence if the true DR is not in its laurenized form
+        if (rev_comp) 
+        {
+            std::vector<ReadHolder *>::iterator gr_iter = group_reads.begin();
+            while (gr_iter != group_reads.end()) 
+            {
+                try {
+                    (*gr_iter)->reverseComplementSeq();
+                } catch (crispr::exception& e) {
+                    std::cerr<<e.what()<<std::endl;
+                    throw crispr::exception(__FILE__,
+                                            __LINE__,
+                                            __PRETTY_FUNCTION__,
+                                            "Failed to reverse complement sequence");
+                }
+                gr_iter++;
+            }
+        }
     }
     return true;
 }
 
+void WorkHorse::findPartialRepeats(std::vector<ReadHolder *>& groupReads, SmithWaterman& partialAligner)
+{
+    //-----
+    // Look for partial DRs hanging off the ends of every read in the group.
+    // All the windows are handed to the aligner together so that it can
+    // align the DR against many reads at once
+    //
+    const std::string& true_DR = partialAligner.query();
+    std::vector<ReadHolder *> window_reads;
+    std::vector<SW_Window> windows;
+    std::vector<SW_Alignment> partials;
+    std::vector<bool> found;
+    
+    // front first
+    std::vector<ReadHolder *>::iterator gr_iter = groupReads.begin();
+    while (gr_iter != groupReads.end()) 
+    {
+        SW_Window window;
+        if((*gr_iter)->frontPartialWindow(mOpts, window.searchStart, window.searchLength))
+        {
+            window.target = &((*gr_iter)->getSeq());
+            windows.push_back(window);
+            window_reads.push_back(*gr_iter);
+        }
+        gr_iter++;
+    }
+    partialAligner.alignAnchoredBatch(windows, SW_ANCHOR_FRONT, CRASS_DEF_PARTIAL_SIM_CUT_OFF, partials, found);
+    for (unsigned int i = 0; i < windows.size(); i++) 
+    {
+        if (found[i]) 
+        {
+            window_reads[i]->addFrontPartial(partials[i], true_DR);
+        }
+    }
+    
+    // then the back
+    windows.clear();
+    window_reads.clear();
+    gr_iter = groupReads.begin();
+    while (gr_iter != groupReads.end()) 
+    {
+        SW_Window window;
+        if((*gr_iter)->backPartialWindow(mOpts, window.searchStart, window.searchLength))
+        {
+            window.target = &((*gr_iter)->getSeq());
+            windows.push_back(window);
+            window_reads.push_back(*gr_iter);
+        }
+        gr_iter++;
+    }
+    partialAligner.alignAnchoredBatch(windows, SW_ANCHOR_BACK, CRASS_DEF_PARTIAL_SIM_CUT_OFF, partials, found);
+    for (unsigned int i = 0; i < windows.size(); i++) 
+    {
+        if (found[i]) 
+        {
+            window_reads[i]->addBackPartial(partials[i], true_DR);
+        }
+    }
+}
+
 
 void WorkHorse::cleanGroup(int GID)
 {
@@ -1389,6 +2417,26 @@ void WorkHorse::cleanGroup(int GID)
 }
 
 
+int WorkHorse::mostSpacersInGroup(DR_Cluster * currentGroup)
+{
+    //-----
+    // Every spacer in a graph is cut from one of the group's reads, so the
+    // graph can't get more than the reads' spacers put together
+    //
+    size_t most_spacers = 0;
+    DR_ClusterIterator grouped_drs_iter;
+    for (grouped_drs_iter = currentGroup->begin(); grouped_drs_iter != currentGroup->end(); grouped_drs_iter++) 
+    {
+        ReadList * reads = mReads.find(*grouped_drs_iter)->second;
+        ReadListIterator read_iter;
+        for (read_iter = reads->begin(); read_iter != reads->end(); read_iter++) 
+        {
+            most_spacers += NodeManager::mostSpacersFromRead(*read_iter);
+        }
+    }
+    return (int)most_spacers;
+}
+
 int WorkHorse::numberOfReadsInGroup(DR_Cluster * currentGroup)
 {
     DR_ClusterIterator grouped_drs_iter = currentGroup->begin();
@@ -1636,159 +2684,45 @@ bool WorkHorse::clusterDRReads(StringToken DRToken,
     
 }
 
-//**************************************
-// spacer graphs
-//**************************************
-int WorkHorse::makeSpacerGraphs(void)
-{
-	//-----
-	// build the spacer graphs
-	//
-    // go through the DR2GID_map and make all reads in each group into nodes
-    DR_ListIterator dr_iter = mDRs.begin();
-    while(dr_iter != mDRs.end())
-    {
-        if(NULL != dr_iter->second)
-        {
-        	logInfo("Making spacer graph for DR: " << dr_iter->first, 1);
-        	if((dr_iter->second)->buildSpacerGraph())
-        		return 1;
-        }
-        dr_iter++;
-    }
-    return 0;
-}
-
-int WorkHorse::cleanSpacerGraphs(void)
-{
-	//-----
-	// clean the spacer graphs
-	//
-    // go through the DR2GID_map and make all reads in each group into nodes
-#ifdef DEBUG
-    //renderSpacerGraphs("Spacer_Preclean_");
-#endif
-    DR_ListIterator dr_iter = mDRs.begin();
-    while(dr_iter != mDRs.end())
-    {
-        if(NULL != dr_iter->second)
-        {
-        	logInfo("Cleaning spacer graph for DR: " << dr_iter->first, 1);
-        	//(dr_iter->second)->printAllSpacers();
-        	if((dr_iter->second)->cleanSpacerGraph())
-        		return 1;
-        }
-        dr_iter++;
-    }
-    return 0;
-}
-
-int WorkHorse::generateFlankers(void)
-{
-	//-----
-	// Wrapper for graph cleaning
-	//
-	// create a spacer dictionary
-	logInfo("Detecting Flanker sequences", 1);
-	DR_Cluster_MapIterator drg_iter = mDR2GIDMap.begin();
-	while(drg_iter != mDR2GIDMap.end())
-	{
-		if(NULL != drg_iter->second)
-		{            
-            if (NULL != mDRs[mTrueDRs[drg_iter->first]])
-            {
-                logInfo("Assigning flankers for NodeManager "<<drg_iter->first, 3);
-                (mDRs[mTrueDRs[drg_iter->first]])->generateFlankers();
-		    }
-        }
-		drg_iter++;
-	}
-	return 0;
-}
-//**************************************
-// contig making
-//**************************************
-int WorkHorse::splitIntoContigs(void)
-{
-	//-----
-	// split all groups into contigs
-	//
-    DR_ListIterator dr_iter = mDRs.begin();
-    while(dr_iter != mDRs.end())
-    {
-        if(NULL != dr_iter->second)
-        {
-        	logInfo("Making spacer contigs for DR: " << dr_iter->first, 1);
-
-            if((dr_iter->second)->splitIntoContigs())
-        		return 1;
-        }
-        dr_iter++;
-    }
-    return 0;
-}
-
 //**************************************
 // file IO
 //**************************************
 
 
-int WorkHorse::renderDebugGraphs(void)
-{
-	//-----
-	// Print the debug graph
-	//
-    // use the default name
-	return renderDebugGraphs("Group_");
-}
-
-int WorkHorse::renderDebugGraphs(std::string namePrefix)
+int WorkHorse::renderDebugGraph(int GID, NodeManager * manager, std::string namePrefix)
 {
 	//-----
-	// Print the debug graph
+	// Print the debug graph for one group
 	//
-	// go through the DR2GID_map and make all reads in each group into nodes
 #ifdef RENDERING
-    std::cout<<"["<<PACKAGE_NAME<<"_imageRenderer]: Rendering Debugging graphs using Graphviz"<<std::endl;
-    logInfo("Rendering debug graphs" , 1);
+    logInfo("Rendering debug graph for group "<<GID , 1);
 #endif
-    
-    DR_Cluster_MapIterator drg_iter = mDR2GIDMap.begin();
-    while(drg_iter != mDR2GIDMap.end())
+    std::string true_dr = mTrueDRs.find(GID)->second;
+    std::ofstream graph_file;
+    std::string graph_file_prefix = mOpts->output_fastq + namePrefix + to_string(GID) + "_" + true_dr;
+    std::string graph_file_name = graph_file_prefix + "_debug.gv";
+    graph_file.open(graph_file_name.c_str());
+    if (graph_file.good()) 
     {
-        if(NULL != drg_iter->second)
-        {            
-            if (NULL != mDRs[mTrueDRs[drg_iter->first]])
-            {
-                std::ofstream graph_file;
-                std::string graph_file_prefix = mOpts->output_fastq + namePrefix + to_string(drg_iter->first) + "_" + mTrueDRs[drg_iter->first];
-                std::string graph_file_name = graph_file_prefix + "_debug.gv";
-                graph_file.open(graph_file_name.c_str());
-                if (graph_file.good()) 
-                {
-                    mDRs[mTrueDRs[drg_iter->first]]->printDebugGraph(graph_file, mTrueDRs[drg_iter->first], false, false, false);
+        manager->printDebugGraph(graph_file, true_dr, false, false, false);
 #if RENDERING
-                    if (!mOpts->noRendering) 
-                    {
-                        // create a command string and call neato to make the image file
-                        std::cout<<"["<<PACKAGE_NAME<<"_imageRenderer]: Rendering group "<<drg_iter->first<<std::endl;
-                        std::string cmd = "neato -Teps " + graph_file_name + " > "+ graph_file_prefix + ".eps";
-                        if (system(cmd.c_str()))
-                        {
-                            logError("Problem running neato when rendering debug graphs");
-                        }
-                    }
-#endif
-                } 
-                else 
-                {
-                    logError("Unable to create graph output file "<<graph_file_name);
-                }
-                graph_file.close();
+        if (!mOpts->noRendering) 
+        {
+            // create a command string and call neato to make the image file
+            std::cout<<"["<<PACKAGE_NAME<<"_imageRenderer]: Rendering group "<<GID<<std::endl;
+            std::string cmd = "neato -Teps " + graph_file_name + " > "+ graph_file_prefix + ".eps";
+            if (system(cmd.c_str()))
+            {
+                logError("Problem running neato when rendering debug graphs");
             }
         }
-        drg_iter++;
+#endif
+    } 
+    else 
+    {
+        logError("Unable to create graph output file "<<graph_file_name);
     }
+    graph_file.close();
     return 0;
 }
 
@@ -1825,6 +2759,7 @@ int WorkHorse::renderSpacerGraphs(std::string namePrefix)
     }
 
     gvGraphHeader(key_file, "Keys");
+    int cluster_number = 0;
     DR_Cluster_MapIterator drg_iter = mDR2GIDMap.begin();
     while(drg_iter != mDR2GIDMap.end())
     {
@@ -1847,9 +2782,10 @@ int WorkHorse::renderSpacerGraphs(std::string namePrefix)
                                                        mOpts->showSingles))
                 {
                     // add our group to the key
-                    current_manager->printSpacerKey(key_file, 
-                                                    10, 
-                                                    namePrefix + to_string(drg_iter->first));
+                    gvKeyGroupHeader(key_file, cluster_number, namePrefix + to_string(drg_iter->first));
+                    current_manager->printSpacerKey(key_file, 10);
+                    gvKeyFooter(key_file);
+                    cluster_number++;
                     
                     // output the reads
                     std::string read_file_name = mOpts->output_fastq +  "Group_" + to_string(drg_iter->first) + "_" + mTrueDRs[drg_iter->first] + ".fa";
@@ -1897,11 +2833,12 @@ int WorkHorse::checkFileOrError(const char * fileName)
     return 0;
 }
 
-bool WorkHorse::outputResults(std::string namePrefix)
+int WorkHorse::openOutput(std::string namePrefix)
 {
 	
     //-----
-	// Print the cleaned? spacer graph, reads and the XML
+	// Open the key file, the sources file and the XML so that each group
+	// can go out to them as soon as it has been assembled
 	//
 
 #ifdef RENDERING
@@ -1914,191 +2851,240 @@ bool WorkHorse::outputResults(std::string namePrefix)
     
     std::stringstream key_file_name;
     key_file_name << mOpts->output_fastq<<PACKAGE_NAME << "."<<mTimeStamp<<".keys.gv";
-    std::ofstream key_file(key_file_name.str().c_str());
+    mKeyFile.open(key_file_name.str().c_str());
     
-    if (!key_file) 
+    if (!mKeyFile) 
     {
         logError("Cannot open the key file: "<< key_file_name.str());
         return 1;
     }
     
-    gvGraphHeader(key_file, "Keys");
+    gvGraphHeader(mKeyFile, "Keys");
 
+    // the sources of the spacers can go in a file of their own rather than
+    // bloating out the XML
+    if (mOpts->sourcesFile) 
+    {
+        std::string sources_file_name = mOpts->output_fastq + PACKAGE_NAME + "." + mTimeStamp + ".sources";
+        mSourcesFile.open(sources_file_name.c_str());
+        if (!mSourcesFile) 
+        {
+            logError("Cannot open the sources file: "<< sources_file_name);
+            return 1;
+        }
+    }
     
     
     // print all the assembly gossip to XML
 	namePrefix += CRASS_DEF_CRISPR_EXT;
 	logInfo("Writing XML output to \"" << namePrefix << "\"", 1);
 	
+    mOutputName = namePrefix;
+    mGroupsOutput = 0;
+    if (!mXMLOut.open(namePrefix, CRASS_DEF_ROOT_ELEMENT, CRASS_DEF_XML_VERSION)) 
+    {
+        logError("Cannot open the XML file: "<< namePrefix);
+        return 1;
+    }
+	return 0;
+}
 
-    crispr::xml::writer * xml_doc = new crispr::xml::writer();
-    int error_num;
-    xercesc::DOMElement * root_element = xml_doc->createDOMDocument(CRASS_DEF_ROOT_ELEMENT, 
-                                                                    CRASS_DEF_XML_VERSION, 
-                                                                    error_num);
+int WorkHorse::writeGroup(int GID, NodeManager ** manager, GroupOutput& output)
+{
+    //-----
+    // Print the group's spacer graph and reads, put its XML, key and
+    // sources in output and let go of its node manager. This runs on the
+    // thread that assembled the group so the manager doesn't hang around
+    // while the groups before it are assembled, only output does
+    //
+    output.GID = GID;
+    output.printed = false;
+    std::map<int, std::string>::iterator tdr_iter = mTrueDRs.find(GID);
     
-    if (!root_element && error_num) 
+    // make sure that our cluster is real
+    if (tdr_iter == mTrueDRs.end() || NULL == *manager) 
     {
-        delete xml_doc;
-        throw crispr::xml_exception(__FILE__,
-                                    __LINE__,
-                                    __PRETTY_FUNCTION__,
-                                    "Unable to create xml document");
+        return 0;
     }
-    // go through the node managers and print the group info 
-    // print all the inside information
-    int final_out_number = 0;
-    DR_Cluster_MapIterator drg_iter =  mDR2GIDMap.begin();
-    for (drg_iter =  mDR2GIDMap.begin(); drg_iter != mDR2GIDMap.end(); drg_iter++) {
 
-        // make sure that our cluster is real
-        if (drg_iter->second == NULL) 
-        {
-            continue;
-        }
-        if(NULL == mDRs[mTrueDRs[drg_iter->first]])
+    NodeManager * current_manager = *manager;
+    
+    std::string graph_file_prefix = mOpts->output_fastq + "Spacers_" + to_string(GID) + "_" + tdr_iter->second;
+    std::string graph_file_name = graph_file_prefix + "_spacers.gv";
+    
+    // check to see if there is anything to print
+    if ( current_manager->printSpacerGraph(graph_file_name, 
+                                           tdr_iter->second, 
+                                           mOpts->longDescription, 
+                                           mOpts->showSingles))
+    {
+#ifdef RENDERING
+        if (!mOpts->noRendering) 
         {
-            continue;
+            // create a command string and call graphviz to make the image file
+            std::cout<<"["<<PACKAGE_NAME<<"_imageRenderer]: Rendering group "<<GID<<std::endl;
+            std::string cmd = mOpts->layoutAlgorithm + " -Teps " + graph_file_name + " > "+ graph_file_prefix + ".eps";
+            if(system(cmd.c_str()))
+            {
+                logError("Problem running "<<mOpts->layoutAlgorithm<<" when rendering spacer graphs");
+                return 1;
+            }
         }
-
-        NodeManager * current_manager = mDRs[mTrueDRs[drg_iter->first]];
+#endif
+        // add our group to the key
+        std::stringstream key;
+        current_manager->printSpacerKey(key, 10);
         
-        std::ofstream graph_file;        
+        // output the reads
+        std::string read_file_name = mOpts->output_fastq +  "Group_" + to_string(GID) + "_" + tdr_iter->second + ".fa";
+        this->dumpReads(current_manager, read_file_name, true);
         
-        std::string graph_file_prefix = mOpts->output_fastq + "Spacers_" + to_string(drg_iter->first) + "_" + mTrueDRs[drg_iter->first];
-        std::string graph_file_name = graph_file_prefix + "_spacers.gv";
+        /* 
+         *   The xml data for crass.crispr, as it will sit inside the root element
+         */
+        std::stringstream xml;
+        std::stringstream sources;
+        crispr::xml::streamer xml_out(xml, 1);
+        std::string gid_as_string = "G" + to_string(GID);
+        xml_out.beginGroup(gid_as_string, tdr_iter->second);
+        /*
+         * <data> section
+         */
+        this->addDataToXML(xml_out, GID, (mOpts->sourcesFile) ? &sources : NULL);
         
-        // check to see if there is anything to print
-        if ( current_manager->printSpacerGraph(graph_file_name, 
-                                               mTrueDRs[drg_iter->first], 
-                                               mOpts->longDescription, 
-                                               mOpts->showSingles))
-        {
-#ifdef RENDERING
-            if (!mOpts->noRendering) 
-            {
-                // create a command string and call graphviz to make the image file
-                std::cout<<"["<<PACKAGE_NAME<<"_imageRenderer]: Rendering group "<<drg_iter->first<<std::endl;
-                std::string cmd = mOpts->layoutAlgorithm + " -Teps " + graph_file_name + " > "+ graph_file_prefix + ".eps";
-                if(system(cmd.c_str()))
-                {
-                    logError("Problem running "<<mOpts->layoutAlgorithm<<" when rendering spacer graphs");
-                    return 1;
-                }
-            }
-#endif
-            // add our group to the key
-            current_manager->printSpacerKey(key_file, 
-                                            10, 
-                                            namePrefix + to_string(drg_iter->first));
-            
-            // output the reads
-            std::string read_file_name = mOpts->output_fastq +  "Group_" + to_string(drg_iter->first) + "_" + mTrueDRs[drg_iter->first] + ".fa";
-            this->dumpReads(current_manager, read_file_name, true);
-            
-            /* 
-             *   Output the xml data to crass.crispr
-             */
-            std::string gid_as_string = "G" + to_string(drg_iter->first);
-            final_out_number++;
-            xercesc::DOMElement * group_elem = xml_doc->addGroup(gid_as_string, 
-                                                                 mTrueDRs[drg_iter->first], 
-                                                                 root_element);
-            /*
-             * <data> section
-             */
-            this->addDataToDOM(xml_doc, group_elem, drg_iter->first);
-            
-            /*
-             * <metadata> section
-             */
-            this->addMetadataToDOM(xml_doc, group_elem, drg_iter->first);
-            
-            /*
-             * <assembly> section
-             */
-            xercesc::DOMElement * assem_elem = xml_doc->addAssembly(group_elem);
-            current_manager->printAssemblyToDOM(xml_doc, assem_elem, false);
-        }
-        else 
-        {
-            // should delete this guy since there are no spacers
-            delete mDRs[mTrueDRs[drg_iter->first]];
-            mDRs[mTrueDRs[drg_iter->first]] = NULL;
-        }
+        /*
+         * <metadata> section
+         */
+        this->addMetadataToXML(xml_out, GID);
+        
+        /*
+         * <assembly> section
+         */
+        xml_out.beginElement("assembly");
+        current_manager->printAssemblyToXML(xml_out, false);
+        xml_out.endElement();
+        xml_out.endElement();
+        xml_out.flush();
+        
+        output.printed = true;
+        output.xml = xml.str();
+        output.key = key.str();
+        output.sources = sources.str();
     }
-    std::cout<<"["<<PACKAGE_NAME<<"_graphBuilder]: "<<final_out_number<<" CRISPRs found!"<<std::endl;
-    xml_doc->printDOMToFile(namePrefix);
-
-    delete xml_doc;
     
-    gvGraphFooter(key_file);
-    key_file.close();
-	return 0;
+    // either it's all in output or there were no spacers, either way
+    // we're done with this guy
+    delete current_manager;
+    *manager = NULL;
+    return 0;
 }
 
-bool WorkHorse::addDataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMElement * groupElement, int groupNumber)
+void WorkHorse::appendGroup(GroupOutput& output)
 {
-    try 
+    if (!output.printed) 
     {
-        xercesc::DOMElement * data_elem = xmlDoc->addData(groupElement);
-        if ((mDRs[mTrueDRs[groupNumber]])->haveAnyFlankers()) {
-            xmlDoc->createFlankers(data_elem);
-        }
-        
-        xercesc::DOMElement * sources_tag = data_elem->getFirstElementChild();
-        std::set<StringToken> all_sources;
-        
-        for (xercesc::DOMElement * currentElement = data_elem->getFirstElementChild(); currentElement != NULL; currentElement = currentElement->getNextElementSibling()) 
-        {
-            if( xercesc::XMLString::equals(currentElement->getTagName(), xmlDoc->tag_Drs()))
-            {
-                // TODO: current implementation in Crass only supports a single DR for a group
-                // in the future this will change, but for now ok to keep as a constant
-                std::string drid = "DR1";
-                xmlDoc->addDirectRepeat(drid, mTrueDRs[groupNumber], currentElement);
-            }
-            else if (xercesc::XMLString::equals(currentElement->getTagName(), xmlDoc->tag_Spacers()))
-            {
-                // print out all the spacers for this group
-                (mDRs[mTrueDRs[groupNumber]])->addSpacersToDOM(xmlDoc, currentElement, false, all_sources);
-                
-            }
-            else if (xercesc::XMLString::equals(currentElement->getTagName(), xmlDoc->tag_Flankers()))
-            {
-                // should only get in here if there are flankers for the group
+        return;
+    }
+    gvKeyGroupHeader(mKeyFile, mGroupsOutput, mOutputName + to_string(output.GID));
+    mKeyFile << output.key;
+    gvKeyFooter(mKeyFile);
+    if (mSourcesFile.is_open()) 
+    {
+        mSourcesFile << output.sources;
+    }
+    mGroupsOutput++;
+    mXMLOut.addFragment(output.xml);
+    mXMLOut.flush();
+}
 
-                // print out all the flankers for this group
-                (mDRs[mTrueDRs[groupNumber]])->addFlankersToDOM(xmlDoc, currentElement, false, all_sources);
+int WorkHorse::closeOutput(void)
+{
+    std::cout<<"["<<PACKAGE_NAME<<"_graphBuilder]: "<<mGroupsOutput<<" CRISPRs found!"<<std::endl;
+    if (!mXMLOut.close()) 
+    {
+        logError("Could not write all of the XML to: "<< mOutputName);
+        return 1;
+    }
+    
+    gvGraphFooter(mKeyFile);
+    mKeyFile.close();
+    if (mSourcesFile.is_open()) 
+    {
+        mSourcesFile.close();
+    }
+	return 0;
+}
 
-            }
-        }
-        (mDRs[mTrueDRs[groupNumber]])->generateAllsourceTags(xmlDoc, all_sources, sources_tag);
-        
+bool WorkHorse::addDataToXML(crispr::xml::streamer& xmlOut, int groupNumber, std::ostream * sourcesFile)
+{
+    //-----
+    // With a sources file the <source> tags are left out of the XML. Each
+    // group gets a "G<id>" line in the file, then "SP<id>" or "FL<id>", a tab
+    // and the source ids for each spacer and flanker, and then "SO<id>", a
+    // tab and the read header for each of the sources
+    //
+    std::string& true_dr = mTrueDRs.find(groupNumber)->second;
+    NodeManager * current_manager = mDRs.find(true_dr)->second;
+    TokenBitmap all_sources;
+    current_manager->getAllSources(all_sources, false);
+    
+    xmlOut.beginElement("data");
+    xmlOut.beginElement("sources");
+    if (sourcesFile != NULL) 
+    {
+        *sourcesFile<<"G"<<groupNumber<<"\n";
     }
-    catch( xercesc::XMLException& e )
+    else
     {
-        char* message = xercesc::XMLString::transcode( e.getMessage() );
-        std::ostringstream errBuf;
-        errBuf << "Error parsing file: " << message << std::flush;
-        xercesc::XMLString::release( &message );
-        return 1;
+        current_manager->generateAllsourceTags(xmlOut, all_sources);
+    }
+    xmlOut.endElement();
+    
+    // TODO: current implementation in Crass only supports a single DR for a group
+    // in the future this will change, but for now ok to keep as a constant
+    std::string drid = "DR1";
+    xmlOut.beginElement("drs");
+    xmlOut.addDirectRepeat(drid, true_dr);
+    xmlOut.endElement();
+    
+    // print out all the spacers for this group
+    xmlOut.beginElement("spacers");
+    current_manager->addSpacersToXML(xmlOut, false, sourcesFile);
+    xmlOut.endElement();
+    
+    if (current_manager->haveAnyFlankers()) 
+    {
+        // print out all the flankers for this group
+        xmlOut.beginElement("flankers");
+        current_manager->addFlankersToXML(xmlOut, false, sourcesFile);
+        xmlOut.endElement();
+    }
+    xmlOut.endElement();
+    
+    if (sourcesFile != NULL) 
+    {
+        current_manager->generateAllsourceTags(xmlOut, all_sources, sourcesFile);
     }
     return 0;
 }
 
-bool WorkHorse::addMetadataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMElement * groupElement, int groupNumber)
+bool WorkHorse::addMetadataToXML(crispr::xml::streamer& xmlOut, int groupNumber)
 {
+    // <metadata> gets closed whatever happens in here so that the rest of
+    // the group still nests properly
+    bool retval = 0;
+    std::string& true_dr = mTrueDRs.find(groupNumber)->second;
+    xmlOut.beginElement("metadata");
     try {
         
         std::stringstream notes;
         notes << "Run on "<< mTimeStamp;
-        xercesc::DOMElement * metadata_elem = xmlDoc->addMetaData(groupElement);
-        xercesc::DOMElement * prog_elem = xmlDoc->addProgram(metadata_elem);
-        xmlDoc->addProgName(PACKAGE_NAME, prog_elem);
-        xmlDoc->addProgVersion(PACKAGE_VERSION, prog_elem);
-        xmlDoc->addProgCommand(mCommandLine, prog_elem);
-        xmlDoc->addNotesToMetadata(notes.str(), metadata_elem);
+        xmlOut.beginElement("program");
+        xmlOut.addTextElement("name", PACKAGE_NAME);
+        xmlOut.addTextElement("version", PACKAGE_VERSION);
+        xmlOut.addTextElement("command", mCommandLine);
+        xmlOut.endElement();
+        xmlOut.addTextElement("notes", notes.str());
         
         std::string file_name;
         char buf[4096];
@@ -2117,7 +3103,7 @@ bool WorkHorse::addMetadataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMEleme
             file_name = mOpts->output_fastq + PACKAGE_NAME + "." + mTimeStamp + ".log";
             if (! checkFileOrError(file_name.c_str())) 
             {
-                xmlDoc->addFileToMetadata("log", absolute_dir + file_name, metadata_elem);
+                xmlOut.addFileToMetadata("log", absolute_dir + file_name);
             }
             else
             {
@@ -2128,16 +3114,31 @@ bool WorkHorse::addMetadataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMEleme
             }
         }
         
+        if (mOpts->sourcesFile) 
+        {
+            file_name = mOpts->output_fastq + PACKAGE_NAME + "." + mTimeStamp + ".sources";
+            if (! checkFileOrError(file_name.c_str())) 
+            {
+                xmlOut.addFileToMetadata("data", absolute_dir + file_name);
+            }
+            else
+            {
+                throw crispr::no_file_exception(__FILE__, 
+                                                __LINE__, 
+                                                __PRETTY_FUNCTION__,
+                                                (absolute_dir + file_name).c_str());
+            }
+        }
         
 #ifdef DEBUG
         // check for debuging .gv files
         if (!mOpts->noDebugGraph) 
         {
             file_name = mOpts->output_fastq + "Group_"; 
-            std::string file_sufix = to_string(groupNumber) + "_" + mTrueDRs[groupNumber] + "_debug.gv";
+            std::string file_sufix = to_string(groupNumber) + "_" + true_dr + "_debug.gv";
             if (! checkFileOrError((file_name + file_sufix).c_str())) 
             {
-                xmlDoc->addFileToMetadata("data", absolute_dir + file_name + file_sufix, metadata_elem);
+                xmlOut.addFileToMetadata("data", absolute_dir + file_name + file_sufix);
             } 
             else 
             {
@@ -2151,7 +3152,7 @@ bool WorkHorse::addMetadataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMEleme
             file_name = mOpts->output_fastq + "Clean_";
             if (! checkFileOrError((file_name + file_sufix).c_str())) 
             {
-                xmlDoc->addFileToMetadata("data", absolute_dir + file_name + file_sufix, metadata_elem);
+                xmlOut.addFileToMetadata("data", absolute_dir + file_name + file_sufix);
             } 
             else 
             {
@@ -2170,21 +3171,21 @@ bool WorkHorse::addMetadataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMEleme
 #ifdef DEBUG
         if (!mOpts->noDebugGraph) 
         {
-            file_name = mOpts->output_fastq + "Group_" + to_string(groupNumber) + "_" + mTrueDRs[groupNumber] + ".eps";
+            file_name = mOpts->output_fastq + "Group_" + to_string(groupNumber) + "_" + true_dr + ".eps";
             if (! checkFileOrError(file_name.c_str())) 
             {
-                xmlDoc->addFileToMetadata("image", absolute_dir + file_name, metadata_elem);
+                xmlOut.addFileToMetadata("image", absolute_dir + file_name);
             } 
             else 
             {
                 throw crispr::no_file_exception(__FILE__, __LINE__, __PRETTY_FUNCTION__,(absolute_dir + file_name).c_str());
             }
             
-            file_name = mOpts->output_fastq + "Clean_" + to_string(groupNumber) + "_" + mTrueDRs[groupNumber] + ".eps";
+            file_name = mOpts->output_fastq + "Clean_" + to_string(groupNumber) + "_" + true_dr + ".eps";
             
             if (! checkFileOrError(file_name.c_str())) 
             {
-                xmlDoc->addFileToMetadata("image", absolute_dir + file_name, metadata_elem);
+                xmlOut.addFileToMetadata("image", absolute_dir + file_name);
             } 
             else 
             {
@@ -2195,10 +3196,10 @@ bool WorkHorse::addMetadataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMEleme
 #endif // DEBUG
         if (!mOpts->noRendering) 
         {
-            file_name = mOpts->output_fastq + "Spacers_" + to_string(groupNumber) + "_" + mTrueDRs[groupNumber] + ".eps";
+            file_name = mOpts->output_fastq + "Spacers_" + to_string(groupNumber) + "_" + true_dr + ".eps";
             if (! checkFileOrError(file_name.c_str())) 
             {
-                xmlDoc->addFileToMetadata("image", absolute_dir + file_name, metadata_elem);
+                xmlOut.addFileToMetadata("image", absolute_dir + file_name);
             } 
             else 
             {
@@ -2211,10 +3212,10 @@ bool WorkHorse::addMetadataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMEleme
         
         // add in the final Spacer graph
         file_name = mOpts->output_fastq + "Spacers_"; 
-        std::string file_sufix = to_string(groupNumber) + "_" + mTrueDRs[groupNumber] + "_spacers.gv";
+        std::string file_sufix = to_string(groupNumber) + "_" + true_dr + "_spacers.gv";
         if (! checkFileOrError((file_name + file_sufix).c_str())) 
         {
-            xmlDoc->addFileToMetadata("data", absolute_dir + file_name + file_sufix, metadata_elem);
+            xmlOut.addFileToMetadata("data", absolute_dir + file_name + file_sufix);
         } 
         else 
         {
@@ -2226,10 +3227,10 @@ bool WorkHorse::addMetadataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMEleme
 
         
         // check the sequence file
-        file_name = mOpts->output_fastq +  "Group_" + to_string(groupNumber) + "_" + mTrueDRs[groupNumber] + ".fa";
+        file_name = mOpts->output_fastq +  "Group_" + to_string(groupNumber) + "_" + true_dr + ".fa";
         if (! checkFileOrError(file_name.c_str())) 
         {
-            xmlDoc->addFileToMetadata("sequence", absolute_dir + file_name, metadata_elem);
+            xmlOut.addFileToMetadata("sequence", absolute_dir + file_name);
         } 
         else 
         {
@@ -2237,14 +3238,13 @@ bool WorkHorse::addMetadataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMEleme
         }
     } catch(crispr::no_file_exception& e) {
         std::cerr<<e.what()<<std::endl;
-        return 1;
+        retval = 1;
     } catch(std::exception& e) {
         std::cerr<<e.what()<<std::endl;
-        return 1;
-    } catch(xercesc::DOMException& e) {
-        
+        retval = 1;
     }
-    return 0;
+    xmlOut.endElement();
+    return retval;
     
 }
 
@@ -40,9 +40,12 @@
 
 // system includes
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
+#include <pthread.h>
 
 // local includes
 #include "crassDefines.h"
@@ -50,18 +53,29 @@
 #include "NodeManager.h"
 #include "ReadHolder.h"
 #include "StringCheck.h"
-#include "writer.h"
+#include "streamer.h"
 #if SEARCH_SINGLETON
 #include "SearchChecker.h"
 #endif
 #include "Types.h"
 #include "Aligner.h"
+#include "WorkStealingPool.h"
 
 
 // typedefs
 typedef std::map<std::string, NodeManager *> DR_List;
 typedef std::map<std::string, NodeManager *>::iterator DR_ListIterator;
 
+// the graph stages that get timed for each group
+enum {
+    WH_BUILD_GRAPH = 0,
+    WH_CLEAN_GRAPH,
+    WH_BUILD_SPACER_GRAPH,
+    WH_CLEAN_SPACER_GRAPH,
+    WH_SPLIT_CONTIGS,
+    WH_GRAPH_STAGES
+};
+
 
 
 bool sortLengthAssending( const std::string &a, const std::string &b);
@@ -69,12 +83,55 @@ bool sortLengthDecending( const std::string &a, const std::string &b);
 bool includeSubstring(const std::string& a, const std::string& b);
 bool isNotEmpty(const std::string& a);
 
+// The DRs of a cluster and how many reads each had going into consensus.
+// Reads are only ever added so a cluster with the same members as one from
+// an earlier run has exactly the same reads
+typedef std::vector<std::pair<StringToken, size_t> > ClusterMembers;
+
+// What consensus and the graphs made of a cluster, so that an unchanged
+// cluster can be copied through to a later run
+typedef struct {
+    int gidsUsed;                           // how many new GIDs splitting the cluster took
+    std::vector<int> groups;                // -1 for the cluster's own GID, otherwise how far past the first new GID
+    Vecstr trueDRs;                         // the true DR of each group
+    Vecstr snapshots;                       // the group's last graph snapshot, "" if it was dropped before it had a graph
+    std::vector<int> mostSpacers;           // and for those, how many spacers their reads had
+} ClusterOutcome;
+
+typedef std::map<ClusterMembers, ClusterOutcome> ClusterIndex;
+
+// a cluster of this run, the GIDs it split into start at firstNewGID
+typedef struct {
+    ClusterMembers members;
+    int firstNewGID;
+    ClusterOutcome outcome;
+} ClusterRecord;
+
+// What an assembled group adds to the files all the groups share. It waits
+// here for the groups before it to go out, its node manager doesn't
+typedef struct {
+    int GID;
+    bool printed;                           // false if the group had no spacer graph to print
+    std::string xml;                        // its <group>, laid out to go inside the root element
+    std::string key;                        // its entries in the key file
+    std::string sources;                    // its lines in the sources file
+} GroupOutput;
+
+class GroupAssemblyTask;
+class GroupOutputQueue;
+class WorkHorseTest;
+
 class WorkHorse {
+    friend class GroupAssemblyTask;
+    friend class GroupOutputQueue;
+    friend class WorkHorseTest;         // the tests look at what a resumed run did with its clusters
+    
     public:
     WorkHorse (options * opts, std::string timestamp, std::string commandLine) 
         { 
             mOpts = opts; 
             mMaxReadLength = 0;
+            mGroupsOutput = 0;
             mStringCheck.setName("WH");
             mTimeStamp = timestamp;
             mCommandLine = commandLine;
@@ -102,17 +159,30 @@ class WorkHorse {
         //**************************************
         int parseSeqFiles(Vecstr seqFiles);	// parse the raw read files
         
-        int buildGraph(void);									// build the basic graph structue
+        void writeSearchCheckpoint(std::string fileName, lookupTable& readsFound);     // save everything the search found
+        
+        void readSearchCheckpoint(std::string fileName, lookupTable& readsFound, std::string& runID);     // and load it back in, runID is the run that saved it
         
-        int cleanGraph(void);									// clean the graph structue
+        void readClusterIndex(std::string runID);               // what the run that wrote the checkpoint made of its clusters
+        
+        void writeClusterIndex(void);                           // what this run made of its clusters, for the next run to resume from
+        
+        int assembleGroups(void);								// build, clean and split the graphs of all groups
+        
+        GroupAssemblyTask * newGroupTask(int GID, DR_Cluster * group, GroupOutputQueue * output, size_t outputIndex);     // set a group up for assembly, before any group is assembled
+        
+        int assembleGroup(int GID, DR_Cluster * group, NodeManager ** manager, int firstStage, double * stageTimes, int * prunedBefore);
+        
+        int writeGraphSnapshot(int GID, NodeManager * manager, int nextStage);     // save a group's graph if asked to, nextStage is where it picks up again
+        
+        int loadGraphSnapshots(Vecstr snapshotFiles);           // make groups out of saved graphs instead of searching
 
         void removeRedundantRepeats(Vecstr& repeatVector);
         
         Vecstr * createNonRedundantSet(GroupKmerMap& groupKmerCountsMap, 
-                                                         int& nextFreeGID);
+                                                         int& nextFreeGID,
+                                                         const std::set<StringToken>& skipDRs);
 
-        int removeLowConfidenceNodeManagers(void);
-        
         int findConsensusDRs(GroupKmerMap& groupKmerCountsMap, 
                              int& nextFreeGID);
     
@@ -136,22 +206,20 @@ class WorkHorse {
         
         void splitGroupedDR( std::map<char, int>& collaped_options, Aligner& dr_aligner, int collapsed_pos, int GID, int * nextFreeGID);
         bool parseGroupedDRs( int GID, int * nextFreeGID);
+        void findPartialRepeats(std::vector<ReadHolder *>& groupReads, SmithWaterman& partialAligner);
+        void indexTrueDR(int GID);
+        void clusterMembers(int GID, ClusterMembers& members);
+        void recordClusterOutcome(int GID, ClusterMembers& members, int firstNewGID, int nextFreeGID);
+        bool canCopyCluster(ClusterOutcome& outcome);
+        void rerunCluster(int GID, int firstNewGID, ClusterMembers& members, ClusterOutcome& outcome);
+        bool copyClusterThrough(int GID, int firstNewGID, ClusterMembers& members, ClusterOutcome& outcome);
         void combineGroupsWithIdenticalDRs();
         
         int numberOfReadsInGroup(DR_Cluster * currentGroup);
         
-        void cleanGroup(int GID);
+        int mostSpacersInGroup(DR_Cluster * currentGroup);     // at least as many as the group's graph will get
         
-        //**************************************
-        // spacer graphs
-        //**************************************
-        int makeSpacerGraphs(void);
-        int cleanSpacerGraphs(void);
-        int generateFlankers(void);
-        //**************************************
-        // contig making
-        //**************************************
-        int splitIntoContigs(void);
+        void cleanGroup(int GID);
         
         //**************************************
         // file IO
@@ -162,9 +230,7 @@ class WorkHorse {
     }
         //int dumpSpacers(void);										// Dump the spacers for this group to file
         
-        int renderDebugGraphs(void);							// render debug graphs
-        
-        int renderDebugGraphs(std::string namePrefix);
+        int renderDebugGraph(int GID, NodeManager * manager, std::string namePrefix);	// render a debug graph
         
         int renderSpacerGraphs(void);							// render debug graphs
         
@@ -172,13 +238,19 @@ class WorkHorse {
         
         int checkFileOrError(const char * fileName);
     
-        bool outputResults(void) { return outputResults(mOpts->output_fastq + "crass"); } // print all the assembly gossip to XML
+        int openOutput(void) { return openOutput(mOpts->output_fastq + "crass"); } // get ready to print all the assembly gossip to XML
         
-        bool outputResults(std::string namePrefix);
+        int openOutput(std::string namePrefix);
+        
+        int writeGroup(int GID, NodeManager ** manager, GroupOutput& output);   // print one assembled group's own files, keep its part of the shared ones and free its node manager
+        
+        void appendGroup(GroupOutput& output);                  // put a written group in the shared files, one group at a time in GID order
+        
+        int closeOutput(void);
 
-        bool addDataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMElement * groupElement, int groupNumber);
+        bool addDataToXML(crispr::xml::streamer& xmlOut, int groupNumber, std::ostream * sourcesFile = NULL);
         
-        bool addMetadataToDOM(crispr::xml::writer * xmlDoc, xercesc::DOMElement * groupElement, int groupNumber);
+        bool addMetadataToXML(crispr::xml::streamer& xmlOut, int groupNumber);
 
         
     // members
@@ -194,6 +266,72 @@ class WorkHorse {
         std::map<int, bool> mGroupMap;				// list of valid group IDs
         DR_Cluster_Map mDR2GIDMap;					// map a DR (StringToken) to a GID
         std::map<int, std::string> mTrueDRs;		// map GId to true DR strings
+        TrueDR_Index mTrueDRIndex;                  // map true DR strings to the lowest GID that has them
+        std::vector<int> mIdenticalDRGroups;        // GIDs whose true DR is already owned by another group
+        AlignmentCache mAlignmentCache;             // slave alignments kept while groups are split and realigned
+        std::map<int, int> mFirstStages;            // the stage each group loaded from a snapshot starts at
+        std::map<int, std::string> mSnapshotFiles;  // the last snapshot written for each group
+        std::map<int, int> mMostSpacers;            // the most spacers each group's reads could make, -1 if never counted
+        std::string mRunID;                         // ties a run's checkpoint and cluster index together
+        std::set<StringToken> mSingletonDRs;        // DRs that only singletons have turned up for, they're never clustered
+        ClusterIndex mPriorClusters;                // what the run we resumed from made of its clusters
+        std::map<int, ClusterRecord> mClusters;     // what this run made of its clusters, by cluster GID
+        crispr::xml::streamer mXMLOut;              // the .crispr file the groups go out to as they are assembled
+        std::string mOutputName;                    // and its name
+        std::ofstream mKeyFile;                     // the keys to every group's spacer graph
+        std::ofstream mSourcesFile;                 // the spacer sources, when they're kept out of the XML
+        int mGroupsOutput;                          // how many groups have made it to the XML
+};
+
+// Groups finish in whatever order the pool gets through them but go out
+// to the shared files in GID order. Whichever thread finishes the group
+// that is next in line appends it, along with any after it that were only
+// waiting on it, while the other threads get on with assembling
+class GroupOutputQueue {
+public:
+    GroupOutputQueue(WorkHorse * workHorse, size_t groups);
+    ~GroupOutputQueue(void);
+
+    // the group at index is done with, output is what it left for the
+    // shared files or NULL if it left nothing
+    void finished(size_t index, GroupOutput * output);
+
+private:
+    WorkHorse * GOQ_WorkHorse;
+    std::vector<GroupOutput> GOQ_Outputs;       // in the order they go out
+    std::vector<bool> GOQ_Finished;
+    size_t GOQ_Next;                            // the first group not yet appended
+    bool GOQ_Appending;                         // a thread is busy appending groups
+    pthread_mutex_t GOQ_Lock;
+};
+
+// one group's trip through the graph pipeline, for the pool. The group's
+// own files are written and its node manager freed straight after
+class GroupAssemblyTask : public PoolTask {
+public:
+    GroupAssemblyTask(WorkHorse * workHorse, int GID, DR_Cluster * group, NodeManager ** manager, int firstStage, size_t reads, GroupOutputQueue * output, size_t outputIndex);
+
+    int run(void);
+
+    inline double stageTime(int stage) const { return GAT_StageTimes[stage]; }
+    
+    // the first stage the group didn't go through, WH_GRAPH_STAGES if it did them all
+    inline int prunedBefore(void) const { return GAT_PrunedBefore; }
+    
+    // the group was assembled but couldn't be written
+    inline bool writeFailed(void) const { return GAT_WriteFailed; }
+
+private:
+    WorkHorse * GAT_WorkHorse;
+    int GAT_GID;
+    DR_Cluster * GAT_Group;
+    NodeManager ** GAT_Manager;
+    int GAT_FirstStage;
+    double GAT_StageTimes[WH_GRAPH_STAGES];
+    int GAT_PrunedBefore;
+    bool GAT_WriteFailed;
+    GroupOutputQueue * GAT_Output;
+    size_t GAT_OutputIndex;
 };
 
 #endif //WorkHorse_h
@@ -0,0 +1,204 @@
+/*
+ *  WorkStealingPool.cpp is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+
+// system includes
+#include <algorithm>
+#include <iostream>
+#include <exception>
+#include <string>
+
+// local includes
+#include "WorkStealingPool.h"
+#include "Exception.h"
+
+static bool costlierTask(const PoolTask * a, const PoolTask * b)
+{
+    return a->cost() > b->cost();
+}
+
+WorkStealingPool::WorkStealingPool(int numThreads)
+{
+    WSP_NumThreads = (numThreads < 1) ? 1 : numThreads;
+    for (int i = 0; i < WSP_NumThreads; i++)
+    {
+        WorkQueue * queue = new WorkQueue;
+        pthread_mutex_init(&(queue->lock), NULL);
+        WSP_Queues.push_back(queue);
+    }
+    pthread_mutex_init(&WSP_FailLock, NULL);
+    WSP_Failed = 0;
+}
+
+WorkStealingPool::~WorkStealingPool(void)
+{
+    for (size_t i = 0; i < WSP_Queues.size(); i++)
+    {
+        pthread_mutex_destroy(&(WSP_Queues[i]->lock));
+        delete WSP_Queues[i];
+    }
+    pthread_mutex_destroy(&WSP_FailLock);
+}
+
+int WorkStealingPool::runAll(std::vector<PoolTask *>& tasks)
+{
+    //-----
+    // deal the tasks out biggest first so every queue starts on the
+    // biggest thing it has and then let the threads loose on them
+    //
+    std::vector<PoolTask *> sorted_tasks(tasks);
+    std::stable_sort(sorted_tasks.begin(), sorted_tasks.end(), costlierTask);
+    for (size_t i = 0; i < sorted_tasks.size(); i++)
+    {
+        WSP_Queues[i % WSP_NumThreads]->tasks.push_back(sorted_tasks[i]);
+    }
+    WSP_Failed = 0;
+
+    // no point starting more threads than there are tasks
+    int thread_count = std::min(WSP_NumThreads, (int)sorted_tasks.size());
+    std::vector<pthread_t> threads(thread_count > 1 ? thread_count - 1 : 0);
+    std::vector<WorkerArgs> args(threads.size());
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        args[i].pool = this;
+        args[i].queue = (int)i + 1;
+        if (pthread_create(&threads[i], NULL, workerMain, &args[i]) != 0)
+        {
+            // the other threads will steal its queue
+            threads.resize(i);
+            break;
+        }
+    }
+    work(0);
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    return WSP_Failed;
+}
+
+void * WorkStealingPool::workerMain(void * args)
+{
+    WorkerArgs * worker_args = static_cast<WorkerArgs *>(args);
+    worker_args->pool->work(worker_args->queue);
+    return NULL;
+}
+
+void WorkStealingPool::work(int queue)
+{
+    PoolTask * task;
+    while ((task = nextTask(queue)) != NULL)
+    {
+        int failed = 1;
+        std::string error;
+        try {
+            failed = task->run();
+        } catch (crispr::exception& e) {
+            error = e.what();
+        } catch (std::exception& e) {
+            error = e.what();
+        } catch (...) {
+            error = "an unknown exception has occurred in a pool task";
+        }
+        if (failed)
+        {
+            pthread_mutex_lock(&WSP_FailLock);
+            WSP_Failed++;
+            if (!error.empty())
+            {
+                std::cerr<<error<<std::endl;
+            }
+            pthread_mutex_unlock(&WSP_FailLock);
+        }
+    }
+}
+
+PoolTask * WorkStealingPool::nextTask(int queue)
+{
+    //-----
+    // take the next task off our own queue, or failing that the biggest
+    // task waiting on any other queue. The tasks are whole groups so the
+    // locks are hardly ever fought over, which means thieves can take
+    // from the front where the big ones are rather than from the back
+    //
+    PoolTask * task = NULL;
+    WorkQueue * own = WSP_Queues[queue];
+    pthread_mutex_lock(&(own->lock));
+    if (!own->tasks.empty())
+    {
+        task = own->tasks.front();
+        own->tasks.pop_front();
+    }
+    pthread_mutex_unlock(&(own->lock));
+    if (task != NULL)
+    {
+        return task;
+    }
+
+    while (true)
+    {
+        int victim = -1;
+        size_t victim_cost = 0;
+        for (int i = 0; i < WSP_NumThreads; i++)
+        {
+            if (i == queue) continue;
+            WorkQueue * other = WSP_Queues[i];
+            pthread_mutex_lock(&(other->lock));
+            if (!other->tasks.empty() && (victim == -1 || other->tasks.front()->cost() > victim_cost))
+            {
+                victim = i;
+                victim_cost = other->tasks.front()->cost();
+            }
+            pthread_mutex_unlock(&(other->lock));
+        }
+        if (victim == -1)
+        {
+            // everything has been handed out
+            return NULL;
+        }
+        WorkQueue * other = WSP_Queues[victim];
+        pthread_mutex_lock(&(other->lock));
+        if (!other->tasks.empty())
+        {
+            task = other->tasks.front();
+            other->tasks.pop_front();
+        }
+        pthread_mutex_unlock(&(other->lock));
+        if (task != NULL)
+        {
+            return task;
+        }
+        // someone beat us to it, look again
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ *  WorkStealingPool.h is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+
+#ifndef crass_WorkStealingPool_h
+#define crass_WorkStealingPool_h
+
+// system includes
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+// one lump of work for the pool. cost is only used to decide what gets
+// started first so any rough measure of size will do
+class PoolTask {
+public:
+    PoolTask(size_t cost): PT_Cost(cost) {}
+    virtual ~PoolTask(void) {}
+
+    // return non-zero if the task failed
+    virtual int run(void) = 0;
+
+    inline size_t cost(void) const { return PT_Cost; }
+
+private:
+    size_t PT_Cost;
+};
+
+class WorkStealingPool {
+public:
+    WorkStealingPool(int numThreads);
+    ~WorkStealingPool(void);
+
+    // run every task and come back when they are all done. Each thread
+    // gets its own queue and works through it biggest task first, once
+    // its queue runs dry it steals the biggest task left on anyone else's.
+    // The calling thread does its share of the work too. Returns the
+    // number of tasks that failed or threw
+    int runAll(std::vector<PoolTask *>& tasks);
+
+    inline int numThreads(void) const { return WSP_NumThreads; }
+
+private:
+    typedef struct {
+        pthread_mutex_t lock;
+        std::deque<PoolTask *> tasks;
+    } WorkQueue;
+
+    typedef struct {
+        WorkStealingPool * pool;
+        int queue;
+    } WorkerArgs;
+
+    static void * workerMain(void * args);
+    void work(int queue);
+    PoolTask * nextTask(int queue);
+
+    int WSP_NumThreads;
+    std::vector<WorkQueue *> WSP_Queues;
+    pthread_mutex_t WSP_FailLock;
+    int WSP_Failed;
+};
+
+#endif
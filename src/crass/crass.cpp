@@ -111,6 +111,7 @@ void usage(void)
     std::cout<< "-o --outDir          <DIR>   Output directory [default: .]"<<std::endl;
     std::cout<< "-V --version                 Program and version information"<<std::endl;
     std::cout<< "-g --logToScreen             Print the logging information to screen rather than a file"<<std::endl;
+    std::cout<< "-t --threads         <INT>   Number of threads used to assemble the CRISPRs [Default: "<<CRASS_DEF_NUM_THREADS<<"]"<<std::endl;
     std::cout<<std::endl;
     std::cout<<"CRISPR Identification Options:"<<std::endl;
     std::cout<< "-d --minDR           <INT>   Minimim length of the direct repeat"<<std::endl; 
@@ -167,12 +168,18 @@ void usage(void)
     std::cout<<"                              red-blue, blue-red, green-red-blue, red-blue-green"<<std::endl;
     std::cout<<"-L --longDescription          Set if you want the spacer sequence printed along with the ID in the spacer graph. [Default: false]"<<std::endl;
     std::cout<<"-G --showSingltons            Set if you want to print singleton spacers in the spacer graph [Default: false]"<<std::endl;
+    std::cout<<"-O --sourcesFile              Write the sources of each spacer to a .sources file instead of the XML [Default: false]"<<std::endl;
 #ifdef DEBUG
     std::cout<<"-e --noDebugGraph             Stops creation of debug .gv files even if the DEBUG preprocessor macro is set [Default: false]"<<std::endl;
 #endif
 #ifdef RENDERING
     std::cout<<"-r --noRendering              Stops rendering of .gv files even if the RENDERING preprocessor macro is set [Default: false]"<<std::endl;
 #endif
+    std::cout<<"--checkpoint          <FILE>  Save the state of the search to this file so it can be picked up again later"<<std::endl;
+    std::cout<<"--resumeFrom          <FILE>  Pick up from a checkpoint made with --checkpoint, any sequence files given are searched on top of it"<<std::endl;
+    std::cout<<"--graphSnapshots      <DIR>   Save the graph of every group to this directory once it is built and again once it is cleaned."<<std::endl;
+    std::cout<<"                              With --resumeFrom, clusters the new files don't change are copied from the snapshots left here"<<std::endl;
+    std::cout<<"--fromGraphSnapshots          The files given are graph snapshots to pick up from rather than sequence files"<<std::endl;
 #ifdef SEARCH_SINGLETON
     std::cout<<"--searchChecker       <FILE>  A file containing read headers that should be tracked through "<<PACKAGE_NAME<<std::endl;
 #endif
@@ -195,7 +202,7 @@ int processOptions(int argc, char *argv[], options *opts)
 {
     int c;
     int index;
-    while( (c = getopt_long(argc, argv, "a:b:c:d:D:ef:gGhk:K:l:Ln:o:rs:S:Vw:", long_options, &index)) != -1 ) 
+    while( (c = getopt_long(argc, argv, "a:b:c:d:D:ef:gGhk:K:l:Ln:o:Ors:S:t:Vw:", long_options, &index)) != -1 ) 
     {
         switch(c) 
         {
@@ -313,6 +320,9 @@ int processOptions(int argc, char *argv[], options *opts)
             case 'L':
                 opts->longDescription = true;
                 break;
+            case 'O':
+                opts->sourcesFile = true;
+                break;
             case 'n':
                 from_string<unsigned int>(opts->minNumRepeats, optarg, std::dec);
                 if (opts->minNumRepeats < 2) 
@@ -359,6 +369,14 @@ int processOptions(int argc, char *argv[], options *opts)
             case 'S': 
                 from_string<unsigned int>(opts->highSpacerSize, optarg, std::dec);
                 break;
+            case 't':
+                from_string<int>(opts->numThreads, optarg, std::dec);
+                if (opts->numThreads < 1) 
+                {
+                    std::cerr<<PACKAGE_NAME<<" [WARNING]: Need at least one thread, changing to "<<CRASS_DEF_NUM_THREADS<<std::endl;
+                    opts->numThreads = CRASS_DEF_NUM_THREADS;
+                }
+                break;
             case 'V': 
                 versionInfo(); 
                 exit(1); 
@@ -373,6 +391,28 @@ int processOptions(int argc, char *argv[], options *opts)
                 }
                 break;        
             case 0:
+                if (strcmp("checkpoint", long_options[index].name) == 0) opts->checkpointFile = optarg;
+                if (strcmp("resumeFrom", long_options[index].name) == 0) opts->resumeFrom = optarg;
+                if (strcmp("graphSnapshots", long_options[index].name) == 0) 
+                {
+                    opts->graphSnapshots = optarg;
+                    if (opts->graphSnapshots.empty())
+                    {
+                        std::cerr<<PACKAGE_NAME<<" [ERROR]: The graph snapshot directory cannot be empty"<<std::endl;
+                        usage();
+                        exit(1);
+                    }
+                    if (opts->graphSnapshots[opts->graphSnapshots.length() - 1] != '/')
+                    {
+                        opts->graphSnapshots += '/';
+                    }
+                    struct stat snapshot_stats;
+                    if (0 != stat(opts->graphSnapshots.c_str(), &snapshot_stats)) 
+                    {
+                        RecursiveMkdir(opts->graphSnapshots);
+                    }
+                }
+                if (strcmp("fromGraphSnapshots", long_options[index].name) == 0) opts->fromGraphSnapshots = true;
 #ifdef SEARCH_SINGLETON
                 if (strcmp("searchChecker", long_options[index].name) == 0) opts->searchChecker = optarg;
 #endif
@@ -444,7 +484,12 @@ int main(int argc, char *argv[])
     opts.graphColourType       = CRASS_DEF_GRAPH_COLOUR;                 // the colour type of the graph
     opts.longDescription       = CRASS_DEF_SPACER_LONG_DESC;             // print a long description for the final spacer graph
     opts.showSingles           = CRASS_DEF_SPACER_SHOW_SINGLES;          // print singletons when making the spacer graph
+    opts.sourcesFile           = CRASS_DEF_SOURCES_FILE;                 // write the spacer sources to their own file
     opts.cNodeKmerLength       = CRASS_DEF_NODE_KMER_SIZE;               // length of the kmers making up a crisprnode
+    opts.checkpointFile        = "";                                     // no checkpoint unless asked for
+    opts.resumeFrom            = "";                                     // search the sequence files unless told to resume
+    opts.graphSnapshots        = "";                                     // no graph snapshots unless asked for
+    opts.fromGraphSnapshots    = false;                                  // the files on the command line are reads
 #ifdef DEBUG
     opts.noDebugGraph          = false;                                  // Even if DEBUG preprocessor macro is set do not produce debug graph files
 #endif
@@ -458,10 +503,12 @@ int main(int argc, char *argv[])
     opts.layoutAlgorithm       = "unset";
 #endif
     opts.covCutoff             = CRASS_DEF_COVCUTOFF;
+    opts.numThreads            = CRASS_DEF_NUM_THREADS;
 
     int opt_idx = processOptions(argc, argv, &opts);
 
-    if (opt_idx >= argc) 
+    // a resumed run already has its reads, any files given are added to them
+    if (opt_idx >= argc && opts.resumeFrom.empty()) 
     {
         std::cerr<<PACKAGE_NAME<<" [ERROR]: Specify sequence files to process!"<<std::endl;
         usage();
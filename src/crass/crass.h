@@ -75,16 +75,22 @@ static struct option long_options [] = {
     {"longDescription",no_argument,NULL,'L'},
     {"minNumRepeats", required_argument, NULL, 'n'},
     {"outDir", required_argument, NULL, 'o'},
+    {"sourcesFile", no_argument, NULL, 'O'},
 #ifdef RENDERING
     {"noRendering",no_argument,NULL,'r'},
 #endif
     {"minSpacer", required_argument, NULL, 's'},
     {"maxSpacer", required_argument, NULL, 'S'},
+    {"threads", required_argument, NULL, 't'},
     {"version", no_argument, NULL, 'V'},
     {"windowLength", required_argument, NULL, 'w'},
     {"spacerScalling",required_argument,NULL,'x'},
     {"repeatScalling",required_argument,NULL,'y'},
     {"noScalling",no_argument,NULL,'z'},
+    {"checkpoint", required_argument, NULL, 0},
+    {"resumeFrom", required_argument, NULL, 0},
+    {"graphSnapshots", required_argument, NULL, 0},
+    {"fromGraphSnapshots", no_argument, NULL, 0},
 #ifdef SEARCH_SINGLETON
     {"searchChecker", required_argument, NULL, 0},
 #endif
@@ -66,11 +66,12 @@
 #define CRASS_DEF_KMER_SIZE                     (11)					// length of the kmers used when clustering DR groups
 #define CRASS_DEF_K_CLUST_MIN                   (6)					// number of shared kmers needed to group DR variants together
 #define CRASS_DEF_READ_COUNTER_LOGGER           (100000)
-#define CRASS_DEF_MAX_READS_FOR_DECISION        (1000)
+#define CRASS_DEF_MAX_READS_FOR_DECISION        (1000)                // reads sampled from a group to make the DR consensus
+#define CRASS_DEF_READ_SAMPLING_SEED            (0x9e3779b9)          // fixed so the same input always gets the same sample
   // HARD CODED PARAMS FOR FINDING TRUE DRs
 #define CRASS_DEF_MIN_CONS_ARRAY_LEN            (1200)                // minimum size of the consensus array
-#define CRASS_DEF_CONS_ARRAY_RL_MULTIPLIER      (4)                   // find the cons array length by multiplying read length by this guy
-#define CRASS_DEF_CONS_ARRAY_START              (0.5)               // how far into the cons array to start placing reads 
+#define CRASS_DEF_CONS_ARRAY_PADDING            (8)                   // empty columns either side of the reads in the cons array
+#define CRASS_DEF_MAX_POOLED_ALIGNER_BUFFERS    (4)                   // how many sets of cons array buffers each thread keeps for reuse
 #define CRASS_DEF_PERCENT_IN_ZONE_CUT_OFF       (0.85)              // amount that a DR must agrre with the existsing DR within a zone to be added
 #define CRASS_DEF_NUM_KMERS_4_MODE              (5)                 // find the top XX occuring in the DR
 #define CRASS_DEF_NUM_KMERS_4_MODE_HALF         (CRASS_DEF_NUM_KMERS_4_MODE - (CRASS_DEF_NUM_KMERS_4_MODE/2)) // Ceil of 50% of CRASS_DEF_NUM_KMERS_4_MODE
@@ -110,6 +111,7 @@
 // --------------------------------------------------------------------
 #define CRASS_DEF_NODE_KMER_SIZE                (7)                   // size of the kmer that defines a crispr node
 #define CRASS_DEF_MAX_CLEANING                  (2)                   // the maximum length that a branch can be before it's cleaned
+#define CRASS_DEF_NODE_INLINE_EDGES             (4)                   // edges a crispr node holds before its edge list goes to the heap
 #define CRASS_DEF_STDEV_SPACER_LENGTH           (6.0)                 // the maximum standard deviation allowed in the length of spacers 
                                                                     // after the true DR is found that is allowable before it is removed
 // --------------------------------------------------------------------
@@ -124,6 +126,7 @@
 #define CRASS_DEF_MAX_SPACER_SIZE               (50)                  // maximum spacer size
 #define CRASS_DEF_NUM_DR_ERRORS                 (0)                   // maxiumum allowable errors in direct repeat
 #define CRASS_DEF_COVCUTOFF                     (3)                   // minimum number of attached spacers that a group needs to have
+#define CRASS_DEF_NUM_THREADS                   (1)                   // number of threads used to assemble the groups
 #ifdef DEBUG
     #define CRASS_DEF_MAX_LOGGING               (10)
 #else
@@ -136,6 +139,15 @@
 #define CRASS_DEF_GRAPH_COLOUR                  BLUE_RED            // default colour scale for the graphs
 #define CRASS_DEF_SPACER_LONG_DESC              false               // use a long desc of the spacer in the output graph
 #define CRASS_DEF_SPACER_SHOW_SINGLES           false                // do not show singles by default
+#define CRASS_DEF_SOURCES_FILE                  false               // sources go inline in the XML by default
+#define CRASS_DEF_SEARCH_CHECKPOINT_KIND        "search"            // what the checkpoint written after the search calls itself
+#define CRASS_DEF_SEARCH_CHECKPOINT_VERSION     (2)                 // bump whenever the layout of the search checkpoint changes
+#define CRASS_DEF_GRAPH_SNAPSHOT_KIND           "graph"             // the snapshots of each group's graph
+#define CRASS_DEF_GRAPH_SNAPSHOT_VERSION        (1)                 // bump whenever the layout of a NodeManager snapshot changes
+#define CRASS_DEF_GRAPH_SNAPSHOT_EXT            ".snapshot"         // after ".built" or ".cleaned" on the group's file name
+#define CRASS_DEF_CLUSTER_INDEX_KIND            "clusters"          // what each run made of its clusters, kept with the graph snapshots
+#define CRASS_DEF_CLUSTER_INDEX_VERSION         (1)                 // bump whenever the layout of the cluster index changes
+#define CRASS_DEF_CLUSTER_INDEX_FILE            "crass.clusters"
 
 typedef struct {
     int                 logLevel;                                           // level of verbosity allowed in the log file
@@ -156,6 +168,11 @@ typedef struct {
     bool                longDescription;                                    // print a long description for the final spacer graph
     bool                 showSingles;                                       // print singletons when making the spacer graph
     int                 cNodeKmerLength;                                    // length of the kmers making up a crisprnode
+    bool                sourcesFile;                                        // write the sources of the spacers to their own file instead of the XML
+    std::string         checkpointFile;                                     // save the state of the search to this file once it is finished
+    std::string         resumeFrom;                                         // load the state of the search from this file and search any files given on top
+    std::string         graphSnapshots;                                     // directory to save the graph of each group to after building and cleaning
+    bool                fromGraphSnapshots;                                 // the files on the command line are graph snapshots rather than reads
 #ifdef DEBUG
     bool                noDebugGraph;                                       // Even if DEBUG preprocessor macro is set do not produce debug graph files
 #endif
@@ -166,6 +183,7 @@ typedef struct {
     bool                noRendering;                                        // Even if RENDERING preprocessor macro is set do not produce any rendered images
 #endif
     int                 covCutoff;                                          // The lower bounds of acceptable numbers of reads that a group can have
+    int                 numThreads;                                         // number of threads used to assemble the groups
 
 } options;
 
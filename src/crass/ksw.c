@@ -36,17 +36,62 @@
 #define UNLIKELY(x) (x)
 #endif
 
+/*
+ * The wider kernels are built with per-function target attributes so the
+ * rest of the file (and the program) still only needs SSE2. Which one runs
+ * is decided from CPUID when the query profile is made.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__)
+#if __clang_major__ >= 4
+#define KSW_HAVE_AVX2 1
+#endif
+#if __clang_major__ >= 5
+#define KSW_HAVE_AVX512 1
+#endif
+#elif defined(__GNUC__)
+#if __GNUC__ >= 5
+#define KSW_HAVE_AVX2 1
+#endif
+#if __GNUC__ >= 6
+#define KSW_HAVE_AVX512 1
+#endif
+#endif
+#endif
+
+#if defined(KSW_HAVE_AVX2) || defined(KSW_HAVE_AVX512)
+#include <immintrin.h>
+#endif
+
 const kswr_t g_defr = { 0, -1, -1, -1, -1, -1, -1 };
 
 struct _kswq_t {
 	int qlen, slen;
 	uint8_t shift, mdiff, max, size;
-	__m128i *qp, *H0, *H1, *E, *Hmax;
+	uint8_t simd, vbytes; // the kernel this profile is laid out for and its vector width in bytes
+	void *qp, *H0, *H1, *E, *Hmax;
 };
 
+int ksw_simd_level(void)
+{
+#if defined(KSW_HAVE_AVX2) || defined(KSW_HAVE_AVX512)
+	__builtin_cpu_init();
+#endif
+#ifdef KSW_HAVE_AVX512
+	if (__builtin_cpu_supports("avx512bw")) return KSW_SIMD_AVX512;
+#endif
+#ifdef KSW_HAVE_AVX2
+	if (__builtin_cpu_supports("avx2")) return KSW_SIMD_AVX2;
+#endif
+	return KSW_SIMD_SSE2;
+}
+
 /**
  * Initialize the query data structure
  *
+ * @param simd   Which kernel to lay the profile out for; KSW_SIMD_AUTO picks
+ *               the widest one the CPU supports. Requests for kernels the CPU
+ *               can't run fall back to the best one it can
  * @param size   Number of bytes used to store a score; valid valures are 1 or 2
  * @param qlen   Length of the query sequence
  * @param query  Query sequence
@@ -55,21 +100,27 @@ struct _kswq_t {
  *
  * @return       Query data structure
  */
-kswq_t *ksw_qinit(int size, int qlen, const uint8_t *query, int m, const int8_t *mat)
+kswq_t *ksw_qinit_simd(int simd, int size, int qlen, const uint8_t *query, int m, const int8_t *mat)
 {
 	kswq_t *q;
-	int slen, a, tmp, p;
+	int slen, a, tmp, p, best, vbytes;
+	uint8_t *base;
     
+	best = ksw_simd_level();
+	if (simd == KSW_SIMD_AUTO || simd > best) simd = best;
+	vbytes = simd == KSW_SIMD_AVX512? 64 : simd == KSW_SIMD_AVX2? 32 : 16;
 	size = size > 1? 2 : 1;
-	p = 8 * (3 - size); // # values per __m128i
+	p = vbytes / size; // # values per vector
 	slen = (qlen + p - 1) / p; // segmented length
-	q = (kswq_t*)malloc(sizeof(kswq_t) + 256 + 16 * slen * (m + 4)); // a single block of memory
-	q->qp = (__m128i*)(((size_t)q + sizeof(kswq_t) + 15) >> 4 << 4); // align memory
-	q->H0 = q->qp + slen * m;
-	q->H1 = q->H0 + slen;
-	q->E  = q->H1 + slen;
-	q->Hmax = q->E + slen;
+	q = (kswq_t*)malloc(sizeof(kswq_t) + vbytes + vbytes * slen * (m + 4)); // a single block of memory
+	base = (uint8_t*)(((size_t)q + sizeof(kswq_t) + vbytes - 1) / vbytes * vbytes); // align memory
+	q->qp = base;
+	q->H0 = base + vbytes * slen * m;
+	q->H1 = (uint8_t*)q->H0 + vbytes * slen;
+	q->E  = (uint8_t*)q->H1 + vbytes * slen;
+	q->Hmax = (uint8_t*)q->E + vbytes * slen;
 	q->slen = slen; q->qlen = qlen; q->size = size;
+	q->simd = simd; q->vbytes = vbytes;
 	// compute shift
 	tmp = m * m;
 	for (a = 0, q->shift = 127, q->mdiff = 0; a < tmp; ++a) { // find the minimum and maximum score
@@ -103,221 +154,211 @@ kswq_t *ksw_qinit(int size, int qlen, const uint8_t *query, int m, const int8_t
 	return q;
 }
 
-kswr_t ksw_u8(kswq_t *q, int tlen, const uint8_t *target, int _gapo, int _gape, int xtra) // the first gap costs -(_o+_e)
+kswq_t *ksw_qinit(int size, int qlen, const uint8_t *query, int m, const int8_t *mat)
 {
-	int slen, i, m_b, n_b, te = -1, gmax = 0, minsc, endsc;
-	uint64_t *b;
-	__m128i zero, gapoe, gape, shift, *H0, *H1, *E, *Hmax;
-	kswr_t r;
-    
-#define __max_16(ret, xx) do { \
-(xx) = _mm_max_epu8((xx), _mm_srli_si128((xx), 8)); \
-(xx) = _mm_max_epu8((xx), _mm_srli_si128((xx), 4)); \
-(xx) = _mm_max_epu8((xx), _mm_srli_si128((xx), 2)); \
-(xx) = _mm_max_epu8((xx), _mm_srli_si128((xx), 1)); \
-(ret) = _mm_extract_epi16((xx), 0) & 0x00ff; \
-} while (0)
-    
-	// initialization
-	r = g_defr;
-	minsc = (xtra&KSW_XSUBO)? xtra&0xffff : 0x10000;
-	endsc = (xtra&KSW_XSTOP)? xtra&0xffff : 0x10000;
-	m_b = n_b = 0; b = 0;
-	zero = _mm_set1_epi32(0);
-	gapoe = _mm_set1_epi8(_gapo + _gape);
-	gape = _mm_set1_epi8(_gape);
-	shift = _mm_set1_epi8(q->shift);
-	H0 = q->H0; H1 = q->H1; E = q->E; Hmax = q->Hmax;
-	slen = q->slen;
-	for (i = 0; i < slen; ++i) {
-		_mm_store_si128(E + i, zero);
-		_mm_store_si128(H0 + i, zero);
-		_mm_store_si128(Hmax + i, zero);
-	}
-	// the core loop
-	for (i = 0; i < tlen; ++i) {
-		int j, k, cmp, imax;
-		__m128i e, h, f = zero, max = zero, *S = q->qp + target[i] * slen; // s is the 1st score vector
-		h = _mm_load_si128(H0 + slen - 1); // h={2,5,8,11,14,17,-1,-1} in the above example
-		h = _mm_slli_si128(h, 1); // h=H(i-1,-1); << instead of >> because x64 is little-endian
-		for (j = 0; LIKELY(j < slen); ++j) {
-			/* SW cells are computed in the following order:
-			 *   H(i,j)   = max{H(i-1,j-1)+S(i,j), E(i,j), F(i,j)}
-			 *   E(i+1,j) = max{H(i,j)-q, E(i,j)-r}
-			 *   F(i,j+1) = max{H(i,j)-q, F(i,j)-r}
-			 */
-			// compute H'(i,j); note that at the beginning, h=H'(i-1,j-1)
-			h = _mm_adds_epu8(h, _mm_load_si128(S + j));
-			h = _mm_subs_epu8(h, shift); // h=H'(i-1,j-1)+S(i,j)
-			e = _mm_load_si128(E + j); // e=E'(i,j)
-			h = _mm_max_epu8(h, e);
-			h = _mm_max_epu8(h, f); // h=H'(i,j)
-			max = _mm_max_epu8(max, h); // set max
-			_mm_store_si128(H1 + j, h); // save to H'(i,j)
-			// now compute E'(i+1,j)
-			h = _mm_subs_epu8(h, gapoe); // h=H'(i,j)-gapo
-			e = _mm_subs_epu8(e, gape); // e=E'(i,j)-gape
-			e = _mm_max_epu8(e, h); // e=E'(i+1,j)
-			_mm_store_si128(E + j, e); // save to E'(i+1,j)
-			// now compute F'(i,j+1)
-			f = _mm_subs_epu8(f, gape);
-			f = _mm_max_epu8(f, h);
-			// get H'(i-1,j) and prepare for the next j
-			h = _mm_load_si128(H0 + j); // h=H'(i-1,j)
-		}
-		// NB: we do not need to set E(i,j) as we disallow adjecent insertion and then deletion
-		for (k = 0; LIKELY(k < 16); ++k) { // this block mimics SWPS3; NB: H(i,j) updated in the lazy-F loop cannot exceed max
-			f = _mm_slli_si128(f, 1);
-			for (j = 0; LIKELY(j < slen); ++j) {
-				h = _mm_load_si128(H1 + j);
-				h = _mm_max_epu8(h, f); // h=H'(i,j)
-				_mm_store_si128(H1 + j, h);
-				h = _mm_subs_epu8(h, gapoe);
-				f = _mm_subs_epu8(f, gape);
-				cmp = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(f, h), zero));
-				if (UNLIKELY(cmp == 0xffff)) goto end_loop16;
-			}
-		}
-    end_loop16:
-		//int k;for (k=0;k<16;++k)printf("%d ", ((uint8_t*)&max)[k]);printf("\n");
-		__max_16(imax, max); // imax is the maximum number in max
-		if (imax >= minsc) { // write the b array; this condition adds branching unfornately
-			if (n_b == 0 || (int32_t)b[n_b-1] + 1 != i) { // then append
-				if (n_b == m_b) {
-					m_b = m_b? m_b<<1 : 8;
-					b = (uint64_t*)realloc(b, 8 * m_b);
-				}
-				b[n_b++] = (uint64_t)imax<<32 | i;
-			} else if ((int)(b[n_b-1]>>32) < imax) b[n_b-1] = (uint64_t)imax<<32 | i; // modify the last
-		}
-		if (imax > gmax) {
-			gmax = imax; te = i; // te is the end position on the target
-			for (j = 0; LIKELY(j < slen); ++j) // keep the H1 vector
-				_mm_store_si128(Hmax + j, _mm_load_si128(H1 + j));
-			if (gmax + q->shift >= 255 || gmax >= endsc) break;
-		}
-		S = H1; H1 = H0; H0 = S; // swap H0 and H1
-	}
-	r.score = gmax + q->shift < 255? gmax : 255;
-	r.te = te;
-	if (r.score != 255) { // get a->qe, the end of query match; find the 2nd best score
-		int max = -1, low, high, qlen = slen * 16;
-		uint8_t *t = (uint8_t*)Hmax;
-		for (i = 0; i < qlen; ++i, ++t)
-			if ((int)*t > max) max = *t, r.qe = i / 16 + i % 16 * slen;
-		//printf("%d,%d\n", max, gmax);
-		if (b) {
-			i = (r.score + q->max - 1) / q->max;
-			low = te - i; high = te + i;
-			for (i = 0; i < n_b; ++i) {
-				int e = (int32_t)b[i];
-				if ((e < low || e > high) && b[i]>>32 > (uint32_t)r.score2)
-					r.score2 = b[i]>>32, r.te2 = e;
-			}
-		}
+	return ksw_qinit_simd(KSW_SIMD_AUTO, size, qlen, query, m, mat);
+}
+
+/*
+ * Find the end of the query match from the H row kept at the best target
+ * position. Ties are broken in the order the 128-bit layout stores the
+ * query, so every kernel reports the same qe that the SSE2 one always has.
+ */
+static int ksw_query_end(const kswq_t *q)
+{
+	int i, max = -1, best_key = 0, qe = -1;
+	int p = q->vbytes / q->size, n = q->slen * p;
+	int p16 = 16 / q->size, slen16 = (q->qlen + p16 - 1) / p16;
+	for (i = 0; i < n; ++i) {
+		int k = i / p + i % p * q->slen, key, v;
+		if (k >= q->qlen) continue; // padding never holds the best score
+		v = q->size == 1? ((uint8_t*)q->Hmax)[i] : ((uint16_t*)q->Hmax)[i];
+		key = k % slen16 * p16 + k / slen16;
+		if (v > max || (v == max && key < best_key))
+			max = v, best_key = key, qe = k;
 	}
-	free(b);
-	return r;
+	return qe;
 }
 
-kswr_t ksw_i16(kswq_t *q, int tlen, const uint8_t *target, int _gapo, int _gape, int xtra) // the first gap costs -(_o+_e)
+// find the 2nd best score away from the best one
+static void ksw_second_best(const kswq_t *q, kswr_t *r, const uint64_t *b, int n_b)
 {
-	int slen, i, m_b, n_b, te = -1, gmax = 0, minsc, endsc;
-	uint64_t *b;
-	__m128i zero, gapoe, gape, *H0, *H1, *E, *Hmax;
-	kswr_t r;
-    
-#define __max_8(ret, xx) do { \
-(xx) = _mm_max_epi16((xx), _mm_srli_si128((xx), 8)); \
-(xx) = _mm_max_epi16((xx), _mm_srli_si128((xx), 4)); \
-(xx) = _mm_max_epi16((xx), _mm_srli_si128((xx), 2)); \
-(ret) = _mm_extract_epi16((xx), 0); \
-} while (0)
-    
-	// initialization
-	r = g_defr;
-	minsc = (xtra&KSW_XSUBO)? xtra&0xffff : 0x10000;
-	endsc = (xtra&KSW_XSTOP)? xtra&0xffff : 0x10000;
-	m_b = n_b = 0; b = 0;
-	zero = _mm_set1_epi32(0);
-	gapoe = _mm_set1_epi16(_gapo + _gape);
-	gape = _mm_set1_epi16(_gape);
-	H0 = q->H0; H1 = q->H1; E = q->E; Hmax = q->Hmax;
-	slen = q->slen;
-	for (i = 0; i < slen; ++i) {
-		_mm_store_si128(E + i, zero);
-		_mm_store_si128(H0 + i, zero);
-		_mm_store_si128(Hmax + i, zero);
+	int i, low, high;
+	i = (r->score + q->max - 1) / q->max;
+	low = r->te - i; high = r->te + i;
+	for (i = 0; i < n_b; ++i) {
+		int e = (int32_t)b[i];
+		if ((e < low || e > high) && b[i]>>32 > (uint32_t)r->score2)
+			r->score2 = b[i]>>32, r->te2 = e;
 	}
-	// the core loop
-	for (i = 0; i < tlen; ++i) {
-		int j, k, imax;
-		__m128i e, h, f = zero, max = zero, *S = q->qp + target[i] * slen; // s is the 1st score vector
-		h = _mm_load_si128(H0 + slen - 1); // h={2,5,8,11,14,17,-1,-1} in the above example
-		h = _mm_slli_si128(h, 2);
-		for (j = 0; LIKELY(j < slen); ++j) {
-			h = _mm_adds_epi16(h, *S++);
-			e = _mm_load_si128(E + j);
-			h = _mm_max_epi16(h, e);
-			h = _mm_max_epi16(h, f);
-			max = _mm_max_epi16(max, h);
-			_mm_store_si128(H1 + j, h);
-			h = _mm_subs_epu16(h, gapoe);
-			e = _mm_subs_epu16(e, gape);
-			e = _mm_max_epi16(e, h);
-			_mm_store_si128(E + j, e);
-			f = _mm_subs_epu16(f, gape);
-			f = _mm_max_epi16(f, h);
-			h = _mm_load_si128(H0 + j);
-		}
-		for (k = 0; LIKELY(k < 16); ++k) {
-			f = _mm_slli_si128(f, 2);
-			for (j = 0; LIKELY(j < slen); ++j) {
-				h = _mm_load_si128(H1 + j);
-				h = _mm_max_epi16(h, f);
-				_mm_store_si128(H1 + j, h);
-				h = _mm_subs_epu16(h, gapoe);
-				f = _mm_subs_epu16(f, gape);
-				if(UNLIKELY(!_mm_movemask_epi8(_mm_cmpgt_epi16(f, h)))) goto end_loop8;
-			}
-		}
-    end_loop8:
-		__max_8(imax, max);
-		if (imax >= minsc) {
-			if (n_b == 0 || (int32_t)b[n_b-1] + 1 != i) {
-				if (n_b == m_b) {
-					m_b = m_b? m_b<<1 : 8;
-					b = (uint64_t*)realloc(b, 8 * m_b);
-				}
-				b[n_b++] = (uint64_t)imax<<32 | i;
-			} else if ((int)(b[n_b-1]>>32) < imax) b[n_b-1] = (uint64_t)imax<<32 | i; // modify the last
-		}
-		if (imax > gmax) {
-			gmax = imax; te = i;
-			for (j = 0; LIKELY(j < slen); ++j)
-				_mm_store_si128(Hmax + j, _mm_load_si128(H1 + j));
-			if (gmax >= endsc) break;
-		}
-		S = H1; H1 = H0; H0 = S;
+}
+
+/*******************************************
+ * SSE2                                    *
+ *******************************************/
+
+static inline int ksw_hmax_epu8_sse2(__m128i xx)
+{
+	xx = _mm_max_epu8(xx, _mm_srli_si128(xx, 8));
+	xx = _mm_max_epu8(xx, _mm_srli_si128(xx, 4));
+	xx = _mm_max_epu8(xx, _mm_srli_si128(xx, 2));
+	xx = _mm_max_epu8(xx, _mm_srli_si128(xx, 1));
+	return _mm_extract_epi16(xx, 0) & 0x00ff;
+}
+
+static inline int ksw_hmax_epi16_sse2(__m128i xx)
+{
+	xx = _mm_max_epi16(xx, _mm_srli_si128(xx, 8));
+	xx = _mm_max_epi16(xx, _mm_srli_si128(xx, 4));
+	xx = _mm_max_epi16(xx, _mm_srli_si128(xx, 2));
+	return _mm_extract_epi16(xx, 0);
+}
+
+#define KSW_SUFFIX              sse2
+#define KSW_ATTR
+#define KSW_VEC                 __m128i
+#define KSW_VBYTES              16
+#define KSW_LOAD(p)             _mm_load_si128(p)
+#define KSW_STORE(p, x)         _mm_store_si128((p), (x))
+#define KSW_ZERO()              _mm_set1_epi32(0)
+#define KSW_SET1_8(x)           _mm_set1_epi8(x)
+#define KSW_SET1_16(x)          _mm_set1_epi16(x)
+#define KSW_ADDS_EPU8(a, b)     _mm_adds_epu8((a), (b))
+#define KSW_SUBS_EPU8(a, b)     _mm_subs_epu8((a), (b))
+#define KSW_MAX_EPU8(a, b)      _mm_max_epu8((a), (b))
+#define KSW_ADDS_EPI16(a, b)    _mm_adds_epi16((a), (b))
+#define KSW_SUBS_EPU16(a, b)    _mm_subs_epu16((a), (b))
+#define KSW_MAX_EPI16(a, b)     _mm_max_epi16((a), (b))
+#define KSW_SHL_8(x)            _mm_slli_si128((x), 1) // << instead of >> because x64 is little-endian
+#define KSW_SHL_16(x)           _mm_slli_si128((x), 2)
+#define KSW_ALL_LE_EPU8(f, h)   (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8((f), (h)), zero)) == 0xffff)
+#define KSW_ANY_GT_EPI16(f, h)  _mm_movemask_epi8(_mm_cmpgt_epi16((f), (h)))
+#define KSW_HMAX_EPU8(x)        ksw_hmax_epu8_sse2(x)
+#define KSW_HMAX_EPI16(x)       ksw_hmax_epi16_sse2(x)
+#include "ksw_kernels.h"
+
+/*******************************************
+ * AVX2                                    *
+ *******************************************/
+
+#ifdef KSW_HAVE_AVX2
+
+#define KSW_AVX2_ATTR __attribute__((target("avx2")))
+
+static inline KSW_AVX2_ATTR int ksw_hmax_epu8_avx2(__m256i xx)
+{
+	return ksw_hmax_epu8_sse2(_mm_max_epu8(_mm256_castsi256_si128(xx), _mm256_extracti128_si256(xx, 1)));
+}
+
+static inline KSW_AVX2_ATTR int ksw_hmax_epi16_avx2(__m256i xx)
+{
+	return ksw_hmax_epi16_sse2(_mm_max_epi16(_mm256_castsi256_si128(xx), _mm256_extracti128_si256(xx, 1)));
+}
+
+// byte shifts only work inside each 128-bit lane so carry across from the lane below
+#define KSW_AVX2_LANE_BELOW(x)  _mm256_permute2x128_si256((x), (x), 0x08)
+
+#define KSW_SUFFIX              avx2
+#define KSW_ATTR                KSW_AVX2_ATTR
+#define KSW_VEC                 __m256i
+#define KSW_VBYTES              32
+#define KSW_LOAD(p)             _mm256_load_si256(p)
+#define KSW_STORE(p, x)         _mm256_store_si256((p), (x))
+#define KSW_ZERO()              _mm256_setzero_si256()
+#define KSW_SET1_8(x)           _mm256_set1_epi8(x)
+#define KSW_SET1_16(x)          _mm256_set1_epi16(x)
+#define KSW_ADDS_EPU8(a, b)     _mm256_adds_epu8((a), (b))
+#define KSW_SUBS_EPU8(a, b)     _mm256_subs_epu8((a), (b))
+#define KSW_MAX_EPU8(a, b)      _mm256_max_epu8((a), (b))
+#define KSW_ADDS_EPI16(a, b)    _mm256_adds_epi16((a), (b))
+#define KSW_SUBS_EPU16(a, b)    _mm256_subs_epu16((a), (b))
+#define KSW_MAX_EPI16(a, b)     _mm256_max_epi16((a), (b))
+#define KSW_SHL_8(x)            _mm256_alignr_epi8((x), KSW_AVX2_LANE_BELOW(x), 15)
+#define KSW_SHL_16(x)           _mm256_alignr_epi8((x), KSW_AVX2_LANE_BELOW(x), 14)
+#define KSW_ALL_LE_EPU8(f, h)   (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8((f), (h)), zero)) == -1)
+#define KSW_ANY_GT_EPI16(f, h)  _mm256_movemask_epi8(_mm256_cmpgt_epi16((f), (h)))
+#define KSW_HMAX_EPU8(x)        ksw_hmax_epu8_avx2(x)
+#define KSW_HMAX_EPI16(x)       ksw_hmax_epi16_avx2(x)
+#include "ksw_kernels.h"
+
+#endif // KSW_HAVE_AVX2
+
+/*******************************************
+ * AVX-512BW                               *
+ *******************************************/
+
+#ifdef KSW_HAVE_AVX512
+
+#define KSW_AVX512_ATTR __attribute__((target("avx512f,avx512bw")))
+
+static inline KSW_AVX512_ATTR int ksw_hmax_epu8_avx512(__m512i xx)
+{
+	__m256i yy = _mm256_max_epu8(_mm512_castsi512_si256(xx), _mm512_extracti64x4_epi64(xx, 1));
+	return ksw_hmax_epu8_sse2(_mm_max_epu8(_mm256_castsi256_si128(yy), _mm256_extracti128_si256(yy, 1)));
+}
+
+static inline KSW_AVX512_ATTR int ksw_hmax_epi16_avx512(__m512i xx)
+{
+	__m256i yy = _mm256_max_epi16(_mm512_castsi512_si256(xx), _mm512_extracti64x4_epi64(xx, 1));
+	return ksw_hmax_epi16_sse2(_mm_max_epi16(_mm256_castsi256_si128(yy), _mm256_extracti128_si256(yy, 1)));
+}
+
+// each 128-bit lane moved up one place with zeros coming in at the bottom
+#define KSW_AVX512_LANE_BELOW(x) _mm512_maskz_shuffle_i64x2(0xfc, (x), (x), 0x90)
+
+#define KSW_SUFFIX              avx512
+#define KSW_ATTR                KSW_AVX512_ATTR
+#define KSW_VEC                 __m512i
+#define KSW_VBYTES              64
+#define KSW_LOAD(p)             _mm512_load_si512(p)
+#define KSW_STORE(p, x)         _mm512_store_si512((p), (x))
+#define KSW_ZERO()              _mm512_setzero_si512()
+#define KSW_SET1_8(x)           _mm512_set1_epi8(x)
+#define KSW_SET1_16(x)          _mm512_set1_epi16(x)
+#define KSW_ADDS_EPU8(a, b)     _mm512_adds_epu8((a), (b))
+#define KSW_SUBS_EPU8(a, b)     _mm512_subs_epu8((a), (b))
+#define KSW_MAX_EPU8(a, b)      _mm512_max_epu8((a), (b))
+#define KSW_ADDS_EPI16(a, b)    _mm512_adds_epi16((a), (b))
+#define KSW_SUBS_EPU16(a, b)    _mm512_subs_epu16((a), (b))
+#define KSW_MAX_EPI16(a, b)     _mm512_max_epi16((a), (b))
+#define KSW_SHL_8(x)            _mm512_alignr_epi8((x), KSW_AVX512_LANE_BELOW(x), 15)
+#define KSW_SHL_16(x)           _mm512_alignr_epi8((x), KSW_AVX512_LANE_BELOW(x), 14)
+#define KSW_ALL_LE_EPU8(f, h)   (_mm512_cmpgt_epu8_mask((f), (h)) == 0)
+#define KSW_ANY_GT_EPI16(f, h)  (_mm512_cmpgt_epi16_mask((f), (h)) != 0)
+#define KSW_HMAX_EPU8(x)        ksw_hmax_epu8_avx512(x)
+#define KSW_HMAX_EPI16(x)       ksw_hmax_epi16_avx512(x)
+#include "ksw_kernels.h"
+
+#endif // KSW_HAVE_AVX512
+
+/*******************************************
+ * Dispatch                                *
+ *******************************************/
+
+kswr_t ksw_u8(kswq_t *q, int tlen, const uint8_t *target, int _gapo, int _gape, int xtra)
+{
+	switch (q->simd) {
+#ifdef KSW_HAVE_AVX512
+		case KSW_SIMD_AVX512: return ksw_u8_avx512(q, tlen, target, _gapo, _gape, xtra);
+#endif
+#ifdef KSW_HAVE_AVX2
+		case KSW_SIMD_AVX2: return ksw_u8_avx2(q, tlen, target, _gapo, _gape, xtra);
+#endif
+		default: return ksw_u8_sse2(q, tlen, target, _gapo, _gape, xtra);
 	}
-	r.score = gmax; r.te = te;
-	{
-		int max = -1, low, high, qlen = slen * 8;
-		uint16_t *t = (uint16_t*)Hmax;
-		for (i = 0, r.qe = -1; i < qlen; ++i, ++t)
-			if ((int)*t > max) max = *t, r.qe = i / 8 + i % 8 * slen;
-		if (b) {
-			i = (r.score + q->max - 1) / q->max;
-			low = te - i; high = te + i;
-			for (i = 0; i < n_b; ++i) {
-				int e = (int32_t)b[i];
-				if ((e < low || e > high) && b[i]>>32 > (uint32_t)r.score2)
-					r.score2 = b[i]>>32, r.te2 = e;
-			}
-		}
+}
+
+kswr_t ksw_i16(kswq_t *q, int tlen, const uint8_t *target, int _gapo, int _gape, int xtra)
+{
+	switch (q->simd) {
+#ifdef KSW_HAVE_AVX512
+		case KSW_SIMD_AVX512: return ksw_i16_avx512(q, tlen, target, _gapo, _gape, xtra);
+#endif
+#ifdef KSW_HAVE_AVX2
+		case KSW_SIMD_AVX2: return ksw_i16_avx2(q, tlen, target, _gapo, _gape, xtra);
+#endif
+		default: return ksw_i16_sse2(q, tlen, target, _gapo, _gape, xtra);
 	}
-	free(b);
-	return r;
 }
 
 static void revseq(int l, uint8_t *s)
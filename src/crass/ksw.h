@@ -8,6 +8,12 @@
 #define KSW_XSUBO  0x40000
 #define KSW_XSTART 0x80000
 
+// which striped kernel a query profile is made for
+#define KSW_SIMD_AUTO   0
+#define KSW_SIMD_SSE2   1
+#define KSW_SIMD_AVX2   2
+#define KSW_SIMD_AVX512 3
+
 struct _kswq_t;
 typedef struct _kswq_t kswq_t;
 
@@ -62,6 +68,14 @@ extern "C" {
 	 */
 	kswr_t ksw_align(int qlen, uint8_t *query, int tlen, uint8_t *target, int m, const int8_t *mat, int gapo, int gape, int xtra, kswq_t **qry);
     kswq_t *ksw_qinit(int size, int qlen, const uint8_t *query, int m, const int8_t *mat);
+    
+    // ksw_qinit for a particular kernel, one of KSW_SIMD_*. ksw_u8 and ksw_i16
+    // run whichever kernel the profile was made for. All of the kernels give
+    // the same kswr_t as long as the gap open penalty is above zero
+    kswq_t *ksw_qinit_simd(int simd, int size, int qlen, const uint8_t *query, int m, const int8_t *mat);
+    
+    // the widest kernel this CPU can run
+    int ksw_simd_level(void);
     kswr_t ksw_u8(kswq_t *q, int tlen, const uint8_t *target, int _gapo, int _gape, int xtra);
     kswr_t ksw_i16(kswq_t *q, int tlen, const uint8_t *target, int _gapo, int _gape, int xtra);
 
@@ -0,0 +1,249 @@
+/* The MIT License
+ 
+ Copyright (c) 2011 by Attractive Chaos <attractor@live.co.uk>
+ 
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+ 
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+ */
+
+/*
+ * The striped Smith-Waterman kernels, written once against a small set of
+ * vector macros. ksw.c includes this file once per instruction set after
+ * defining:
+ *
+ *   KSW_SUFFIX             appended to the function names (ksw_u8_<suffix>)
+ *   KSW_ATTR               function attribute enabling the instruction set
+ *   KSW_VEC                the vector type
+ *   KSW_VBYTES             bytes per vector
+ *   KSW_LOAD / KSW_STORE   aligned load and store
+ *   KSW_ZERO, KSW_SET1_8, KSW_SET1_16
+ *   KSW_ADDS_EPU8, KSW_SUBS_EPU8, KSW_MAX_EPU8
+ *   KSW_ADDS_EPI16, KSW_SUBS_EPU16, KSW_MAX_EPI16
+ *   KSW_SHL_8, KSW_SHL_16  shift the whole vector up by one lane
+ *   KSW_ALL_LE_EPU8(f,h)   true when every f <= h
+ *   KSW_ANY_GT_EPI16(f,h)  true when any f > h
+ *   KSW_HMAX_EPU8, KSW_HMAX_EPI16  horizontal maximum
+ *
+ * All of the macros are undefined again at the bottom of this file.
+ */
+
+#define KSW_CAT2(a, b) a##_##b
+#define KSW_CAT(a, b) KSW_CAT2(a, b)
+
+static KSW_ATTR kswr_t KSW_CAT(ksw_u8, KSW_SUFFIX)(kswq_t *q, int tlen, const uint8_t *target, int _gapo, int _gape, int xtra) // the first gap costs -(_o+_e)
+{
+	int slen, i, m_b, n_b, te = -1, gmax = 0, minsc, endsc;
+	const int p = KSW_VBYTES; // # values per vector
+	uint64_t *b;
+	KSW_VEC zero, gapoe, gape, shift, *H0, *H1, *E, *Hmax;
+	kswr_t r;
+    
+	// initialization
+	r = g_defr;
+	minsc = (xtra&KSW_XSUBO)? xtra&0xffff : 0x10000;
+	endsc = (xtra&KSW_XSTOP)? xtra&0xffff : 0x10000;
+	m_b = n_b = 0; b = 0;
+	zero = KSW_ZERO();
+	gapoe = KSW_SET1_8(_gapo + _gape);
+	gape = KSW_SET1_8(_gape);
+	shift = KSW_SET1_8(q->shift);
+	H0 = (KSW_VEC*)q->H0; H1 = (KSW_VEC*)q->H1; E = (KSW_VEC*)q->E; Hmax = (KSW_VEC*)q->Hmax;
+	slen = q->slen;
+	for (i = 0; i < slen; ++i) {
+		KSW_STORE(E + i, zero);
+		KSW_STORE(H0 + i, zero);
+		KSW_STORE(Hmax + i, zero);
+	}
+	// the core loop
+	for (i = 0; i < tlen; ++i) {
+		int j, k, imax;
+		KSW_VEC e, h, f = zero, max = zero, *S = (KSW_VEC*)q->qp + target[i] * slen; // s is the 1st score vector
+		h = KSW_LOAD(H0 + slen - 1); // h={2,5,8,11,14,17,-1,-1} in the example in ksw_qinit
+		h = KSW_SHL_8(h); // h=H(i-1,-1)
+		for (j = 0; LIKELY(j < slen); ++j) {
+			/* SW cells are computed in the following order:
+			 *   H(i,j)   = max{H(i-1,j-1)+S(i,j), E(i,j), F(i,j)}
+			 *   E(i+1,j) = max{H(i,j)-q, E(i,j)-r}
+			 *   F(i,j+1) = max{H(i,j)-q, F(i,j)-r}
+			 */
+			// compute H'(i,j); note that at the beginning, h=H'(i-1,j-1)
+			h = KSW_ADDS_EPU8(h, KSW_LOAD(S + j));
+			h = KSW_SUBS_EPU8(h, shift); // h=H'(i-1,j-1)+S(i,j)
+			e = KSW_LOAD(E + j); // e=E'(i,j)
+			h = KSW_MAX_EPU8(h, e);
+			h = KSW_MAX_EPU8(h, f); // h=H'(i,j)
+			max = KSW_MAX_EPU8(max, h); // set max
+			KSW_STORE(H1 + j, h); // save to H'(i,j)
+			// now compute E'(i+1,j)
+			h = KSW_SUBS_EPU8(h, gapoe); // h=H'(i,j)-gapo
+			e = KSW_SUBS_EPU8(e, gape); // e=E'(i,j)-gape
+			e = KSW_MAX_EPU8(e, h); // e=E'(i+1,j)
+			KSW_STORE(E + j, e); // save to E'(i+1,j)
+			// now compute F'(i,j+1)
+			f = KSW_SUBS_EPU8(f, gape);
+			f = KSW_MAX_EPU8(f, h);
+			// get H'(i-1,j) and prepare for the next j
+			h = KSW_LOAD(H0 + j); // h=H'(i-1,j)
+		}
+		// NB: we do not need to set E(i,j) as we disallow adjecent insertion and then deletion
+		for (k = 0; LIKELY(k < p); ++k) { // this block mimics SWPS3; NB: H(i,j) updated in the lazy-F loop cannot exceed max
+			f = KSW_SHL_8(f);
+			for (j = 0; LIKELY(j < slen); ++j) {
+				h = KSW_LOAD(H1 + j);
+				h = KSW_MAX_EPU8(h, f); // h=H'(i,j)
+				KSW_STORE(H1 + j, h);
+				h = KSW_SUBS_EPU8(h, gapoe);
+				f = KSW_SUBS_EPU8(f, gape);
+				if (UNLIKELY(KSW_ALL_LE_EPU8(f, h))) goto end_loop16;
+			}
+		}
+    end_loop16:
+		imax = KSW_HMAX_EPU8(max); // imax is the maximum number in max
+		if (imax >= minsc) { // write the b array; this condition adds branching unfornately
+			if (n_b == 0 || (int32_t)b[n_b-1] + 1 != i) { // then append
+				if (n_b == m_b) {
+					m_b = m_b? m_b<<1 : 8;
+					b = (uint64_t*)realloc(b, 8 * m_b);
+				}
+				b[n_b++] = (uint64_t)imax<<32 | i;
+			} else if ((int)(b[n_b-1]>>32) < imax) b[n_b-1] = (uint64_t)imax<<32 | i; // modify the last
+		}
+		if (imax > gmax) {
+			gmax = imax; te = i; // te is the end position on the target
+			for (j = 0; LIKELY(j < slen); ++j) // keep the H1 vector
+				KSW_STORE(Hmax + j, KSW_LOAD(H1 + j));
+			if (gmax + q->shift >= 255 || gmax >= endsc) break;
+		}
+		S = H1; H1 = H0; H0 = S; // swap H0 and H1
+	}
+	r.score = gmax + q->shift < 255? gmax : 255;
+	r.te = te;
+	if (r.score != 255) { // get a->qe, the end of query match; find the 2nd best score
+		r.qe = ksw_query_end(q);
+		if (b) ksw_second_best(q, &r, b, n_b);
+	}
+	free(b);
+	return r;
+}
+
+static KSW_ATTR kswr_t KSW_CAT(ksw_i16, KSW_SUFFIX)(kswq_t *q, int tlen, const uint8_t *target, int _gapo, int _gape, int xtra) // the first gap costs -(_o+_e)
+{
+	int slen, i, m_b, n_b, te = -1, gmax = 0, minsc, endsc;
+	const int p = KSW_VBYTES / 2; // # values per vector
+	uint64_t *b;
+	KSW_VEC zero, gapoe, gape, *H0, *H1, *E, *Hmax;
+	kswr_t r;
+    
+	// initialization
+	r = g_defr;
+	minsc = (xtra&KSW_XSUBO)? xtra&0xffff : 0x10000;
+	endsc = (xtra&KSW_XSTOP)? xtra&0xffff : 0x10000;
+	m_b = n_b = 0; b = 0;
+	zero = KSW_ZERO();
+	gapoe = KSW_SET1_16(_gapo + _gape);
+	gape = KSW_SET1_16(_gape);
+	H0 = (KSW_VEC*)q->H0; H1 = (KSW_VEC*)q->H1; E = (KSW_VEC*)q->E; Hmax = (KSW_VEC*)q->Hmax;
+	slen = q->slen;
+	for (i = 0; i < slen; ++i) {
+		KSW_STORE(E + i, zero);
+		KSW_STORE(H0 + i, zero);
+		KSW_STORE(Hmax + i, zero);
+	}
+	// the core loop
+	for (i = 0; i < tlen; ++i) {
+		int j, k, imax;
+		KSW_VEC e, h, f = zero, max = zero, *S = (KSW_VEC*)q->qp + target[i] * slen; // s is the 1st score vector
+		h = KSW_LOAD(H0 + slen - 1); // h={2,5,8,11,14,17,-1,-1} in the example in ksw_qinit
+		h = KSW_SHL_16(h);
+		for (j = 0; LIKELY(j < slen); ++j) {
+			h = KSW_ADDS_EPI16(h, KSW_LOAD(S++));
+			e = KSW_LOAD(E + j);
+			h = KSW_MAX_EPI16(h, e);
+			h = KSW_MAX_EPI16(h, f);
+			max = KSW_MAX_EPI16(max, h);
+			KSW_STORE(H1 + j, h);
+			h = KSW_SUBS_EPU16(h, gapoe);
+			e = KSW_SUBS_EPU16(e, gape);
+			e = KSW_MAX_EPI16(e, h);
+			KSW_STORE(E + j, e);
+			f = KSW_SUBS_EPU16(f, gape);
+			f = KSW_MAX_EPI16(f, h);
+			h = KSW_LOAD(H0 + j);
+		}
+		for (k = 0; LIKELY(k < p); ++k) {
+			f = KSW_SHL_16(f);
+			for (j = 0; LIKELY(j < slen); ++j) {
+				h = KSW_LOAD(H1 + j);
+				h = KSW_MAX_EPI16(h, f);
+				KSW_STORE(H1 + j, h);
+				h = KSW_SUBS_EPU16(h, gapoe);
+				f = KSW_SUBS_EPU16(f, gape);
+				if (UNLIKELY(!KSW_ANY_GT_EPI16(f, h))) goto end_loop8;
+			}
+		}
+    end_loop8:
+		imax = KSW_HMAX_EPI16(max);
+		if (imax >= minsc) {
+			if (n_b == 0 || (int32_t)b[n_b-1] + 1 != i) {
+				if (n_b == m_b) {
+					m_b = m_b? m_b<<1 : 8;
+					b = (uint64_t*)realloc(b, 8 * m_b);
+				}
+				b[n_b++] = (uint64_t)imax<<32 | i;
+			} else if ((int)(b[n_b-1]>>32) < imax) b[n_b-1] = (uint64_t)imax<<32 | i; // modify the last
+		}
+		if (imax > gmax) {
+			gmax = imax; te = i;
+			for (j = 0; LIKELY(j < slen); ++j)
+				KSW_STORE(Hmax + j, KSW_LOAD(H1 + j));
+			if (gmax >= endsc) break;
+		}
+		S = H1; H1 = H0; H0 = S;
+	}
+	r.score = gmax; r.te = te;
+	r.qe = ksw_query_end(q);
+	if (b) ksw_second_best(q, &r, b, n_b);
+	free(b);
+	return r;
+}
+
+#undef KSW_CAT
+#undef KSW_CAT2
+#undef KSW_SUFFIX
+#undef KSW_ATTR
+#undef KSW_VEC
+#undef KSW_VBYTES
+#undef KSW_LOAD
+#undef KSW_STORE
+#undef KSW_ZERO
+#undef KSW_SET1_8
+#undef KSW_SET1_16
+#undef KSW_ADDS_EPU8
+#undef KSW_SUBS_EPU8
+#undef KSW_MAX_EPU8
+#undef KSW_ADDS_EPI16
+#undef KSW_SUBS_EPU16
+#undef KSW_MAX_EPI16
+#undef KSW_SHL_8
+#undef KSW_SHL_16
+#undef KSW_ALL_LE_EPU8
+#undef KSW_ANY_GT_EPI16
+#undef KSW_HMAX_EPU8
+#undef KSW_HMAX_EPI16
@@ -0,0 +1,277 @@
+/*
+ *  streamer.cpp is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+#include "streamer.h"
+#include "Exception.h"
+
+
+crispr::xml::streamer::streamer() {
+    XS_Out = &XS_File;
+    XS_Depth = 0;
+    XS_StartTagOpen = false;
+}
+
+crispr::xml::streamer::streamer(std::ostream& out, size_t depth) {
+    XS_Out = &out;
+    XS_Depth = depth;
+    XS_StartTagOpen = false;
+}
+
+crispr::xml::streamer::~streamer() {
+    if (XS_File.is_open()) 
+    {
+        close();
+    }
+}
+
+bool crispr::xml::streamer::open(std::string fileName, const char * rootElement, const char * versionNumber)
+{
+    XS_File.open(fileName.c_str());
+    if (!XS_File) 
+    {
+        return false;
+    }
+    XS_Out = &XS_File;
+    XS_Depth = 0;
+    XS_OpenElements.clear();
+    XS_StartTagOpen = false;
+    
+    // same declaration as writer's serializer puts out
+    *XS_Out << "<?xml version=\"1.0\" encoding=\"ISO8859-1\" standalone=\"no\" ?>";
+    beginElement(rootElement);
+    addAttribute("version", versionNumber);
+    return true;
+}
+
+bool crispr::xml::streamer::close(void)
+{
+    while (!XS_OpenElements.empty()) 
+    {
+        endElement();
+    }
+    *XS_Out << "\n";
+    XS_File.flush();
+    bool retval = XS_File.good();
+    XS_File.close();
+    return retval;
+}
+
+void crispr::xml::streamer::flush(void)
+{
+    closeStartTag();
+    XS_Out->flush();
+}
+
+void crispr::xml::streamer::addFragment(const std::string& fragment)
+{
+    closeStartTag();
+    *XS_Out << fragment;
+}
+
+//
+// Generic elements
+//
+
+void crispr::xml::streamer::beginElement(const char * tag)
+{
+    closeStartTag();
+    newLine();
+    *XS_Out << "<" << tag;
+    XS_OpenElements.push_back(tag);
+    XS_StartTagOpen = true;
+}
+
+void crispr::xml::streamer::addAttribute(const char * name, const std::string& value)
+{
+    *XS_Out << " " << name << "=\"" << escape(value) << "\"";
+}
+
+void crispr::xml::streamer::endElement(void)
+{
+    if (XS_OpenElements.empty()) 
+    {
+        throw crispr::xml_exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, "There is no open element to end");
+    }
+    if (XS_StartTagOpen) 
+    {
+        // nothing went in it
+        *XS_Out << "/>";
+        XS_StartTagOpen = false;
+        XS_OpenElements.pop_back();
+    } 
+    else 
+    {
+        std::string tag = XS_OpenElements.back();
+        XS_OpenElements.pop_back();
+        newLine();
+        *XS_Out << "</" << tag << ">";
+    }
+}
+
+void crispr::xml::streamer::addTextElement(const char * tag, const std::string& text)
+{
+    closeStartTag();
+    newLine();
+    *XS_Out << "<" << tag << ">" << escape(text) << "</" << tag << ">";
+}
+
+//
+// The crispr schema
+//
+
+void crispr::xml::streamer::beginGroup(std::string& gID, std::string& drConsensus)
+{
+    beginElement("group");
+    addAttribute("gid", gID);
+    addAttribute("drseq", drConsensus);
+}
+
+void crispr::xml::streamer::addSource(std::string& accession, std::string& soid)
+{
+    beginElement("source");
+    addAttribute("accession", accession);
+    addAttribute("soid", soid);
+    endElement();
+}
+
+void crispr::xml::streamer::addDirectRepeat(std::string& drid, std::string& seq)
+{
+    beginElement("dr");
+    addAttribute("seq", seq);
+    addAttribute("drid", drid);
+    endElement();
+}
+
+void crispr::xml::streamer::beginSpacer(std::string& seq, std::string& spid, std::string& cov)
+{
+    beginElement("spacer");
+    addAttribute("seq", seq);
+    addAttribute("spid", spid);
+    addAttribute("cov", cov);
+}
+
+void crispr::xml::streamer::addSpacerSource(std::string& soid)
+{
+    beginElement("source");
+    addAttribute("soid", soid);
+    endElement();
+}
+
+void crispr::xml::streamer::beginFlanker(std::string& seq, std::string& flid)
+{
+    beginElement("flanker");
+    addAttribute("seq", seq);
+    addAttribute("flid", flid);
+}
+
+void crispr::xml::streamer::beginContig(std::string& cid)
+{
+    beginElement("contig");
+    addAttribute("cid", cid);
+}
+
+void crispr::xml::streamer::beginSpacerToContig(std::string& spid)
+{
+    beginElement("cspacer");
+    addAttribute("spid", spid);
+}
+
+void crispr::xml::streamer::addSpacer(const char * tag, std::string& spid, std::string& drid, std::string& drconf)
+{
+    beginElement(tag);
+    addAttribute("drid", drid);
+    addAttribute("drconf", drconf);
+    addAttribute("spid", spid);
+    endElement();
+}
+
+void crispr::xml::streamer::addFlanker(const char * tag, std::string& flid, std::string& drconf, std::string& directjoin)
+{
+    beginElement(tag);
+    addAttribute("flid", flid);
+    addAttribute("drconf", drconf);
+    addAttribute("directjoin", directjoin);
+    endElement();
+}
+
+void crispr::xml::streamer::addFileToMetadata(const char * type, std::string url)
+{
+    beginElement("file");
+    addAttribute("type", type);
+    addAttribute("url", url);
+    endElement();
+}
+
+std::string crispr::xml::streamer::escape(const std::string& value)
+{
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (size_t i = 0; i < value.size(); i++) 
+    {
+        switch (value[i]) 
+        {
+            case '&':
+                escaped += "&amp;";
+                break;
+            case '<':
+                escaped += "&lt;";
+                break;
+            case '>':
+                escaped += "&gt;";
+                break;
+            case '"':
+                escaped += "&quot;";
+                break;
+            default:
+                escaped += value[i];
+                break;
+        }
+    }
+    return escaped;
+}
+
+void crispr::xml::streamer::closeStartTag(void)
+{
+    if (XS_StartTagOpen) 
+    {
+        *XS_Out << ">";
+        XS_StartTagOpen = false;
+    }
+}
+
+void crispr::xml::streamer::newLine(void)
+{
+    // two spaces for every element we're inside of
+    *XS_Out << "\n" << std::string(2 * (XS_Depth + XS_OpenElements.size()), ' ');
+}
@@ -0,0 +1,165 @@
+/*
+ *  streamer.h is part of the CRisprASSembler project
+ *
+ *  Created by Connor Skennerton.
+ *  Copyright 2011, 2012 Connor Skennerton & Michael Imelfort. All rights reserved.
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ *
+ *                     A B R A K A D A B R A
+ *                      A B R A K A D A B R
+ *                       A B R A K A D A B
+ *                        A B R A K A D A
+ *                         A B R A K A D
+ *                          A B R A K A
+ *                           A B R A K
+ *                            A B R A
+ *                             A B R
+ *                              A B
+ *                               A
+ */
+
+#ifndef STREAMER_H
+#define STREAMER_H
+
+// system includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <ostream>
+
+namespace crispr {
+    namespace xml {
+        // Writes a crispr file straight to disk as it goes, in place of
+        // building the whole document with writer first. Elements are closed
+        // in the reverse order they were opened, so a caller only ever needs
+        // to hold on to the part of the results it is writing right now.
+        // The layout is the same as writer's pretty printed output
+        class streamer {
+            
+            //members
+            std::ofstream XS_File;
+            std::ostream * XS_Out;                      // XS_File, or whatever a fragment is being written to
+            size_t XS_Depth;                            // how many elements a fragment goes inside of
+            std::vector<std::string> XS_OpenElements;   // names of the elements not yet closed, innermost last
+            bool XS_StartTagOpen;                       // the last start tag is still waiting for its '>'
+            
+        public:
+            
+            //constructor/destructor
+            streamer();
+            
+            /** Write a fragment of a crispr file, laid out to go depth
+             *  elements in, for a file streamer to take with addFragment
+             *  @param out Where the fragment goes
+             *  @param depth How many elements the fragment will be inside of
+             */
+            streamer(std::ostream& out, size_t depth);
+            ~streamer();
+            
+            /** Open a crispr file and write its root element's start tag
+             *  @param fileName The file to write to, anything there is overwritten
+             *  @param rootElement Name for the root element
+             *  @param versionNumber version for the crispr file to have
+             *  @return false if the file could not be opened
+             */
+            bool open(std::string fileName, const char * rootElement, const char * versionNumber);
+            
+            /** Close everything that is still open, including the root element, and then the file
+             *  @return false if anything failed to make it to disk
+             */
+            bool close(void);
+            
+            /** Push everything written so far out to disk   
+             */
+            void flush(void);
+            
+            inline bool isOpen(void) { return XS_File.is_open(); }
+            
+            /** Put a fragment written by another streamer inside the current element
+             *  @param fragment What the other streamer wrote
+             */
+            void addFragment(const std::string& fragment);
+            
+            //
+            // Generic elements
+            //
+            
+            /** Start a new element inside the current one   
+             *  @param tag The element's name
+             */
+            void beginElement(const char * tag);
+            
+            /** Give the element just started an attribute. Only valid before anything is put inside it
+             *  @param name The attribute's name
+             *  @param value The attribute's value, escaped on the way out
+             */
+            void addAttribute(const char * name, const std::string& value);
+            
+            /** Close the current element
+             *  @throws crispr::xml_exception if every element is already closed
+             */
+            void endElement(void);
+            
+            /** Add an element that holds only text, like 'name' or 'notes'   
+             *  @param tag The element's name
+             *  @param text The text, escaped on the way out
+             */
+            void addTextElement(const char * tag, const std::string& text);
+            
+            //
+            // The crispr schema, see writer for what each of these mean.
+            // The begin* calls must be matched with an endElement
+            //
+            void beginGroup(std::string& gID, std::string& drConsensus);
+            
+            void addSource(std::string& accession, std::string& soid);
+            
+            void addDirectRepeat(std::string& drid, std::string& seq);
+            
+            void beginSpacer(std::string& seq, std::string& spid, std::string& cov);
+            
+            void addSpacerSource(std::string& soid);
+            
+            void beginFlanker(std::string& seq, std::string& flid);
+            
+            void beginContig(std::string& cid);
+            
+            void beginSpacerToContig(std::string& spid);
+            
+            void addSpacer(const char * tag, std::string& spid, std::string& drid, std::string& drconf);
+            
+            void addFlanker(const char * tag, std::string& flid, std::string& drconf, std::string& directjoin);
+            
+            void addFileToMetadata(const char * type, std::string url);
+            
+            /** Replace the characters that can't appear as they are in xml text or attribute values   
+             *  @param value The raw string
+             *  @return The escaped string
+             */
+            static std::string escape(const std::string& value);
+            
+        private:
+            
+            // finish off a start tag left open for attributes
+            void closeStartTag(void);
+            
+            void newLine(void);
+        };
+    }
+}
+
+#endif
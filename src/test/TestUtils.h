@@ -0,0 +1,57 @@
+#ifndef TestUtils_h
+#define TestUtils_h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// a small LCG so that the random tests come out the same on every platform
+inline unsigned int nextRandom(unsigned int& state)
+{
+    state = state * 1103515245u + 12345u;
+    return (state >> 16) & 0x7fff;
+}
+
+inline std::string randomSequence(unsigned int& state, int length)
+{
+    std::string seq;
+    for (int i = 0; i < length; ++i) {
+        // the low bits repeat far too soon for long or many sequences
+        seq += "ACGT"[(nextRandom(state) >> 10) & 3];
+    }
+    return seq;
+}
+
+// an empty file under /tmp that is removed again when this goes out of scope
+class TempFile
+{
+    public:
+        TempFile(const std::string& prefix)
+        {
+            std::string pattern = "/tmp/" + prefix + "_XXXXXX";
+            std::vector<char> name(pattern.begin(), pattern.end());
+            name.push_back('\0');
+            int fd = mkstemp(&name[0]);
+            if (fd == -1) {
+                throw std::runtime_error("could not make a temporary file from " + pattern);
+            }
+            close(fd);
+            mName = &name[0];
+        }
+
+        ~TempFile(void) { remove(mName.c_str()); }
+
+        const char * name(void) const { return mName.c_str(); }
+
+    private:
+        // one owner per file
+        TempFile(const TempFile&);
+        TempFile& operator=(const TempFile&);
+
+        std::string mName;
+};
+
+#endif //TestUtils_h
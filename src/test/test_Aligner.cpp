@@ -0,0 +1,164 @@
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "Aligner.h"
+#include "ReadHolder.h"
+#include "NucleotideCodec.h"
+#include "SeqUtils.h"
+#include "StringCheck.h"
+#include "TestUtils.h"
+#include "ksw.h"
+
+// one read holding the DR between two flanks, filed under the DR's token
+static StringToken addDR(const std::string& dr, StringCheck& stringCheck, ReadMap& reads)
+{
+    std::string flank = "CATCATCATCATCATCATCA";
+    ReadHolder * holder = new ReadHolder(flank + dr + flank, "read");
+    holder->startStopsAdd(static_cast<unsigned int>(flank.length()), static_cast<unsigned int>(flank.length() + dr.length() - 1));
+    StringToken token = stringCheck.addString(dr);
+    reads[token] = new ReadList(1, holder);
+    return token;
+}
+
+static void freeReads(ReadMap& reads)
+{
+    ReadMap::iterator read_iter;
+    for (read_iter = reads.begin(); read_iter != reads.end(); ++read_iter) {
+        if (read_iter->second != NULL) {
+            delete read_iter->second->front();
+            delete read_iter->second;
+        }
+    }
+}
+
+// the Aligner's defaults
+static void scoringMatrix(int8_t * mat)
+{
+    int k = 0;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) mat[k++] = (i == j) ? 1 : -3;
+        mat[k++] = 0;
+    }
+    for (int j = 0; j < 5; ++j) mat[k++] = 0;
+}
+
+TEST_CASE("slaves start where ksw_align puts them on periodic DRs", "[Aligner]") {
+    const char * units[] = {"AC", "ACG", "AAC", "ACGTT", "AGCTAG", "TTGCA"};
+    const int gapo = 5, gape = 2, xtra = KSW_XSTART | KSW_XSUBO | 5;
+    int8_t mat[25];
+    scoringMatrix(mat);
+
+    int checked = 0;
+    for (int u = 0; u < 6; ++u) {
+        std::string unit = units[u];
+        // a run of the unit, and the same again with a substitution in it
+        std::string run;
+        while (run.length() < 32) run += unit;
+        for (int variant = 0; variant < 2; ++variant) {
+            std::string master = run;
+            if (variant == 1) master[master.length() / 3] = (master[master.length() / 3] == 'T') ? 'G' : 'T';
+
+            StringCheck string_check;
+            ReadMap reads;
+            DR_Cluster cluster;
+            cluster.push_back(addDR(master, string_check, reads));
+            // slaves shifted along the unit and cut short at either end
+            std::vector<std::string> slaves;
+            for (size_t shift = 0; shift <= unit.length(); ++shift) {
+                for (int trim = 0; trim < 6; trim += 2) {
+                    std::string slave = run.substr(shift, run.length() - shift - trim);
+                    if (trim == 2) slave[slave.length() / 2] = (slave[slave.length() / 2] == 'A') ? 'C' : 'A';
+                    if (string_check.getToken(slave) != 0) continue;
+                    slaves.push_back(slave);
+                    cluster.push_back(addDR(slave, string_check, reads));
+                }
+            }
+
+            Aligner aligner(&reads, &string_check);
+            aligner.setMasterDR(cluster[0]);
+            aligner.alignSlaves(cluster.begin(), cluster.end());
+
+            std::vector<uint8_t> master_codes(master.length() + 1);
+            nt4Encode(master, &master_codes[0]);
+            kswq_t * master_profile = ksw_qinit(2, static_cast<int>(master.length()), &master_codes[0], 5, mat);
+            for (size_t i = 0; i < slaves.size(); ++i) {
+                int slave_length = static_cast<int>(slaves[i].length());
+                std::vector<uint8_t> forward(slave_length + 1), reverse(slave_length + 1);
+                nt4Encode(slaves[i], &forward[0]);
+                nt4Encode(reverseComplement(slaves[i]), &reverse[0]);
+                kswr_t expected = ksw_align(slave_length, &forward[0], static_cast<int>(master.length()), &master_codes[0], 5, mat, gapo, gape, xtra, NULL);
+                kswr_t flipped = ksw_align(slave_length, &reverse[0], static_cast<int>(master.length()), &master_codes[0], 5, mat, gapo, gape, xtra, NULL);
+                if (expected.score <= flipped.score || expected.score < slave_length / 2 || expected.tb < 0) continue;
+
+                // the Aligner scores with the master as the query so equal
+                // scoring ends can come out differently, the starts should
+                // only ever come from the same end
+                kswr_t end = ksw_i16(master_profile, slave_length, &forward[0], gapo, gape, xtra);
+                if (end.qe != expected.te || end.te != expected.qe) continue;
+
+                StringToken slave_token = string_check.getToken(slaves[i]);
+                REQUIRE(aligner.offset(slave_token) - aligner.offset(cluster[0]) == expected.tb - expected.qb);
+                ++checked;
+            }
+            free(master_profile);
+            freeReads(reads);
+        }
+    }
+    REQUIRE(checked > 50);
+}
+
+TEST_CASE("cached slave alignments place DRs where new ones do", "[Aligner]") {
+    unsigned int state = 17;
+    for (int trial = 0; trial < 20; ++trial) {
+        // a handful of DR variants, some of them reverse complemented so
+        // that the first aligner has to flip them
+        std::string dr = randomSequence(state, 25 + nextRandom(state) % 10);
+        StringCheck string_check;
+        ReadMap reads;
+        DR_Cluster cluster;
+        int variants = 3 + nextRandom(state) % 5;
+        for (int v = 0; v < variants; ++v) {
+            std::string variant = dr;
+            if (v > 0) variant[nextRandom(state) % variant.length()] = "ACGT"[nextRandom(state) % 4];
+            if (string_check.getToken(variant) != 0) continue;
+            std::string read = randomSequence(state, 30) + variant + randomSequence(state, 30);
+            if (v > 0 && nextRandom(state) % 2 == 0) {
+                variant = reverseComplement(variant);
+                read = reverseComplement(read);
+                if (string_check.getToken(variant) != 0) continue;
+            }
+            ReadHolder * holder = new ReadHolder(read, "read");
+            holder->startStopsAdd(30, 30 + static_cast<int>(variant.length()) - 1);
+            StringToken token = string_check.addString(variant);
+            reads[token] = new ReadList(1, holder);
+            cluster.push_back(token);
+        }
+
+        AlignmentCache cache;
+        std::vector<int> offsets;
+        {
+            Aligner aligner(&reads, &string_check);
+            aligner.setAlignmentCache(&cache);
+            aligner.setMasterDR(cluster[0]);
+            aligner.alignSlaves(cluster.begin(), cluster.end());
+            REQUIRE(cache.hits() == 0);
+            REQUIRE(cache.lookups() == cluster.size() - 1);
+            for (size_t i = 0; i < cluster.size(); ++i) {
+                offsets.push_back(aligner.offset(cluster[i]) - aligner.offset(cluster[0]));
+            }
+        }
+
+        // the cluster now holds the flipped tokens, they should all be found
+        Aligner aligner(&reads, &string_check);
+        aligner.setAlignmentCache(&cache);
+        aligner.setMasterDR(cluster[0]);
+        aligner.alignSlaves(cluster.begin(), cluster.end());
+        REQUIRE(cache.hits() == cluster.size() - 1);
+        for (size_t i = 0; i < cluster.size(); ++i) {
+            REQUIRE(aligner.offset(cluster[i]) - aligner.offset(cluster[0]) == offsets[i]);
+        }
+
+        freeReads(reads);
+    }
+}
@@ -0,0 +1,83 @@
+#include <string>
+
+#include "catch.hpp"
+#include "Checkpoint.h"
+#include "Exception.h"
+#include "ReadHolder.h"
+#include "TestUtils.h"
+
+TEST_CASE("read holders come back the same from a checkpoint", "[Checkpoint]") {
+    const std::string dr = "GTTTCAATCCACGCGCCCACGCGGAGCGCGAC";
+    std::string seq = dr + "AAACCCGGGTTTAAACCCGGGTTTAAACCCGGG" + dr + "ACGTTGCAACGTTGCAACGTTGCAACGT" + dr;
+    ReadHolder original(seq, "read_1");
+    original.setComment("some comment");
+    original.setQual(std::string(seq.length(), 'I'));
+    int start = 0;
+    for (int i = 0; i < 3; ++i) {
+        original.startStopsAdd(start, start + static_cast<int>(dr.length()) - 1);
+        start = original.getStartStopList().back() + (i == 0 ? 34 : 29);
+    }
+    original.setRepeatLength(static_cast<int>(dr.length()));
+    original.setDRLowLexi(true);
+
+    TempFile file("crass_test_checkpoint");
+    // past what 32 bits can hold
+    const uint64_t big = static_cast<uint64_t>(5000000) * 1000;
+    {
+        CheckpointWriter out(file.name(), "test", 3);
+        original.writeCheckpoint(out);
+        out.writeInt(-42);
+        out.writeSize(big);
+        out.close();
+    }
+
+    {
+        CheckpointReader in(file.name(), "test", 3);
+        ReadHolder copy;
+        copy.readCheckpoint(in);
+        REQUIRE(copy.getSeq() == original.getSeq());
+        REQUIRE(copy.getHeader() == original.getHeader());
+        REQUIRE(copy.getComment() == original.getComment());
+        REQUIRE(copy.getQual() == original.getQual());
+        REQUIRE(copy.getStartStopList() == original.getStartStopList());
+        REQUIRE(copy.getRepeatLength() == original.getRepeatLength());
+        REQUIRE(copy.getLowLexi() == original.getLowLexi());
+        REQUIRE(copy.spacerStringAt(0) == original.spacerStringAt(0));
+        REQUIRE(in.readInt() == -42);
+        REQUIRE(in.readSize() == big);
+        REQUIRE(in.atEnd());
+        REQUIRE_THROWS_AS(in.readBool(), const crispr::exception&);
+    }
+
+    // somebody else's checkpoint, or an older one of ours
+    REQUIRE_THROWS_AS(CheckpointReader(file.name(), "other", 3), const crispr::exception&);
+    REQUIRE_THROWS_AS(CheckpointReader(file.name(), "test", 2), const crispr::exception&);
+}
+
+TEST_CASE("read holders that were never flipped come back unflipped", "[Checkpoint]") {
+    // every constructor has to leave the flag set, not just setDRLowLexi
+    const std::string dr = "GTTTCAATCCACGCGCCCACGCGGAGCGCGAC";
+    std::string seq = dr + "AAACCCGGGTTTAAACCCGGGTTTAAACCCGGG" + dr;
+    ReadHolder fasta(seq, "read_1");
+    ReadHolder fastq(seq.c_str(), "read_2", "", std::string(seq.length(), 'I').c_str());
+    fasta.startStopsAdd(0, static_cast<int>(dr.length()) - 1);
+    REQUIRE_FALSE(fasta.getLowLexi());
+    REQUIRE_FALSE(fastq.getLowLexi());
+
+    TempFile file("crass_test_checkpoint");
+    {
+        CheckpointWriter out(file.name(), "test", 1);
+        fasta.writeCheckpoint(out);
+        fastq.writeCheckpoint(out);
+        out.close();
+    }
+    CheckpointReader in(file.name(), "test", 1);
+    ReadHolder fasta_copy, fastq_copy;
+    fasta_copy.readCheckpoint(in);
+    fastq_copy.readCheckpoint(in);
+    REQUIRE(in.atEnd());
+    REQUIRE_FALSE(fasta_copy.getLowLexi());
+    REQUIRE_FALSE(fastq_copy.getLowLexi());
+    REQUIRE(fasta_copy.getStartStopList() == fasta.getStartStopList());
+    REQUIRE(fastq_copy.getQual() == fastq.getQual());
+}
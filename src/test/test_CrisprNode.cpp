@@ -0,0 +1,197 @@
+#include <vector>
+
+#include "catch.hpp"
+#include "CrisprNode.h"
+#include "SmallVector.h"
+#include "Slab.h"
+#include "ReadMembership.h"
+
+TEST_CASE("small vectors spill onto the heap when they fill up", "[CrisprNode]") {
+    SmallVector<int, 4> values;
+    REQUIRE(values.empty());
+    for (int i = 0; i < 4; ++i) {
+        values.push_back(i);
+    }
+    REQUIRE_FALSE(values.onHeap());
+    for (int i = 4; i < 100; ++i) {
+        values.push_back(i);
+    }
+    REQUIRE(values.onHeap());
+    REQUIRE(values.size() == 100);
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(values[i] == i);
+    }
+
+    // pushing one of its own elements while growing
+    SmallVector<int, 2> own;
+    own.push_back(7);
+    own.push_back(8);
+    own.push_back(own[0]);
+    REQUIRE(own[2] == 7);
+
+    SmallVector<int, 4> copy(values);
+    values[0] = -1;
+    REQUIRE(copy.size() == 100);
+    REQUIRE(copy[0] == 0);
+    SmallVector<int, 4> small;
+    small.push_back(3);
+    copy = small;
+    REQUIRE(copy.size() == 1);
+    REQUIRE(copy[0] == 3);
+}
+
+struct SlabCounted {
+    static int alive;
+    int value;
+    SlabCounted(int v): value(v) { ++alive; }
+    ~SlabCounted() { --alive; }
+};
+int SlabCounted::alive = 0;
+
+TEST_CASE("slabs keep their objects in place and in order", "[CrisprNode]") {
+    {
+        Slab<SlabCounted, 8> slab;
+        std::vector<SlabCounted *> handed_out;
+        for (int i = 0; i < 50; ++i) {
+            handed_out.push_back(new (slab.allocate()) SlabCounted(i));
+        }
+        REQUIRE(slab.size() == 50);
+        REQUIRE(SlabCounted::alive == 50);
+        for (int i = 0; i < 50; ++i) {
+            REQUIRE(&slab[i] == handed_out[i]);
+            REQUIRE(slab[i].value == i);
+        }
+        slab.clear();
+        REQUIRE(slab.size() == 0);
+        REQUIRE(SlabCounted::alive == 0);
+        new (slab.allocate()) SlabCounted(7);
+        REQUIRE(slab[0].value == 7);
+    }
+    // going out of scope cleans up what was left
+    REQUIRE(SlabCounted::alive == 0);
+}
+
+TEST_CASE("crispr node edges keep their types and ranks", "[CrisprNode]") {
+    //
+    //  first --F--> second --JF--> third
+    //
+    CrisprNode first(1), second(2), third(3);
+    NodeList nodes(4, static_cast<CrisprNode *>(NULL));
+    nodes[1] = &first;
+    nodes[2] = &second;
+    nodes[3] = &third;
+    REQUIRE(first.addEdge(&second, CN_EDGE_FORWARD));
+    REQUIRE(second.addEdge(&first, CN_EDGE_BACKWARD));
+    REQUIRE(second.addEdge(&third, CN_EDGE_JUMPING_F));
+    REQUIRE(third.addEdge(&second, CN_EDGE_JUMPING_B));
+
+    // the same edge twice is ignored, a different type isn't
+    REQUIRE_FALSE(first.addEdge(&second, CN_EDGE_FORWARD));
+    REQUIRE(first.getRank(CN_EDGE_FORWARD) == 1);
+    REQUIRE(first.getTotalRank() == 1);
+    REQUIRE(second.getInnerRank() == 1);
+    REQUIRE(second.getJumpingRank() == 1);
+    REQUIRE(second.getFirstEdge(CN_EDGE_BACKWARD) == first.getID());
+    REQUIRE(second.getFirstEdge(CN_EDGE_JUMPING_F) == third.getID());
+    REQUIRE(second.getFirstEdge(CN_EDGE_FORWARD) == 0);
+
+    // tokens that aren't nodes, or are past the end of the list, find nothing
+    REQUIRE(nodeAt(nodes, 2) == &second);
+    REQUIRE(nodeAt(nodes, 0) == NULL);
+    REQUIRE(nodeAt(nodes, 4) == NULL);
+    REQUIRE(nodeAt(nodes, 1000) == NULL);
+
+    // the edges are small enough for a few to sit inside the node
+    REQUIRE(sizeof(crisprEdgeStruct) <= 8);
+
+    // taking out the middle node leaves the ends with nothing
+    second.detachNode(nodes);
+    REQUIRE_FALSE(second.isAttached());
+    REQUIRE(first.getTotalRank() == 0);
+    REQUIRE(third.getTotalRank() == 0);
+    REQUIRE_FALSE(first.isAttached());
+    REQUIRE_FALSE(third.isAttached());
+    edgeList * edges = second.getEdges();
+    for (edgeListIterator iter = edges->begin(); iter != edges->end(); ++iter) {
+        REQUIRE_FALSE(iter->attached);
+    }
+
+    // a busy node still finds all of its partners
+    CrisprNode hub(10);
+    std::vector<CrisprNode *> spokes;
+    for (int i = 0; i < 3 * CRASS_DEF_NODE_INLINE_EDGES; ++i) {
+        spokes.push_back(new CrisprNode(100 + i));
+        REQUIRE(hub.addEdge(spokes.back(), (i % 2) ? CN_EDGE_JUMPING_F : CN_EDGE_JUMPING_B));
+        REQUIRE(spokes.back()->addEdge(&hub, (i % 2) ? CN_EDGE_JUMPING_B : CN_EDGE_JUMPING_F));
+    }
+    REQUIRE(hub.getEdges()->onHeap());
+    REQUIRE(hub.getRank(CN_EDGE_JUMPING_F) == 3 * CRASS_DEF_NODE_INLINE_EDGES / 2);
+    REQUIRE(hub.getRank(CN_EDGE_JUMPING_B) == 3 * CRASS_DEF_NODE_INLINE_EDGES / 2);
+    for (size_t i = 0; i < spokes.size(); ++i) {
+        REQUIRE_FALSE(hub.addEdge(spokes[i], (i % 2) ? CN_EDGE_JUMPING_F : CN_EDGE_JUMPING_B));
+        delete spokes[i];
+    }
+}
+
+TEST_CASE("read membership keeps each node's reads sorted", "[CrisprNode]") {
+    ReadMembership reads;
+    reads.add(5, 30);
+    reads.add(5, 10);
+    reads.add(5, 30);
+    reads.add(2, 7);
+    REQUIRE_FALSE(reads.frozen());
+    reads.freeze();
+    REQUIRE(reads.frozen());
+    std::vector<StringToken> five(reads.begin(5), reads.end(5));
+    REQUIRE(five.size() == 3);
+    REQUIRE(five[0] == 10);
+    REQUIRE(five[1] == 30);
+    REQUIRE(five[2] == 30);
+    REQUIRE(reads.size(2) == 1);
+    REQUIRE(reads.size(3) == 0);
+    REQUIRE(reads.size(100) == 0);
+
+    // more reads after freezing get merged in
+    reads.add(5, 20);
+    reads.add(12, 1);
+    reads.freeze();
+    five.assign(reads.begin(5), reads.end(5));
+    REQUIRE(five.size() == 4);
+    REQUIRE(five[1] == 20);
+    REQUIRE(reads.size(12) == 1);
+    REQUIRE(*reads.begin(2) == 7);
+}
+
+TEST_CASE("discounted coverage counts reads shared with neighbours", "[CrisprNode]") {
+    //
+    //  first --F--> second, first --JB--> third
+    //
+    CrisprNode first(1), second(2), third(3);
+    REQUIRE(first.addEdge(&second, CN_EDGE_FORWARD));
+    REQUIRE(second.addEdge(&first, CN_EDGE_BACKWARD));
+    REQUIRE(first.addEdge(&third, CN_EDGE_JUMPING_B));
+    REQUIRE(third.addEdge(&first, CN_EDGE_JUMPING_F));
+    NodeList nodes(4, static_cast<CrisprNode *>(NULL));
+    nodes[1] = &first;
+    nodes[2] = &second;
+    nodes[3] = &third;
+
+    ReadMembership reads;
+    reads.add(1, 100);
+    reads.add(1, 101);
+    reads.add(1, 102);
+    reads.add(2, 100);
+    reads.add(2, 101);
+    reads.add(3, 102);
+    reads.add(3, 100);
+    reads.add(3, 102);
+    reads.freeze();
+
+    // 100 is on both neighbours and 102 twice on the one, 101 only once
+    REQUIRE(first.getDiscountedCoverage(reads) == 2);
+    REQUIRE(first.getDiscountedCoverage(reads) == 2);
+
+    // with its edges detached nothing is shared any more
+    first.detachNode(nodes);
+    REQUIRE(first.getDiscountedCoverage(reads) == 0);
+}
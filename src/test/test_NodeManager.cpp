@@ -0,0 +1,374 @@
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "Checkpoint.h"
+#include "NodeManager.h"
+#include "ReadHolder.h"
+#include "StlExt.h"
+#include "TestUtils.h"
+
+TEST_CASE("spacer keys don't collide once tokens get big", "[NodeManager]") {
+    // these two pairs used to land on the same 32 bit key
+    REQUIRE(makeSpacerKey(1, 6032704) != makeSpacerKey(431, 1000000));
+    REQUIRE(makeSpacerKey(200000, 300000) == makeSpacerKey(300000, 200000));
+    REQUIRE(makeSpacerKey(200000, 300000) != makeSpacerKey(200000, 300001));
+    REQUIRE(makeKey(50000, 60000) != makeKey(60000, 50000));
+}
+
+TEST_CASE("a big group keeps every one of its spacers", "[NodeManager]") {
+    //
+    // DR sp(i) DR sp(i+1) DR for a lot of different spacers, every
+    // spacer end is a new node so the manager ends up well past 100k
+    // nodes and a few hundred thousand string tokens
+    //
+    const int spacer_count = 60000;
+    const std::string dr = "GTTTCAATCCACGCGCCCACGCGGAGCGCGAC";
+    options opts;
+    opts.cNodeKmerLength = 24;
+
+    unsigned int state = 31;
+    std::vector<std::string> spacers;
+    for (int i = 0; i < spacer_count; ++i) {
+        spacers.push_back(randomSequence(state, 30 + nextRandom(state) % 8));
+    }
+
+    std::vector<ReadHolder *> reads;
+    {
+        NodeManager manager(dr, &opts);
+        for (int i = 0; i + 1 < spacer_count; ++i) {
+            std::string seq = dr + spacers[i] + dr + spacers[i + 1] + dr;
+            ReadHolder * read = new ReadHolder(seq, "read_" + to_string(i));
+            int start = 0;
+            read->startStopsAdd(start, start + static_cast<int>(dr.length()) - 1);
+            start += static_cast<int>(dr.length() + spacers[i].length());
+            read->startStopsAdd(start, start + static_cast<int>(dr.length()) - 1);
+            start += static_cast<int>(dr.length() + spacers[i + 1].length());
+            read->startStopsAdd(start, start + static_cast<int>(dr.length()) - 1);
+            reads.push_back(read);
+            REQUIRE(manager.addReadHolder(read));
+        }
+
+        NodeVector nodes;
+        manager.findAllNodes(&nodes);
+        REQUIRE(nodes.size() == 2 * static_cast<size_t>(spacer_count));
+        REQUIRE(manager.getSpacerCountAndStats(true, false) == spacer_count);
+    }
+
+    for (size_t i = 0; i < reads.size(); ++i) {
+        delete reads[i];
+    }
+}
+
+TEST_CASE("the spacers a read can make bound the spacers it does make", "[NodeManager]") {
+    const std::string dr = "GTTTCAATCCACGCGCCCACGCGGAGCGCGAC";
+    const int dr_len = static_cast<int>(dr.length());
+    options opts;
+    opts.cNodeKmerLength = 24;
+
+    unsigned int state = 5;
+    std::string flank = randomSequence(state, 40);
+    std::string spacer = randomSequence(state, 36);
+
+    // one repeat at the very front, the rest of the read is cut as a spacer
+    ReadHolder front(dr + flank, "front");
+    front.startStopsAdd(0, dr_len - 1);
+    // one repeat in the middle only has flanks
+    ReadHolder middle(flank + dr + spacer, "middle");
+    middle.startStopsAdd(40, 40 + dr_len - 1);
+    // two repeats with overhangs either side
+    std::string seq = flank + dr + spacer + dr + flank;
+    ReadHolder both(seq, "both");
+    both.startStopsAdd(40, 40 + dr_len - 1);
+    both.startStopsAdd(40 + dr_len + 36, 40 + 2 * dr_len + 36 - 1);
+
+    REQUIRE(NodeManager::mostSpacersFromRead(&front) == 1);
+    REQUIRE(NodeManager::mostSpacersFromRead(&middle) == 0);
+    REQUIRE(NodeManager::mostSpacersFromRead(&both) == 1);
+
+    ReadHolder * reads[3] = {&front, &middle, &both};
+    for (int i = 0; i < 3; ++i) {
+        NodeManager manager(dr, &opts);
+        REQUIRE(manager.addReadHolder(reads[i]));
+        REQUIRE(manager.getSpacerInstanceCount() == NodeManager::mostSpacersFromRead(reads[i]));
+    }
+}
+
+static void addNoisyReads(NodeManager& manager, std::vector<ReadHolder *>& reads, unsigned int& state, const std::string& dr, int pool, int readCount)
+{
+    //
+    // reads that run through a pool of spacers in a mostly fixed order,
+    // with some jumping around, point errors and trimmed spacers so that
+    // there are plenty of caps, forks and bubbles to clean up
+    //
+    std::vector<std::string> spacers;
+    for (int i = 0; i < pool; ++i) {
+        spacers.push_back(randomSequence(state, 26 + nextRandom(state) % 10));
+    }
+    for (int r = 0; r < readCount; ++r) {
+        std::string seq = dr;
+        std::vector<int> starts(1, 0);
+        int current = nextRandom(state) % pool;
+        int length = 2 + nextRandom(state) % 4;
+        for (int k = 0; k < length; ++k) {
+            std::string spacer = spacers[current];
+            if (nextRandom(state) % 6 == 0) {
+                spacer[nextRandom(state) % spacer.length()] = "ACGT"[nextRandom(state) % 4];
+            }
+            if (nextRandom(state) % 10 == 0) {
+                spacer.erase(spacer.length() - 1 - nextRandom(state) % 3);
+            }
+            seq += spacer;
+            starts.push_back(static_cast<int>(seq.length()));
+            seq += dr;
+            current = (nextRandom(state) % 3 == 0) ? nextRandom(state) % pool : (current + 1) % pool;
+        }
+        ReadHolder * read = new ReadHolder(seq, "read_" + to_string(static_cast<int>(reads.size())));
+        for (size_t k = 0; k < starts.size(); ++k) {
+            read->startStopsAdd(starts[k], starts[k] + static_cast<int>(dr.length()) - 1);
+        }
+        reads.push_back(read);
+        manager.addReadHolder(read);
+    }
+}
+
+TEST_CASE("cleaning the graph leaves nothing for another pass", "[NodeManager]") {
+    const std::string dr = "GTTTCAATCCACGCGCCCACGCGGAGCGCGAC";
+    unsigned int state = 7;
+    for (int trial = 0; trial < 20; ++trial) {
+        options opts;
+        opts.cNodeKmerLength = 8 + nextRandom(state) % 6;
+        std::vector<ReadHolder *> reads;
+        {
+            NodeManager manager(dr, &opts);
+            int pool = 10 + nextRandom(state) % 40;
+            addNoisyReads(manager, reads, state, dr, pool, 50 + nextRandom(state) % 300);
+
+            NodeVector before, after_first, after_second;
+            manager.findAllNodes(&before);
+            manager.cleanGraph();
+            manager.findAllNodes(&after_first);
+            REQUIRE(after_first.size() < before.size());
+
+            // a second clean finds nothing more to take off
+            manager.cleanGraph();
+            manager.findAllNodes(&after_second);
+            REQUIRE(after_second == after_first);
+        }
+
+        for (size_t i = 0; i < reads.size(); ++i) {
+            delete reads[i];
+        }
+    }
+}
+
+TEST_CASE("a snapshot of a graph cleans up the same as the graph", "[NodeManager]") {
+    const std::string dr = "GTTTCAATCCACGCGCCCACGCGGAGCGCGAC";
+    unsigned int state = 5;
+    options opts;
+    opts.cNodeKmerLength = 10;
+    TempFile file("crass_test_snapshot");
+
+    std::vector<ReadHolder *> reads;
+    NodeManager original(dr, &opts);
+    addNoisyReads(original, reads, state, dr, 30, 200);
+    {
+        CheckpointWriter out(file.name(), "graph", 1);
+        original.writeCheckpoint(out);
+        out.close();
+    }
+
+    NodeManager copy(dr, &opts);
+    {
+        CheckpointReader in(file.name(), "graph", 1);
+        copy.readCheckpoint(in);
+        REQUIRE(in.atEnd());
+    }
+    REQUIRE(copy.getReadCount() == reads.size());
+    REQUIRE(copy.getSpacerInstanceCount() == original.getSpacerInstanceCount());
+
+    // the nodes come back with the same tokens so compare those
+    original.cleanGraph();
+    copy.cleanGraph();
+    NodeVector original_nodes, copied_nodes;
+    original.findAllNodes(&original_nodes);
+    copy.findAllNodes(&copied_nodes);
+    REQUIRE(original_nodes.size() == copied_nodes.size());
+    for (size_t i = 0; i < original_nodes.size(); ++i) {
+        REQUIRE(original_nodes[i]->getID() == copied_nodes[i]->getID());
+        REQUIRE(original_nodes[i]->getTotalRank() == copied_nodes[i]->getTotalRank());
+        REQUIRE(original_nodes[i]->getCoverage() == copied_nodes[i]->getCoverage());
+    }
+    REQUIRE(original.buildSpacerGraph() == copy.buildSpacerGraph());
+    REQUIRE(original.getAttachedSpacerCount() == copy.getAttachedSpacerCount());
+
+    for (size_t i = 0; i < reads.size(); ++i) {
+        delete reads[i];
+    }
+}
+
+static void addArrayReads(NodeManager& manager, std::vector<ReadHolder *>& reads, const std::string& dr, const std::vector<std::string>& spacers)
+{
+    // every run of three spacers in a row, twice over
+    for (size_t i = 0; i + 2 < spacers.size(); ++i) {
+        for (int copy = 0; copy < 2; ++copy) {
+            std::string seq = dr;
+            std::vector<int> starts(1, 0);
+            for (size_t k = i; k < i + 3; ++k) {
+                seq += spacers[k];
+                starts.push_back(static_cast<int>(seq.length()));
+                seq += dr;
+            }
+            ReadHolder * read = new ReadHolder(seq, "read_" + to_string(reads.size()));
+            for (size_t k = 0; k < starts.size(); ++k) {
+                read->startStopsAdd(starts[k], starts[k] + static_cast<int>(dr.length()) - 1);
+            }
+            reads.push_back(read);
+            manager.addReadHolder(read);
+        }
+    }
+}
+
+TEST_CASE("two arrays sharing a spacer split into contigs at the cross", "[NodeManager]") {
+    //
+    //  a0 - a1 - a2 - x - a3 - a4 - a5
+    //                 |
+    //  b0 - b1 - b2 - x - b3 - b4 - b5
+    //
+    const std::string dr = "GTTTCAATCCACGCGCCCACGCGGAGCGCGAC";
+    unsigned int state = 13;
+    options opts;
+    opts.cNodeKmerLength = 12;
+    std::string shared = randomSequence(state, 32);
+    std::vector<std::string> first, second;
+    for (int i = 0; i < 7; ++i) {
+        first.push_back((i == 3) ? shared : randomSequence(state, 30 + i));
+        second.push_back((i == 3) ? shared : randomSequence(state, 30 + i));
+    }
+
+    std::vector<ReadHolder *> reads;
+    {
+        NodeManager manager(dr, &opts);
+        addArrayReads(manager, reads, dr, first);
+        addArrayReads(manager, reads, dr, second);
+        manager.indexReads();
+        manager.buildSpacerGraph();
+        manager.splitIntoContigs();
+
+        StringCheck * strings = manager.getStringCheck();
+        std::map<std::string, int> contig_of;
+        for (int contig = 1; contig <= manager.getSpacerInstanceCount() * 2; ++contig) {
+            SpacerInstanceVector spacers;
+            manager.findSpacerForContig(&spacers, contig);
+            for (size_t i = 0; i < spacers.size(); ++i) {
+                std::string seq = strings->getString(spacers[i]->getID());
+                REQUIRE(contig_of.find(seq) == contig_of.end());
+                contig_of[seq] = contig;
+            }
+        }
+
+        // each arm is a contig of its own and the cross is on its own
+        REQUIRE(contig_of.size() == 13);
+        std::set<int> contigs;
+        for (int arm = 0; arm < 4; ++arm) {
+            const std::vector<std::string>& array = (arm < 2) ? first : second;
+            int start = (arm % 2) ? 4 : 0;
+            int contig = contig_of[array[start]];
+            REQUIRE(contig != 0);
+            REQUIRE(contig_of[array[start + 1]] == contig);
+            REQUIRE(contig_of[array[start + 2]] == contig);
+            contigs.insert(contig);
+        }
+        contigs.insert(contig_of[shared]);
+        REQUIRE(contigs.size() == 5);
+    }
+    for (size_t i = 0; i < reads.size(); ++i) {
+        delete reads[i];
+    }
+}
+
+static void addRandomArrayReads(NodeManager& manager, std::vector<ReadHolder *>& reads, unsigned int& state, const std::string& dr, int arrays, int readCount)
+{
+    // a few arrays that now and then share a spacer, read in short runs with
+    // the odd sequencing error or trimmed base
+    std::vector<std::vector<std::string> > spacers(arrays);
+    for (int a = 0; a < arrays; ++a) {
+        int length = 8 + nextRandom(state) % 20;
+        for (int i = 0; i < length; ++i) {
+            if (a > 0 && nextRandom(state) % 8 == 0) {
+                const std::vector<std::string>& other = spacers[nextRandom(state) % a];
+                spacers[a].push_back(other[nextRandom(state) % other.size()]);
+            } else {
+                spacers[a].push_back(randomSequence(state, 26 + nextRandom(state) % 10));
+            }
+        }
+    }
+    for (int r = 0; r < readCount; ++r) {
+        const std::vector<std::string>& array = spacers[nextRandom(state) % arrays];
+        int first = nextRandom(state) % array.size();
+        int length = 1 + nextRandom(state) % 4;
+        std::string seq = dr;
+        std::vector<int> starts(1, 0);
+        for (int k = first; k < first + length && k < static_cast<int>(array.size()); ++k) {
+            std::string spacer = array[k];
+            if (nextRandom(state) % 8 == 0) {
+                spacer[nextRandom(state) % spacer.length()] = "ACGT"[nextRandom(state) % 4];
+            }
+            if (nextRandom(state) % 12 == 0) {
+                spacer.erase(spacer.length() - 1 - nextRandom(state) % 3);
+            }
+            seq += spacer;
+            starts.push_back(static_cast<int>(seq.length()));
+            seq += dr;
+        }
+        ReadHolder * read = new ReadHolder(seq, "read_" + to_string(static_cast<int>(reads.size())));
+        for (size_t k = 0; k < starts.size(); ++k) {
+            read->startStopsAdd(starts[k], starts[k] + static_cast<int>(dr.length()) - 1);
+        }
+        reads.push_back(read);
+        manager.addReadHolder(read);
+    }
+}
+
+TEST_CASE("contigs come out numbered as they always have", "[NodeManager]") {
+    // the checksum is over every contig's spacers as the tree made them
+    // before the spacers moved out of a std::map. Which cross a contig walk
+    // starts from decides the contig IDs, so the spacers have to be walked
+    // in the order that map kept them
+    const std::string dr = "GTTTCAATCCACGCGCCCACGCGGAGCGCGAC";
+    unsigned int state = 13;
+    unsigned int checksum = 2166136261u;
+    for (int trial = 0; trial < 10; ++trial) {
+        options opts;
+        opts.cNodeKmerLength = 8 + nextRandom(state) % 6;
+        int arrays = 1 + nextRandom(state) % 4;
+        int read_count = 50 + nextRandom(state) % 400;
+        std::vector<ReadHolder *> reads;
+        {
+            NodeManager manager(dr, &opts);
+            addRandomArrayReads(manager, reads, state, dr, arrays, read_count);
+            manager.cleanGraph();
+            manager.buildSpacerGraph();
+            manager.cleanSpacerGraph();
+            manager.splitIntoContigs();
+
+            StringCheck * strings = manager.getStringCheck();
+            for (int contig = 1; contig <= manager.getSpacerInstanceCount() * 2; ++contig) {
+                SpacerInstanceVector spacers;
+                manager.findSpacerForContig(&spacers, contig);
+                for (size_t i = 0; i < spacers.size(); ++i) {
+                    std::string line = to_string(trial) + " " + to_string(contig) + " " + to_string(static_cast<int>(i)) + " " + strings->getString(spacers[i]->getID()) + "\n";
+                    for (size_t c = 0; c < line.length(); ++c) {
+                        checksum = (checksum ^ static_cast<unsigned char>(line[c])) * 16777619u;
+                    }
+                }
+            }
+        }
+        for (size_t i = 0; i < reads.size(); ++i) {
+            delete reads[i];
+        }
+    }
+    REQUIRE(checksum == 136165741u);
+}
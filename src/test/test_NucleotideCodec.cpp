@@ -0,0 +1,75 @@
+#include <string>
+#include <cstring>
+#include <vector>
+
+#include "catch.hpp"
+#include "NucleotideCodec.h"
+#include "SeqUtils.h"
+
+// the straight forward way of doing it, for comparison
+static std::string naiveReverseComplement(const std::string& seq)
+{
+    std::string ret;
+    for (std::string::const_reverse_iterator iter = seq.rbegin(); iter != seq.rend(); ++iter) {
+        ret += complementOf(*iter);
+    }
+    return ret;
+}
+
+TEST_CASE("reverse complementing sequences", "[codec]") {
+    // long enough to go through the 16 byte blocks with a tail left over
+    std::string seq = "CCCCGCAGGCGCGGGGATGAACCGAGCGAGACATCACCGGCGAGTCGGAGCGCGTTGCGTTCCCCGCAGGCGCGGGGATGAACCGAAGATAAACGCCGGCGT";
+    
+    SECTION("in place gives the same answer as doing it one base at a time") {
+        for (size_t len = 0; len <= seq.length(); ++len) {
+            std::string sub = seq.substr(0, len);
+            std::string expected = naiveReverseComplement(sub);
+            reverseComplementInPlace(sub);
+            REQUIRE(sub == expected);
+        }
+    }
+    SECTION("into a buffer gives the same answer as doing it one base at a time") {
+        for (size_t len = 0; len <= seq.length(); ++len) {
+            std::string sub = seq.substr(0, len);
+            std::vector<char> out(len + 1, '\0');
+            reverseComplementInto(sub.data(), len, &out[0]);
+            REQUIRE(std::string(&out[0], len) == naiveReverseComplement(sub));
+        }
+    }
+    SECTION("lower case and IUPAC codes inside a block are kept") {
+        std::string mixed = "acgtNNRYacgtACGTKMacgtBDHVacgtACGTacgtWS";
+        std::string expected = naiveReverseComplement(mixed);
+        std::string in_place = mixed;
+        reverseComplementInPlace(in_place);
+        REQUIRE(in_place == expected);
+        REQUIRE(reverseComplement(mixed) == expected);
+        REQUIRE(reverseComplement("ACGTN") == "NACGT");
+    }
+}
+
+TEST_CASE("encoding sequences as nt4 codes", "[codec]") {
+    std::string seq = "ACGTacgtNRYACGTTGCAacgtnACGTACGTACGTA";
+    std::vector<unsigned char> codes(seq.length());
+    nt4Encode(seq, &codes[0]);
+    for (size_t i = 0; i < seq.length(); ++i) {
+        REQUIRE(codes[i] == NT4_TABLE[(unsigned char)seq[i]]);
+    }
+    
+    std::vector<char> decoded(seq.length());
+    nt4Decode(&codes[0], codes.size(), &decoded[0]);
+    REQUIRE(std::string(&decoded[0], decoded.size()) == "ACGTACGTNNNACGTTGCAACGTNACGTACGTACGTA");
+    
+    // reverse complementing the codes is the same as encoding the reverse complement
+    std::vector<unsigned char> rc_codes(seq.length());
+    nt4Encode(naiveReverseComplement(seq), &rc_codes[0]);
+    nt4ReverseComplement(&codes[0], codes.size());
+    REQUIRE(codes == rc_codes);
+}
+
+TEST_CASE("choosing the lowest lexicographical orientation", "[codec]") {
+    REQUIRE(canonicalCompare("AACC") < 0);
+    REQUIRE(canonicalCompare("GGTT") > 0);
+    REQUIRE(canonicalCompare("ACGT") == 0);
+    REQUIRE(laurenize("GTTCCCCGCAGGCGCGGGGATGAACCG") == "CGGTTCATCCCCGCGCCTGCGGGGAAC");
+    REQUIRE(laurenize("CGGTTCATCCCCGCGCCTGCGGGGAAC") == "CGGTTCATCCCCGCGCCTGCGGGGAAC");
+}
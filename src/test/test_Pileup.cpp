@@ -0,0 +1,104 @@
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "Pileup.h"
+#include "NucleotideCodec.h"
+#include "TestUtils.h"
+
+// one column at a time, the way the Aligner used to do it
+template <typename Count_t>
+static int naiveConsensus(const std::vector<Count_t>& counts, int stride, int minDepth, std::string& consensus, std::vector<float>& conservation)
+{
+    const char bases[4] = {'A', 'C', 'G', 'T'};
+    int num_deep = 0;
+    consensus.assign(stride, 'N');
+    conservation.assign(stride, 0.0f);
+    for (int j = 0; j < stride; ++j) {
+        int max_count = 0;
+        float total_count = 0.0;
+        for (int b = 0; b < 4; ++b) {
+            total_count += static_cast<float>(counts[b * stride + j]);
+            if ((int)counts[b * stride + j] > max_count) {
+                max_count = counts[b * stride + j];
+                consensus[j] = bases[b];
+            }
+        }
+        if (total_count > minDepth) {
+            conservation[j] = static_cast<float>(max_count)/total_count;
+            num_deep++;
+        }
+    }
+    return num_deep;
+}
+
+template <typename Count_t>
+static void checkPileup(int stride, int reads, unsigned int seed)
+{
+    unsigned int state = seed;
+    std::vector<Count_t> counts(4 * stride, 0);
+    std::vector<Count_t> expected(4 * stride, 0);
+    for (int r = 0; r < reads; ++r) {
+        int len = 1 + nextRandom(state) % stride;
+        int start = nextRandom(state) % (stride - len + 1);
+        std::string seq;
+        for (int i = 0; i < len; ++i) {
+            seq += "ACGTNacgt"[nextRandom(state) % 9];
+        }
+        std::vector<unsigned char> codes(len);
+        nt4Encode(seq, &codes[0]);
+        pileupAdd(&counts[0], stride, start, &codes[0], len);
+        for (int i = 0; i < len; ++i) {
+            // N counts as an A
+            expected[(nt4Code(seq[i]) & 3) * stride + start + i]++;
+        }
+    }
+    REQUIRE(counts == expected);
+    
+    std::string naive_consensus;
+    std::vector<float> naive_conservation;
+    int naive_deep = naiveConsensus(expected, stride, 2, naive_consensus, naive_conservation);
+    std::vector<char> consensus(stride, 'X');
+    std::vector<float> conservation(stride, -1.0f);
+    int deep = pileupConsensus(&counts[0], stride, 2, &consensus[0], &conservation[0]);
+    REQUIRE(deep == naive_deep);
+    REQUIRE(std::string(consensus.begin(), consensus.end()) == naive_consensus);
+    for (int j = 0; j < stride; ++j) {
+        REQUIRE(conservation[j] == naive_conservation[j]);
+    }
+}
+
+TEST_CASE("vector pileup matches adding one base at a time", "[pileup]") {
+    SECTION("16 bit counts") {
+        // odd lengths leave tails after the 8 and 16 column blocks
+        checkPileup<uint16_t>(37, 0, 1);
+        checkPileup<uint16_t>(37, 3, 2);
+        checkPileup<uint16_t>(101, 500, 3);
+        checkPileup<uint16_t>(256, 2000, 4);
+    }
+    SECTION("32 bit counts") {
+        checkPileup<uint32_t>(37, 3, 5);
+        checkPileup<uint32_t>(101, 500, 6);
+        checkPileup<uint32_t>(258, 2000, 7);
+    }
+}
+
+TEST_CASE("consensus ties go to the first base", "[pileup]") {
+    // columns: empty, A=C, G=T, all equal, T only
+    int stride = 5;
+    uint16_t counts[20] = {
+        0, 3, 0, 2, 0,      // A
+        0, 3, 0, 2, 0,      // C
+        0, 0, 4, 2, 0,      // G
+        0, 0, 4, 2, 7       // T
+    };
+    char consensus[5];
+    float conservation[5];
+    int deep = pileupConsensus(counts, stride, 2, consensus, conservation);
+    REQUIRE(std::string(consensus, 5) == "NAGAT");
+    REQUIRE(deep == 4);
+    REQUIRE(conservation[0] == 0.0f);
+    REQUIRE(conservation[1] == 0.5f);
+    REQUIRE(conservation[3] == 0.25f);
+    REQUIRE(conservation[4] == 1.0f);
+}
@@ -0,0 +1,48 @@
+#include <string>
+
+#include "catch.hpp"
+#include "crassDefines.h"
+#include "ReadHolder.h"
+#include "SmithWaterman.h"
+
+static void findBackPartial(ReadHolder& read, const std::string& dr)
+{
+    options opts;
+    opts.lowSpacerSize = 8;
+    SmithWaterman aligner(dr);
+    SW_Alignment partial;
+    int search_start, search_length;
+    REQUIRE(read.backPartialWindow(&opts, search_start, search_length));
+    REQUIRE(aligner.alignAnchored(read.getSeq(), search_start, search_length, SW_ANCHOR_BACK, CRASS_DEF_PARTIAL_SIM_CUT_OFF, partial));
+    read.addBackPartial(partial, dr);
+}
+
+TEST_CASE("back partials with an indel keep the start the aligner found", "[ReadHolder]") {
+    const std::string dr = "GTTTCAATCCACGCGCCCACGCGGATGCGAC";
+    const std::string body = dr + "TTGTAGCTAGCTAGGCTAGCATCGACTAGCATTAGCA" + dr + "TTCAGTACGATCGGATCAGTTACGGATTGC";
+    const int dr_len = static_cast<int>(dr.length());
+    const int second_dr = dr_len + 37;
+
+    SECTION("an inserted base") {
+        // DR[0..20) with an extra G after DR[9]
+        std::string partial = dr.substr(0, 10) + "G" + dr.substr(10, 10);
+        ReadHolder read(body + partial, "insertion");
+        read.startStopsAdd(0, dr_len - 1);
+        read.startStopsAdd(second_dr, second_dr + dr_len - 1);
+        findBackPartial(read, dr);
+        REQUIRE(read.numRepeats() == 3);
+        REQUIRE(read.startStopsAt(4) == static_cast<int>(body.length()));
+        REQUIRE(read.startStopsAt(5) == static_cast<int>(body.length() + partial.length()) - 1);
+    }
+    SECTION("a deleted base") {
+        // DR[0..20) without DR[10]
+        std::string partial = dr.substr(0, 10) + dr.substr(11, 9);
+        ReadHolder read(body + partial, "deletion");
+        read.startStopsAdd(0, dr_len - 1);
+        read.startStopsAdd(second_dr, second_dr + dr_len - 1);
+        findBackPartial(read, dr);
+        REQUIRE(read.numRepeats() == 3);
+        REQUIRE(read.startStopsAt(4) == static_cast<int>(body.length()));
+        REQUIRE(read.startStopsAt(5) == static_cast<int>(body.length() + partial.length()) - 1);
+    }
+}
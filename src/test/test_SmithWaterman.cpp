@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "SmithWaterman.h"
+#include "TestUtils.h"
+
+static int score(char a, char b)
+{
+    return (a == b && a != 'N') ? SW_MATCH : SW_MISMATCH;
+}
+
+// plain affine gap dynamic programming with the same scores. Local gives the
+// best score anywhere, otherwise the score of aligning all of a to all of b
+static int referenceScore(const std::string& a, const std::string& b, bool local)
+{
+    const int minus_inf = -1000000;
+    int n = static_cast<int>(a.length()), m = static_cast<int>(b.length());
+    std::vector<int> h((n + 1) * (m + 1)), e((n + 1) * (m + 1), minus_inf), f((n + 1) * (m + 1), minus_inf);
+    int best = 0;
+    for (int i = 0; i <= n; ++i) {
+        for (int j = 0; j <= m; ++j) {
+            int k = i * (m + 1) + j;
+            if (i == 0 || j == 0) {
+                int gap = (i + j == 0) ? 0 : -(SW_GAP_OPEN + (i + j) * SW_GAP_EXTEND);
+                h[k] = local ? 0 : gap;
+                continue;
+            }
+            e[k] = std::max(e[k - 1] - SW_GAP_EXTEND, h[k - 1] - SW_GAP_OPEN - SW_GAP_EXTEND);
+            f[k] = std::max(f[k - m - 1] - SW_GAP_EXTEND, h[k - m - 1] - SW_GAP_OPEN - SW_GAP_EXTEND);
+            h[k] = std::max(h[k - m - 2] + score(a[i - 1], b[j - 1]), std::max(e[k], f[k]));
+            if (local && h[k] < 0) h[k] = 0;
+            if (h[k] > best) best = h[k];
+        }
+    }
+    return local ? best : h[n * (m + 1) + m];
+}
+
+TEST_CASE("partial DRs are found at the ends of a read", "[SmithWaterman]") {
+    std::string dr = "GTTTCAATCCACGCGCCCACGCGGATGCGAC";
+    std::string spacer = "ACGTAGCTAGCTAGGCTAGCATCGACTAGCATTAGCA";
+    SmithWaterman aligner(dr);
+    SW_Alignment alignment;
+
+    // the last 12 bases of the DR at the front of the read
+    std::string front = dr.substr(dr.length() - 12) + spacer + dr;
+    REQUIRE(aligner.align(front, 0, 12 + 10, 0.85, alignment));
+    REQUIRE(alignment.targetStart == 0);
+    REQUIRE(alignment.targetEnd == 11);
+    REQUIRE(alignment.queryStart == static_cast<int>(dr.length()) - 12);
+    REQUIRE(alignment.queryEnd == static_cast<int>(dr.length()) - 1);
+    REQUIRE(alignment.identity == 1.0f);
+
+    // and the first 15 at the back, coordinates are in the whole read
+    std::string back = dr + spacer + dr.substr(0, 15);
+    int search_start = static_cast<int>(dr.length() + 10);
+    REQUIRE(aligner.align(back, search_start, static_cast<int>(back.length()) - search_start, 0.85, alignment));
+    REQUIRE(alignment.targetStart == static_cast<int>(back.length()) - 15);
+    REQUIRE(alignment.targetEnd == static_cast<int>(back.length()) - 1);
+    REQUIRE(alignment.queryStart == 0);
+    REQUIRE(alignment.queryEnd == 14);
+}
+
+TEST_CASE("the identity cut off rejects poor partials", "[SmithWaterman]") {
+    std::string dr = "GTTTCAATCCACGCGCCCACGCGGATGCGAC";
+    SmithWaterman aligner(dr);
+    SW_Alignment alignment;
+
+    // an insertion in the middle of the first 16 bases
+    std::string read = dr.substr(0, 8) + "T" + dr.substr(8, 8);
+    REQUIRE(aligner.align(read, 0, static_cast<int>(read.length()), 0, alignment));
+    REQUIRE(alignment.targetStart == 0);
+    REQUIRE(alignment.targetEnd == 16);
+    REQUIRE(alignment.queryEnd == 15);
+    REQUIRE(alignment.identity == Approx(1.0 - 1.0 / 17));
+    REQUIRE(aligner.align(read, 0, static_cast<int>(read.length()), 0.9, alignment));
+    REQUIRE_FALSE(aligner.align(read, 0, static_cast<int>(read.length()), 0.95, alignment));
+
+    // nothing to align
+    REQUIRE_FALSE(aligner.align(read, 0, 0, 0, alignment));
+    REQUIRE_FALSE(aligner.align(read, 10, static_cast<int>(read.length()), 0, alignment));
+}
+
+TEST_CASE("alignments score the same as a plain dynamic programming fill", "[SmithWaterman]") {
+    unsigned int state = 11;
+    for (int trial = 0; trial < 500; ++trial) {
+        std::string dr = randomSequence(state, 20 + nextRandom(state) % 25);
+        std::string read = randomSequence(state, 30 + nextRandom(state) % 100);
+        // drop a mutated piece of the DR into most reads
+        if (nextRandom(state) % 4 != 0) {
+            int from = nextRandom(state) % dr.length();
+            std::string piece = dr.substr(from, 5 + nextRandom(state) % dr.length());
+            for (size_t i = 0; i < piece.length(); ++i) {
+                if (nextRandom(state) % 12 == 0) piece[i] = "ACGT"[nextRandom(state) % 4];
+            }
+            if (nextRandom(state) % 3 == 0) piece.erase(nextRandom(state) % piece.length(), 1);
+            read.insert(nextRandom(state) % read.length(), piece);
+        }
+        int search_start = nextRandom(state) % 10;
+        int search_length = static_cast<int>(read.length()) - search_start - nextRandom(state) % 10;
+
+        SmithWaterman aligner(dr);
+        SW_Alignment alignment;
+        std::string searched = read.substr(search_start, search_length);
+        int best = referenceScore(searched, dr, true);
+        if (!aligner.align(read, search_start, search_length, 0, alignment)) {
+            REQUIRE(best == 0);
+            continue;
+        }
+        REQUIRE(alignment.score == best);
+        REQUIRE(alignment.targetStart >= search_start);
+        REQUIRE(alignment.targetEnd < search_start + search_length);
+        REQUIRE(alignment.queryStart >= 0);
+        REQUIRE(alignment.queryStart <= alignment.queryEnd);
+        REQUIRE(alignment.queryEnd < static_cast<int>(dr.length()));
+        // the coordinates really do hold an alignment with the best score
+        std::string target_part = read.substr(alignment.targetStart, alignment.targetEnd - alignment.targetStart + 1);
+        std::string query_part = dr.substr(alignment.queryStart, alignment.queryEnd - alignment.queryStart + 1);
+        REQUIRE(referenceScore(target_part, query_part, false) == best);
+    }
+}
+
+static int levenshtein(const std::string& a, const std::string& b)
+{
+    std::vector<int> row(b.length() + 1);
+    for (size_t j = 0; j <= b.length(); ++j) row[j] = static_cast<int>(j);
+    for (size_t i = 1; i <= a.length(); ++i) {
+        int diagonal = row[0];
+        row[0] = static_cast<int>(i);
+        for (size_t j = 1; j <= b.length(); ++j) {
+            int above = row[j];
+            row[j] = std::min(diagonal + ((a[i - 1] == b[j - 1]) ? 0 : 1), std::min(above, row[j - 1]) + 1);
+            diagonal = above;
+        }
+    }
+    return row[b.length()];
+}
+
+TEST_CASE("anchored alignments hang off the ends of the window", "[SmithWaterman]") {
+    std::string dr = "GTTTCAATCCACGCGCCCACGCGGATGCGAC";
+    std::string spacer = "ACGTAGCTAGCTAGGCTAGCATCGACTAGCATTAGCA";
+    SmithWaterman aligner(dr);
+    SW_Alignment alignment;
+
+    std::string front = dr.substr(dr.length() - 12) + spacer + dr;
+    REQUIRE(aligner.alignAnchored(front, 0, 40, SW_ANCHOR_FRONT, 0.85, alignment));
+    REQUIRE(alignment.targetStart == 0);
+    REQUIRE(alignment.targetEnd == 11);
+    REQUIRE(alignment.queryStart == static_cast<int>(dr.length()) - 12);
+    REQUIRE(alignment.queryEnd == static_cast<int>(dr.length()) - 1);
+    REQUIRE(alignment.edits == 0);
+
+    // a sequencing error on the first base of the read is just an edit
+    front[0] = (front[0] == 'A') ? 'C' : 'A';
+    REQUIRE(aligner.alignAnchored(front, 0, 40, SW_ANCHOR_FRONT, 0.85, alignment));
+    REQUIRE(alignment.targetStart == 0);
+    REQUIRE(alignment.targetEnd == 11);
+    REQUIRE(alignment.edits == 1);
+
+    std::string back = dr + spacer + dr.substr(0, 15);
+    int search_start = static_cast<int>(dr.length() + 10);
+    int search_length = static_cast<int>(back.length()) - search_start;
+    REQUIRE(aligner.alignAnchored(back, search_start, search_length, SW_ANCHOR_BACK, 0.85, alignment));
+    REQUIRE(alignment.targetStart == static_cast<int>(back.length()) - 15);
+    REQUIRE(alignment.targetEnd == static_cast<int>(back.length()) - 1);
+    REQUIRE(alignment.queryStart == 0);
+    REQUIRE(alignment.queryEnd == 14);
+
+    // the DR in the middle of the window doesn't count, it isn't at the end.
+    // At most a couple of bases of the spacer happen to match
+    std::string middle = spacer + dr + spacer;
+    if (aligner.alignAnchored(middle, 0, static_cast<int>(middle.length()), SW_ANCHOR_FRONT, 0.85, alignment)) {
+        REQUIRE(alignment.targetEnd < 3);
+    }
+    if (aligner.alignAnchored(middle, 0, static_cast<int>(middle.length()), SW_ANCHOR_BACK, 0.85, alignment)) {
+        REQUIRE(alignment.targetStart > static_cast<int>(middle.length()) - 4);
+    }
+}
+
+TEST_CASE("partials with a single error are kept whole once they are long enough", "[SmithWaterman]") {
+    //-----
+    // With CRASS_DEF_PARTIAL_SIM_CUT_OFF at 0.85 one edit is fine from 7
+    // bases on. The error is counted against the whole partial wherever it
+    // falls, even on the first or last base, rather than the partial being
+    // trimmed back to the part that matches. That trimming is what the old
+    // local alignment did, and it could push a real partial under the cut off
+    //
+    std::string dr = "GTTTCAATCCACGCGCCCACGCGGATGCGAC";
+    // the spacer can't start like the end of the DR, or an error on the
+    // last couple of bases could just as well be read as the partial
+    // running on into the spacer
+    std::string spacer = "TTGTAGCTAGCTAGGCTAGCATCGACTAGCATTAGCA";
+    int dr_length = static_cast<int>(dr.length());
+    double similarity = 0.85;
+    SmithWaterman aligner(dr);
+    SW_Alignment alignment;
+    for (int length = 6; length <= dr_length; ++length) {
+        for (int error = 0; error < length; ++error) {
+            std::string front_partial = dr.substr(dr_length - length);
+            front_partial[error] = (front_partial[error] == 'A') ? 'T' : 'A';
+            std::string front = front_partial + spacer + dr;
+            bool front_found = aligner.alignAnchored(front, 0, length + 10, SW_ANCHOR_FRONT, similarity, alignment);
+            bool front_whole = front_found && alignment.targetEnd == length - 1 && alignment.edits == 1;
+
+            std::string back_partial = dr.substr(0, length);
+            back_partial[error] = (back_partial[error] == 'A') ? 'T' : 'A';
+            std::string back = dr + spacer + back_partial;
+            int search_start = static_cast<int>(back.length()) - length - 10;
+            bool back_found = aligner.alignAnchored(back, search_start, length + 10, SW_ANCHOR_BACK, similarity, alignment);
+            bool back_whole = back_found && alignment.targetStart == static_cast<int>(back.length()) - length && alignment.edits == 1;
+
+            if (length >= 7) {
+                REQUIRE(front_whole);
+                REQUIRE(back_whole);
+            } else {
+                // 5 out of 6 is under the cut off
+                REQUIRE_FALSE(front_whole);
+                REQUIRE_FALSE(back_whole);
+            }
+        }
+    }
+}
+
+TEST_CASE("anchored alignments find the best passing partial", "[SmithWaterman]") {
+    unsigned int state = 5;
+    double similarity = 0.85;
+    for (int trial = 0; trial < 300; ++trial) {
+        std::string dr = randomSequence(state, 20 + nextRandom(state) % 25);
+        int partial_length = 3 + nextRandom(state) % (dr.length() - 3);
+        std::string partial = dr.substr(dr.length() - partial_length);
+        for (size_t i = 0; i < partial.length(); ++i) {
+            if (nextRandom(state) % 10 == 0) partial[i] = "ACGT"[nextRandom(state) % 4];
+        }
+        if (nextRandom(state) % 4 == 0) partial.erase(nextRandom(state) % partial.length(), 1);
+        std::string read = partial + randomSequence(state, 20 + nextRandom(state) % 40);
+        int window = static_cast<int>(read.length()) - nextRandom(state) % 10;
+
+        // try every length of the window against every suffix of the DR
+        int max_edits = static_cast<int>((1.0 - similarity) * dr.length() / similarity);
+        int best_length = -1, best_edits = 0;
+        for (int length = 1; length <= window && length <= static_cast<int>(dr.length()) + max_edits; ++length) {
+            int edits = static_cast<int>(read.length() + dr.length());
+            for (size_t from = 0; from <= dr.length(); ++from) {
+                edits = std::min(edits, levenshtein(read.substr(0, length), dr.substr(from)));
+            }
+            if (1.0 - (static_cast<double>(edits) / length) >= similarity) {
+                if (best_length == -1 || length - 2 * edits >= best_length - 2 * best_edits) {
+                    best_length = length;
+                    best_edits = edits;
+                }
+            }
+        }
+
+        SmithWaterman aligner(dr);
+        SW_Alignment alignment;
+        bool found = aligner.alignAnchored(read, 0, window, SW_ANCHOR_FRONT, similarity, alignment);
+        REQUIRE(found == (best_length != -1));
+        if (found) {
+            REQUIRE(alignment.targetEnd + 1 == best_length);
+            REQUIRE(alignment.edits == best_edits);
+            std::string read_part = read.substr(0, best_length);
+            REQUIRE(levenshtein(read_part, dr.substr(alignment.queryStart)) == best_edits);
+        }
+
+        // and the same thing backwards
+        std::string reversed_read(read.rbegin(), read.rend());
+        std::string reversed_dr(dr.rbegin(), dr.rend());
+        SmithWaterman backwards_aligner(reversed_dr);
+        SW_Alignment backwards;
+        int offset = static_cast<int>(read.length()) - window;
+        REQUIRE(backwards_aligner.alignAnchored(reversed_read, offset, window, SW_ANCHOR_BACK, similarity, backwards) == found);
+        if (found) {
+            REQUIRE(backwards.targetEnd == static_cast<int>(read.length()) - 1);
+            REQUIRE(backwards.targetStart == static_cast<int>(read.length()) - best_length);
+            REQUIRE(backwards.edits == best_edits);
+            REQUIRE(backwards.queryStart == 0);
+        }
+    }
+}
+
+TEST_CASE("batched anchored alignments agree with one at a time", "[SmithWaterman]") {
+    unsigned int state = 11;
+    double similarity = 0.85;
+    for (int group = 0; group < 20; ++group) {
+        std::string dr = randomSequence(state, 20 + nextRandom(state) % 30);
+        SmithWaterman aligner(dr);
+
+        // more reads than there are lanes, some with partials at one end or
+        // the other, and a few windows that don't fit the read at all
+        int read_count = 1 + nextRandom(state) % (3 * SW_BATCH_LANES);
+        std::vector<std::string> reads;
+        for (int i = 0; i < read_count; ++i) {
+            std::string read = randomSequence(state, 10 + nextRandom(state) % 60);
+            int partial_length = 1 + nextRandom(state) % dr.length();
+            switch (nextRandom(state) % 3) {
+                case 0: read = dr.substr(dr.length() - partial_length) + read; break;
+                case 1: read += dr.substr(0, partial_length); break;
+                default: break;
+            }
+            if (nextRandom(state) % 3 == 0) read[nextRandom(state) % read.length()] = 'N';
+            reads.push_back(read);
+        }
+        std::vector<SW_Window> windows;
+        for (int i = 0; i < read_count; ++i) {
+            SW_Window window;
+            window.target = &reads[i];
+            window.searchStart = nextRandom(state) % 8;
+            window.searchLength = static_cast<int>(reads[i].length()) - window.searchStart - nextRandom(state) % 8;
+            if (nextRandom(state) % 10 == 0) window.searchLength += 20;
+            windows.push_back(window);
+        }
+
+        SW_Anchor anchors[2] = {SW_ANCHOR_FRONT, SW_ANCHOR_BACK};
+        for (int a = 0; a < 2; ++a) {
+            std::vector<SW_Alignment> alignments;
+            std::vector<bool> found;
+            aligner.alignAnchoredBatch(windows, anchors[a], similarity, alignments, found);
+            REQUIRE(alignments.size() == windows.size());
+            REQUIRE(found.size() == windows.size());
+            for (int i = 0; i < read_count; ++i) {
+                SW_Alignment alignment;
+                bool single = aligner.alignAnchored(reads[i], windows[i].searchStart, windows[i].searchLength, anchors[a], similarity, alignment);
+                REQUIRE(found[i] == single);
+                if (single) {
+                    REQUIRE(alignments[i].targetStart == alignment.targetStart);
+                    REQUIRE(alignments[i].targetEnd == alignment.targetEnd);
+                    REQUIRE(alignments[i].queryStart == alignment.queryStart);
+                    REQUIRE(alignments[i].queryEnd == alignment.queryEnd);
+                    REQUIRE(alignments[i].edits == alignment.edits);
+                    REQUIRE(alignments[i].score == alignment.score);
+                }
+            }
+        }
+    }
+
+    // an empty batch is fine too
+    SmithWaterman aligner("GTTTCAATCCACGCGCCCACGCGGATGCGAC");
+    std::vector<SW_Window> windows;
+    std::vector<SW_Alignment> alignments;
+    std::vector<bool> found;
+    aligner.alignAnchoredBatch(windows, SW_ANCHOR_FRONT, similarity, alignments, found);
+    REQUIRE(alignments.empty());
+    REQUIRE(found.empty());
+}
@@ -0,0 +1,112 @@
+#include <string>
+#include <vector>
+#include <sstream>
+#include <pthread.h>
+
+#include "catch.hpp"
+#include "StringCheck.h"
+#include "Exception.h"
+
+TEST_CASE("string checks hand out a new token for every string added", "[StringCheck]") {
+    StringCheck strings;
+    REQUIRE(strings.getToken("ACGT") == 0);
+    StringToken first = strings.addString("ACGT");
+    StringToken second = strings.addString("TTGCA");
+    StringToken again = strings.addString("ACGT");
+    REQUIRE(first == 2);
+    REQUIRE(second == 3);
+    REQUIRE(again == 4);
+    REQUIRE(strings.getString(first) == "ACGT");
+    REQUIRE(strings.getString(again) == "ACGT");
+    // the newest token wins
+    REQUIRE(strings.getToken("ACGT") == again);
+    REQUIRE(strings.getToken("TTGCA") == second);
+    REQUIRE(strings.getToken("TTGC") == 0);
+    REQUIRE_THROWS_AS(strings.getString(1), const crispr::exception&);
+    REQUIRE_THROWS_AS(strings.getString(5), const crispr::exception&);
+
+    // big strings and the empty string are fine too
+    std::string big(100000, 'G');
+    StringToken big_token = strings.addString(big);
+    StringToken empty_token = strings.addString("");
+    REQUIRE(strings.getString(big_token) == big);
+    REQUIRE(strings.getString(empty_token) == "");
+    REQUIRE(strings.getToken("") == empty_token);
+}
+
+struct StringCheckWorker {
+    StringCheck * strings;
+    int id;
+    int count;
+    std::vector<StringToken> tokens;
+    int failures;
+};
+
+static std::string workerString(int id, int i) {
+    std::stringstream ss;
+    ss << "read_" << id << "_" << i;
+    return ss.str();
+}
+
+static void * stringCheckWork(void * arg) {
+    StringCheckWorker * worker = static_cast<StringCheckWorker *>(arg);
+    for (int i = 0; i < worker->count; ++i) {
+        std::string mine = workerString(worker->id, i);
+        StringToken token = worker->strings->addString(mine);
+        worker->tokens.push_back(token);
+        if (worker->strings->getString(token) != mine || worker->strings->getToken(mine) != token) {
+            worker->failures++;
+        }
+        // everyone also adds the same shared strings, and reads the other
+        // threads' strings while they may still be going in
+        StringToken shared = worker->strings->addString(workerString(-1, i % 50));
+        if (worker->strings->getString(shared) != workerString(-1, i % 50)) {
+            worker->failures++;
+        }
+        StringToken theirs = worker->strings->getToken(workerString((worker->id + 1) % 8, i));
+        if (theirs != 0 && worker->strings->getString(theirs) != workerString((worker->id + 1) % 8, i)) {
+            worker->failures++;
+        }
+    }
+    return NULL;
+}
+
+TEST_CASE("string checks can be filled from many threads at once", "[StringCheck]") {
+    StringCheck strings;
+    const int num_threads = 8;
+    const int count = 20000;
+    std::vector<StringCheckWorker> workers(num_threads);
+    std::vector<pthread_t> threads(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+        workers[t].strings = &strings;
+        workers[t].id = t;
+        workers[t].count = count;
+        workers[t].failures = 0;
+    }
+    for (int t = 0; t < num_threads; ++t) {
+        REQUIRE(pthread_create(&threads[t], NULL, stringCheckWork, &workers[t]) == 0);
+    }
+    for (int t = 0; t < num_threads; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+
+    std::vector<bool> seen(2 * num_threads * count + 2, false);
+    for (int t = 0; t < num_threads; ++t) {
+        REQUIRE(workers[t].failures == 0);
+        for (int i = 0; i < count; ++i) {
+            StringToken token = workers[t].tokens[i];
+            REQUIRE(token > 1);
+            REQUIRE(token < static_cast<StringToken>(seen.size()));
+            // no token is handed out twice
+            REQUIRE_FALSE(seen[token]);
+            seen[token] = true;
+            REQUIRE(strings.getString(token) == workerString(t, i));
+            REQUIRE(strings.getToken(workerString(t, i)) == token);
+        }
+    }
+    for (int i = 0; i < 50; ++i) {
+        StringToken shared = strings.getToken(workerString(-1, i));
+        REQUIRE(shared != 0);
+        REQUIRE(strings.getString(shared) == workerString(-1, i));
+    }
+}
@@ -0,0 +1,47 @@
+#include <vector>
+
+#include "catch.hpp"
+#include "TokenBitmap.h"
+#include "TestUtils.h"
+
+TEST_CASE("token bitmaps stay in order through unions", "[TokenBitmap]") {
+    unsigned int state = 11;
+    TokenBitmap sparse, dense;
+    std::vector<bool> expected(300000, false);
+    for (int i = 0; i < 2000; ++i) {
+        StringToken token = (nextRandom(state) << 3) ^ nextRandom(state);
+        sparse.add(token);
+        expected[token] = true;
+    }
+    // enough in one chunk that it has to turn into a bitmap
+    std::vector<StringToken> run;
+    for (StringToken token = 70000; token < 80000; token += 2) {
+        run.push_back(token);
+    }
+    dense.add(&run[0], &run[0] + run.size());
+    dense.add(&run[0], &run[0] + run.size());
+    REQUIRE(dense.size() == run.size());
+    REQUIRE(dense.contains(70002));
+    REQUIRE_FALSE(dense.contains(70003));
+    for (size_t i = 0; i < run.size(); ++i) {
+        expected[run[i]] = true;
+    }
+
+    sparse |= dense;
+    dense |= sparse;
+    std::vector<StringToken> from_sparse, from_dense;
+    sparse.getTokens(from_sparse);
+    dense.getTokens(from_dense);
+    REQUIRE(from_sparse == from_dense);
+    REQUIRE(sparse.size() == from_sparse.size());
+
+    std::vector<StringToken> wanted;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (expected[i]) {
+            wanted.push_back(static_cast<StringToken>(i));
+        }
+    }
+    REQUIRE(from_sparse == wanted);
+    sparse.clear();
+    REQUIRE(sparse.empty());
+}
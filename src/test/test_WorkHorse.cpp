@@ -0,0 +1,379 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "catch.hpp"
+#include "crassDefines.h"
+#include "Exception.h"
+#include "SeqUtils.h"
+#include "StlExt.h"
+#include "WorkHorse.h"
+#include "TestUtils.h"
+
+static const std::string kFirstDR = "GTTTCAATCCACGCGCCCACGCGGAGCGCGAC";
+static const std::string kSecondDR = "GTTGAAGTGGTACTTCCAGTAAAACAAGGATTGAAAC";
+
+class WorkHorseTest {
+public:
+    // run crass on the reads in files with the options in opts, the
+    // timestamp keeps each run's ID apart
+    WorkHorseTest(options& opts, const std::string& timestamp, const std::string& file)
+    : WHT_Horse(&opts, timestamp, "test"), WHT_Output(NULL)
+    {
+        Vecstr files;
+        if (!file.empty()) {
+            files.push_back(file);
+        }
+        // keep the progress messages out of the test output
+        std::stringstream progress;
+        std::streambuf * cout_buffer = std::cout.rdbuf(progress.rdbuf());
+        try {
+            WHT_Result = WHT_Horse.doWork(files);
+        } catch (crispr::exception& e) {
+            // crass reports these and gives up, so the run failed
+            WHT_Result = -1;
+        }
+        std::cout.rdbuf(cout_buffer);
+    }
+
+    // a crass that hasn't done anything yet, for going through the
+    // assembly a step at a time
+    WorkHorseTest(options& opts, const std::string& timestamp)
+    : WHT_Horse(&opts, timestamp, "test"), WHT_Result(0), WHT_Output(NULL)
+    {}
+
+    ~WorkHorseTest()
+    {
+        for (size_t i = 0; i < WHT_Tasks.size(); ++i) {
+            delete WHT_Tasks[i];
+        }
+        delete WHT_Output;
+    }
+
+    // load the groups in the snapshots and set them up for assembly the
+    // way assembleGroups does, lowest GID first
+    void loadGroups(const Vecstr& snapshots)
+    {
+        REQUIRE(WHT_Horse.loadGraphSnapshots(snapshots) == 0);
+        std::stringstream progress;
+        std::streambuf * cout_buffer = std::cout.rdbuf(progress.rdbuf());
+        REQUIRE(WHT_Horse.openOutput() == 0);
+        std::cout.rdbuf(cout_buffer);
+        WHT_Output = new GroupOutputQueue(&WHT_Horse, WHT_Horse.mDR2GIDMap.size());
+        DR_Cluster_MapIterator drg_iter;
+        for (drg_iter = WHT_Horse.mDR2GIDMap.begin(); drg_iter != WHT_Horse.mDR2GIDMap.end(); ++drg_iter) {
+            WHT_GIDs.push_back(drg_iter->first);
+            WHT_Tasks.push_back(WHT_Horse.newGroupTask(drg_iter->first, drg_iter->second, WHT_Output, WHT_Tasks.size()));
+        }
+    }
+
+    int gid(size_t index) { return WHT_GIDs[index]; }
+    int assemble(size_t index) { return WHT_Tasks[index]->run(); }
+    bool holdsManager(size_t index) { return NULL != WHT_Horse.mDRs[WHT_Horse.mTrueDRs[WHT_GIDs[index]]]; }
+    int groupsOutput(void) { return WHT_Horse.mGroupsOutput; }
+    std::string outputName(void) { return WHT_Horse.mOutputName; }
+
+    int closeOutput(void)
+    {
+        std::stringstream progress;
+        std::streambuf * cout_buffer = std::cout.rdbuf(progress.rdbuf());
+        int retval = WHT_Horse.closeOutput();
+        std::cout.rdbuf(cout_buffer);
+        return retval;
+    }
+
+    int result(void) { return WHT_Result; }
+    size_t priorClusters(void) { return WHT_Horse.mPriorClusters.size(); }
+
+    // the group whose true DR has dr in it, either way round
+    int groupOf(const std::string& dr)
+    {
+        std::map<int, std::string>::iterator tdr_iter;
+        for (tdr_iter = WHT_Horse.mTrueDRs.begin(); tdr_iter != WHT_Horse.mTrueDRs.end(); ++tdr_iter) {
+            if (tdr_iter->second.find(dr) != std::string::npos || tdr_iter->second.find(reverseComplement(dr)) != std::string::npos) {
+                return tdr_iter->first;
+            }
+        }
+        return 0;
+    }
+
+    // groups that were copied through start from the stage their snapshot was taken at
+    bool copied(const std::string& dr)
+    {
+        int GID = groupOf(dr);
+        REQUIRE(GID != 0);
+        return WHT_Horse.mFirstStages.find(GID) != WHT_Horse.mFirstStages.end();
+    }
+
+    std::string snapshotOf(const std::string& dr) { return WHT_Horse.mSnapshotFiles[groupOf(dr)]; }
+
+    // write the cluster index again as if the cluster with dr had made
+    // trueDR instead, or as if the run had another ID
+    void rewriteIndex(const std::string& dr, const std::string& trueDR, const std::string& runID)
+    {
+        int GID = groupOf(dr);
+        std::map<int, ClusterRecord>::iterator cluster_iter = WHT_Horse.mClusters.find(GID);
+        REQUIRE(cluster_iter != WHT_Horse.mClusters.end());
+        cluster_iter->second.outcome.trueDRs[0] = trueDR;
+        WHT_Horse.mRunID = runID;
+        WHT_Horse.writeClusterIndex();
+    }
+
+    std::string trueDR(const std::string& dr) { return WHT_Horse.mTrueDRs[groupOf(dr)]; }
+    std::string runID(void) { return WHT_Horse.mRunID; }
+
+private:
+    WorkHorse WHT_Horse;
+    int WHT_Result;
+    GroupOutputQueue * WHT_Output;
+    std::vector<GroupAssemblyTask *> WHT_Tasks;
+    std::vector<int> WHT_GIDs;
+};
+
+static options testOptions(const std::string& dir)
+{
+    options opts;
+    opts.logLevel              = CRASS_DEF_DEFAULT_LOGGING;
+    opts.reportStats           = CRASS_DEF_STATS_REPORT;
+    opts.lowDRsize             = CRASS_DEF_MIN_DR_SIZE;
+    opts.highDRsize            = CRASS_DEF_MAX_DR_SIZE;
+    opts.lowSpacerSize         = CRASS_DEF_MIN_SPACER_SIZE;
+    opts.highSpacerSize        = CRASS_DEF_MAX_SPACER_SIZE;
+    opts.output_fastq          = dir;
+    opts.delim                 = CRASS_DEF_STATS_REPORT_DELIM;
+    opts.kmer_clust_size       = CRASS_DEF_K_CLUST_MIN;
+    opts.searchWindowLength    = CRASS_DEF_OPTIMAL_SEARCH_WINDOW_LENGTH;
+    opts.minNumRepeats         = CRASS_DEF_DEFAULT_MIN_NUM_REPEATS;
+    opts.logToScreen           = true;                      // there's no log file to point the output at
+    opts.coverageBins          = CRASS_DEF_NUM_OF_BINS;
+    opts.graphColourType       = CRASS_DEF_GRAPH_COLOUR;
+    opts.longDescription       = CRASS_DEF_SPACER_LONG_DESC;
+    opts.showSingles           = CRASS_DEF_SPACER_SHOW_SINGLES;
+    opts.sourcesFile           = CRASS_DEF_SOURCES_FILE;
+    opts.cNodeKmerLength       = CRASS_DEF_NODE_KMER_SIZE;
+    opts.checkpointFile        = dir + "first.checkpoint";
+    opts.resumeFrom            = "";
+    opts.graphSnapshots        = dir;
+    opts.fromGraphSnapshots    = false;
+#ifdef DEBUG
+    opts.noDebugGraph          = true;
+#endif
+#ifdef SEARCH_SINGLETON
+    opts.searchChecker         = "";
+#endif
+#ifdef RENDERING
+    opts.layoutAlgorithm       = DEFAULT_RENDERING_ALGORITHM;
+    opts.noRendering           = true;
+#endif
+    opts.covCutoff             = CRASS_DEF_COVCUTOFF;
+    opts.numThreads            = CRASS_DEF_NUM_THREADS;
+    return opts;
+}
+
+// random sequence that shares no 6-mer with either DR, so it is never
+// taken for a partial repeat
+static std::string flank(unsigned int& state)
+{
+    for (;;) {
+        std::string seq = randomSequence(state, 40);
+        bool clean = true;
+        for (size_t i = 0; i + 6 <= seq.length(); ++i) {
+            std::string kmer = seq.substr(i, 6);
+            if (kFirstDR.find(kmer) != std::string::npos || kSecondDR.find(kmer) != std::string::npos) {
+                clean = false;
+            }
+        }
+        if (clean) {
+            return seq;
+        }
+    }
+}
+
+// reads that each run through three or four spacers of one array
+static void writeArrayReads(std::ofstream& out, unsigned int& state, const std::string& name, const std::string& dr, int spacerSeed, int readCount)
+{
+    unsigned int spacer_state = spacerSeed;
+    std::vector<std::string> spacers;
+    for (int i = 0; i < 12; ++i) {
+        spacers.push_back(randomSequence(spacer_state, 30 + nextRandom(spacer_state) % 6));
+    }
+    for (int i = 0; i < readCount; ++i) {
+        int first = nextRandom(state) % 8;
+        int count = 3 + nextRandom(state) % 2;
+        std::string seq = flank(state) + dr;
+        for (int j = first; j < first + count; ++j) {
+            seq += spacers[j] + dr;
+        }
+        out << ">" << name << "_" << i << "\n" << seq << flank(state) << "\n";
+    }
+}
+
+static void writeReads(const std::string& fileName, unsigned int state, int firstReads, int secondReads)
+{
+    std::ofstream out(fileName.c_str());
+    writeArrayReads(out, state, "first_" + fileName.substr(fileName.length() - 4), kFirstDR, 3, firstReads);
+    writeArrayReads(out, state, "second_" + fileName.substr(fileName.length() - 4), kSecondDR, 5, secondReads);
+}
+
+static void removeDirectory(const std::string& dir)
+{
+    DIR * listing = opendir(dir.c_str());
+    if (NULL == listing) {
+        return;
+    }
+    struct dirent * entry;
+    while (NULL != (entry = readdir(listing))) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..") {
+            unlink((dir + name).c_str());
+        }
+    }
+    closedir(listing);
+    rmdir(dir.c_str());
+}
+
+TEST_CASE("resuming copies unchanged clusters and redoes the rest", "[WorkHorse]") {
+    char dir_name[] = "/tmp/crass_test_XXXXXX";
+    REQUIRE(NULL != mkdtemp(dir_name));
+    std::string dir = std::string(dir_name) + "/";
+    options opts = testOptions(dir);
+    writeReads(dir + "reads.fa", 7, 40, 40);
+
+    WorkHorseTest first(opts, "first", dir + "reads.fa");
+    REQUIRE(first.result() == 0);
+    REQUIRE(first.groupOf(kFirstDR) != 0);
+    REQUIRE(first.groupOf(kSecondDR) != 0);
+
+    options resumed = opts;
+    resumed.resumeFrom = opts.checkpointFile;
+    resumed.checkpointFile = "";
+
+    SECTION("a cluster nothing was added to is copied, one with more reads is redone") {
+        // more reads for the second array only
+        writeReads(dir + "more.fa", 11, 0, 10);
+        WorkHorseTest second(resumed, "second", dir + "more.fa");
+        REQUIRE(second.result() == 0);
+        REQUIRE(second.priorClusters() == 2);
+        REQUIRE(second.copied(kFirstDR));
+        REQUIRE_FALSE(second.copied(kSecondDR));
+        REQUIRE(second.groupOf(kFirstDR) == first.groupOf(kFirstDR));
+        REQUIRE(second.trueDR(kFirstDR) == first.trueDR(kFirstDR));
+    }
+    SECTION("with nothing new every cluster is copied") {
+        WorkHorseTest second(resumed, "second", "");
+        REQUIRE(second.result() == 0);
+        REQUIRE(second.copied(kFirstDR));
+        REQUIRE(second.copied(kSecondDR));
+    }
+    SECTION("a copy that would collide with a redone group of the same true DR is redone") {
+        // the index says the first cluster made the second one's true DR,
+        // and the second cluster is redone because it gets more reads
+        first.rewriteIndex(kFirstDR, first.trueDR(kSecondDR), first.runID());
+        writeReads(dir + "more.fa", 11, 0, 10);
+        WorkHorseTest second(resumed, "second", dir + "more.fa");
+        REQUIRE(second.result() == 0);
+        REQUIRE(second.priorClusters() == 2);
+        REQUIRE_FALSE(second.copied(kFirstDR));
+        REQUIRE_FALSE(second.copied(kSecondDR));
+        REQUIRE(second.trueDR(kFirstDR) == first.trueDR(kFirstDR));
+    }
+    SECTION("a missing snapshot means the cluster is redone") {
+        REQUIRE(0 == unlink(first.snapshotOf(kFirstDR).c_str()));
+        WorkHorseTest second(resumed, "second", "");
+        REQUIRE(second.result() == 0);
+        REQUIRE_FALSE(second.copied(kFirstDR));
+        REQUIRE(second.copied(kSecondDR));
+    }
+    SECTION("a snapshot of another group means the cluster is redone") {
+        std::ifstream in(first.snapshotOf(kSecondDR).c_str(), std::ios::binary);
+        std::ofstream out(first.snapshotOf(kFirstDR).c_str(), std::ios::binary);
+        out << in.rdbuf();
+        out.close();
+        WorkHorseTest second(resumed, "second", "");
+        REQUIRE(second.result() == 0);
+        REQUIRE_FALSE(second.copied(kFirstDR));
+        REQUIRE(second.copied(kSecondDR));
+    }
+    SECTION("an index from another run is ignored") {
+        first.rewriteIndex(kFirstDR, first.trueDR(kFirstDR), "another run");
+        WorkHorseTest second(resumed, "second", "");
+        REQUIRE(second.result() == 0);
+        REQUIRE(second.priorClusters() == 0);
+        REQUIRE_FALSE(second.copied(kFirstDR));
+        REQUIRE_FALSE(second.copied(kSecondDR));
+    }
+    SECTION("an index made with other options is ignored rather than failing the run") {
+        resumed.covCutoff = opts.covCutoff + 1;
+        WorkHorseTest second(resumed, "second", "");
+        REQUIRE(second.result() == 0);
+        REQUIRE(second.priorClusters() == 0);
+        REQUIRE_FALSE(second.copied(kFirstDR));
+        REQUIRE_FALSE(second.copied(kSecondDR));
+    }
+    SECTION("a search run with other DR, spacer, window or repeat options fails the run") {
+        resumed.lowSpacerSize = opts.lowSpacerSize + 1;
+        WorkHorseTest second(resumed, "second", "");
+        REQUIRE(second.result() != 0);
+    }
+    SECTION("an index that can't be read is ignored rather than failing the run") {
+        std::ofstream out((dir + CRASS_DEF_CLUSTER_INDEX_FILE).c_str());
+        out << "not a cluster index";
+        out.close();
+        WorkHorseTest second(resumed, "second", "");
+        REQUIRE(second.result() == 0);
+        REQUIRE(second.priorClusters() == 0);
+        REQUIRE_FALSE(second.copied(kFirstDR));
+    }
+    removeDirectory(dir);
+}
+
+TEST_CASE("a group's node manager is freed before the groups ahead of it are done", "[WorkHorse]") {
+    char dir_name[] = "/tmp/crass_test_XXXXXX";
+    REQUIRE(NULL != mkdtemp(dir_name));
+    std::string dir = std::string(dir_name) + "/";
+    options opts = testOptions(dir);
+    writeReads(dir + "reads.fa", 7, 40, 40);
+    
+    WorkHorseTest first(opts, "first", dir + "reads.fa");
+    REQUIRE(first.result() == 0);
+    Vecstr snapshots;
+    snapshots.push_back(first.snapshotOf(kFirstDR));
+    snapshots.push_back(first.snapshotOf(kSecondDR));
+    
+    options loaded = opts;
+    loaded.fromGraphSnapshots = true;
+    loaded.checkpointFile = "";
+    WorkHorseTest second(loaded, "second");
+    second.loadGroups(snapshots);
+    REQUIRE(second.holdsManager(0));
+    REQUIRE(second.holdsManager(1));
+    
+    // the later group is done first and lets its manager go even though
+    // it can't go in the XML until the one before it has
+    REQUIRE(second.assemble(1) == 0);
+    REQUIRE_FALSE(second.holdsManager(1));
+    REQUIRE(second.holdsManager(0));
+    REQUIRE(second.groupsOutput() == 0);
+    
+    REQUIRE(second.assemble(0) == 0);
+    REQUIRE_FALSE(second.holdsManager(0));
+    REQUIRE(second.groupsOutput() == 2);
+    REQUIRE(second.closeOutput() == 0);
+    
+    // and they still went out in GID order
+    std::ifstream in(second.outputName().c_str());
+    std::stringstream xml;
+    xml << in.rdbuf();
+    size_t first_group = xml.str().find("gid=\"G" + to_string(second.gid(0)) + "\"");
+    size_t second_group = xml.str().find("gid=\"G" + to_string(second.gid(1)) + "\"");
+    REQUIRE(first_group != std::string::npos);
+    REQUIRE(second_group != std::string::npos);
+    REQUIRE(first_group < second_group);
+    removeDirectory(dir);
+}
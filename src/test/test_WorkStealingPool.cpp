@@ -0,0 +1,56 @@
+#include <vector>
+#include <pthread.h>
+
+#include "catch.hpp"
+#include "WorkStealingPool.h"
+#include "Exception.h"
+
+class CountingTask : public PoolTask {
+public:
+    CountingTask(size_t cost, int result, bool doThrow): PoolTask(cost), runs(0), CT_result(result), CT_throw(doThrow) {}
+
+    int run(void) {
+        // spin for a bit so the threads overlap and have to steal
+        volatile size_t sink = 0;
+        for (size_t i = 0; i < cost() * 1000; ++i) {
+            sink += i;
+        }
+        __sync_fetch_and_add(&runs, 1);
+        if (CT_throw) {
+            throw crispr::exception(__FILE__, __LINE__, __PRETTY_FUNCTION__, "task blew up");
+        }
+        return CT_result;
+    }
+
+    int runs;
+
+private:
+    int CT_result;
+    bool CT_throw;
+};
+
+TEST_CASE("the pool runs every task exactly once", "[WorkStealingPool]") {
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        std::vector<CountingTask *> counting;
+        std::vector<PoolTask *> tasks;
+        // one huge task and lots of little ones
+        counting.push_back(new CountingTask(5000, 0, false));
+        for (int i = 0; i < 500; ++i) {
+            counting.push_back(new CountingTask(1 + i % 7, (i % 100 == 3) ? 1 : 0, i == 250));
+        }
+        tasks.assign(counting.begin(), counting.end());
+
+        WorkStealingPool pool(threads);
+        REQUIRE(pool.numThreads() == threads);
+        // five tasks fail and one throws
+        REQUIRE(pool.runAll(tasks) == 6);
+        for (size_t i = 0; i < counting.size(); ++i) {
+            REQUIRE(counting[i]->runs == 1);
+            delete counting[i];
+        }
+
+        // and the pool can be used again, even with nothing to do
+        std::vector<PoolTask *> none;
+        REQUIRE(pool.runAll(none) == 0);
+    }
+}
@@ -0,0 +1,100 @@
+#include <cstdlib>
+#include <vector>
+
+#include "catch.hpp"
+#include "ksw.h"
+#include "TestUtils.h"
+
+// a DR and a copy of it with substitutions, indels and a shift, in nt4 codes
+static void makeDRPair(unsigned int& state, std::vector<uint8_t>& master, std::vector<uint8_t>& slave)
+{
+    int master_length = 20 + nextRandom(state) % 30;
+    int j = static_cast<int>(nextRandom(state) % 11) - 5;
+    master.resize(master_length);
+    slave.clear();
+    for (int i = 0; i < master_length; ++i) {
+        master[i] = (nextRandom(state) % 50 == 0) ? 4 : nextRandom(state) % 4;
+    }
+    while (j < master_length + 5) {
+        unsigned int what = nextRandom(state) % 16;
+        if (j < 0 || j >= master_length || what == 0) {
+            slave.push_back(nextRandom(state) % 4);
+            ++j;
+        } else if (what == 1) {
+            // deletion
+            j += 1 + nextRandom(state) % 3;
+        } else if (what == 2) {
+            // insertion
+            for (unsigned int k = 0; k <= nextRandom(state) % 3; ++k) {
+                slave.push_back(nextRandom(state) % 4);
+            }
+        } else {
+            slave.push_back(master[j++]);
+        }
+    }
+}
+
+static kswr_t alignWith(int simd, int size, std::vector<uint8_t>& master, std::vector<uint8_t>& slave, const int8_t * mat, int xtra)
+{
+    kswq_t * q = ksw_qinit_simd(simd, size, master.size(), &master[0], 5, mat);
+    kswr_t r = (size == 2) ? ksw_i16(q, slave.size(), &slave[0], 5, 2, xtra) : ksw_u8(q, slave.size(), &slave[0], 5, 2, xtra);
+    free(q);
+    return r;
+}
+
+TEST_CASE("all of the ksw kernels give the same alignment", "[ksw]") {
+    // the same scoring that the Aligner uses
+    int8_t mat[25];
+    for (int i = 0; i < 5; ++i) {
+        for (int j = 0; j < 5; ++j) {
+            mat[i * 5 + j] = (i == 4 || j == 4) ? 0 : ((i == j) ? 1 : -3);
+        }
+    }
+    int xtras[3] = {KSW_XSUBO | 5, KSW_XSTOP | 12, 0};
+    
+    if (ksw_simd_level() < KSW_SIMD_AVX512) {
+        WARN("this CPU can't run every kernel, the missing ones fall back to the widest it has");
+    }
+    
+    unsigned int state = 42;
+    std::vector<uint8_t> master, slave;
+    for (int pair = 0; pair < 2000; ++pair) {
+        makeDRPair(state, master, slave);
+        for (int size = 1; size <= 2; ++size) {
+            for (int x = 0; x < 3; ++x) {
+                kswr_t sse2 = alignWith(KSW_SIMD_SSE2, size, master, slave, mat, xtras[x]);
+                for (int simd = KSW_SIMD_AVX2; simd <= KSW_SIMD_AVX512; ++simd) {
+                    kswr_t wide = alignWith(simd, size, master, slave, mat, xtras[x]);
+                    REQUIRE(wide.score == sse2.score);
+                    REQUIRE(wide.te == sse2.te);
+                    REQUIRE(wide.qe == sse2.qe);
+                    REQUIRE(wide.score2 == sse2.score2);
+                    REQUIRE(wide.te2 == sse2.te2);
+                    REQUIRE(wide.tb == sse2.tb);
+                    REQUIRE(wide.qb == sse2.qb);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("ksw_align finds the offset of a shifted DR", "[ksw]") {
+    int8_t mat[25];
+    for (int i = 0; i < 5; ++i) {
+        for (int j = 0; j < 5; ++j) {
+            mat[i * 5 + j] = (i == 4 || j == 4) ? 0 : ((i == j) ? 1 : -3);
+        }
+    }
+    // GTTTCAATCCACGCGCCCACGCGGATGCGAC against the same DR missing its first three bases
+    const char * dr = "GTTTCAATCCACGCGCCCACGCGGATGCGAC";
+    std::vector<uint8_t> master, slave;
+    for (const char * c = dr; *c; ++c) {
+        master.push_back((*c == 'A') ? 0 : (*c == 'C') ? 1 : (*c == 'G') ? 2 : 3);
+    }
+    slave.assign(master.begin() + 3, master.end());
+    
+    kswr_t r = ksw_align(slave.size(), &slave[0], master.size(), &master[0], 5, mat, 5, 2, KSW_XSTART | KSW_XSUBO | 5, 0);
+    REQUIRE(r.score == static_cast<int>(slave.size()));
+    REQUIRE(r.tb - r.qb == 3);
+    REQUIRE(r.te == static_cast<int>(master.size()) - 1);
+}
@@ -0,0 +1,128 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "catch.hpp"
+#include "Exception.h"
+#include "streamer.h"
+#include "TestUtils.h"
+
+TEST_CASE("streamed crispr files nest and escape like the DOM writer", "[streamer]") {
+    TempFile file("crass_test_streamer");
+
+    {
+        crispr::xml::streamer out;
+        REQUIRE(out.open(file.name(), "crispr", "1.1"));
+        std::string gid = "G1";
+        std::string dr = "GTTTCAATCC";
+        out.beginGroup(gid, dr);
+        out.beginElement("data");
+        out.beginElement("sources");
+        std::string accession = "read_1 \"a<b>&c\"";
+        std::string soid = "SO1";
+        out.addSource(accession, soid);
+        out.endElement();
+        out.beginElement("spacers");
+        std::string seq = "ACGT";
+        std::string spid = "SP1";
+        std::string cov = "3";
+        out.beginSpacer(seq, spid, cov);
+        out.addSpacerSource(soid);
+        out.endElement();
+        out.endElement();
+        out.endElement();
+        out.beginElement("metadata");
+        out.addTextElement("notes", "one & two");
+        out.endElement();
+        out.beginElement("assembly");
+        std::string cid = "C1";
+        out.beginContig(cid);
+        out.endElement();
+        // the group and the root are left for close to finish off
+        out.flush();
+        REQUIRE(out.close());
+        REQUIRE_FALSE(out.isOpen());
+    }
+
+    std::ifstream in(file.name());
+    std::stringstream written;
+    written << in.rdbuf();
+    REQUIRE(written.str() ==
+            "<?xml version=\"1.0\" encoding=\"ISO8859-1\" standalone=\"no\" ?>\n"
+            "<crispr version=\"1.1\">\n"
+            "  <group gid=\"G1\" drseq=\"GTTTCAATCC\">\n"
+            "    <data>\n"
+            "      <sources>\n"
+            "        <source accession=\"read_1 &quot;a&lt;b&gt;&amp;c&quot;\" soid=\"SO1\"/>\n"
+            "      </sources>\n"
+            "      <spacers>\n"
+            "        <spacer seq=\"ACGT\" spid=\"SP1\" cov=\"3\">\n"
+            "          <source soid=\"SO1\"/>\n"
+            "        </spacer>\n"
+            "      </spacers>\n"
+            "    </data>\n"
+            "    <metadata>\n"
+            "      <notes>one &amp; two</notes>\n"
+            "    </metadata>\n"
+            "    <assembly>\n"
+            "      <contig cid=\"C1\"/>\n"
+            "    </assembly>\n"
+            "  </group>\n"
+            "</crispr>\n");
+
+    crispr::xml::streamer nowhere;
+    REQUIRE_FALSE(nowhere.open("/nonexistent/dir/crass.crispr", "crispr", "1.1"));
+}
+
+TEST_CASE("ending more elements than were begun throws", "[streamer]") {
+    TempFile file("crass_test_streamer");
+
+    crispr::xml::streamer out;
+    REQUIRE_THROWS_AS(out.endElement(), crispr::xml_exception);
+    REQUIRE(out.open(file.name(), "crispr", "1.1"));
+    out.beginElement("group");
+    out.endElement();
+    // this one ends the root
+    out.endElement();
+    REQUIRE_THROWS_AS(out.endElement(), crispr::xml_exception);
+    REQUIRE(out.close());
+}
+
+TEST_CASE("a group written as a fragment comes out as if it was written in place", "[streamer]") {
+    TempFile file("crass_test_streamer");
+
+    std::stringstream fragment;
+    {
+        crispr::xml::streamer group(fragment, 1);
+        std::string gid = "G2";
+        std::string dr = "GTTTCAATCC";
+        group.beginGroup(gid, dr);
+        group.beginElement("data");
+        std::string drid = "DR1";
+        group.addDirectRepeat(drid, dr);
+        group.endElement();
+        group.endElement();
+        // only the group was begun in here
+        REQUIRE_THROWS_AS(group.endElement(), crispr::xml_exception);
+    }
+
+    {
+        crispr::xml::streamer out;
+        REQUIRE(out.open(file.name(), "crispr", "1.1"));
+        out.addFragment(fragment.str());
+        REQUIRE(out.close());
+    }
+
+    std::ifstream in(file.name());
+    std::stringstream written;
+    written << in.rdbuf();
+    REQUIRE(written.str() ==
+            "<?xml version=\"1.0\" encoding=\"ISO8859-1\" standalone=\"no\" ?>\n"
+            "<crispr version=\"1.1\">\n"
+            "  <group gid=\"G2\" drseq=\"GTTTCAATCC\">\n"
+            "    <data>\n"
+            "      <dr seq=\"GTTTCAATCC\" drid=\"DR1\"/>\n"
+            "    </data>\n"
+            "  </group>\n"
+            "</crispr>\n");
+}